@@ -28,6 +28,7 @@ macx {
 unix {
     INCLUDEPATH += /usr/include/botan-1.10
     LIBS += /usr/lib/libbotan-1.10.so.0
+    LIBS += -lpthread
 }
 
 # phonon, icon
@@ -93,6 +94,8 @@ SOURCES += main.cpp \
     json.cpp \
     githubcommitsdialog.cpp \
     gpduploader.cpp \
+    gpdloader.cpp \
+    jobscheduler.cpp \
     fatxpathgendialog.cpp \
     profilecleanerwizard.cpp \
     svoddialog.cpp \
@@ -142,6 +145,8 @@ HEADERS  += mainwindow.h \
     json.h \
     githubcommitsdialog.h \
     gpduploader.h \
+    gpdloader.h \
+    jobscheduler.h \
     fatxpathgendialog.h \
     profilecleanerwizard.h \
     svoddialog.h \
@@ -6,7 +6,8 @@
 DeviceViewer::DeviceViewer(QStatusBar *statusBar, QList<QAction *> gpdActions,
         QList<QAction *> gameActions, QWidget *parent) :
     QDialog(parent), ui(new Ui::DeviceViewer), currentDrive(NULL), parentEntry(NULL),
-    gpdActions(gpdActions), gameActions(gameActions), statusBar(statusBar), drivesLoaded(false)
+    gpdActions(gpdActions), gameActions(gameActions), statusBar(statusBar), drivesLoaded(false),
+    countingMemory(false)
 {
     ui->setupUi(this);
 
@@ -41,22 +42,74 @@ DeviceViewer::DeviceViewer(QStatusBar *statusBar, QList<QAction *> gpdActions,
 
 DeviceViewer::~DeviceViewer()
 {
+    waitForDriveJobs();
+
     for (size_t i = 0; i < loadedDrives.size(); i++)
         delete loadedDrives.at(i);
 
     delete ui;
 }
 
+static QString driveResource(FatxDrive *drive)
+{
+    return "FatxDrive:" + QString::number((quintptr)drive, 16);
+}
+
+// counts the free memory on all of a drive's partitions, it reads the whole FAT so it can take a while.
+// The partitions are counted at the same time, and their root folders are read along the way
+class MemoryCountJob : public Job
+{
+public:
+    MemoryCountJob(FatxDrive *drive) :
+        Job(driveResource(drive)), drive(drive)
+    {
+    }
+
+    FatxDrive *GetDrive()
+    {
+        return drive;
+    }
+
+protected:
+    void Execute()
+    {
+        checkCancelled();
+        drive->MountPartitions(partitionCounted, this);
+    }
+
+private:
+    static void partitionCounted(void *arg, Partition *part)
+    {
+        static_cast<MemoryCountJob*>(arg)->checkCancelled();
+    }
+
+    FatxDrive *drive;
+};
+
 void DeviceViewer::DrawMemoryGraph()
 {
     UINT64 totalFreeSpace = 0;
     UINT64 totalSpace = 0;
 
-    if (!drivesLoaded)
+    if (countingMemory)
+        return;
+
+    // the first count is done on the job scheduler, the drive can't be used until it's done
+    if (!countedDrives.contains(currentDrive))
     {
+        countingMemory = true;
+        SetWidgetsEnabled(false);
+        ui->btnBack->setEnabled(false);
+
         progressBar->setVisible(true);
         progressBar->setMinimum(0);
         progressBar->setMaximum(0);
+        statusBar->showMessage("Counting free space...");
+
+        MemoryCountJob *job = new MemoryCountJob(currentDrive);
+        connect(job, SIGNAL(Finished(bool, QString)), this, SLOT(onMemoryCounted(bool, QString)));
+        JobScheduler::Instance()->Submit(job);
+        return;
     }
 
     // load the partion information
@@ -67,12 +120,6 @@ void DeviceViewer::DrawMemoryGraph()
         totalSpace += (UINT64)parts.at(i)->clusterCount * parts.at(i)->clusterSize;
     }
 
-    if (!drivesLoaded)
-    {
-        progressBar->setMaximum(1);
-        progressBar->setVisible(false);
-    }
-
     // calculate the percentage
     float freeMemPercentage = (((float)totalFreeSpace * 100.0) / totalSpace);
 
@@ -104,6 +151,42 @@ void DeviceViewer::DrawMemoryGraph()
             " of Used Space");
 }
 
+void DeviceViewer::onMemoryCounted(bool success, QString error)
+{
+    MemoryCountJob *job = static_cast<MemoryCountJob*>(sender());
+
+    countingMemory = false;
+    progressBar->setMaximum(1);
+    progressBar->setVisible(false);
+    SetWidgetsEnabled(true);
+    ui->btnBack->setEnabled(directoryChain.size() > 1);
+
+    if (!success)
+    {
+        statusBar->showMessage("");
+        QMessageBox::critical(this, "Error", "An error occurred while counting the free space.\n\n" +
+                error);
+        return;
+    }
+
+    statusBar->showMessage("Free space counted successfully", 3000);
+
+    // the drives might have been reloaded since the job was started
+    if (std::find(loadedDrives.begin(), loadedDrives.end(), job->GetDrive()) == loadedDrives.end())
+        return;
+    countedDrives.insert(job->GetDrive());
+
+    if (job->GetDrive() == currentDrive)
+        DrawMemoryGraph();
+}
+
+void DeviceViewer::waitForDriveJobs()
+{
+    JobScheduler *scheduler = JobScheduler::Instance();
+    for (size_t i = 0; i < loadedDrives.size(); i++)
+        scheduler->WaitForResource(driveResource(loadedDrives.at(i)));
+}
+
 void DeviceViewer::showContextMenu(QPoint point)
 {
     QPoint globalPos = ui->treeWidget->mapToGlobal(point);
@@ -175,7 +258,8 @@ void DeviceViewer::showContextMenu(QPoint point)
             // save the file to the local disk
             MultiProgressDialog *dialog = new MultiProgressDialog(OpExtract, FileSystemFATX, currentDrive,
                     path + "/", filesToExtract, this,
-                    QString::fromStdString(directoryChain.last()->path + directoryChain.last()->name + "\\"));
+                    QString::fromStdString(FatxDrive::GetFolderPath(directoryChain.last()) +
+                    directoryChain.last()->name + "\\"));
             dialog->setModal(true);
             dialog->show();
             dialog->start();
@@ -293,10 +377,7 @@ void DeviceViewer::showContextMenu(QPoint point)
                 return;
 
             FatxFileEntry *fileEntry = items.at(0)->data(0, Qt::UserRole).value<FatxFileEntry*>();
-            FatxIO io = currentDrive->GetFatxIO(fileEntry);
-
-            fileEntry->name = name.toStdString();
-            io.WriteEntryToDisk();
+            currentDrive->RenameFile(fileEntry, name.toStdString());
 
             items.at(0)->setText(0, name);
         }
@@ -346,8 +427,10 @@ void DeviceViewer::LoadDrives()
     // clear all the items
     ui->treeWidget->clear();
 
+    waitForDriveJobs();
     for (size_t i = 0; i < loadedDrives.size(); i++)
         delete loadedDrives.at(i);
+    countedDrives.clear();
 
     try
     {
@@ -424,6 +507,10 @@ void DeviceViewer::LoadDrives()
 
 void DeviceViewer::SetWidgetsEnabled(bool enabled)
 {
+    // nothing can touch the drive while its free memory is being counted
+    if (countingMemory)
+        enabled = false;
+
     ui->btnPartitions->setEnabled(enabled);
     ui->btnSecurityBlob->setEnabled(enabled);
     ui->txtDriveName->setEnabled(enabled);
@@ -564,7 +651,7 @@ void DeviceViewer::LoadFolderAll(FatxFileEntry *folder)
 
         parentEntry = folder;
 
-        ui->txtPath->setText(QString::fromStdString(folder->path + folder->name + "\\"));
+        ui->txtPath->setText(QString::fromStdString(FatxDrive::GetFolderPath(folder) + folder->name + "\\"));
     }
     catch (std::string error)
     {
@@ -810,8 +897,23 @@ void DeviceViewer::on_btnBackup_clicked()
     if (savePath == "")
         return;
 
-    SingleProgressDialog *dialog = new SingleProgressDialog(FileSystemFATX, currentDrive, OpBackup, "",
-            savePath, NULL, this);
+    // an incremental backup only stores what changed since the previous one
+    QString basePath = "";
+    int btn = QMessageBox::question(this, "Incremental Backup?",
+            "Would you like to only back up what has changed since a previous backup? The previous backup will be needed to restore from this one.",
+            QMessageBox::Yes, QMessageBox::No);
+    if (btn == QMessageBox::Yes)
+    {
+        basePath = QFileDialog::getOpenFileName(this, "Choose the previous backup",
+                QtHelpers::DefaultLocation() + "/Drive Backup.bin");
+
+        if (basePath == "")
+            return;
+    }
+
+    // the base backup's path is passed along as the internal path
+    SingleProgressDialog *dialog = new SingleProgressDialog(FileSystemFATX, currentDrive, OpBackup,
+            basePath, savePath, NULL, this);
     dialog->setModal(true);
     dialog->show();
     dialog->start();
@@ -15,6 +15,7 @@
 #include <QProgressBar>
 #include <QPixmap>
 #include <QAction>
+#include <QSet>
 #include "qthelpers.h"
 
 // forms
@@ -26,6 +27,7 @@
 #include "singleprogressdialog.h"
 #include "packageviewer.h"
 #include "flashdriveconfigdatadialog.h"
+#include "jobscheduler.h"
 
 // xbox
 #include "Fatx/FatxDriveDetection.h"
@@ -76,6 +78,7 @@ private slots:
     void on_btnShowAll_clicked();
     void on_txtPath_returnPressed();
     void on_txtDriveName_editingFinished();
+    void onMemoryCounted(bool success, QString error);
 
 private:
     Ui::DeviceViewer *ui;
@@ -90,6 +93,10 @@ private:
     QString previousName;
     bool drivesLoaded;
 
+    // the drives that have had their free memory counted, and if it's being counted right now
+    QSet<FatxDrive*> countedDrives;
+    bool countingMemory;
+
     void LoadFolderAll(FatxFileEntry *folder);
     void LoadFolderTree(QTreeWidgetItem *item);
     void LoadPartitions();
@@ -100,6 +107,7 @@ private:
     void InjectFiles(QList<void *> files, QString rootPath);
     void DrawHeader(QString driveName);
     void SetWidgetsEnabled(bool enabled);
+    void waitForDriveJobs();
 
     friend void updateUI(void *arg, bool finished);
     friend void updateUIDelete(void *arg);
@@ -14,7 +14,7 @@ FatxFileDialog::FatxFileDialog(FatxDrive *drive, FatxFileEntry *entry, DWORD clu
     ui->lblModified->setText(msTimeToString(entry->lastWriteDate));
     ui->lblAccessed->setText(msTimeToString(entry->lastAccessDate));
     ui->lblTypeOfFile->setText(getFileType(QString::fromStdString(entry->name)));
-    ui->lblLocation->setText(QString::fromStdString(entry->path));
+    ui->lblLocation->setText(QString::fromStdString(FatxDrive::GetFolderPath(entry)));
 
     if ((entry->fileAttributes & FatxDirectory) == 0)
     {
@@ -104,7 +104,11 @@ QString FatxFileDialog::getFileType(QString fileName)
 
 void FatxFileDialog::WriteEntryBack()
 {
-    entry->name = ui->txtName->text().toStdString();
+    // renaming goes through the drive so it can find the entry by its new name
+    std::string name = ui->txtName->text().toStdString();
+    if (name != entry->name)
+        drive->RenameFile(entry, name);
+
     entry->fileAttributes = 0;
 
     if (ui->chArchive->checkState() == Qt::Checked)
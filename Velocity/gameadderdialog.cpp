@@ -235,7 +235,6 @@ void GameAdderDialog::finishedDownloadingGpd(QString gamePath, QString awardPath
     delete downloader;
 
     ui->progressBar->setValue(((double)++downloadedCount / (double)totalDownloadCount) * 100);
-    QMutex m;
     if (!error)
     {
         if (!allowInjection)
@@ -253,9 +252,7 @@ void GameAdderDialog::finishedDownloadingGpd(QString gamePath, QString awardPath
         {
             qDebug() << "Started " << QString::fromStdWString(entry.gameName);
             // inject the game gpd
-            m.lock();
             package->InjectFile(gamePath.toStdString(), gpdName.toStdString());
-            m.unlock();
             QFile::remove(gamePath);
 
             if (!awardPath.isEmpty())
@@ -279,9 +276,7 @@ void GameAdderDialog::finishedDownloadingGpd(QString gamePath, QString awardPath
                         }
                         else
                         {
-                            m.lock();
                             package->ExtractFile("PEC", pecTempPath.toStdString());
-                            m.unlock();
                             existed = true;
                         }
                     }
@@ -290,18 +285,14 @@ void GameAdderDialog::finishedDownloadingGpd(QString gamePath, QString awardPath
                 }
 
                 // inject the gpd and delete it
-                m.lock();
                 pecPackage->InjectFile(awardPath.toStdString(), gpdName.toStdString());
-                m.unlock();
                 QFile::remove(awardPath);
             }
 
             // update the dash gpd
-            m.lock();
             dashGpd->CreateTitleEntry(&entry);
             ui->treeWidgetQueue->topLevelItem(index)->setData(0, Qt::UserRole, QVariant::fromValue(entry));
             dashGpd->gamePlayedCount.int32++;
-            m.unlock();
 
             qDebug() << "Ended " << QString::fromStdWString(entry.gameName);
         }
@@ -333,9 +324,7 @@ void GameAdderDialog::finishedDownloadingGpd(QString gamePath, QString awardPath
 
         try
         {
-            m.lock();
             dashGpd->WriteSettingEntry(dashGpd->gamePlayedCount);
-            m.unlock();
         }
         catch (std::string error)
         {
@@ -404,9 +393,7 @@ void GameAdderDialog::finishedDownloadingGpd(QString gamePath, QString awardPath
             dashGpd->Close();
             delete dashGpd;
 
-            m.lock();
             package->ReplaceFile(dashGpdTempPath.toStdString(), "FFFE07D1.gpd");
-            m.unlock();
 
             QFile::remove(dashGpdTempPath);
         }
@@ -429,7 +416,6 @@ void GameAdderDialog::finishedDownloadingGpd(QString gamePath, QString awardPath
                 pecPackage->metaData->enabled = true;
                 pecPackage->metaData->WriteMetaData();
 
-                m.lock();
                 pecPackage->Rehash();
                 pecPackage->Resign(kvPath);
 
@@ -441,7 +427,6 @@ void GameAdderDialog::finishedDownloadingGpd(QString gamePath, QString awardPath
                     package->ReplaceFile(pecTempPath.toStdString(), "PEC");
 
                 QFile::remove(pecTempPath);
-                m.unlock();
             }
         }
         catch (std::string error)
@@ -453,10 +438,8 @@ void GameAdderDialog::finishedDownloadingGpd(QString gamePath, QString awardPath
 
         try
         {
-            m.lock();
             package->Rehash();
             package->Resign(kvPath);
-            m.unlock();
 
             if (dispose)
             {
@@ -11,7 +11,6 @@
 #include <QMenu>
 #include <QMessageBox>
 #include <QStringList>
-#include <QMutex>
 
 // other
 #include "json.h"
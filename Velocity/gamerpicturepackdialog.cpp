@@ -376,7 +376,9 @@ void GamerPicturePackDialog::on_btnCreatePack_clicked()
 
     try
     {
-        StfsPackage picturePack(savePath.toStdString(), StfsPackageCreate);
+        // the pack is built in memory and saved once it's finished
+        StfsPackageBuilder builder;
+        StfsPackage &picturePack = *builder.GetPackage();
 
         picturePack.metaData->contentType = GamerPicture;
         std::wstring *w = new std::wstring(ui->txtPackName->text().toStdWString());
@@ -436,6 +438,7 @@ void GamerPicturePackDialog::on_btnCreatePack_clicked()
         // fix the package
         picturePack.Rehash();
         picturePack.Resign(QtHelpers::GetKVPath(Retail, this));
+        builder.Save(savePath.toStdString());
 
         statusBar->showMessage("Successfully created your picture pack", 3000);
         ui->tabWidget->setEnabled(true);
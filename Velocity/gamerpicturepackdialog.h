@@ -18,6 +18,7 @@
 
 // xbox360
 #include "Stfs/StfsPackage.h"
+#include "Stfs/StfsPackageBuilder.h"
 
 // other
 #include "titleidfinder.h"
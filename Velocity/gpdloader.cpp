@@ -0,0 +1,141 @@
+#include "gpdloader.h"
+#include <QCoreApplication>
+#include <QFile>
+#include "IO/MemoryIO.h"
+#include "jobscheduler.h"
+
+class GpdLoadJob : public Job
+{
+public:
+    GpdLoadJob(GpdLoader *loader, int index, GpdLoadType type, QByteArray data, string tempPath) :
+        loader(loader), index(index), type(type), data(data), tempPath(tempPath)
+    {
+    }
+
+protected:
+    void Execute()
+    {
+        LoadedGpd gpd = { type, NULL, NULL, tempPath, QImage(), QString() };
+
+        try
+        {
+            writeFile(QString::fromStdString(tempPath));
+            writeFile(QString::fromStdString(tempPath + "_C"));
+
+            MemoryIO io((BYTE*)data.data(), data.size());
+            io.SetPosition(0);
+
+            if (type == GpdLoadGame)
+            {
+                gpd.gameGpd = new GameGpd(&io, tempPath);
+
+                // decoding the thumbnail is slow enough to be worth doing here too
+                GameGpd *gameGpd = gpd.gameGpd;
+                if (gameGpd->thumbnail.length != 0 && gameGpd->GetImageData(&gameGpd->thumbnail) != NULL)
+                    gpd.thumbnail = QImage::fromData(gameGpd->thumbnail.image, gameGpd->thumbnail.length);
+            }
+            else
+            {
+                gpd.awardGpd = new AvatarAwardGpd(&io, tempPath);
+            }
+        }
+        catch (string error)
+        {
+            gpd.error = QString::fromStdString(error);
+        }
+        catch (...)
+        {
+            gpd.error = "An unknown error has occurred.";
+        }
+
+        if (!gpd.error.isEmpty())
+        {
+            delete gpd.gameGpd;
+            delete gpd.awardGpd;
+            gpd.gameGpd = NULL;
+            gpd.awardGpd = NULL;
+        }
+
+        // the data isn't needed anymore
+        data.clear();
+
+        loader->finished(index, gpd);
+    }
+
+private:
+    GpdLoader *loader;
+    int index;
+    GpdLoadType type;
+    QByteArray data;
+    string tempPath;
+
+    void writeFile(QString path)
+    {
+        QFile file(path);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(data) != data.size())
+            throw string("Unable to write the temporary file '" + path.toStdString() + "'.\n");
+        file.close();
+    }
+};
+
+GpdLoader::GpdLoader(QObject *parent) :
+    QObject(parent), added(0), handedOut(0), finishedCount(0)
+{
+}
+
+GpdLoader::~GpdLoader()
+{
+    // the jobs still need the loader
+    {
+        QMutexLocker locker(&mutex);
+        while (finishedCount != added)
+            loaded.wait(&mutex);
+    }
+
+    // free the gpds that were never handed out
+    foreach (LoadedGpd gpd, results)
+    {
+        delete gpd.gameGpd;
+        delete gpd.awardGpd;
+    }
+}
+
+void GpdLoader::Add(GpdLoadType type, StfsPackage *package, StfsFileEntry *entry, string tempPath)
+{
+    QByteArray data(entry->fileSize, 0);
+    MemoryIO io((BYTE*)data.data(), data.size());
+    io.SetPosition(0);
+    package->ExtractFile(entry, &io);
+
+    JobScheduler::Instance()->Submit(new GpdLoadJob(this, added++, type, data, tempPath));
+}
+
+bool GpdLoader::Next(LoadedGpd *gpd)
+{
+    QMutexLocker locker(&mutex);
+    if (handedOut == added)
+        return false;
+
+    while (!results.contains(handedOut))
+    {
+        loaded.wait(&mutex, 50);
+
+        if (!results.contains(handedOut))
+        {
+            locker.unlock();
+            QCoreApplication::processEvents();
+            locker.relock();
+        }
+    }
+
+    *gpd = results.take(handedOut++);
+    return true;
+}
+
+void GpdLoader::finished(int index, const LoadedGpd &gpd)
+{
+    QMutexLocker locker(&mutex);
+    results.insert(index, gpd);
+    finishedCount++;
+    loaded.wakeAll();
+}
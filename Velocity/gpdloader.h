@@ -0,0 +1,67 @@
+#ifndef GPDLOADER_H
+#define GPDLOADER_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QImage>
+#include <QMap>
+#include <QMutex>
+#include <QWaitCondition>
+
+#include "Stfs/StfsPackage.h"
+#include "Gpd/GameGpd.h"
+#include "Gpd/AvatarAwardGpd.h"
+
+enum GpdLoadType
+{
+    GpdLoadGame,
+    GpdLoadAvatarAward
+};
+
+struct LoadedGpd
+{
+    GpdLoadType type;
+    GameGpd *gameGpd;
+    AvatarAwardGpd *awardGpd;
+    string tempPath;
+
+    // the game's thumbnail, only set for game gpds that have one
+    QImage thumbnail;
+
+    // empty if the gpd was loaded successfully
+    QString error;
+};
+
+// parses gpds on the job scheduler, the gpds are read out of the package into memory first so that
+// nothing has to wait on the unbuffered file reads
+class GpdLoader : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit GpdLoader(QObject *parent = 0);
+    ~GpdLoader();
+
+    // read the gpd out of the package and queue it up to be parsed. The package is only used on the
+    // calling thread. The gpd is written to tempPath for it to be edited, and to tempPath + "_C" so
+    // there's an untouched copy of it
+    void Add(GpdLoadType type, StfsPackage *package, StfsFileEntry *entry, string tempPath);
+
+    // wait for the next gpd, in the order they were added, processing events while waiting so the
+    // ui stays responsive. Returns false once all of the gpds have been handed out
+    bool Next(LoadedGpd *gpd);
+
+private:
+    QMutex mutex;
+    QWaitCondition loaded;
+
+    // the gpds that have been parsed but not handed out yet
+    QMap<int, LoadedGpd> results;
+    int added, handedOut, finishedCount;
+
+    void finished(int index, const LoadedGpd &gpd);
+
+    friend class GpdLoadJob;
+};
+
+#endif // GPDLOADER_H
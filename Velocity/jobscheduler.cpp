@@ -0,0 +1,145 @@
+#include "jobscheduler.h"
+
+Job::Job(QString resource) :
+    resource(resource), cancelled(0)
+{
+    // the scheduler deletes the job once the finished signal has made it to the ui
+    setAutoDelete(false);
+}
+
+Job::~Job()
+{
+}
+
+QString Job::GetResource()
+{
+    return resource;
+}
+
+void Job::Cancel()
+{
+    cancelled.fetchAndStoreOrdered(1);
+}
+
+bool Job::IsCancelled()
+{
+    return cancelled.fetchAndAddOrdered(0) != 0;
+}
+
+void Job::ProgressCallback(void *arg, DWORD cur, DWORD total)
+{
+    Job *job = reinterpret_cast<Job*>(arg);
+    job->checkCancelled();
+
+    // scale the values down so that they fit in an int
+    while (total > 0x7FFFFFFF)
+    {
+        cur >>= 1;
+        total >>= 1;
+    }
+    emit job->Progress(cur, total);
+}
+
+void Job::checkCancelled()
+{
+    if (IsCancelled())
+        throw std::string("The operation was cancelled.\n");
+}
+
+void Job::run()
+{
+    bool success = true;
+    QString error;
+
+    {
+        // only one job can use a resource at a time, jobs without one can all run at once
+        QMutexLocker locker(resource.isEmpty() ? NULL : JobScheduler::Instance()->getResourceLock(
+                resource));
+
+        // jobs check for cancellation themselves, some of them always have to report back
+        try
+        {
+            Execute();
+        }
+        catch (std::string e)
+        {
+            success = false;
+            error = QString::fromStdString(e);
+        }
+        catch (...)
+        {
+            success = false;
+            error = "An unknown error has occurred.\n";
+        }
+    }
+
+    emit Finished(success, error);
+    JobScheduler::Instance()->finished(this);
+
+    // queued behind the finished signal, so receivers can still use the job when they get it
+    deleteLater();
+}
+
+JobScheduler::JobScheduler(QObject *parent) :
+    QObject(parent)
+{
+    // jobs waiting on a resource hold onto a thread, so make sure there are some to spare
+    if (pool.maxThreadCount() < 4)
+        pool.setMaxThreadCount(4);
+}
+
+JobScheduler *JobScheduler::Instance()
+{
+    static JobScheduler scheduler;
+    return &scheduler;
+}
+
+void JobScheduler::Submit(Job *job)
+{
+    {
+        QMutexLocker locker(&mutex);
+        jobs.append(job);
+        resourceUsers[job->GetResource()]++;
+    }
+
+    pool.start(job);
+}
+
+void JobScheduler::CancelAll()
+{
+    QMutexLocker locker(&mutex);
+    foreach (Job *job, jobs)
+        job->Cancel();
+}
+
+void JobScheduler::WaitForResource(QString resource)
+{
+    QMutexLocker locker(&mutex);
+    while (resourceUsers.value(resource, 0) != 0)
+        jobFinished.wait(&mutex);
+}
+
+void JobScheduler::WaitForDone()
+{
+    QMutexLocker locker(&mutex);
+    while (!jobs.isEmpty())
+        jobFinished.wait(&mutex);
+}
+
+QMutex *JobScheduler::getResourceLock(QString resource)
+{
+    QMutexLocker locker(&mutex);
+    if (!resourceLocks.contains(resource))
+        resourceLocks.insert(resource, new QMutex);
+    return resourceLocks.value(resource);
+}
+
+void JobScheduler::finished(Job *job)
+{
+    QMutexLocker locker(&mutex);
+    jobs.removeOne(job);
+    if (--resourceUsers[job->GetResource()] == 0)
+        resourceUsers.remove(job->GetResource());
+
+    jobFinished.wakeAll();
+}
@@ -0,0 +1,91 @@
+#ifndef JOBSCHEDULER_H
+#define JOBSCHEDULER_H
+
+#include <QObject>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QAtomicInt>
+#include <QMap>
+#include <QString>
+
+#include "winnames.h"
+
+// a long running operation that's run on the job scheduler's threads
+class Job : public QObject, public QRunnable
+{
+    Q_OBJECT
+
+public:
+    // jobs that use the same resource, such as the path of a package, are never run at the same time
+    explicit Job(QString resource = "");
+    virtual ~Job();
+
+    QString GetResource();
+
+    // ask the job to stop, it stops the next time it checks IsCancelled
+    void Cancel();
+    bool IsCancelled();
+
+    // progress callback for the XboxInternals functions, pass the job in as the arg
+    static void ProgressCallback(void *arg, DWORD cur, DWORD total);
+
+signals:
+    // these are emitted on the job's thread, so they're queued to any receivers in the ui
+    void Progress(int value, int maximum);
+    void Finished(bool success, QString error);
+
+protected:
+    // do the work, errors are thrown as strings like everywhere else
+    virtual void Execute() = 0;
+
+    // throw if the job has been cancelled
+    void checkCancelled();
+
+private:
+    QString resource;
+    QAtomicInt cancelled;
+
+    void run();
+};
+
+class JobScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    static JobScheduler *Instance();
+
+    // queue up a job, the scheduler owns it from now on. It's deleted on the thread it was created on
+    // once its finished signal has been delivered
+    void Submit(Job *job);
+
+    // cancel all of the queued and running jobs
+    void CancelAll();
+
+    // wait for all of the jobs using the resource to finish
+    void WaitForResource(QString resource);
+
+    // wait for all of the jobs to finish
+    void WaitForDone();
+
+private:
+    explicit JobScheduler(QObject *parent = 0);
+
+    QThreadPool pool;
+
+    QMutex mutex;
+    QWaitCondition jobFinished;
+    QList<Job*> jobs;
+    QMap<QString, QMutex*> resourceLocks;
+    QMap<QString, int> resourceUsers;
+
+    // get the lock that keeps jobs on the same resource from running at once
+    QMutex *getResourceLock(QString resource);
+    void finished(Job *job);
+
+    friend class Job;
+};
+
+#endif // JOBSCHEDULER_H
@@ -329,6 +329,10 @@ void MainWindow::LoadAllPlugins()
 
 MainWindow::~MainWindow()
 {
+    // don't pull anything out from under the jobs that are still running
+    JobScheduler::Instance()->CancelAll();
+    JobScheduler::Instance()->WaitForDone();
+
     // close all of the open subviews
     QList<QMdiSubWindow*> subWindows = ui->mdiArea->subWindowList();
     for (int i = 0; i < subWindows.length(); i++)
@@ -372,6 +376,54 @@ void MainWindow::dragLeaveEvent(QDragLeaveEvent *)
     ui->statusBar->showMessage("");
 }
 
+// rehashes and resigns a package off of the ui thread
+class PackageRehashJob : public Job
+{
+public:
+    PackageRehashJob(StfsPackage *package, std::string fileName, std::string kvPath) :
+        Job(QString::fromStdString(fileName)), package(package), kvPath(kvPath)
+    {
+    }
+
+    ~PackageRehashJob()
+    {
+        delete package;
+    }
+
+protected:
+    void Execute()
+    {
+        checkCancelled();
+        package->Rehash();
+        package->Resign(kvPath);
+    }
+
+private:
+    StfsPackage *package;
+    std::string kvPath;
+};
+
+void MainWindow::rehashAndResign(StfsPackage *package, std::string fileName)
+{
+    // the key vault has to be picked on the ui thread
+    std::string kvPath = QtHelpers::GetKVPath(package->metaData->certificate.ownerConsoleType, this);
+
+    PackageRehashJob *job = new PackageRehashJob(package, fileName, kvPath);
+    connect(job, SIGNAL(Finished(bool, QString)), this, SLOT(onPackageRehashed(bool, QString)));
+    JobScheduler::Instance()->Submit(job);
+
+    ui->statusBar->showMessage("Rehashing and resigning STFS package...");
+}
+
+void MainWindow::onPackageRehashed(bool success, QString error)
+{
+    if (success)
+        ui->statusBar->showMessage("STFS package rehashed and resigned successfully.", 3000);
+    else
+        QMessageBox::critical(this, "Error",
+                "An error occurred while rehashing and resigning the package.\n\n" + error);
+}
+
 void MainWindow::LoadFiles(QList<QUrl> &filePaths)
 {
     for (int i = 0; i < filePaths.size(); i++)
@@ -418,12 +470,7 @@ void MainWindow::LoadFiles(QList<QUrl> &filePaths)
                             }
                             else
                             {
-                                package->Rehash();
-                                package->Resign(QtHelpers::GetKVPath(package->metaData->certificate.ownerConsoleType, this));
-
-                                delete package;
-
-                                ui->statusBar->showMessage("STFS package rehashed and resigned successfully.", 3000);
+                                rehashAndResign(package, fileName);
                             }
                         }
                         else
@@ -439,12 +486,7 @@ void MainWindow::LoadFiles(QList<QUrl> &filePaths)
                             }
                             else if (settings->value("ProfileDropAction").toInt() == RehashAndResign)
                             {
-                                package->Rehash();
-                                package->Resign(QtHelpers::GetKVPath(package->metaData->certificate.ownerConsoleType, this));
-
-                                delete package;
-
-                                ui->statusBar->showMessage("STFS package rehashed and resigned successfully.", 3000);
+                                rehashAndResign(package, fileName);
                             }
                             else
                             {
@@ -40,6 +40,7 @@
 #include "svoddialog.h"
 #include "ytgrdialog.h"
 #include "deviceviewer.h"
+#include "jobscheduler.h"
 
 // other
 #include "PluginInterfaces/igamemodder.h"
@@ -135,6 +136,8 @@ private slots:
 
     void on_actionDevice_Viewer_triggered();
 
+    void onPackageRehashed(bool success, QString error);
+
 private:
     Ui::MainWindow *ui;
     QSettings *settings;
@@ -143,6 +146,9 @@ private:
     bool firstUpdateCheck;
 
     void LoadFiles(QList<QUrl> &filePaths);
+
+    // rehash and resign the package on the job scheduler, the job takes ownership of the package
+    void rehashAndResign(StfsPackage *package, std::string fileName);
 };
 
 #endif // MAINWINDOW_H
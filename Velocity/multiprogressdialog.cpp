@@ -168,7 +168,7 @@ void MultiProgressDialog::operateOnNextFile()
                     try
                     {
                         // make all the directories needed
-                        QString temp = QString::fromStdString(entry->path);
+                        QString temp = QString::fromStdString(FatxDrive::GetFolderPath(entry));
                         QString dirPath = QDir::toNativeSeparators(outDir + temp.replace(rootPath, ""));
                         QDir saveDir(dirPath);
 
@@ -216,7 +216,7 @@ void MultiProgressDialog::operateOnNextFile()
                             *fileName = fileName->replace("/", "\\");
 
                             // get the FATX file path
-                            QString fatxPath = QString::fromStdString(parentEntry->path + parentEntry->name) +
+                            QString fatxPath = QString::fromStdString(FatxDrive::GetFolderPath(parentEntry) + parentEntry->name) +
                                     fileName->replace(rootPath, "").mid(0, fileName->replace(rootPath, "").lastIndexOf("\\"));
                             pEntry = drive->CreatePath(fatxPath.toStdString());
                         }
@@ -230,8 +230,8 @@ void MultiProgressDialog::operateOnNextFile()
 
                             if (button == QMessageBox::Yes)
                             {
-                                FatxIO file = drive->GetFatxIO(drive->GetFileEntry(pEntry->path + pEntry->name + "\\" +
-                                        fileInfo.fileName().toStdString()));
+                                FatxIO file = drive->GetFatxIO(drive->GetFileEntry(FatxDrive::GetFolderPath(pEntry) +
+                                        pEntry->name + "\\" + fileInfo.fileName().toStdString()));
                                 file.ReplaceFile(cleanName.toStdString(), updateProgress, this);
                             }
                         }
@@ -2,7 +2,8 @@
 #include "ui_profilecleanerwizard.h"
 
 ProfileCleanerWizard::ProfileCleanerWizard(QWidget *parent) :
-    QWizard(parent), ui(new Ui::ProfileCleanerWizard), profileOpened(false), op(Dust)
+    QWizard(parent), ui(new Ui::ProfileCleanerWizard), profileOpened(false), profile(NULL),
+    cleanJob(NULL), op(Dust)
 {
     setWindowFlags(windowFlags() & ~Qt::WindowContextHelpButtonHint);
     ui->setupUi(this);
@@ -20,6 +21,16 @@ ProfileCleanerWizard::ProfileCleanerWizard(QWidget *parent) :
 
 ProfileCleanerWizard::~ProfileCleanerWizard()
 {
+    // the cleaned profile is only moved into place at the very end, so stopping early is safe
+    if (cleanJob)
+    {
+        cleanJob->Cancel();
+        JobScheduler::Instance()->WaitForResource(profilePath);
+    }
+
+    if (profileOpened)
+        delete profile;
+
     delete ui;
 }
 
@@ -78,31 +89,78 @@ void ProfileCleanerWizard::on_pushButton_clicked()
     button(QWizard::NextButton)->setEnabled(true);
 }
 
-void ProfileCleanerWizard::clean()
+// extracts, cleans and rebuilds a profile off of the ui thread
+class ProfileCleanJob : public Job
 {
-    button(QWizard::FinishButton)->setEnabled(false);
+public:
+    ProfileCleanJob(StfsPackage *profile, QString profilePath, CleanOperation op,
+            std::string kvPath) :
+        Job(profilePath), profile(profile), profilePath(profilePath), op(op), kvPath(kvPath),
+        endSize(0)
+    {
+    }
+
+    ~ProfileCleanJob()
+    {
+        delete profile;
+    }
+
+    DWORD GetEndSize()
+    {
+        return endSize;
+    }
 
-    // extract all of the files
-    directory = QDir::tempPath() + "/" + QUuid::createUuid().toString().replace("{", "").replace("}",
-                "").replace("-", "") + "/";
-    QDir d(directory);
-    d.mkdir(directory);
-    StfsFileListing f = profile->GetFileListing();
-    extractAll(&f, directory);
-    qDebug() << "Extraction complete";
-
-    QStringList exceptions;
-    exceptions.push_back("FFFE07D1.gpd");
-    exceptions.push_back("FFFE07DE.gpd");
-    exceptions.push_back("584D07D1.gpd");
-
-    // iterate through all of the Gpds in the profile
-    QFileInfoList files = d.entryInfoList();
-    for (int i = 0; i < files.size(); i++)
+protected:
+    void Execute()
     {
-        if (files.at(i).fileName().mid(files.at(i).fileName().lastIndexOf(".")) == ".gpd")
+        // extract all of the files
+        directory = QDir::tempPath() + "/" + QUuid::createUuid().toString().replace("{",
+                    "").replace("}", "").replace("-", "") + "/";
+        QDir d(directory);
+        d.mkdir(directory);
+
+        try
         {
-            try
+            cleanProfile(d);
+        }
+        catch (...)
+        {
+            deleteAllRecursive(QDir(directory));
+            d.rmdir(directory);
+            throw;
+        }
+
+        deleteAllRecursive(QDir(directory));
+        d.rmdir(directory);
+    }
+
+private:
+    StfsPackage *profile;
+    QString profilePath;
+    CleanOperation op;
+    std::string kvPath;
+    QString directory;
+    DWORD endSize;
+
+    void cleanProfile(QDir &d)
+    {
+        StfsFileListing f = profile->GetFileListing();
+        extractAll(&f, directory);
+        qDebug() << "Extraction complete";
+
+        QStringList exceptions;
+        exceptions.push_back("FFFE07D1.gpd");
+        exceptions.push_back("FFFE07DE.gpd");
+        exceptions.push_back("584D07D1.gpd");
+
+        // iterate through all of the Gpds in the profile
+        QFileInfoList files = d.entryInfoList();
+        for (int i = 0; i < files.size(); i++)
+        {
+            emit Progress(i, files.size() * 2);
+            checkCancelled();
+
+            if (files.at(i).fileName().mid(files.at(i).fileName().lastIndexOf(".")) == ".gpd")
             {
                 GpdBase gpd(files.at(i).absoluteFilePath().toStdString());
 
@@ -131,163 +189,151 @@ void ProfileCleanerWizard::clean()
                 }
 
                 gpd.Clean();
-                QApplication::processEvents();
-            }
-            catch (string error)
-            {
-                QMessageBox::critical(this, "Clean Error",
-                        "An error has occurred while cleaning your profile.\n\n" + QString::fromStdString(error));
-
-                deleteAllRecursive(QDir(directory));
-                d.rmdir(directory);
-                delete profile;
-
-                return;
             }
         }
-    }
-
-    // rebuild the profile
-    QString newProfilePath = QDir::tempPath() + "/" + QUuid::createUuid().toString().replace("{",
-            "").replace("}", "").replace("-", "");
-    StfsPackage newProfile(newProfilePath.toStdString(), StfsPackageCreate);
 
-    // copy all the metadata over to the new profile
-    newProfile.metaData->certificate.publicKeyCertificateSize =
-        profile->metaData->certificate.publicKeyCertificateSize;
+        // rebuild the profile in memory
+        StfsPackageBuilder builder;
+        StfsPackage &newProfile = *builder.GetPackage();
 
-    std::string *s = new std::string(profile->metaData->certificate.ownerConsolePartNumber);
-    memcpy(&newProfile.metaData->certificate.ownerConsolePartNumber, s, sizeof(std::string));
+        // copy all the metadata over to the new profile
+        newProfile.metaData->certificate.publicKeyCertificateSize =
+            profile->metaData->certificate.publicKeyCertificateSize;
 
-    newProfile.metaData->certificate.ownerConsoleType = profile->metaData->certificate.ownerConsoleType;
-    newProfile.metaData->certificate.consoleTypeFlags = profile->metaData->certificate.consoleTypeFlags;
+        std::string *s = new std::string(profile->metaData->certificate.ownerConsolePartNumber);
+        memcpy(&newProfile.metaData->certificate.ownerConsolePartNumber, s, sizeof(std::string));
 
-    s = new std::string(profile->metaData->certificate.dateGeneration);
-    memcpy(&newProfile.metaData->certificate.dateGeneration, s, sizeof(std::string));
+        newProfile.metaData->certificate.ownerConsoleType = profile->metaData->certificate.ownerConsoleType;
+        newProfile.metaData->certificate.consoleTypeFlags = profile->metaData->certificate.consoleTypeFlags;
 
-    memcpy(newProfile.metaData->certificate.ownerConsoleID,
-           profile->metaData->certificate.ownerConsoleID, 5);
+        s = new std::string(profile->metaData->certificate.dateGeneration);
+        memcpy(&newProfile.metaData->certificate.dateGeneration, s, sizeof(std::string));
 
-    memcpy(newProfile.metaData->consoleID, profile->metaData->consoleID, 5);
-    newProfile.metaData->contentSize = profile->metaData->contentSize;
-    newProfile.metaData->contentType = Profile;
-    newProfile.metaData->titleID = profile->metaData->titleID;
-    memcpy(newProfile.metaData->deviceID, profile->metaData->deviceID, 20);
+        memcpy(newProfile.metaData->certificate.ownerConsoleID,
+               profile->metaData->certificate.ownerConsoleID, 5);
 
-    std::wstring *w = new std::wstring(profile->metaData->displayDescription);
-    memcpy(&newProfile.metaData->displayDescription, w, sizeof(std::wstring));
+        memcpy(newProfile.metaData->consoleID, profile->metaData->consoleID, 5);
+        newProfile.metaData->contentSize = profile->metaData->contentSize;
+        newProfile.metaData->contentType = Profile;
+        newProfile.metaData->titleID = profile->metaData->titleID;
+        memcpy(newProfile.metaData->deviceID, profile->metaData->deviceID, 20);
 
-    w = new std::wstring(profile->metaData->displayName);
-    memcpy(&newProfile.metaData->displayName, w, sizeof(std::wstring));
+        std::wstring *w = new std::wstring(profile->metaData->displayDescription);
+        memcpy(&newProfile.metaData->displayDescription, w, sizeof(std::wstring));
 
-    newProfile.metaData->executableType = profile->metaData->executableType;
-    newProfile.metaData->headerSize = profile->metaData->headerSize;
-    memcpy(newProfile.metaData->licenseData, profile->metaData->licenseData,
-           sizeof(LicenseEntry) * 0x10);
-    newProfile.metaData->metaDataVersion = profile->metaData->metaDataVersion;
-    memcpy(newProfile.metaData->profileID, profile->metaData->profileID, 8);
+        w = new std::wstring(profile->metaData->displayName);
+        memcpy(&newProfile.metaData->displayName, w, sizeof(std::wstring));
 
-    w = new std::wstring(profile->metaData->publisherName);
-    memcpy(&newProfile.metaData->publisherName, w, sizeof(std::wstring));
+        newProfile.metaData->executableType = profile->metaData->executableType;
+        newProfile.metaData->headerSize = profile->metaData->headerSize;
+        memcpy(newProfile.metaData->licenseData, profile->metaData->licenseData,
+               sizeof(LicenseEntry) * 0x10);
+        newProfile.metaData->metaDataVersion = profile->metaData->metaDataVersion;
+        memcpy(newProfile.metaData->profileID, profile->metaData->profileID, 8);
 
-    newProfile.metaData->savegameID = profile->metaData->savegameID;
+        w = new std::wstring(profile->metaData->publisherName);
+        memcpy(&newProfile.metaData->publisherName, w, sizeof(std::wstring));
 
-    newProfile.metaData->thumbnailImage = new BYTE[profile->metaData->thumbnailImageSize];
-    newProfile.metaData->titleThumbnailImage = new BYTE[profile->metaData->titleThumbnailImageSize];
-    memcpy(newProfile.metaData->thumbnailImage, profile->metaData->thumbnailImage,
-           profile->metaData->thumbnailImageSize);
-    memcpy(newProfile.metaData->titleThumbnailImage, profile->metaData->titleThumbnailImage,
-           profile->metaData->titleThumbnailImageSize);
-    newProfile.metaData->thumbnailImageSize = profile->metaData->thumbnailImageSize;
-    newProfile.metaData->titleThumbnailImageSize = profile->metaData->titleThumbnailImageSize;
+        newProfile.metaData->savegameID = profile->metaData->savegameID;
 
-    w = new std::wstring(profile->metaData->titleName);
-    memcpy(&newProfile.metaData->titleName, w, sizeof(std::wstring));
+        newProfile.metaData->thumbnailImage = new BYTE[profile->metaData->thumbnailImageSize];
+        newProfile.metaData->titleThumbnailImage = new BYTE[profile->metaData->titleThumbnailImageSize];
+        memcpy(newProfile.metaData->thumbnailImage, profile->metaData->thumbnailImage,
+               profile->metaData->thumbnailImageSize);
+        memcpy(newProfile.metaData->titleThumbnailImage, profile->metaData->titleThumbnailImage,
+               profile->metaData->titleThumbnailImageSize);
+        newProfile.metaData->thumbnailImageSize = profile->metaData->thumbnailImageSize;
+        newProfile.metaData->titleThumbnailImageSize = profile->metaData->titleThumbnailImageSize;
 
-    newProfile.metaData->transferFlags = profile->metaData->transferFlags;
-    newProfile.metaData->version = profile->metaData->version;
+        w = new std::wstring(profile->metaData->titleName);
+        memcpy(&newProfile.metaData->titleName, w, sizeof(std::wstring));
 
-    newProfile.metaData->WriteMetaData();
+        newProfile.metaData->transferFlags = profile->metaData->transferFlags;
+        newProfile.metaData->version = profile->metaData->version;
 
-    // inject all of the old files into the profile
-    injectAll(&newProfile, directory, "");
+        newProfile.metaData->WriteMetaData();
 
-    // delete the old profile
-    delete profile;
+        // inject all of the old files into the profile
+        injectAll(&newProfile, directory, "");
 
-    QApplication::processEvents();
+        // the old profile is about to be replaced
+        profile->Close();
 
-    deleteAllRecursive(QDir(directory));
-    d.rmdir(directory);
-    qDebug() << "Deletion complete";
+        // fix the profile
+        checkCancelled();
+        newProfile.Rehash();
+        newProfile.Resign(kvPath);
 
-    // fix the profile
-    newProfile.Rehash();
-    newProfile.Resign(QtHelpers::GetKVPath(newProfile.metaData->certificate.ownerConsoleType, this));
+        // write the cleaned profile next to the old one, then move it into place
+        QString newProfilePath = profilePath + ".tmp";
+        QFile::remove(newProfilePath);
+        builder.Save(newProfilePath.toStdString());
+        endSize = builder.GetLength();
 
-    newProfile.Close();
+        // the old profile is only removed once the new one has taken its place
+        QString oldProfilePath = profilePath + ".old";
+        QFile::remove(oldProfilePath);
+        if (!QFile::rename(profilePath, oldProfilePath))
+            throw string("Unable to replace the profile. The cleaned profile was saved to " +
+                    newProfilePath.toStdString() + ".");
 
-    QFileInfo info(newProfilePath);
-    ui->lblEndSize->setText(QString::fromStdString(ByteSizeToString(info.size())));
-    ui->lblDataRemoved->setText(QString::fromStdString(ByteSizeToString(initialSize - info.size())));
+        if (!QFile::rename(newProfilePath, profilePath) &&
+                !QFile::copy(newProfilePath, profilePath))
+        {
+            // put the old profile back, both files are kept if even that fails
+            QFile::rename(oldProfilePath, profilePath);
+            throw string("Unable to replace the profile. The cleaned profile was saved to " +
+                    newProfilePath.toStdString() + ".");
+        }
 
-    // move the cleaned profile to the old location
-    QFile::remove(profilePath);
-    QFile::rename(newProfilePath, profilePath);
+        QFile::remove(newProfilePath);
+        QFile::remove(oldProfilePath);
 
-    // update the ui
-    ui->progressBar->setVisible(false);
-    ui->wizardPage_2->setTitle("Finished");
-    ui->wizardPage_2->setSubTitle("Your profile has been cleaned successfully");
-    button(QWizard::FinishButton)->setEnabled(true);
-}
-
-void ProfileCleanerWizard::extractAll(StfsFileListing *f, QString parentDirectory)
-{
-    // extract all files
-    for (DWORD i = 0; i < f->fileEntries.size(); i++)
-    {
-        profile->ExtractFile(&f->fileEntries.at(i),
-                parentDirectory.toStdString() + f->fileEntries.at(i).name);
-        QApplication::processEvents();
+        emit Progress(1, 1);
     }
-    // create all folders
-    for (DWORD i = 0; i < f->folderEntries.size(); i++)
+
+    void extractAll(StfsFileListing *f, QString parentDirectory)
     {
-        QDir d;
-        d.mkpath(parentDirectory + QString::fromStdString(f->folderEntries.at(i).folder.name) + "/");
-        if (f->folderEntries.at(i).fileEntries.size() != 0)
-            extractAll(&f->folderEntries.at(i),
-                       parentDirectory + QString::fromStdString(f->folderEntries.at(i).folder.name) + "/");
+        // extract all files
+        for (DWORD i = 0; i < f->fileEntries.size(); i++)
+        {
+            checkCancelled();
+            profile->ExtractFile(&f->fileEntries.at(i),
+                    parentDirectory.toStdString() + f->fileEntries.at(i).name);
+        }
+        // create all folders
+        for (DWORD i = 0; i < f->folderEntries.size(); i++)
+        {
+            QDir d;
+            d.mkpath(parentDirectory + QString::fromStdString(f->folderEntries.at(i).folder.name) + "/");
+            if (f->folderEntries.at(i).fileEntries.size() != 0)
+                extractAll(&f->folderEntries.at(i),
+                           parentDirectory + QString::fromStdString(f->folderEntries.at(i).folder.name) + "/");
+        }
     }
-}
 
-void ProfileCleanerWizard::deleteAllRecursive(QDir directory)
-{
-    QFileInfoList files = directory.entryInfoList(QDir::Files);
-    for (int i = 0; i < files.size(); i++)
-        QFile::remove(files.at(i).absoluteFilePath());
-    QApplication::processEvents();
-    QFileInfoList dirs = directory.entryInfoList(QDir::Dirs);
-    for (int i = 2; i < dirs.size(); i++)
+    void deleteAllRecursive(QDir directory)
     {
-        QDir d;
-        deleteAllRecursive(QDir(dirs.at(i).absoluteFilePath() + "/"));
-        d.rmdir(dirs.at(i).absoluteFilePath());
+        QFileInfoList files = directory.entryInfoList(QDir::Files);
+        for (int i = 0; i < files.size(); i++)
+            QFile::remove(files.at(i).absoluteFilePath());
+        QFileInfoList dirs = directory.entryInfoList(QDir::Dirs);
+        for (int i = 2; i < dirs.size(); i++)
+        {
+            QDir d;
+            deleteAllRecursive(QDir(dirs.at(i).absoluteFilePath() + "/"));
+            d.rmdir(dirs.at(i).absoluteFilePath());
+        }
     }
-}
 
-void ProfileCleanerWizard::injectAll(StfsPackage *profile, QDir currentDirectory,
-        QString currentStfsDir)
-{
-    try
+    void injectAll(StfsPackage *profile, QDir currentDirectory, QString currentStfsDir)
     {
         QFileInfoList files = currentDirectory.entryInfoList(QDir::Files);
         for (int i = 0; i < files.size(); i++)
         {
+            checkCancelled();
             profile->InjectFile(files.at(i).absoluteFilePath().toStdString(),
                     currentStfsDir.toStdString() + files.at(i).fileName().toStdString());
-            QApplication::processEvents();
         }
         QFileInfoList dirs = currentDirectory.entryInfoList(QDir::Dirs);
         for (int i = 2; i < dirs.size(); i++)
@@ -298,11 +344,57 @@ void ProfileCleanerWizard::injectAll(StfsPackage *profile, QDir currentDirectory
                       currentStfsDir + dirs.at(i).fileName() + "\\");
         }
     }
-    catch (string error)
+};
+
+void ProfileCleanerWizard::clean()
+{
+    button(QWizard::FinishButton)->setEnabled(false);
+
+    // the key vault has to be picked on the ui thread
+    std::string kvPath = QtHelpers::GetKVPath(profile->metaData->certificate.ownerConsoleType, this);
+
+    // the job owns the profile from here on
+    ProfileCleanJob *job = new ProfileCleanJob(profile, profilePath, op, kvPath);
+    profile = NULL;
+    profileOpened = false;
+
+    connect(job, SIGNAL(Progress(int, int)), this, SLOT(onCleanProgress(int, int)));
+    connect(job, SIGNAL(Finished(bool, QString)), this, SLOT(onCleanFinished(bool, QString)));
+
+    cleanJob = job;
+    JobScheduler::Instance()->Submit(job);
+}
+
+void ProfileCleanerWizard::onCleanProgress(int value, int maximum)
+{
+    ui->progressBar->setMaximum(maximum);
+    ui->progressBar->setValue(value);
+}
+
+void ProfileCleanerWizard::onCleanFinished(bool success, QString error)
+{
+    ProfileCleanJob *job = static_cast<ProfileCleanJob*>(cleanJob);
+    cleanJob = NULL;
+
+    ui->progressBar->setVisible(false);
+    button(QWizard::FinishButton)->setEnabled(true);
+
+    if (!success)
     {
-        qDebug() << "Clean error: " << QString::fromStdString(error);
+        QMessageBox::critical(this, "Clean Error",
+                "An error has occurred while cleaning your profile.\n\n" + error);
+        ui->wizardPage_2->setTitle("Error");
+        ui->wizardPage_2->setSubTitle("Your profile could not be cleaned");
         return;
     }
+
+    ui->lblEndSize->setText(QString::fromStdString(ByteSizeToString(job->GetEndSize())));
+    ui->lblDataRemoved->setText(QString::fromStdString(ByteSizeToString(initialSize -
+            job->GetEndSize())));
+
+    // update the ui
+    ui->wizardPage_2->setTitle("Finished");
+    ui->wizardPage_2->setSubTitle("Your profile has been cleaned successfully");
 }
 
 void ProfileCleanerWizard::on_radioButton_toggled(bool checked)
@@ -7,9 +7,11 @@
 #include <QUuid>
 #include <QDebug>
 #include "qthelpers.h"
+#include "jobscheduler.h"
 
 // xbox360
 #include "Stfs/StfsPackage.h"
+#include "Stfs/StfsPackageBuilder.h"
 #include "Gpd/DashboardGpd.h"
 #include "Gpd/GameGpd.h"
 
@@ -44,20 +46,21 @@ private slots:
 
     void on_radioButton_3_toggled(bool checked);
 
+    void onCleanProgress(int value, int maximum);
+
+    void onCleanFinished(bool success, QString error);
+
 private:
     Ui::ProfileCleanerWizard *ui;
     bool profileOpened;
     StfsPackage *profile;
-    QString directory;
     QString profilePath;
     DWORD initialSize;
+    Job *cleanJob;
 
     CleanOperation op;
 
     void clean();
-    void extractAll(StfsFileListing *f, QString parentDirectory);
-    void deleteAllRecursive(QDir directory);
-    void injectAll(StfsPackage *profile, QDir currentDirectory, QString currentStfsDir);
 };
 
 #endif // PROFILECLEANERWIZARD_H
@@ -52,7 +52,9 @@ void ProfileCreatorWizard::onFinished(int status)
         return;
     try
     {
-        StfsPackage newProfile(ui->lblSavePath->text().toStdString(), StfsPackageCreate);
+        // the profile is built in memory and saved once it's finished
+        StfsPackageBuilder builder;
+        StfsPackage &newProfile = *builder.GetPackage();
 
         // set up the metadata for the profile
         newProfile.metaData->magic = CON;
@@ -188,6 +190,8 @@ void ProfileCreatorWizard::onFinished(int status)
         if (path != "")
             newProfile.Resign(path);
 
+        builder.Save(ui->lblSavePath->text().toStdString());
+
         // delete the temp files
         QFile::remove(accountTempPath);
         QFile::remove(dashGpdTempPath);
@@ -12,6 +12,7 @@
 
 // xbox360
 #include "Stfs/StfsPackage.h"
+#include "Stfs/StfsPackageBuilder.h"
 #include "Stfs/XContentHeader.h"
 #include "Gpd/DashboardGpd.h"
 #include "Account/Account.h"
@@ -1,4 +1,5 @@
 #include "profileeditor.h"
+#include "gpdloader.h"
 #include "ui_profileeditor.h"
 
 ProfileEditor::ProfileEditor(QStatusBar *statusBar, StfsPackage *profile, bool dispose,
@@ -239,7 +240,8 @@ ProfileEditor::ProfileEditor(QStatusBar *statusBar, StfsPackage *profile, bool d
         // load the avatar image
         if (dashGpd->avatarImage.entry.type != 0)
         {
-            QByteArray imageBuff((char*)dashGpd->avatarImage.image, (size_t)dashGpd->avatarImage.length);
+            QByteArray imageBuff((char*)dashGpd->GetImageData(&dashGpd->avatarImage),
+                    (size_t)dashGpd->avatarImage.length);
             ui->imgAvatar->setPixmap(QPixmap::fromImage(QImage::fromData(imageBuff)));
         }
         else
@@ -268,7 +270,11 @@ ProfileEditor::ProfileEditor(QStatusBar *statusBar, StfsPackage *profile, bool d
 
     QMap<QString, GpdPaths> paths;
 
-    // load all the games played
+    // the gpds are parsed on other threads, and added to the ui as they're done
+    GpdLoader loader;
+    vector<TitleEntry*> titlesLoading;
+
+    // queue up all the games played
     for (DWORD i = 0; i < dashGpd->gamesPlayed.size(); i++)
     {
         // if the game doesn't have any achievements, no need to load it
@@ -286,43 +292,58 @@ ProfileEditor::ProfileEditor(QStatusBar *statusBar, StfsPackage *profile, bool d
             return;
         }
 
-        // extract the gpd
+        StfsFileEntry entry = profile->GetFileEntry(gpdName.toStdString());
+
+        // read the gpd into memory and queue it up to be parsed
         string tempPath = (QDir::tempPath() + "/" + QUuid::createUuid().toString().replace("{",
                 "").replace("}", "").replace("-", "")).toStdString();
-        profile->ExtractFile(gpdName.toStdString(), tempPath);
         tempFiles.push_back(tempPath);
 
-        QString newPath = QString::fromStdString(tempPath + "_C");
-        QFile::copy(QString::fromStdString(tempPath), newPath);
-
-        paths[titleIDStr].gameGpd = newPath;
-        paths[titleIDStr].awardGpd = "";
-
-        // parse the gpd
-        GameGpd *gpd;
         try
         {
-            gpd = new GameGpd(tempPath);
+            loader.Add(GpdLoadGame, profile, &entry, tempPath);
         }
         catch (string error)
         {
             ok = false;
             QMessageBox::critical(this, "File Load Error",
-                    "Error loading game Gpd, '" + gpdName + "'.\n\n" + QString::fromStdString(error));
+                    "Error reading game Gpd, '" + gpdName + "'.\n\n" + QString::fromStdString(error));
+            return;
+        }
+
+        paths[titleIDStr].gameGpd = QString::fromStdString(tempPath + "_C");
+        paths[titleIDStr].awardGpd = "";
+
+        titlesLoading.push_back(&dashGpd->gamesPlayed.at(i));
+    }
+
+    // add the games in order as they finish loading
+    LoadedGpd loaded;
+    for (DWORD i = 0; loader.Next(&loaded); i++)
+    {
+        TitleEntry *titleEntry = titlesLoading.at(i);
+        QString gpdName = QString::number(titleEntry->titleID, 16).toUpper() + ".gpd";
+
+        if (!loaded.error.isEmpty())
+        {
+            ok = false;
+            QMessageBox::critical(this, "File Load Error",
+                    "Error loading game Gpd, '" + gpdName + "'.\n\n" + loaded.error);
             return;
         }
+        GameGpd *gpd = loaded.gameGpd;
 
         // if there aren't any achievements for it, then don't add it to the game list
-        if (dashGpd->gamesPlayed.at(i).achievementCount != 0)
+        if (titleEntry->achievementCount != 0)
         {
-            GameEntry g = { gpd, &dashGpd->gamesPlayed.at(i), false, tempPath, gpdName.toStdString() };
+            GameEntry g = { gpd, titleEntry, false, loaded.tempPath, gpdName.toStdString() };
             games.push_back(g);
         }
 
         // if there are avatar awards then add it to the vector
-        if (dashGpd->gamesPlayed.at(i).avatarAwardCount != 0)
+        if (titleEntry->avatarAwardCount != 0)
         {
-            AvatarAwardGameEntry a = { gpd, &dashGpd->gamesPlayed.at(i), NULL, false, string(""), string("") };
+            AvatarAwardGameEntry a = { gpd, titleEntry, NULL, false, string(""), string("") };
             aaGames.push_back(a);
         }
 
@@ -331,20 +352,17 @@ ProfileEditor::ProfileEditor(QStatusBar *statusBar, StfsPackage *profile, bool d
         item->setText(0, QString::fromStdWString(gpd->gameName.ws));
 
         // set the thumbnail
-        if (gpd->thumbnail.image != NULL)
-        {
-            QByteArray imageBuff((char*)gpd->thumbnail.image, (size_t)gpd->thumbnail.length);
-            item->setIcon(0, QIcon(QPixmap::fromImage(QImage::fromData(imageBuff))));
-        }
+        if (!loaded.thumbnail.isNull())
+            item->setIcon(0, QIcon(QPixmap::fromImage(loaded.thumbnail)));
         else
             item->setIcon(0, QIcon(QPixmap(":/Images/HiddenAchievement.png")));
 
         // add the item to the list
-        if (dashGpd->gamesPlayed.at(i).achievementCount != 0)
+        if (titleEntry->achievementCount != 0)
             ui->gamesList->insertTopLevelItem(ui->gamesList->topLevelItemCount(), item);
 
         // add it to the avatar award game list if needed
-        if (dashGpd->gamesPlayed.at(i).avatarAwardCount != 0)
+        if (titleEntry->avatarAwardCount != 0)
             ui->aaGamelist->insertTopLevelItem(ui->aaGamelist->topLevelItemCount(), new QTreeWidgetItem(*item));
 
         QApplication::processEvents();
@@ -411,7 +429,7 @@ ProfileEditor::ProfileEditor(QStatusBar *statusBar, StfsPackage *profile, bool d
         return;
     }
 
-    // extract and parse all of the Gpds in the PEC
+    // read all of the Gpds in the PEC and queue them up to be parsed
     for (DWORD i = 0; i < aaGames.size(); i++)
     {
         QString titleIDStr = QString::number(aaGames.at(i).titleEntry->titleID, 16).toUpper();
@@ -428,34 +446,41 @@ ProfileEditor::ProfileEditor(QStatusBar *statusBar, StfsPackage *profile, bool d
             return;
         }
 
-        // extract the avatar award Gpd
+        StfsFileEntry entry = PEC->GetFileEntry(gpdName.toStdString());
+
         string tempGpdName = (QDir::tempPath() + "/" + QUuid::createUuid().toString().replace("{",
                 "").replace("}", "").replace("-", "")).toStdString();
         tempFiles.push_back(tempGpdName);
-        PEC->ExtractFile(gpdName.toStdString(), tempGpdName);
-
-        QString newPath = QString::fromStdString(tempGpdName + "_C");
-        QFile::copy(QString::fromStdString(tempGpdName), newPath);
-        paths[titleIDStr].awardGpd = newPath;
 
-        // parse the avatar award gpd
-        AvatarAwardGpd *gpd;
         try
         {
-            gpd = new AvatarAwardGpd(tempGpdName);
+            loader.Add(GpdLoadAvatarAward, PEC, &entry, tempGpdName);
         }
         catch (string error)
         {
             ok = false;
             QMessageBox::critical(this, "File Load Error",
-                    "Error loading the Avatar Award Gpd '" + gpdName + "'.\n\n" + QString::fromStdString(error));
+                    "Error reading the Avatar Award Gpd '" + gpdName + "'.\n\n" + QString::fromStdString(error));
             return;
         }
-        aaGames.at(i).gpd = gpd;
-        aaGames.at(i).tempFileName = tempGpdName;
+
+        paths[titleIDStr].awardGpd = QString::fromStdString(tempGpdName + "_C");
         aaGames.at(i).gpdName = gpdName.toStdString();
+    }
 
-        QApplication::processEvents();
+    // wait for the avatar award Gpds to be parsed
+    for (DWORD i = 0; loader.Next(&loaded); i++)
+    {
+        if (!loaded.error.isEmpty())
+        {
+            ok = false;
+            QMessageBox::critical(this, "File Load Error", "Error loading the Avatar Award Gpd '" +
+                    QString::fromStdString(aaGames.at(i).gpdName) + "'.\n\n" + loaded.error);
+            return;
+        }
+
+        aaGames.at(i).gpd = loaded.awardGpd;
+        aaGames.at(i).tempFileName = loaded.tempPath;
     }
 
     if (aaGames.size() >= 1)
@@ -587,7 +612,7 @@ void ProfileEditor::onAssetsDoneDownloading()
         newAsset.metaData->thumbnailImageSize = baScaled.length();
 
         GameGpd *gpd = aaGames.at(ui->aaGamelist->currentIndex().row()).gameGpd;
-        newAsset.metaData->titleThumbnailImage = gpd->thumbnail.image;
+        newAsset.metaData->titleThumbnailImage = gpd->GetImageData(&gpd->thumbnail);
         newAsset.metaData->titleThumbnailImageSize = gpd->thumbnail.length;
 
         newAsset.Rehash();
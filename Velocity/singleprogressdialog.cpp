@@ -87,7 +87,8 @@ void SingleProgressDialog::start()
                     try
                     {
                         FatxDrive *drive = reinterpret_cast<FatxDrive*>(device);
-                        drive->CreateBackup(externalPath.toStdString(), UpdateProgress, this);
+                        drive->CreateBackup(externalPath.toStdString(), UpdateProgress, this,
+                                internalPath.toStdString());
                     }
                     catch (string error)
                     {
@@ -8,7 +8,7 @@ SvodDialog::SvodDialog(SVOD *svod, QStatusBar *statusBar, QWidget *parent) :
     ui->setupUi(this);
     QtHelpers::GenAdjustWidgetAppearanceToOS(this);
 
-    loadListing(NULL, &svod->root);
+    loadListing(NULL, svod->GetRootListing());
 
     ui->treeWidget->header()->setDefaultSectionSize(75);
     ui->treeWidget->header()->resizeSection(0, 250);
@@ -40,11 +40,11 @@ SvodDialog::~SvodDialog()
     delete ui;
 }
 
-void SvodDialog::loadListing(QTreeWidgetItem *parent, vector<GdfxFileEntry> *files)
+void SvodDialog::loadListing(QTreeWidgetItem *parent, const vector<GdfxFileEntry*> &files)
 {
     DWORD addr, index;
 
-    for (DWORD i = 0; i < files->size(); i++)
+    for (DWORD i = 0; i < files.size(); i++)
     {
         QTreeWidgetItem *item;
         if (parent == NULL)
@@ -52,28 +52,49 @@ void SvodDialog::loadListing(QTreeWidgetItem *parent, vector<GdfxFileEntry> *fil
         else
             item = new QTreeWidgetItem(parent);
 
-        svod->SectorToAddress(files->at(i).sector, &addr, &index);
+        svod->SectorToAddress(files.at(i)->sector, &addr, &index);
 
 
         QIcon icon;
-        SvodIO io = svod->GetSvodIO(files->at(i));
-        QtHelpers::GetFileIcon(io.ReadDword(), QString::fromStdString(files->at(i).name), icon, *item);
+        SvodIO io = svod->GetSvodIO(*files.at(i));
+        QtHelpers::GetFileIcon(io.ReadDword(), QString::fromStdString(files.at(i)->name), icon, *item);
 
         item->setIcon(0, icon);
-        item->setText(0, QString::fromStdString(files->at(i).name));
-        item->setText(1, QString::fromStdString(ByteSizeToString(files->at(i).size)));
+        item->setText(0, QString::fromStdString(files.at(i)->name));
+        item->setText(1, QString::fromStdString(ByteSizeToString(files.at(i)->size)));
         item->setText(2, "0x" + QString::number(addr, 16).toUpper());
         item->setText(3, QString::number(index));
-        item->setData(0, Qt::UserRole, QVariant::fromValue(&files->at(i)));
+        item->setData(0, Qt::UserRole, QVariant::fromValue(files.at(i)));
 
-        if (files->at(i).attributes & GdfxDirectory)
+        // the folder's entries are read when it's expanded
+        if (files.at(i)->attributes & GdfxDirectory)
         {
             item->setIcon(0, QIcon(":/Images/FolderFileIcon.png"));
-            loadListing(item, &files->at(i).files);
+            item->setChildIndicatorPolicy(QTreeWidgetItem::ShowIndicator);
         }
     }
 }
 
+void SvodDialog::on_treeWidget_itemExpanded(QTreeWidgetItem *item)
+{
+    if (item->childCount() > 0)
+        return;
+
+    try
+    {
+        GdfxFileEntry *entry = item->data(0, Qt::UserRole).value<GdfxFileEntry*>();
+        loadListing(item, svod->GetDirectoryListing(entry));
+
+        if (item->childCount() == 0)
+            item->setChildIndicatorPolicy(QTreeWidgetItem::DontShowIndicator);
+    }
+    catch (string error)
+    {
+        QMessageBox::warning(this, "Problem Loading",
+                "The folder failed to load.\n\n" + QString::fromStdString(error));
+    }
+}
+
 void SvodDialog::showFileContextMenu(QPoint pos)
 {
     if (ui->treeWidget->currentIndex().row() == -1)
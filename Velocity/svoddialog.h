@@ -54,6 +54,8 @@ private slots:
 
     void on_treeWidget_itemDoubleClicked(QTreeWidgetItem *item, int column);
 
+    void on_treeWidget_itemExpanded(QTreeWidgetItem *item);
+
     void on_btnResign_clicked();
 
 private:
@@ -61,7 +63,7 @@ private:
     SVOD *svod;
     QStatusBar *statusBar;
 
-    void loadListing(QTreeWidgetItem *parent, vector<GdfxFileEntry> *files);
+    void loadListing(QTreeWidgetItem *parent, const vector<GdfxFileEntry*> &files);
 
     friend void UpdateProgress(DWORD cur, DWORD total, void *arg);
 };
@@ -42,7 +42,9 @@ void ThemeCreationWizard::onFinished(int status)
         return;
     try
     {
-        StfsPackage *theme = new StfsPackage(ui->lblSavePath->text().toStdString(), StfsPackageCreate);
+        // the theme is built in memory and saved once it's finished
+        StfsPackageBuilder builder;
+        StfsPackage *theme = builder.GetPackage();
 
         // create a new file
         theme->metaData->magic = CON;
@@ -115,14 +117,13 @@ void ThemeCreationWizard::onFinished(int status)
         // fix the package
         theme->Rehash();
         theme->Resign(QtHelpers::GetKVPath(theme->metaData->certificate.ownerConsoleType, this));
+        builder.Save(ui->lblSavePath->text().toStdString());
 
         // delete the temp files
         QFile::remove(paramsFilePath);
         QFile::remove(dashStyleFilePath);
 
         statusBar->showMessage("Theme created successfully", 3000);
-
-        delete theme;
     }
     catch (string error)
     {
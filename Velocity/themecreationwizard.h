@@ -14,6 +14,7 @@
 
 // xbox 360
 #include "Stfs/StfsPackage.h"
+#include "Stfs/StfsPackageBuilder.h"
 
 // std
 #include <iostream>
@@ -365,7 +365,8 @@ void XdbfDialog::on_treeWidget_doubleClicked(const QModelIndex &index)
         }
         case Image:
         {
-            QByteArray imageBuff((char*)gpd->images.at(e.index).image, (size_t)gpd->images.at(e.index).length);
+            QByteArray imageBuff((char*)gpd->GetImageData(&gpd->images.at(e.index)),
+                    (size_t)gpd->images.at(e.index).length);
 
             ImageDialog dialog(QImage::fromData(imageBuff), this);
             dialog.exec();
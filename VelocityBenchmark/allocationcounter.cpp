@@ -0,0 +1,70 @@
+#include "allocationcounter.h"
+
+#include <cstdlib>
+#include <new>
+
+// dynamic exception specifications are gone in newer versions of the language
+#if __cplusplus >= 201103L
+#define ALLOCATION_THROWS
+#else
+#define ALLOCATION_THROWS throw(std::bad_alloc)
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#define ATOMIC_ADD(target, value) _InterlockedExchangeAdd64((volatile __int64*)(target), (__int64)(value))
+#else
+#define ATOMIC_ADD(target, value) __sync_fetch_and_add((target), (UINT64)(value))
+#endif
+
+static volatile UINT64 allocationCount = 0;
+static volatile UINT64 allocatedBytes = 0;
+
+static void *countedAllocate(size_t size)
+{
+    ATOMIC_ADD(&allocationCount, 1);
+    ATOMIC_ADD(&allocatedBytes, size);
+
+    // malloc(0) is allowed to return NULL, new isn't
+    void *memory = malloc(size ? size : 1);
+    if (memory == NULL)
+        throw std::bad_alloc();
+    return memory;
+}
+
+void *operator new(size_t size) ALLOCATION_THROWS
+{
+    return countedAllocate(size);
+}
+
+void *operator new[](size_t size) ALLOCATION_THROWS
+{
+    return countedAllocate(size);
+}
+
+void operator delete(void *memory) throw()
+{
+    free(memory);
+}
+
+void operator delete[](void *memory) throw()
+{
+    free(memory);
+}
+
+AllocationCount AllocationCounter::Current()
+{
+    AllocationCount count;
+    count.allocations = ATOMIC_ADD(&allocationCount, 0);
+    count.bytes = ATOMIC_ADD(&allocatedBytes, 0);
+    return count;
+}
+
+AllocationCount AllocationCounter::Difference(const AllocationCount &start,
+        const AllocationCount &end)
+{
+    AllocationCount difference;
+    difference.allocations = end.allocations - start.allocations;
+    difference.bytes = end.bytes - start.bytes;
+    return difference;
+}
@@ -0,0 +1,24 @@
+#ifndef ALLOCATIONCOUNTER_H
+#define ALLOCATIONCOUNTER_H
+
+#include "winnames.h"
+
+struct AllocationCount
+{
+    UINT64 allocations;
+    UINT64 bytes;
+};
+
+// counts every call to operator new in the process, which includes XboxInternals as long as it's
+// linked in statically. A shared library on windows has its own operator new and isn't counted
+class AllocationCounter
+{
+public:
+    // the totals since the program started
+    static AllocationCount Current();
+
+    // the allocations made between two calls to Current
+    static AllocationCount Difference(const AllocationCount &start, const AllocationCount &end);
+};
+
+#endif // ALLOCATIONCOUNTER_H
@@ -0,0 +1,40 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <string>
+
+#include "winnames.h"
+#include "fixtures.h"
+
+// a single operation being measured. Open is called once before the first iteration, then every
+// iteration calls Reset and Run. Only Run is timed, and everything throws strings on failure
+class Benchmark
+{
+public:
+    virtual ~Benchmark() {}
+
+    // the operation, like stfs.rehash
+    virtual std::string Name() = 0;
+
+    // the data the operation runs on, like stfs-16m-contiguous
+    virtual std::string Fixture() = 0;
+
+    // generate the fixture if needed and open it
+    virtual void Open(FixtureGenerator *fixtures) = 0;
+
+    // put things back the way they were before the last run
+    virtual void Reset() {}
+
+    virtual void Run() = 0;
+
+    // release everything opened, the benchmark isn't used again after this
+    virtual void Close() {}
+
+    // the amount of data a single run goes through, 0 if throughput doesn't mean anything
+    virtual UINT64 BytesPerRun() { return 0; }
+
+    // the number of things (files, entries) a single run handles, 0 if there's nothing to count
+    virtual UINT64 ItemsPerRun() { return 0; }
+};
+
+#endif // BENCHMARK_H
@@ -0,0 +1,107 @@
+#include "benchmarkrunner.h"
+#include "allocationcounter.h"
+#include "stopwatch.h"
+
+#include <exception>
+
+double BenchmarkResult::Throughput() const
+{
+    if (bytes == 0 || bestSeconds <= 0)
+        return 0;
+    return (double)bytes / bestSeconds;
+}
+
+BenchmarkRunner::BenchmarkRunner(FixtureGenerator *fixtures, DWORD iterations,
+        DWORD warmupIterations) :
+    fixtures(fixtures), iterations(iterations ? iterations : 1), warmupIterations(warmupIterations)
+{
+}
+
+BenchmarkResult BenchmarkRunner::Run(Benchmark *benchmark)
+{
+    BenchmarkResult result;
+    result.name = benchmark->Name();
+    result.fixture = benchmark->Fixture();
+    result.success = true;
+    result.iterations = 0;
+    result.bestSeconds = 0;
+    result.meanSeconds = 0;
+    result.bytes = 0;
+    result.items = 0;
+    result.allocations = 0;
+    result.allocatedBytes = 0;
+
+    bool opened = false;
+    try
+    {
+        benchmark->Open(fixtures);
+        opened = true;
+
+        result.bytes = benchmark->BytesPerRun();
+        result.items = benchmark->ItemsPerRun();
+
+        // the first runs fill the caches and aren't counted
+        for (DWORD i = 0; i < warmupIterations; i++)
+        {
+            benchmark->Reset();
+            benchmark->Run();
+        }
+
+        Stopwatch stopwatch;
+        double totalSeconds = 0;
+        AllocationCount totalAllocations = { 0, 0 };
+
+        for (DWORD i = 0; i < iterations; i++)
+        {
+            benchmark->Reset();
+
+            AllocationCount before = AllocationCounter::Current();
+            stopwatch.Start();
+
+            benchmark->Run();
+
+            double seconds = stopwatch.Elapsed();
+            AllocationCount used = AllocationCounter::Difference(before, AllocationCounter::Current());
+
+            totalSeconds += seconds;
+            totalAllocations.allocations += used.allocations;
+            totalAllocations.bytes += used.bytes;
+
+            if (i == 0 || seconds < result.bestSeconds)
+                result.bestSeconds = seconds;
+            result.iterations++;
+        }
+
+        result.meanSeconds = totalSeconds / result.iterations;
+        result.allocations = totalAllocations.allocations / result.iterations;
+        result.allocatedBytes = totalAllocations.bytes / result.iterations;
+    }
+    catch (std::string error)
+    {
+        result.success = false;
+        result.error = error;
+    }
+    catch (std::exception &e)
+    {
+        result.success = false;
+        result.error = std::string(e.what()) + "\n";
+    }
+
+    if (opened)
+    {
+        try
+        {
+            benchmark->Close();
+        }
+        catch (std::string error)
+        {
+            if (result.success)
+            {
+                result.success = false;
+                result.error = error;
+            }
+        }
+    }
+
+    return result;
+}
@@ -0,0 +1,44 @@
+#ifndef BENCHMARKRUNNER_H
+#define BENCHMARKRUNNER_H
+
+#include <string>
+
+#include "benchmark.h"
+
+struct BenchmarkResult
+{
+    std::string name;
+    std::string fixture;
+    bool success;
+    std::string error;
+
+    DWORD iterations;
+    double bestSeconds;
+    double meanSeconds;
+
+    UINT64 bytes;
+    UINT64 items;
+
+    // averaged over the timed iterations
+    UINT64 allocations;
+    UINT64 allocatedBytes;
+
+    // bytes per second for the best run, 0 when the benchmark doesn't count bytes
+    double Throughput() const;
+};
+
+class BenchmarkRunner
+{
+public:
+    BenchmarkRunner(FixtureGenerator *fixtures, DWORD iterations, DWORD warmupIterations);
+
+    // run the benchmark, failures are reported in the result instead of being thrown
+    BenchmarkResult Run(Benchmark *benchmark);
+
+private:
+    FixtureGenerator *fixtures;
+    DWORD iterations;
+    DWORD warmupIterations;
+};
+
+#endif // BENCHMARKRUNNER_H
@@ -0,0 +1,797 @@
+#include "benchmarks.h"
+
+#include <cctype>
+#include <cstdio>
+#include <sstream>
+
+#include "Stfs/StfsPackageBuilder.h"
+#include "Fatx/FatxDrive.h"
+#include "Gpd/Xdbf.h"
+#include "Disc/Svod.h"
+#include "IO/FileIO.h"
+#include "IO/MemoryIO.h"
+#include "Cryptography/Sha1.h"
+
+#define KB 0x400
+#define MB 0x100000
+
+static std::string sizeName(UINT64 bytes)
+{
+    std::stringstream name;
+    if (bytes >= MB && bytes % MB == 0)
+        name << (bytes / MB) << "m";
+    else
+        name << (bytes / KB) << "k";
+    return name.str();
+}
+
+static UINT64 fileLength(std::string path)
+{
+    FileIO file(path);
+    UINT64 length = file.Length();
+    file.Close();
+    return length;
+}
+
+static void copyFile(std::string from, std::string to)
+{
+    FileIO in(from);
+    FileIO out(to, true);
+
+    BYTE *buffer = new BYTE[MB];
+    UINT64 remaining = in.Length();
+    while (remaining != 0)
+    {
+        DWORD length = (remaining > MB) ? MB : (DWORD)remaining;
+        in.ReadBytes(buffer, length);
+        out.WriteBytes(buffer, length);
+        remaining -= length;
+    }
+    delete[] buffer;
+
+    in.Close();
+    out.Close();
+}
+
+// the settings for the STFS fixtures
+struct StfsFixture
+{
+    DWORD fileCount;
+    DWORD fileSize;
+    DWORD fragmentation;
+
+    std::string Name()
+    {
+        std::stringstream name;
+        name << "stfs-" << sizeName((UINT64)fileCount * fileSize) << "-";
+        if (fragmentation == 0)
+            name << "contiguous";
+        else
+            name << "fragmented" << (fragmentation + 1);
+        return name.str();
+    }
+
+    std::string Create(FixtureGenerator *fixtures)
+    {
+        return fixtures->CreateStfsPackage(Name() + ".con", fileCount, fileSize, fragmentation);
+    }
+};
+
+// fix every hash in a package
+class StfsRehashBenchmark : public Benchmark
+{
+public:
+    StfsRehashBenchmark(StfsFixture fixture) :
+        fixture(fixture), package(NULL), length(0)
+    {
+    }
+
+    std::string Name() { return "stfs.rehash"; }
+    std::string Fixture() { return fixture.Name(); }
+
+    void Open(FixtureGenerator *fixtures)
+    {
+        std::string path = fixture.Create(fixtures);
+        length = fileLength(path);
+        package = new StfsPackage(path);
+    }
+
+    void Run()
+    {
+        package->Rehash();
+    }
+
+    void Close()
+    {
+        delete package;
+    }
+
+    UINT64 BytesPerRun() { return length; }
+
+private:
+    StfsFixture fixture;
+    StfsPackage *package;
+    UINT64 length;
+};
+
+// extract every file in a package to memory
+class StfsExtractBenchmark : public Benchmark
+{
+public:
+    StfsExtractBenchmark(StfsFixture fixture) :
+        fixture(fixture), package(NULL), out(NULL)
+    {
+    }
+
+    std::string Name() { return "stfs.extract"; }
+    std::string Fixture() { return fixture.Name(); }
+
+    void Open(FixtureGenerator *fixtures)
+    {
+        package = new StfsPackage(fixture.Create(fixtures));
+        entries = package->GetFileListing().fileEntries;
+
+        // reserve enough up front that growing the stream isn't part of the timing
+        out = new MemoryIO(fixture.fileSize);
+    }
+
+    void Run()
+    {
+        for (DWORD i = 0; i < entries.size(); i++)
+        {
+            out->SetPosition(0);
+            package->ExtractFile(&entries.at(i), out);
+        }
+    }
+
+    void Close()
+    {
+        delete out;
+        delete package;
+    }
+
+    UINT64 BytesPerRun() { return (UINT64)fixture.fileCount * fixture.fileSize; }
+    UINT64 ItemsPerRun() { return fixture.fileCount; }
+
+private:
+    StfsFixture fixture;
+    StfsPackage *package;
+    std::vector<StfsFileEntry> entries;
+    MemoryIO *out;
+};
+
+// inject a local file into a copy of a package
+class StfsInjectBenchmark : public Benchmark
+{
+public:
+    StfsInjectBenchmark(StfsFixture fixture, DWORD injectSize) :
+        fixture(fixture), injectSize(injectSize), package(NULL)
+    {
+    }
+
+    std::string Name() { return "stfs.inject"; }
+    std::string Fixture() { return fixture.Name() + "+" + sizeName(injectSize); }
+
+    void Open(FixtureGenerator *fixtures)
+    {
+        sourcePath = fixture.Create(fixtures);
+        workPath = fixtures->Path(Fixture() + ".work.con");
+        payloadPath = fixtures->CreateDataFile("payload-" + sizeName(injectSize) + ".bin",
+                injectSize);
+    }
+
+    void Reset()
+    {
+        delete package;
+        package = NULL;
+
+        copyFile(sourcePath, workPath);
+        package = new StfsPackage(workPath);
+    }
+
+    void Run()
+    {
+        package->InjectFile(payloadPath, "injected.bin");
+    }
+
+    void Close()
+    {
+        delete package;
+        remove(workPath.c_str());
+    }
+
+    UINT64 BytesPerRun() { return injectSize; }
+
+private:
+    StfsFixture fixture;
+    DWORD injectSize;
+    StfsPackage *package;
+
+    std::string sourcePath;
+    std::string workPath;
+    std::string payloadPath;
+};
+
+// build a package from scratch, either straight on disk or in memory with StfsPackageBuilder
+class StfsBuildBenchmark : public Benchmark
+{
+public:
+    StfsBuildBenchmark(DWORD fileCount, DWORD fileSize, bool inMemory) :
+        fileCount(fileCount), fileSize(fileSize), inMemory(inMemory), data(NULL)
+    {
+    }
+
+    std::string Name() { return inMemory ? "stfs.build.memory" : "stfs.build.file"; }
+    std::string Fixture()
+    {
+        std::stringstream name;
+        name << fileCount << "x" << sizeName(fileSize);
+        return name.str();
+    }
+
+    void Open(FixtureGenerator *fixtures)
+    {
+        outPath = fixtures->Path(Name() + ".con");
+        data = new BYTE[fileSize];
+        fixtures->FillRandom(data, fileSize);
+    }
+
+    void Reset()
+    {
+        remove(outPath.c_str());
+    }
+
+    void Run()
+    {
+        if (inMemory)
+        {
+            StfsPackageBuilder builder(0, (size_t)fileCount * fileSize);
+            fill(builder.GetPackage());
+            builder.Save(outPath);
+        }
+        else
+        {
+            StfsPackage package(outPath, StfsPackageCreate);
+            fill(&package);
+            package.Close();
+        }
+    }
+
+    void Close()
+    {
+        delete[] data;
+        remove(outPath.c_str());
+    }
+
+    UINT64 BytesPerRun() { return (UINT64)fileCount * fileSize; }
+    UINT64 ItemsPerRun() { return fileCount; }
+
+private:
+    DWORD fileCount;
+    DWORD fileSize;
+    bool inMemory;
+    BYTE *data;
+    std::string outPath;
+
+    void fill(StfsPackage *package)
+    {
+        package->metaData->contentType = SavedGame;
+        package->metaData->titleID = 0xFFFE07D1;
+
+        for (DWORD i = 0; i < fileCount; i++)
+        {
+            std::stringstream name;
+            name << "file" << i << ".bin";
+            package->InjectData(data, fileSize, name.str());
+        }
+
+        package->metaData->WriteMetaData();
+        package->Rehash();
+    }
+};
+
+// the settings for the FATX fixtures
+struct FatxFixture
+{
+    UINT64 imageSize;
+    DWORD folderCount;
+    DWORD filesPerFolder;
+    DWORD fileSize;
+
+    // the size of the dashboard partition at the end of the image, 0 for none
+    UINT64 dashboardSize;
+
+    std::string Name()
+    {
+        std::stringstream name;
+        name << "fatx-" << sizeName(imageSize) << "-" << folderCount << "x" << filesPerFolder;
+        if (dashboardSize != 0)
+            name << "+dash" << sizeName(dashboardSize);
+        return name.str();
+    }
+
+    std::string Create(FixtureGenerator *fixtures)
+    {
+        return fixtures->CreateFatxImage(Name() + ".img", imageSize, folderCount, filesPerFolder,
+                fileSize, dashboardSize);
+    }
+};
+
+// scan the FAT of the Content partition for free clusters
+class FatxFreeMemoryBenchmark : public Benchmark
+{
+public:
+    FatxFreeMemoryBenchmark(FatxFixture fixture) :
+        fixture(fixture), drive(NULL), content(NULL)
+    {
+    }
+
+    std::string Name() { return "fatx.freememory"; }
+    std::string Fixture() { return fixture.Name(); }
+
+    void Open(FixtureGenerator *fixtures)
+    {
+        drive = new FatxDrive(fixture.Create(fixtures), FatxHarddrive);
+        content = drive->GetPartitions().at(0);
+    }
+
+    void Reset()
+    {
+        // the free memory is cached after the first scan
+        content->freeClusters.Clear();
+        content->freeMemory = 0;
+        content->freeMemoryCounted = false;
+    }
+
+    void Run()
+    {
+        drive->GetFreeMemory(content);
+    }
+
+    void Close()
+    {
+        delete drive;
+    }
+
+    UINT64 BytesPerRun() { return (UINT64)content->clusterCount * content->clusterEntrySize; }
+    UINT64 ItemsPerRun() { return content->clusterCount; }
+
+private:
+    FatxFixture fixture;
+    FatxDrive *drive;
+    Partition *content;
+};
+
+// count the free memory and read the root folders of all the partitions at once. With firstOnly
+// only the time until the first partition can be used is measured
+class FatxMountBenchmark : public Benchmark
+{
+public:
+    FatxMountBenchmark(FatxFixture fixture, bool firstOnly) :
+        fixture(fixture), firstOnly(firstOnly), drive(NULL), mounter(NULL)
+    {
+    }
+
+    std::string Name() { return firstOnly ? "fatx.mount.first" : "fatx.mount"; }
+    std::string Fixture() { return fixture.Name(); }
+
+    void Open(FixtureGenerator *fixtures)
+    {
+        drive = new FatxDrive(fixture.Create(fixtures), FatxHarddrive);
+    }
+
+    void Reset()
+    {
+        // the partitions that are left are finished here, so they aren't timed
+        delete mounter;
+        mounter = NULL;
+
+        // the free memory and the root folders are cached after they're read
+        std::vector<Partition*> partitions = drive->GetPartitions();
+        for (size_t i = 0; i < partitions.size(); i++)
+        {
+            Partition *part = partitions.at(i);
+            part->freeClusters.Clear();
+            part->freeMemory = 0;
+            part->freeMemoryCounted = false;
+            part->root.cachedFiles.clear();
+            part->root.clusterChain.clear();
+            part->root.readDirectories = false;
+        }
+
+        mounter = new FatxMounter(drive);
+    }
+
+    void Run()
+    {
+        mounter->Start();
+        if (firstOnly)
+            mounter->WaitForNext();
+        else
+            mounter->Finish();
+    }
+
+    void Close()
+    {
+        delete mounter;
+        delete drive;
+    }
+
+    UINT64 BytesPerRun()
+    {
+        if (firstOnly)
+            return 0;
+
+        UINT64 bytes = 0;
+        std::vector<Partition*> partitions = drive->GetPartitions();
+        for (size_t i = 0; i < partitions.size(); i++)
+            bytes += (UINT64)partitions.at(i)->clusterCount * partitions.at(i)->clusterEntrySize;
+        return bytes;
+    }
+
+    UINT64 ItemsPerRun() { return firstOnly ? 1 : drive->GetPartitions().size(); }
+
+private:
+    FatxFixture fixture;
+    bool firstOnly;
+    FatxDrive *drive;
+    FatxMounter *mounter;
+};
+
+// scan every cluster of the Content partition for deleted files, on a copy of the image that has
+// every other file in the first folder deleted
+class FatxRecoveryScanBenchmark : public Benchmark
+{
+public:
+    FatxRecoveryScanBenchmark(FatxFixture fixture) :
+        fixture(fixture), drive(NULL), content(NULL)
+    {
+    }
+
+    std::string Name() { return "fatx.recovery.scan"; }
+    std::string Fixture() { return fixture.Name(); }
+
+    void Open(FixtureGenerator *fixtures)
+    {
+        std::string workPath = fixtures->Path(Fixture() + ".recovery.img");
+        copyFile(fixture.Create(fixtures), workPath);
+
+        drive = new FatxDrive(workPath, FatxHarddrive);
+        content = drive->GetPartitions().at(0);
+        drive->GetChildFileEntries(&content->root);
+        if (content->root.cachedFiles.size() == 0)
+            throw std::string("Benchmark: The fatx image doesn't have any folders.\n");
+
+        FatxFileEntry *folder = &content->root.cachedFiles.at(0);
+        drive->GetChildFileEntries(folder);
+        for (size_t i = 0; i < folder->cachedFiles.size(); i += 2)
+            drive->RemoveFile(&folder->cachedFiles.at(i));
+    }
+
+    void Reset()
+    {
+    }
+
+    void Run()
+    {
+        drive->FindDeletedFiles(content);
+    }
+
+    void Close()
+    {
+        delete drive;
+    }
+
+    UINT64 BytesPerRun() { return (UINT64)content->clusterCount * content->clusterSize; }
+    UINT64 ItemsPerRun() { return content->clusterCount; }
+
+private:
+    FatxFixture fixture;
+    FatxDrive *drive;
+    Partition *content;
+};
+
+// read the listing of a folder with a lot of files in it
+class FatxListingBenchmark : public Benchmark
+{
+public:
+    FatxListingBenchmark(FatxFixture fixture) :
+        fixture(fixture), drive(NULL), folder(NULL)
+    {
+    }
+
+    std::string Name() { return "fatx.listing"; }
+    std::string Fixture() { return fixture.Name(); }
+
+    void Open(FixtureGenerator *fixtures)
+    {
+        drive = new FatxDrive(fixture.Create(fixtures), FatxHarddrive);
+
+        Partition *content = drive->GetPartitions().at(0);
+        drive->GetChildFileEntries(&content->root);
+        if (content->root.cachedFiles.size() == 0)
+            throw std::string("Benchmark: The fatx image doesn't have any folders.\n");
+        folder = &content->root.cachedFiles.at(0);
+    }
+
+    void Reset()
+    {
+        // the listing is cached after it's read
+        folder->cachedFiles.clear();
+        folder->clusterChain.clear();
+        folder->readDirectories = false;
+    }
+
+    void Run()
+    {
+        drive->GetChildFileEntries(folder);
+    }
+
+    void Close()
+    {
+        delete drive;
+    }
+
+    UINT64 BytesPerRun() { return (UINT64)fixture.filesPerFolder * FATX_ENTRY_SIZE; }
+    UINT64 ItemsPerRun() { return fixture.filesPerFolder; }
+
+private:
+    FatxFixture fixture;
+    FatxDrive *drive;
+    FatxFileEntry *folder;
+};
+
+// catalog the headers of the packages on the Content partition, starting from a freshly loaded drive
+class FatxCatalogBenchmark : public Benchmark
+{
+public:
+    FatxCatalogBenchmark(DWORD packageCount) :
+        packageCount(packageCount), drive(NULL)
+    {
+    }
+
+    std::string Name() { return "fatx.catalog"; }
+    std::string Fixture()
+    {
+        std::stringstream name;
+        name << "fatx-" << packageCount << "-packages";
+        return name.str();
+    }
+
+    void Open(FixtureGenerator *fixtures)
+    {
+        std::string packagePath = fixtures->CreateStfsPackage("catalog.con", 4, 16 * KB, 0);
+        drive = new FatxDrive(fixtures->CreateFatxImage(Fixture() + ".img", 512 * MB, 1, 1, 4 * KB),
+                FatxHarddrive);
+
+        // the free clusters have to be read in before anything can be injected
+        drive->GetFreeMemory(drive->GetPartitions().at(0));
+
+        FatxFileEntry *folder = drive->CreatePath(
+                "Drive:\\Content\\Content\\0000000000000000\\FFFE07D1\\00000001");
+        for (DWORD i = 0; i < packageCount; i++)
+        {
+            std::stringstream name;
+            name << "package" << i;
+            drive->InjectFile(folder, name.str(), packagePath);
+        }
+    }
+
+    void Reset()
+    {
+        // the catalog and the listings it reads are thrown away when the drive is reloaded
+        drive->ReloadDrive();
+    }
+
+    void Run()
+    {
+        if (drive->GetContentCatalog()->Count() != packageCount)
+            throw std::string("Benchmark: The catalog is missing packages.\n");
+    }
+
+    void Close()
+    {
+        delete drive;
+    }
+
+    UINT64 BytesPerRun() { return (UINT64)packageCount * FATX_CATALOG_HEADER_SIZE; }
+    UINT64 ItemsPerRun() { return packageCount; }
+
+private:
+    DWORD packageCount;
+    FatxDrive *drive;
+};
+
+// remove the unused memory from a gpd, in memory so only the cleaning is measured
+class GpdCleanBenchmark : public Benchmark
+{
+public:
+    GpdCleanBenchmark(DWORD settingCount) :
+        settingCount(settingCount), io(NULL), xdbf(NULL)
+    {
+    }
+
+    std::string Name() { return "gpd.clean"; }
+    std::string Fixture()
+    {
+        std::stringstream name;
+        name << "gpd-" << settingCount << "-settings";
+        return name.str();
+    }
+
+    void Open(FixtureGenerator *fixtures)
+    {
+        FileIO gpd(fixtures->CreateGpd(Fixture() + ".gpd", settingCount));
+        original.resize(gpd.Length());
+        gpd.ReadBytes(&original.at(0), original.size());
+        gpd.Close();
+    }
+
+    void Reset()
+    {
+        delete xdbf;
+        delete io;
+
+        io = new MemoryIO(original.size());
+        io->Write(&original.at(0), original.size());
+        xdbf = new Xdbf(io);
+    }
+
+    void Run()
+    {
+        xdbf->Clean();
+    }
+
+    void Close()
+    {
+        delete xdbf;
+        delete io;
+    }
+
+    UINT64 BytesPerRun() { return original.size(); }
+    UINT64 ItemsPerRun() { return settingCount; }
+
+private:
+    DWORD settingCount;
+    std::vector<BYTE> original;
+    MemoryIO *io;
+    Xdbf *xdbf;
+};
+
+// fix every hash in an SVOD system
+class SvodRehashBenchmark : public Benchmark
+{
+public:
+    SvodRehashBenchmark(DWORD dataFileCount, DWORD blockGroupsPerFile) :
+        dataFileCount(dataFileCount), blockGroupsPerFile(blockGroupsPerFile), svod(NULL)
+    {
+    }
+
+    std::string Name() { return "svod.rehash"; }
+    std::string Fixture()
+    {
+        std::stringstream name;
+        name << "svod-" << dataFileCount << "x" << sizeName(dataFileLength());
+        return name.str();
+    }
+
+    void Open(FixtureGenerator *fixtures)
+    {
+        svod = new SVOD(fixtures->CreateSvodSystem(Fixture(), dataFileCount, blockGroupsPerFile));
+    }
+
+    void Run()
+    {
+        svod->Rehash();
+    }
+
+    void Close()
+    {
+        delete svod;
+    }
+
+    UINT64 BytesPerRun() { return dataFileCount * dataFileLength(); }
+    UINT64 ItemsPerRun() { return dataFileCount; }
+
+private:
+    DWORD dataFileCount;
+    DWORD blockGroupsPerFile;
+    SVOD *svod;
+
+    UINT64 dataFileLength()
+    {
+        return 0x1000 + (UINT64)blockGroupsPerFile * 0xCD000;
+    }
+};
+
+// hashes a buffer of 0x1000 byte blocks the way the rehash functions do, once per implementation
+class Sha1BlocksBenchmark : public Benchmark
+{
+public:
+    Sha1BlocksBenchmark(Sha1Backend backend, DWORD blockCount) :
+        backend(backend), blockCount(blockCount)
+    {
+    }
+
+    std::string Name() { return "sha1.hashblocks"; }
+    std::string Fixture()
+    {
+        std::string name = Sha1::BackendToString(backend);
+        for (DWORD i = 0; i < name.length(); i++)
+            name.at(i) = tolower(name.at(i));
+        return name + "-" + sizeName((UINT64)blockCount * 0x1000);
+    }
+
+    void Open(FixtureGenerator *fixtures)
+    {
+        blocks.resize(blockCount * 0x1000);
+        hashes.resize(blockCount * 0x14);
+        fixtures->FillRandom(&blocks.at(0), blocks.size());
+
+        previous = Sha1::GetBackend();
+        Sha1::SetBackend(backend);
+    }
+
+    void Run()
+    {
+        Sha1::HashBlocks(&blocks.at(0), blockCount, &hashes.at(0));
+    }
+
+    void Close()
+    {
+        Sha1::SetBackend(previous);
+    }
+
+    UINT64 BytesPerRun() { return blocks.size(); }
+    UINT64 ItemsPerRun() { return blockCount; }
+
+private:
+    Sha1Backend backend, previous;
+    DWORD blockCount;
+    std::vector<BYTE> blocks;
+    std::vector<BYTE> hashes;
+};
+
+void CreateBenchmarks(DWORD scale, std::vector<Benchmark*> *out)
+{
+    StfsFixture small = { 16, 64 * KB, 0 };
+    StfsFixture medium = { 64, 256 * KB * scale, 0 };
+    StfsFixture fragmented = { 64, 256 * KB * scale, 7 };
+    StfsFixture large = { 64, MB * scale, 0 };
+
+    out->push_back(new StfsRehashBenchmark(small));
+    out->push_back(new StfsRehashBenchmark(medium));
+    out->push_back(new StfsRehashBenchmark(fragmented));
+    out->push_back(new StfsRehashBenchmark(large));
+
+    out->push_back(new StfsExtractBenchmark(medium));
+    out->push_back(new StfsExtractBenchmark(fragmented));
+
+    out->push_back(new StfsInjectBenchmark(medium, 4 * MB * scale));
+
+    out->push_back(new StfsBuildBenchmark(64, 256 * KB * scale, false));
+    out->push_back(new StfsBuildBenchmark(64, 256 * KB * scale, true));
+
+    FatxFixture fatx = { (UINT64)2048 * MB * scale, 2, 512, 4 * KB, 0 };
+    out->push_back(new FatxFreeMemoryBenchmark(fatx));
+    out->push_back(new FatxListingBenchmark(fatx));
+
+    FatxFixture recovery = { (UINT64)512 * MB * scale, 2, 512, 4 * KB, 0 };
+    out->push_back(new FatxRecoveryScanBenchmark(recovery));
+
+    FatxFixture twoPartitions = { (UINT64)4096 * MB * scale, 2, 16, 4 * KB,
+            (UINT64)2048 * MB * scale };
+    out->push_back(new FatxMountBenchmark(twoPartitions, false));
+    out->push_back(new FatxMountBenchmark(twoPartitions, true));
+    out->push_back(new FatxCatalogBenchmark(256 * scale));
+
+    out->push_back(new GpdCleanBenchmark(2000 * scale));
+
+    out->push_back(new SvodRehashBenchmark(3, 8 * scale));
+
+    // only the implementations this cpu can run
+    Sha1Backend backends[] = { Sha1Portable, Sha1Sse2, Sha1Avx2, Sha1ShaNi };
+    for (DWORD i = 0; i < sizeof(backends) / sizeof(backends[0]); i++)
+        if (Sha1::IsSupported(backends[i]))
+            out->push_back(new Sha1BlocksBenchmark(backends[i], 0x1000 * scale));
+}
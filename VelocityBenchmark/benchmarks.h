@@ -0,0 +1,12 @@
+#ifndef BENCHMARKS_H
+#define BENCHMARKS_H
+
+#include <vector>
+
+#include "benchmark.h"
+
+// every benchmark in the suite, the sizes of the fixtures are multiplied by scale. The caller
+// owns the benchmarks
+void CreateBenchmarks(DWORD scale, std::vector<Benchmark*> *out);
+
+#endif // BENCHMARKS_H
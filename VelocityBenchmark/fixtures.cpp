@@ -0,0 +1,502 @@
+#include "fixtures.h"
+
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "Stfs/StfsPackageBuilder.h"
+#include "Fatx/FatxDrive.h"
+#include "Gpd/GpdBase.h"
+#include "IO/FileIO.h"
+
+// where the Content partition starts in the fatx images
+#define FIXTURE_FATX_CONTENT_ADDRESS 0x80000
+
+static void makeDirectory(std::string path)
+{
+#ifdef _WIN32
+    _mkdir(path.c_str());
+#else
+    mkdir(path.c_str(), 0755);
+#endif
+}
+
+static void removeDirectory(std::string path)
+{
+#ifdef _WIN32
+    _rmdir(path.c_str());
+#else
+    rmdir(path.c_str());
+#endif
+}
+
+FixtureGenerator::FixtureGenerator(std::string scratchDirectory, DWORD seed) :
+    scratchDirectory(scratchDirectory), state(seed ? seed : 1), keep(false)
+{
+    if (this->scratchDirectory.size() != 0 &&
+            this->scratchDirectory.at(this->scratchDirectory.size() - 1) != '/')
+        this->scratchDirectory += "/";
+}
+
+FixtureGenerator::~FixtureGenerator()
+{
+    if (keep)
+        return;
+
+    for (size_t i = files.size(); i--;)
+        remove(files.at(i).c_str());
+    for (size_t i = directories.size(); i--;)
+        removeDirectory(directories.at(i));
+}
+
+void FixtureGenerator::Keep()
+{
+    keep = true;
+}
+
+std::string FixtureGenerator::Path(std::string name)
+{
+    return scratchDirectory + name;
+}
+
+DWORD FixtureGenerator::nextRandom()
+{
+    // xorshift, it's plenty random for filling files and much faster than rand
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+void FixtureGenerator::FillRandom(BYTE *buffer, DWORD length)
+{
+    DWORD i = 0;
+    for (; i + 4 <= length; i += 4)
+    {
+        DWORD value = nextRandom();
+        memcpy(buffer + i, &value, 4);
+    }
+
+    DWORD value = nextRandom();
+    memcpy(buffer + i, &value, length - i);
+}
+
+bool FixtureGenerator::findExisting(std::string name, std::string *path)
+{
+    std::map<std::string, std::string>::iterator existing = created.find(name);
+    if (existing == created.end())
+        return false;
+
+    *path = existing->second;
+    return true;
+}
+
+std::string FixtureGenerator::CreateDataFile(std::string name, DWORD length)
+{
+    std::string path;
+    if (findExisting(name, &path))
+        return path;
+    path = Path(name);
+
+    BYTE *data = new BYTE[length];
+    FillRandom(data, length);
+
+    try
+    {
+        FileIO out(path, true);
+        files.push_back(path);
+        out.Write(data, length);
+        out.Close();
+    }
+    catch (...)
+    {
+        delete[] data;
+        throw;
+    }
+    delete[] data;
+
+    created[name] = path;
+    return path;
+}
+
+std::string FixtureGenerator::CreateStfsPackage(std::string name, DWORD fileCount, DWORD fileSize,
+        DWORD fragmentation)
+{
+    std::string path;
+    if (findExisting(name, &path))
+        return path;
+    path = Path(name);
+
+    StfsPackageBuilder builder;
+    StfsPackage *package = builder.GetPackage();
+    package->metaData->contentType = SavedGame;
+    package->metaData->titleID = 0xFFFE07D1;
+
+    DWORD pieceCount = fragmentation + 1;
+    BYTE *data = new BYTE[fileSize];
+    std::string piecePath = Path(name + ".piece");
+
+    try
+    {
+        // every file starts out with just its first piece
+        for (DWORD i = 0; i < fileCount; i++)
+        {
+            std::stringstream fileName;
+            fileName << "file" << i << ".bin";
+
+            DWORD length = (DWORD)((UINT64)fileSize / pieceCount);
+            FillRandom(data, length);
+            package->InjectData(data, length, fileName.str());
+        }
+
+        // the files grow a piece at a time. Replacing a file keeps the blocks it already has and
+        // allocates the rest at the end of the package, so the pieces of the files end up interleaved
+        for (DWORD piece = 2; piece <= pieceCount; piece++)
+        {
+            DWORD length = (DWORD)(((UINT64)fileSize * piece) / pieceCount);
+            for (DWORD i = 0; i < fileCount; i++)
+            {
+                std::stringstream fileName;
+                fileName << "file" << i << ".bin";
+
+                FillRandom(data, length);
+                {
+                    FileIO pieceFile(piecePath, true);
+                    pieceFile.Write(data, length);
+                    pieceFile.Close();
+                }
+
+                package->ReplaceFile(piecePath, fileName.str());
+            }
+        }
+
+        package->metaData->WriteMetaData();
+        package->Rehash();
+
+        builder.Save(path);
+        files.push_back(path);
+    }
+    catch (...)
+    {
+        remove(piecePath.c_str());
+        delete[] data;
+        throw;
+    }
+    remove(piecePath.c_str());
+    delete[] data;
+
+    created[name] = path;
+    return path;
+}
+
+void FixtureGenerator::formatFatxImage(std::string path, UINT64 imageSize, UINT64 dashboardSize)
+{
+    UINT64 dashboardAddress = imageSize - dashboardSize;
+    {
+        // only the end of the file is written, so it's sparse where the file system supports it
+        FileIO image(path, true);
+        files.push_back(path);
+        image.SetPosition(imageSize - 1);
+        image.Write((BYTE)0);
+
+        // the last format recovery version found on dev kit drives that have a partition table
+        image.SetPosition(0);
+        image.Write((WORD)2);
+        image.Write((WORD)0);
+        image.Write((WORD)1525);
+        image.Write((WORD)1);
+
+        // the Content partition followed by the dashboard partition, in sectors
+        image.Write((DWORD)(FIXTURE_FATX_CONTENT_ADDRESS / FAT_SECTOR_SIZE));
+        image.Write((DWORD)((dashboardAddress - FIXTURE_FATX_CONTENT_ADDRESS) / FAT_SECTOR_SIZE));
+        image.Write((DWORD)(dashboardSize ? dashboardAddress / FAT_SECTOR_SIZE : 0));
+        image.Write((DWORD)(dashboardSize / FAT_SECTOR_SIZE));
+
+        // the boot sectors, 16 KiB clusters with the root directory in the first one
+        image.SetPosition(FIXTURE_FATX_CONTENT_ADDRESS);
+        image.Write((DWORD)FATX_MAGIC);
+        image.Write(nextRandom());
+        image.Write((DWORD)0x20);
+        image.Write((DWORD)1);
+
+        if (dashboardSize != 0)
+        {
+            image.SetPosition(dashboardAddress);
+            image.Write((DWORD)FATX_MAGIC);
+            image.Write(nextRandom());
+            image.Write((DWORD)0x20);
+            image.Write((DWORD)1);
+        }
+
+        image.Close();
+    }
+
+    // let the drive work out where the FATs and the clusters are
+    std::vector<Partition> partitions;
+    {
+        FatxDrive drive(path, FatxHarddrive);
+        std::vector<Partition*> mounted = drive.GetPartitions();
+        if (mounted.size() != (dashboardSize ? 2 : 1))
+            throw std::string("Fixtures: The fatx image didn't mount properly.\n");
+        for (size_t i = 0; i < mounted.size(); i++)
+            partitions.push_back(*mounted.at(i));
+    }
+
+    FileIO image(path);
+
+    for (size_t i = 0; i < partitions.size(); i++)
+    {
+        const Partition &part = partitions.at(i);
+
+        // the first cluster entry is reserved, and the root directory is a single cluster
+        image.SetPosition(part.address + 0x1000);
+        if (part.clusterEntrySize == FAT16)
+        {
+            image.Write((WORD)0xFFF8);
+            image.Write((WORD)FAT_CLUSTER16_LAST);
+        }
+        else
+        {
+            image.Write((DWORD)0xFFFFFFF8);
+            image.Write((DWORD)FAT_CLUSTER_LAST);
+        }
+
+        // an empty directory is all 0xFF
+        BYTE *emptyCluster = new BYTE[part.clusterSize];
+        memset(emptyCluster, 0xFF, part.clusterSize);
+        image.SetPosition(part.clusterStartingAddress);
+        image.Write(emptyCluster, part.clusterSize);
+        delete[] emptyCluster;
+    }
+
+    image.Close();
+}
+
+std::string FixtureGenerator::CreateFatxImage(std::string name, UINT64 imageSize, DWORD folderCount,
+        DWORD filesPerFolder, DWORD fileSize, UINT64 dashboardSize)
+{
+    std::string path;
+    if (findExisting(name, &path))
+        return path;
+    path = Path(name);
+
+    formatFatxImage(path, imageSize, dashboardSize);
+
+    std::string payloadPath = Path(name + ".payload");
+    FatxDrive drive(path, FatxHarddrive);
+    Partition *content = drive.GetPartitions().at(0);
+
+    // the clusters are allocated from the list of free ones
+    drive.GetFreeMemory(content);
+    drive.GetChildFileEntries(&content->root);
+
+    BYTE *data = new BYTE[fileSize];
+    try
+    {
+        for (DWORD i = 0; i < folderCount; i++)
+        {
+            std::stringstream folderName;
+            folderName << "Folder" << i;
+
+            FatxFileEntry *folder = drive.CreateFolder(&content->root, folderName.str());
+            for (DWORD x = 0; x < filesPerFolder; x++)
+            {
+                FillRandom(data, fileSize);
+                {
+                    FileIO payload(payloadPath, true);
+                    payload.Write(data, fileSize);
+                    payload.Close();
+                }
+
+                std::stringstream fileName;
+                fileName << "File" << x << ".bin";
+                drive.InjectFile(folder, fileName.str(), payloadPath);
+            }
+        }
+    }
+    catch (...)
+    {
+        remove(payloadPath.c_str());
+        delete[] data;
+        throw;
+    }
+    remove(payloadPath.c_str());
+    delete[] data;
+
+    drive.Close();
+
+    created[name] = path;
+    return path;
+}
+
+std::string FixtureGenerator::CreateGpd(std::string name, DWORD settingCount)
+{
+    std::string path;
+    if (findExisting(name, &path))
+        return path;
+    path = Path(name);
+
+    // room for every setting, the two sync entries and the free memory left behind by deleting
+    DWORD entryTableLength = settingCount + 0x10;
+    DWORD freeMemTableLength = settingCount + 0x10;
+    {
+        FileIO gpd(path, true);
+        files.push_back(path);
+
+        gpd.Write((DWORD)0x58444246);
+        gpd.Write((DWORD)0x10000);
+        gpd.Write(entryTableLength);
+        gpd.Write((DWORD)0);
+        gpd.Write(freeMemTableLength);
+        gpd.Write((DWORD)1);
+
+        // the tables are empty apart from the free memory entry that covers the rest of the file
+        BYTE *tables = new BYTE[(entryTableLength * 0x12) + (freeMemTableLength * 8)];
+        memset(tables, 0, (entryTableLength * 0x12) + (freeMemTableLength * 8));
+        gpd.Write(tables, (entryTableLength * 0x12) + (freeMemTableLength * 8));
+        delete[] tables;
+
+        gpd.SetPosition(0x18 + (entryTableLength * 0x12));
+        gpd.Write((DWORD)0);
+        gpd.Write((DWORD)0xFFFFFFFF);
+        gpd.Close();
+    }
+
+    GpdBase gpd(path);
+    std::vector<SettingEntry> toDelete;
+    for (DWORD i = 0; i < settingCount; i++)
+    {
+        SettingEntry setting;
+        if (i % 2 == 0)
+        {
+            setting.type = Int32;
+            setting.int32 = nextRandom();
+        }
+        else
+        {
+            // strings of different lengths so the free memory is fragmented
+            setting.type = UnicodeString;
+            setting.str = new std::wstring(1 + nextRandom() % 0x40, L'a' + (wchar_t)(i % 26));
+        }
+
+        gpd.CreateSettingEntry(&setting, 0x10000000 | i);
+        if (i % 3 == 0)
+            toDelete.push_back(setting);
+    }
+
+    for (DWORD i = 0; i < toDelete.size(); i++)
+    {
+        gpd.DeleteSettingEntry(toDelete.at(i));
+        if (toDelete.at(i).type == UnicodeString)
+            delete toDelete.at(i).str;
+    }
+    gpd.Close();
+
+    created[name] = path;
+    return path;
+}
+
+std::string FixtureGenerator::CreateSvodSystem(std::string name, DWORD dataFileCount,
+        DWORD blockGroupsPerFile)
+{
+    std::string path;
+    if (findExisting(name, &path))
+        return path;
+    path = Path(name);
+
+    DWORD groupLength = 0xCC * 0x1000;
+    UINT64 dataFileLength = 0x1000 + (UINT64)blockGroupsPerFile * (0x1000 + groupLength);
+
+    // the header only needs the fields SVOD looks at, the hashes are fixed when it's rehashed
+    {
+        BYTE *empty = new BYTE[0xA000];
+        memset(empty, 0, 0xA000);
+
+        FileIO header(path, true);
+        files.push_back(path);
+        header.Write(empty, 0xA000);
+        delete[] empty;
+
+        header.SetPosition(0);
+        header.Write((DWORD)LIVE);
+        header.SetPosition(0x340);
+        header.Write((DWORD)0x971A);
+        header.Write((DWORD)GameOnDemand);
+        header.Write((DWORD)2);
+
+        SvodVolumeDescriptor descriptor;
+        memset(&descriptor, 0, sizeof(SvodVolumeDescriptor));
+        descriptor.size = 0x24;
+        descriptor.dataBlockCount = dataFileCount * blockGroupsPerFile * 0xCC;
+        WriteSvodVolumeDescriptorEx(&descriptor, &header);
+
+        header.Write(dataFileCount);
+        header.Write((UINT64)(dataFileCount * dataFileLength));
+        header.Write((DWORD)FileSystemSVOD);
+        header.Close();
+    }
+
+    std::string dataDirectory = path + ".data";
+    makeDirectory(dataDirectory);
+    directories.push_back(dataDirectory);
+
+    BYTE *emptyTable = new BYTE[0x1000];
+    memset(emptyTable, 0, 0x1000);
+    BYTE *blocks = new BYTE[groupLength];
+
+    try
+    {
+        for (DWORD i = 0; i < dataFileCount; i++)
+        {
+            char fileName[16];
+            sprintf(fileName, "/Data%04d", (int)i);
+
+            FileIO dataFile(dataDirectory + fileName, true);
+            files.push_back(dataDirectory + fileName);
+
+            // the master hash table, then each group of blocks after its level 0 hash table
+            dataFile.Write(emptyTable, 0x1000);
+            for (DWORD x = 0; x < blockGroupsPerFile; x++)
+            {
+                FillRandom(blocks, groupLength);
+                dataFile.Write(emptyTable, 0x1000);
+                dataFile.Write(blocks, groupLength);
+            }
+
+            if (i == 0)
+            {
+                // the GDFX header is in sector 0x20, the root directory is an empty sector after it
+                dataFile.SetPosition(0x12000);
+                dataFile.Write((BYTE*)"MICROSOFT*XBOX*MEDIA", 0x14);
+                dataFile.SetEndian(LittleEndian);
+                dataFile.Write((DWORD)0x24);
+                dataFile.Write((DWORD)0x800);
+                dataFile.Write((UINT64)0);
+
+                memset(blocks, 0xFF, 0x800);
+                dataFile.SetPosition(0x14000);
+                dataFile.Write(blocks, 0x800);
+            }
+
+            dataFile.Close();
+        }
+    }
+    catch (...)
+    {
+        delete[] emptyTable;
+        delete[] blocks;
+        throw;
+    }
+    delete[] emptyTable;
+    delete[] blocks;
+
+    created[name] = path;
+    return path;
+}
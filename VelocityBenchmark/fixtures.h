@@ -0,0 +1,74 @@
+#ifndef FIXTURES_H
+#define FIXTURES_H
+
+#include <map>
+#include <vector>
+#include <string>
+
+#include "winnames.h"
+
+// builds the files the benchmarks run against in a scratch directory, nothing is downloaded. The
+// contents only depend on the seed, so the fixtures are the same from one run to the next
+class FixtureGenerator
+{
+public:
+    // the scratch directory has to exist already
+    FixtureGenerator(std::string scratchDirectory, DWORD seed = 0x5EED);
+
+    // delete every fixture that was created, unless Keep was called
+    ~FixtureGenerator();
+
+    // leave the fixtures in the scratch directory when done
+    void Keep();
+
+    // the full path of a file in the scratch directory
+    std::string Path(std::string name);
+
+    // fill a buffer with pseudo random bytes
+    void FillRandom(BYTE *buffer, DWORD length);
+
+    // a local file full of pseudo random bytes
+    std::string CreateDataFile(std::string name, DWORD length);
+
+    // an STFS package with fileCount files of fileSize bytes each. Every file is written in
+    // (fragmentation + 1) pieces, interleaved with the pieces of the other files, so 0 gives
+    // packages where every file is contiguous
+    std::string CreateStfsPackage(std::string name, DWORD fileCount, DWORD fileSize,
+            DWORD fragmentation);
+
+    // a dev kit style hard drive image with a Content partition that has folderCount folders in it,
+    // each with filesPerFolder files of fileSize bytes. If dashboardSize isn't 0 the last
+    // dashboardSize bytes of the image are an empty dashboard partition
+    std::string CreateFatxImage(std::string name, UINT64 imageSize, DWORD folderCount,
+            DWORD filesPerFolder, DWORD fileSize, UINT64 dashboardSize = 0);
+
+    // a gpd with settingCount settings, every third one is deleted again so there's free memory
+    // for cleaning to get rid of
+    std::string CreateGpd(std::string name, DWORD settingCount);
+
+    // an SVOD system with dataFileCount data files, each made up of blockGroupsPerFile groups of
+    // 0xCC blocks. Returns the path of the header file, the data files are in <path>.data
+    std::string CreateSvodSystem(std::string name, DWORD dataFileCount, DWORD blockGroupsPerFile);
+
+private:
+    std::string scratchDirectory;
+    DWORD state;
+    bool keep;
+
+    // the paths of the fixtures created so far by name, a fixture is only generated once
+    std::map<std::string, std::string> created;
+
+    // every file and directory written, in the order they were created
+    std::vector<std::string> files;
+    std::vector<std::string> directories;
+
+    DWORD nextRandom();
+
+    // returns true and sets path if the fixture was already generated
+    bool findExisting(std::string name, std::string *path);
+
+    // write the empty Content partition of a fatx image, and the dashboard one if there is one
+    void formatFatxImage(std::string path, UINT64 imageSize, UINT64 dashboardSize);
+};
+
+#endif // FIXTURES_H
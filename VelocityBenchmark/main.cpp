@@ -0,0 +1,232 @@
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <botan/botan.h>
+
+#include "benchmarks.h"
+#include "benchmarkrunner.h"
+#include "jsonwriter.h"
+
+static void printUsage()
+{
+    std::cerr <<
+        "usage: velocity-benchmark [options]\n"
+        "\n"
+        "Times the slow paths in XboxInternals against fixtures generated in a scratch directory.\n"
+        "\n"
+        "options:\n"
+        "  --json                  print the results as json\n"
+        "  --filter <text>         only run the benchmarks with text in their name or fixture\n"
+        "  --iterations <count>    how many timed runs of each benchmark, defaults to 5\n"
+        "  --warmup <count>        how many untimed runs before those, defaults to 1\n"
+        "  --scale <factor>        multiply the size of the fixtures, defaults to 1\n"
+        "  --scratch <directory>   where to put the fixtures, defaults to velocity-benchmark-data\n"
+        "  --keep                  don't delete the fixtures afterwards\n"
+        "  --list                  list the benchmarks without running them\n";
+}
+
+static bool matchesFilter(Benchmark *benchmark, const std::string &filter)
+{
+    return filter.empty() || benchmark->Name().find(filter) != std::string::npos ||
+            benchmark->Fixture().find(filter) != std::string::npos;
+}
+
+static void writeText(const BenchmarkResult &result, std::ostream &out)
+{
+    char line[256];
+    if (!result.success)
+    {
+        sprintf(line, "%-20s %-28s failed: ", result.name.c_str(), result.fixture.c_str());
+        out << line << result.error;
+        return;
+    }
+
+    sprintf(line, "%-20s %-28s %10.3f %10.3f %10.1f %12llu %12llu\n", result.name.c_str(),
+            result.fixture.c_str(), result.bestSeconds * 1000, result.meanSeconds * 1000,
+            result.Throughput() / 0x100000, (unsigned long long)result.allocations,
+            (unsigned long long)(result.allocatedBytes / 0x400));
+    out << line;
+}
+
+static void writeJson(const BenchmarkResult &result, JsonWriter &json)
+{
+    json.BeginObject();
+    json.Key("name");
+    json.Value(result.name);
+    json.Key("fixture");
+    json.Value(result.fixture);
+    json.Key("success");
+    json.Value(result.success);
+
+    if (!result.success)
+    {
+        // the errors all end in a new line
+        std::string error = result.error;
+        while (error.size() != 0 && error.at(error.size() - 1) == '\n')
+            error.erase(error.size() - 1);
+
+        json.Key("error");
+        json.Value(error);
+    }
+    else
+    {
+        json.Key("iterations");
+        json.Value((UINT64)result.iterations);
+        json.Key("bestSeconds");
+        json.Value(result.bestSeconds);
+        json.Key("meanSeconds");
+        json.Value(result.meanSeconds);
+        json.Key("bytes");
+        json.Value(result.bytes);
+        json.Key("bytesPerSecond");
+        json.Value(result.Throughput());
+        json.Key("items");
+        json.Value(result.items);
+        json.Key("allocations");
+        json.Value(result.allocations);
+        json.Key("allocatedBytes");
+        json.Value(result.allocatedBytes);
+    }
+
+    json.EndObject();
+}
+
+int main(int argc, char *argv[])
+{
+    Botan::LibraryInitializer init;
+
+    bool jsonOutput = false, keepFixtures = false, listOnly = false;
+    std::string filter;
+    std::string scratchDirectory = "velocity-benchmark-data";
+    DWORD iterations = 5, warmupIterations = 1, scale = 1;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = (i + 1 < argc);
+
+        if (arg == "--json")
+            jsonOutput = true;
+        else if (arg == "--keep")
+            keepFixtures = true;
+        else if (arg == "--list")
+            listOnly = true;
+        else if (arg == "--filter" && hasValue)
+            filter = argv[++i];
+        else if (arg == "--iterations" && hasValue)
+            iterations = strtoul(argv[++i], NULL, 10);
+        else if (arg == "--warmup" && hasValue)
+            warmupIterations = strtoul(argv[++i], NULL, 10);
+        else if (arg == "--scale" && hasValue)
+            scale = strtoul(argv[++i], NULL, 10);
+        else if (arg == "--scratch" && hasValue)
+            scratchDirectory = argv[++i];
+        else if (arg == "-h" || arg == "--help")
+        {
+            printUsage();
+            return 0;
+        }
+        else
+        {
+            std::cerr << "velocity-benchmark: Unknown option '" << arg << "'.\n";
+            printUsage();
+            return 2;
+        }
+    }
+
+    if (scale == 0)
+        scale = 1;
+
+    std::vector<Benchmark*> benchmarks;
+    CreateBenchmarks(scale, &benchmarks);
+
+    if (listOnly)
+    {
+        for (DWORD i = 0; i < benchmarks.size(); i++)
+        {
+            if (matchesFilter(benchmarks.at(i), filter))
+                std::cout << benchmarks.at(i)->Name() << "\t" << benchmarks.at(i)->Fixture() << "\n";
+            delete benchmarks.at(i);
+        }
+        return 0;
+    }
+
+#ifdef _WIN32
+    bool createdScratch = (_mkdir(scratchDirectory.c_str()) == 0);
+#else
+    bool createdScratch = (mkdir(scratchDirectory.c_str(), 0755) == 0);
+#endif
+
+    std::vector<BenchmarkResult> results;
+    {
+        FixtureGenerator fixtures(scratchDirectory);
+        if (keepFixtures)
+            fixtures.Keep();
+
+        BenchmarkRunner runner(&fixtures, iterations, warmupIterations);
+
+        if (!jsonOutput)
+        {
+            char header[256];
+            sprintf(header, "%-20s %-28s %10s %10s %10s %12s %12s\n", "benchmark", "fixture",
+                    "best ms", "mean ms", "MiB/s", "allocs", "alloc KiB");
+            std::cout << header;
+        }
+
+        for (DWORD i = 0; i < benchmarks.size(); i++)
+        {
+            if (matchesFilter(benchmarks.at(i), filter))
+            {
+                results.push_back(runner.Run(benchmarks.at(i)));
+                if (!jsonOutput)
+                    writeText(results.back(), results.back().success ? std::cout : std::cerr);
+            }
+            delete benchmarks.at(i);
+        }
+    }
+
+    if (createdScratch && !keepFixtures)
+    {
+#ifdef _WIN32
+        _rmdir(scratchDirectory.c_str());
+#else
+        rmdir(scratchDirectory.c_str());
+#endif
+    }
+
+    if (jsonOutput)
+    {
+        JsonWriter json(std::cout);
+        json.BeginObject();
+        json.Key("iterations");
+        json.Value((UINT64)iterations);
+        json.Key("warmupIterations");
+        json.Value((UINT64)warmupIterations);
+        json.Key("scale");
+        json.Value((UINT64)scale);
+
+        json.Key("results");
+        json.BeginArray();
+        for (DWORD i = 0; i < results.size(); i++)
+            writeJson(results.at(i), json);
+        json.EndArray();
+
+        json.EndObject();
+        std::cout << "\n";
+    }
+
+    for (DWORD i = 0; i < results.size(); i++)
+        if (!results.at(i).success)
+            return 1;
+    return 0;
+}
@@ -0,0 +1,49 @@
+#include "stopwatch.h"
+
+#include <cstddef>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/time.h>
+#endif
+
+Stopwatch::Stopwatch() :
+    startTicks(0)
+{
+}
+
+void Stopwatch::Start()
+{
+    startTicks = ticks();
+}
+
+double Stopwatch::Elapsed()
+{
+    return (double)(ticks() - startTicks) / (double)ticksPerSecond();
+}
+
+UINT64 Stopwatch::ticks()
+{
+#ifdef _WIN32
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return counter.QuadPart;
+#else
+    // gettimeofday is available everywhere, unlike a monotonic clock on older versions of OS X
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return ((UINT64)now.tv_sec * 1000000) + now.tv_usec;
+#endif
+}
+
+UINT64 Stopwatch::ticksPerSecond()
+{
+#ifdef _WIN32
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    return frequency.QuadPart;
+#else
+    return 1000000;
+#endif
+}
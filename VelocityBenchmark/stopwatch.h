@@ -0,0 +1,25 @@
+#ifndef STOPWATCH_H
+#define STOPWATCH_H
+
+#include "winnames.h"
+
+// measures wall clock time with the best resolution the platform has
+class Stopwatch
+{
+public:
+    Stopwatch();
+
+    void Start();
+
+    // the number of seconds since Start was called
+    double Elapsed();
+
+private:
+    UINT64 startTicks;
+
+    // the current time in ticks, and how many ticks there are in a second
+    static UINT64 ticks();
+    static UINT64 ticksPerSecond();
+};
+
+#endif // STOPWATCH_H
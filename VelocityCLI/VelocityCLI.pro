@@ -0,0 +1,66 @@
+#-------------------------------------------------
+#
+# Command line front end for XboxInternals, no Qt
+#
+#-------------------------------------------------
+
+QT       -= core gui
+
+TARGET = velocity-cli
+TEMPLATE = app
+
+CONFIG += console
+CONFIG -= qt app_bundle
+
+# XboxInternals is a static library everywhere but windows
+unix:DEFINES += XBOXINTERNALS_STATIC
+
+QMAKE_CXXFLAGS = -O3
+
+# linking against XboxInternals (and adding to include path)
+INCLUDEPATH += $$PWD/../XboxInternals
+CONFIG(debug, debug|release) {
+    win32:LIBS += -L$$PWD/../XboxInternals-Win/debug/ -lXboxInternals
+    macx:LIBS += -L$$PWD/../XboxInternals-OSX/debug/ -lXboxInternals
+    unix:!macx {
+        LIBS += -L$$PWD/../XboxInternals-Linux/debug/ -lXboxInternals
+        PRE_TARGETDEPS += $$PWD/../XboxInternals-Linux/debug/libXboxInternals.a
+    }
+}
+CONFIG(release, debug|release) {
+    win32:LIBS += -L$$PWD/../XboxInternals-Win/release/ -lXboxInternals
+    macx:LIBS += -L$$PWD/../XboxInternals-OSX/release/ -lXboxInternals
+    unix:!macx {
+        LIBS += -L$$PWD/../XboxInternals-Linux/release/ -lXboxInternals
+        PRE_TARGETDEPS += $$PWD/../XboxInternals-Linux/release/libXboxInternals.a
+    }
+}
+
+# linking against botan (and adding to include path), after XboxInternals since the static
+# library depends on it
+win32 {
+    LIBS += -LC:/botan/ -lbotan-1.10
+    INCLUDEPATH += C:/botan/include
+}
+macx {
+    INCLUDEPATH += /usr/local/include/botan-1.10
+    LIBS += /usr/local/lib/libbotan-1.10.a
+}
+unix {
+    INCLUDEPATH += /usr/include/botan-1.10
+    LIBS += /usr/lib/libbotan-1.10.so.0
+    LIBS += -lpthread
+}
+
+SOURCES += \
+    main.cpp \
+    clicommands.cpp \
+    batchrunner.cpp \
+    jsonwriter.cpp \
+    stdstreamio.cpp
+
+HEADERS += \
+    clicommands.h \
+    batchrunner.h \
+    jsonwriter.h \
+    stdstreamio.h
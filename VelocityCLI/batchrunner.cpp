@@ -0,0 +1,103 @@
+#include "batchrunner.h"
+
+class BatchWorker : public Thread
+{
+public:
+    BatchWorker(BatchRunner *runner) :
+        runner(runner)
+    {
+    }
+
+protected:
+    void Run()
+    {
+        DWORD index;
+        while (runner->takeFile(&index))
+            BatchRunner::RunOne(runner->command, runner->options, runner->files->at(index),
+                    &runner->results->at(index));
+    }
+
+private:
+    BatchRunner *runner;
+};
+
+BatchRunner::BatchRunner(BatchCommand command, const CommandOptions &options, DWORD jobCount) :
+    command(command), options(options), jobCount(jobCount), nextFile(0), files(NULL), results(NULL)
+{
+    if (this->jobCount == 0)
+        this->jobCount = 1;
+}
+
+void BatchRunner::Run(const std::vector<std::string> &files,
+        std::vector<CommandResult> *outResults)
+{
+    this->files = &files;
+    results = outResults;
+    nextFile = 0;
+
+    // every worker writes to its own result, so they can all be allocated up front
+    results->clear();
+    results->resize(files.size());
+
+    DWORD workerCount = (jobCount < files.size()) ? jobCount : files.size();
+
+    // no point in starting a thread for one file
+    if (workerCount <= 1)
+    {
+        for (DWORD i = 0; i < files.size(); i++)
+            RunOne(command, options, files.at(i), &results->at(i));
+        return;
+    }
+
+    std::vector<BatchWorker*> workers;
+    for (DWORD i = 0; i < workerCount; i++)
+    {
+        workers.push_back(new BatchWorker(this));
+        workers.back()->Start();
+    }
+
+    // RunOne catches everything, so the workers never fail
+    for (DWORD i = 0; i < workers.size(); i++)
+    {
+        workers.at(i)->Join();
+        delete workers.at(i);
+    }
+}
+
+void BatchRunner::RunOne(BatchCommand command, const CommandOptions &options, std::string file,
+        CommandResult *result)
+{
+    result->file = file;
+    result->format = options.format;
+    result->success = true;
+
+    try
+    {
+        command(file, options, result);
+    }
+    catch (std::string error)
+    {
+        result->success = false;
+        result->error = error;
+    }
+    catch (std::exception &e)
+    {
+        result->success = false;
+        result->error = std::string(e.what()) + "\n";
+    }
+    catch (...)
+    {
+        result->success = false;
+        result->error = "An unknown error occurred.\n";
+    }
+}
+
+bool BatchRunner::takeFile(DWORD *index)
+{
+    MutexLocker locker(mutex);
+    if (nextFile >= files->size())
+        return false;
+
+    *index = nextFile++;
+    return true;
+}
@@ -0,0 +1,40 @@
+#ifndef BATCHRUNNER_H
+#define BATCHRUNNER_H
+
+#include "clicommands.h"
+#include "Threading/Thread.h"
+
+typedef void (*BatchCommand)(std::string file, const CommandOptions &options, CommandResult *result);
+
+// runs a command on a list of files, spread out over a number of threads
+class BatchRunner
+{
+public:
+    BatchRunner(BatchCommand command, const CommandOptions &options, DWORD jobCount);
+
+    // the results are in the same order as the files, no matter which finished first
+    void Run(const std::vector<std::string> &files, std::vector<CommandResult> *outResults);
+
+    // run the command on a single file, turning errors into a failed result
+    static void RunOne(BatchCommand command, const CommandOptions &options, std::string file,
+            CommandResult *result);
+
+private:
+    BatchCommand command;
+    CommandOptions options;
+    DWORD jobCount;
+
+    // the next file that hasn't been picked up by a worker yet
+    Mutex mutex;
+    DWORD nextFile;
+
+    const std::vector<std::string> *files;
+    std::vector<CommandResult> *results;
+
+    // give a worker the next file to work on, false when there aren't any left
+    bool takeFile(DWORD *index);
+
+    friend class BatchWorker;
+};
+
+#endif // BATCHRUNNER_H
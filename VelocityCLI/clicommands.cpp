@@ -0,0 +1,681 @@
+#include "clicommands.h"
+#include "stdstreamio.h"
+
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+
+#include "Stfs/StfsPackage.h"
+#include "Stfs/XContentHeader.h"
+#include "Disc/Svod.h"
+#include "Fatx/FatxDrive.h"
+#include "Gpd/GpdBase.h"
+#include "IO/FileIO.h"
+#include "IO/MemoryIO.h"
+
+void CommandResult::AddField(std::string key, std::string value)
+{
+    ResultField field = { key, value, false, 0 };
+    fields.push_back(field);
+}
+
+void CommandResult::AddField(std::string key, UINT64 value)
+{
+    std::stringstream ss;
+    ss << value;
+
+    ResultField field = { key, ss.str(), true, value };
+    fields.push_back(field);
+}
+
+// copy length bytes from the io to a stream, used for extracting to stdout
+static void copyToStream(BaseIO *in, UINT64 length, FILE *stream)
+{
+    StdStreamIO out(stream);
+    BYTE *buffer = new BYTE[0x10000];
+
+    try
+    {
+        while (length != 0)
+        {
+            DWORD toCopy = (length > 0x10000) ? 0x10000 : (DWORD)length;
+            in->ReadBytes(buffer, toCopy);
+            out.Write(buffer, toCopy);
+            length -= toCopy;
+        }
+        out.Flush();
+    }
+    catch (...)
+    {
+        delete[] buffer;
+        throw;
+    }
+
+    delete[] buffer;
+}
+
+static void listStfs(StfsFileListing *listing, std::string parentPath, CommandResult *result)
+{
+    for (DWORD i = 0; i < listing->fileEntries.size(); i++)
+    {
+        ListEntry entry = { parentPath + listing->fileEntries.at(i).name,
+                            listing->fileEntries.at(i).fileSize, false };
+        result->entries.push_back(entry);
+    }
+
+    for (DWORD i = 0; i < listing->folderEntries.size(); i++)
+    {
+        StfsFileListing *folder = &listing->folderEntries.at(i);
+        ListEntry entry = { parentPath + folder->folder.name, 0, true };
+        result->entries.push_back(entry);
+
+        listStfs(folder, parentPath + folder->folder.name + "\\", result);
+    }
+}
+
+static void listSvod(SVOD *svod, const std::vector<GdfxFileEntry*> &listing, std::string parentPath,
+        CommandResult *result)
+{
+    for (DWORD i = 0; i < listing.size(); i++)
+    {
+        GdfxFileEntry *gdfxEntry = listing.at(i);
+        bool directory = (gdfxEntry->attributes & GdfxDirectory) != 0;
+
+        ListEntry entry = { parentPath + gdfxEntry->name, directory ? 0 : gdfxEntry->size, directory };
+        result->entries.push_back(entry);
+
+        if (directory)
+            listSvod(svod, svod->GetDirectoryListing(gdfxEntry), entry.path + "/", result);
+    }
+}
+
+static void listFatx(FatxDrive *drive, FatxFileEntry *folder, std::string parentPath,
+        CommandResult *result)
+{
+    drive->GetChildFileEntries(folder);
+
+    for (DWORD i = 0; i < folder->cachedFiles.size(); i++)
+    {
+        FatxFileEntry *fatxEntry = &folder->cachedFiles.at(i);
+        if (fatxEntry->nameLen == FATX_ENTRY_DELETED)
+            continue;
+
+        bool directory = (fatxEntry->fileAttributes & FatxDirectory) != 0;
+
+        ListEntry entry = { parentPath + fatxEntry->name, directory ? 0 : fatxEntry->fileSize, directory };
+        result->entries.push_back(entry);
+
+        if (directory)
+            listFatx(drive, fatxEntry, entry.path + "\\", result);
+    }
+}
+
+// make sure all of the folders in the path exist in the package
+static void createStfsFolders(StfsPackage *package, std::string pathInPackage)
+{
+    size_t separator = 0;
+    while ((separator = pathInPackage.find('\\', separator)) != std::string::npos)
+    {
+        std::string folderPath = pathInPackage.substr(0, separator++);
+        try
+        {
+            package->GetFileEntry(folderPath, true);
+        }
+        catch (std::string)
+        {
+            package->CreateFolder(folderPath);
+        }
+    }
+}
+
+static std::string fatxPath(std::string path)
+{
+    if (path.substr(0, 7) != "Drive:\\")
+        path = "Drive:\\" + path;
+
+    // no trailing separator, or the last name would be empty
+    while (path.size() > 7 && path.at(path.size() - 1) == '\\')
+        path.erase(path.size() - 1);
+
+    return path;
+}
+
+static void unsupported(const char *command, ContainerFormat format)
+{
+    throw std::string(command) + " isn't supported for " + CliCommands::FormatName(format) + ".\n";
+}
+
+ContainerFormat CliCommands::DetectFormat(std::string path)
+{
+    FILE *file = fopen(path.c_str(), "rb");
+    if (file == NULL)
+        throw std::string("Unable to open '" + path + "'.\n");
+
+    char magic[4] = { 0 };
+    size_t read = fread(magic, 1, 4, file);
+    fclose(file);
+
+    if (read == 4 && (memcmp(magic, "CON ", 4) == 0 || memcmp(magic, "LIVE", 4) == 0 ||
+                      memcmp(magic, "PIRS", 4) == 0))
+    {
+        // the header says which file system the content is in
+        FileIO io(path);
+        XContentHeader header(&io);
+        io.Close();
+
+        return (header.fileSystem == FileSystemSVOD) ? FormatSvod : FormatStfs;
+    }
+    else if (read == 4 && memcmp(magic, "XDBF", 4) == 0)
+        return FormatGpd;
+
+    // drives and their images don't start with a magic, so it's the last resort
+    return FormatFatx;
+}
+
+std::string CliCommands::FormatName(ContainerFormat format)
+{
+    switch (format)
+    {
+        case FormatStfs:
+            return "stfs";
+        case FormatSvod:
+            return "svod";
+        case FormatFatx:
+            return "fatx";
+        case FormatGpd:
+            return "gpd";
+        default:
+            return "unknown";
+    }
+}
+
+ContainerFormat CliCommands::ParseFormat(std::string name)
+{
+    if (name == "stfs")
+        return FormatStfs;
+    else if (name == "svod")
+        return FormatSvod;
+    else if (name == "fatx")
+        return FormatFatx;
+    else if (name == "gpd")
+        return FormatGpd;
+    return FormatUnknown;
+}
+
+void CliCommands::List(std::string file, const CommandOptions &options, CommandResult *result)
+{
+    switch (resolveFormat(file, options, result))
+    {
+        case FormatStfs:
+        {
+            StfsPackage package(file);
+            StfsFileListing listing = package.GetFileListing();
+            listStfs(&listing, "", result);
+            break;
+        }
+        case FormatSvod:
+        {
+            SVOD svod(file);
+            listSvod(&svod, svod.GetRootListing(), "/", result);
+            break;
+        }
+        case FormatFatx:
+        {
+            FatxDrive drive(file, FatxHarddrive);
+            std::vector<Partition*> parts = drive.GetPartitions();
+            for (DWORD i = 0; i < parts.size(); i++)
+            {
+                std::string partitionPath = "Drive:\\" + parts.at(i)->name;
+
+                ListEntry entry = { partitionPath, 0, true };
+                result->entries.push_back(entry);
+
+                listFatx(&drive, &parts.at(i)->root, partitionPath + "\\", result);
+            }
+            break;
+        }
+        case FormatGpd:
+        {
+            GpdBase gpd(file);
+            result->AddField("settings", (UINT64)gpd.settings.size());
+            result->AddField("images", (UINT64)gpd.images.size());
+            result->AddField("strings", (UINT64)gpd.strings.size());
+            break;
+        }
+        default:
+            unsupported("Listing", result->format);
+    }
+}
+
+void CliCommands::Extract(std::string file, std::string pathInContainer, std::string outPath,
+        const CommandOptions &options, CommandResult *result)
+{
+    bool toStdout = (outPath == "-");
+
+    switch (resolveFormat(file, options, result))
+    {
+        case FormatStfs:
+        {
+            StfsPackage package(file);
+            StfsFileEntry entry = package.GetFileEntry(toContainerPath(pathInContainer, '\\'));
+
+            if (toStdout)
+            {
+                StdStreamIO out(stdout);
+                package.ExtractFile(&entry, &out);
+                out.Flush();
+            }
+            else
+                package.ExtractFile(&entry, outPath);
+
+            result->AddField("size", (UINT64)entry.fileSize);
+            break;
+        }
+        case FormatSvod:
+        {
+            std::string path = toContainerPath(pathInContainer, '/');
+            if (path.size() == 0 || path.at(0) != '/')
+                path = "/" + path;
+
+            SVOD svod(file);
+            GdfxFileEntry *entry = svod.GetFileEntry(path);
+            if (entry == NULL || (entry->attributes & GdfxDirectory))
+                throw std::string("SVOD: File '" + path + "' doesn't exist.\n");
+
+            SvodIO io = svod.GetSvodIO(*entry);
+            if (toStdout)
+                copyToStream(&io, entry->size, stdout);
+            else
+                io.SaveFile(outPath);
+
+            result->AddField("size", (UINT64)entry->size);
+            break;
+        }
+        case FormatFatx:
+        {
+            std::string path = fatxPath(toContainerPath(pathInContainer, '\\'));
+
+            FatxDrive drive(file, FatxHarddrive);
+            FatxFileEntry *entry = drive.GetFileEntry(path);
+            if (entry == NULL || (entry->fileAttributes & FatxDirectory))
+                throw std::string("FATX: File '" + path + "' doesn't exist.\n");
+
+            FatxIO io = drive.GetFatxIO(entry);
+            if (toStdout)
+                copyToStream(&io, entry->fileSize, stdout);
+            else
+                io.SaveFile(outPath);
+
+            result->AddField("size", (UINT64)entry->fileSize);
+            break;
+        }
+        default:
+            unsupported("Extracting", result->format);
+    }
+}
+
+void CliCommands::Inject(std::string file, std::string localPath, std::string pathInContainer,
+        const CommandOptions &options, CommandResult *result)
+{
+    bool fromStdin = (localPath == "-");
+
+    switch (resolveFormat(file, options, result))
+    {
+        case FormatStfs:
+        {
+            std::string path = toContainerPath(pathInContainer, '\\');
+
+            StfsPackage package(file);
+            createStfsFolders(&package, path);
+
+            StfsFileEntry entry;
+            if (fromStdin)
+            {
+                std::string data;
+                StdStreamIO::ReadAll(stdin, &data);
+                entry = package.InjectData((BYTE*)data.data(), data.size(), path);
+            }
+            else
+                entry = package.InjectFile(localPath, path);
+
+            result->AddField("size", (UINT64)entry.fileSize);
+            break;
+        }
+        case FormatFatx:
+        {
+            if (fromStdin)
+                throw std::string("FATX: Injecting from stdin isn't supported, give the path of a file.\n");
+
+            std::string path = fatxPath(toContainerPath(pathInContainer, '\\'));
+            size_t separator = path.find_last_of('\\');
+            std::string parentPath = path.substr(0, separator);
+            std::string name = path.substr(separator + 1);
+
+            if (!FatxDrive::ValidFileName(name))
+                throw std::string("FATX: '" + name + "' isn't a valid file name.\n");
+
+            FatxDrive drive(file, FatxHarddrive);
+            FatxFileEntry *parent = drive.CreatePath(parentPath);
+            if (parent == NULL)
+                throw std::string("FATX: Folder '" + parentPath + "' doesn't exist.\n");
+            if (drive.FileExists(parent, name))
+                throw std::string("FATX: File '" + path + "' already exists.\n");
+
+            drive.InjectFile(parent, name, localPath);
+            result->AddField("size", fileLength(localPath));
+            break;
+        }
+        default:
+            unsupported("Injecting", result->format);
+    }
+}
+
+void CliCommands::Copy(std::string file, std::string pathInContainer, std::string destinationFile,
+        std::string destinationFolder, const CommandOptions &options, CommandResult *result)
+{
+    if (resolveFormat(file, options, result) != FormatFatx)
+        unsupported("Copying", result->format);
+
+    std::string path = fatxPath(toContainerPath(pathInContainer, '\\'));
+    std::string folderPath = fatxPath(toContainerPath(destinationFolder, '\\'));
+
+    FatxDrive drive(file, FatxHarddrive);
+    FatxFileEntry *entry = drive.GetFileEntry(path);
+    if (entry == NULL)
+        throw std::string("FATX: File '" + path + "' doesn't exist.\n");
+
+    // copying on the same drive has to go through the same device
+    FatxDrive *destination = &drive;
+    if (destinationFile != file)
+        destination = new FatxDrive(destinationFile, FatxHarddrive);
+
+    try
+    {
+        FatxFileEntry *folder = destination->CreatePath(folderPath);
+        if (folder == NULL)
+            throw std::string("FATX: Folder '" + folderPath + "' doesn't exist.\n");
+
+        std::vector<FatxFileEntry*> entries(1, entry);
+        FatxCopyResult copied = drive.CopyFiles(entries, destination, folder);
+        result->AddField("files", (UINT64)copied.filesCopied);
+        result->AddField("folders", (UINT64)copied.foldersCreated);
+        result->AddField("size", copied.bytesCopied);
+    }
+    catch (...)
+    {
+        if (destination != &drive)
+            delete destination;
+        throw;
+    }
+
+    if (destination != &drive)
+        delete destination;
+}
+
+static const char *recoverabilityName(FatxRecoverability recoverability)
+{
+    switch (recoverability)
+    {
+        case FatxRecoverable:
+            return "full";
+        case FatxPartlyRecoverable:
+            return "partly";
+        default:
+            return "none";
+    }
+}
+
+void CliCommands::Recover(std::string file, std::string pathInContainer, std::string outPath,
+        const CommandOptions &options, CommandResult *result)
+{
+    if (resolveFormat(file, options, result) != FormatFatx)
+        unsupported("Recovering", result->format);
+
+    std::string path = toContainerPath(pathInContainer, '\\');
+    size_t separator = path.find('\\');
+    if (separator == std::string::npos)
+        throw std::string("FATX: The path has to be the partition and the name of the file.\n");
+    std::string partitionName = path.substr(0, separator);
+    std::string name = path.substr(separator + 1);
+
+    FatxDrive drive(file, FatxHarddrive);
+    std::vector<Partition*> parts = drive.GetPartitions();
+
+    Partition *part = NULL;
+    for (DWORD i = 0; i < parts.size(); i++)
+        if (parts.at(i)->name == partitionName)
+            part = parts.at(i);
+    if (part == NULL)
+        throw std::string("FATX: Partition '" + partitionName + "' doesn't exist.\n");
+
+    // the same name can have been deleted more than once, the one with the most left is used
+    FatxRecoveryScan scan = drive.FindDeletedFiles(part);
+    const FatxDeletedEntry *best = NULL;
+    for (DWORD i = 0; i < scan.entries.size(); i++)
+    {
+        const FatxDeletedEntry *deleted = &scan.entries.at(i);
+        if ((deleted->fileAttributes & FatxDirectory) || !FatxNameIndex::NamesEqual(deleted->name, name))
+            continue;
+
+        if (best == NULL || deleted->recoverability < best->recoverability ||
+                (deleted->recoverability == best->recoverability &&
+                deleted->lastWriteDate > best->lastWriteDate))
+            best = deleted;
+    }
+
+    if (best == NULL)
+        throw std::string("FATX: There isn't a deleted file named '" + name + "'.\n");
+
+    drive.ExtractDeletedFile(*best, outPath);
+    result->AddField("size", (UINT64)best->fileSize);
+    result->AddField("recoverable", recoverabilityName(best->recoverability));
+    drive.Close();
+}
+
+void CliCommands::Rehash(std::string file, const CommandOptions &options, CommandResult *result)
+{
+    switch (resolveFormat(file, options, result))
+    {
+        case FormatStfs:
+        {
+            StfsPackage package(file);
+            package.Rehash();
+            break;
+        }
+        case FormatSvod:
+        {
+            SVOD svod(file);
+            svod.Rehash();
+            break;
+        }
+        default:
+            unsupported("Rehashing", result->format);
+    }
+}
+
+void CliCommands::Resign(std::string file, const CommandOptions &options, CommandResult *result)
+{
+    if (options.kvPath.empty())
+        throw std::string("A key vault is needed to resign, pass one with --kv.\n");
+
+    switch (resolveFormat(file, options, result))
+    {
+        case FormatStfs:
+        {
+            StfsPackage package(file);
+            package.Resign(options.kvPath);
+            break;
+        }
+        case FormatSvod:
+        {
+            SVOD svod(file);
+            svod.Resign(options.kvPath);
+            break;
+        }
+        default:
+            unsupported("Resigning", result->format);
+    }
+}
+
+void CliCommands::Verify(std::string file, const CommandOptions &options, CommandResult *result)
+{
+    if (resolveFormat(file, options, result) != FormatStfs)
+        unsupported("Verifying", result->format);
+
+    // rehash a copy in memory, if the hashes come out the same then the ones in the file are right
+    UINT64 length = fileLength(file);
+    MemoryIO copy(length);
+    copy.Resize(length);
+
+    FileIO in(file);
+    for (UINT64 done = 0; done < length; )
+    {
+        DWORD toRead = (length - done > 0x100000) ? 0x100000 : (DWORD)(length - done);
+        in.ReadBytes(copy.GetBuffer() + done, toRead);
+        done += toRead;
+    }
+    in.Close();
+
+    StfsPackage package(&copy);
+
+    BYTE topHashTableHash[0x14], headerHash[0x14];
+    memcpy(topHashTableHash, package.metaData->stfsVolumeDescriptor.topHashTableHash, 0x14);
+    memcpy(headerHash, package.metaData->headerHash, 0x14);
+
+    package.Rehash();
+
+    bool hashTreeValid = memcmp(topHashTableHash,
+            package.metaData->stfsVolumeDescriptor.topHashTableHash, 0x14) == 0;
+    bool headerHashValid = memcmp(headerHash, package.metaData->headerHash, 0x14) == 0;
+
+    result->AddField("hashTree", hashTreeValid ? "valid" : "invalid");
+    result->AddField("headerHash", headerHashValid ? "valid" : "invalid");
+
+    if (!hashTreeValid || !headerHashValid)
+        throw std::string("The package's hashes are incorrect.\n");
+}
+
+void CliCommands::Compact(std::string file, const CommandOptions &options, CommandResult *result)
+{
+    if (resolveFormat(file, options, result) != FormatGpd)
+        unsupported("Compacting", result->format);
+
+    result->AddField("sizeBefore", fileLength(file));
+
+    {
+        GpdBase gpd(file);
+        gpd.Clean();
+        gpd.Close();
+    }
+
+    result->AddField("sizeAfter", fileLength(file));
+}
+
+static std::string scoreToString(double score)
+{
+    std::stringstream ss;
+    ss.setf(std::ios::fixed);
+    ss.precision(4);
+    ss << score;
+    return ss.str();
+}
+
+void CliCommands::Fragmentation(std::string file, const CommandOptions &options, CommandResult *result)
+{
+    if (resolveFormat(file, options, result) != FormatFatx)
+        unsupported("Checking fragmentation of", result->format);
+
+    FatxDrive drive(file, FatxHarddrive);
+    std::vector<Partition*> parts = drive.GetPartitions();
+    for (DWORD i = 0; i < parts.size(); i++)
+    {
+        FatxFragmentationReport report = drive.GetFragmentationReport(parts.at(i));
+
+        // the fields are prefixed with the partition they're for
+        std::string prefix = parts.at(i)->name + ".";
+        result->AddField(prefix + "files", (UINT64)report.fileCount);
+        result->AddField(prefix + "fragmented", (UINT64)report.fragmentedFileCount);
+        result->AddField(prefix + "clusters", (UINT64)report.clusterCount);
+        result->AddField(prefix + "extents", (UINT64)report.extentCount);
+        result->AddField(prefix + "freeRuns", (UINT64)report.freeRunCount);
+        result->AddField(prefix + "largestFreeRun", (UINT64)report.largestFreeRun);
+        result->AddField(prefix + "score", scoreToString(report.score));
+    }
+    drive.Close();
+}
+
+void CliCommands::Defragment(std::string file, const CommandOptions &options, CommandResult *result)
+{
+    if (resolveFormat(file, options, result) != FormatFatx)
+        unsupported("Defragmenting", result->format);
+
+    FatxDrive drive(file, FatxHarddrive);
+    std::vector<Partition*> parts = drive.GetPartitions();
+    for (DWORD i = 0; i < parts.size(); i++)
+    {
+        double scoreBefore = drive.GetFragmentationReport(parts.at(i)).score;
+        FatxDefragmentationResult defragmented = drive.Defragment(parts.at(i));
+        double scoreAfter = drive.GetFragmentationReport(parts.at(i)).score;
+
+        std::string prefix = parts.at(i)->name + ".";
+        result->AddField(prefix + "moved", (UINT64)defragmented.filesMoved);
+        result->AddField(prefix + "skipped", (UINT64)defragmented.filesSkipped);
+        result->AddField(prefix + "bytesMoved", defragmented.bytesMoved);
+        result->AddField(prefix + "scoreBefore", scoreToString(scoreBefore));
+        result->AddField(prefix + "scoreAfter", scoreToString(scoreAfter));
+    }
+    drive.Close();
+}
+
+void CliCommands::Deleted(std::string file, const CommandOptions &options, CommandResult *result)
+{
+    if (resolveFormat(file, options, result) != FormatFatx)
+        unsupported("Finding deleted files in", result->format);
+
+    FatxDrive drive(file, FatxHarddrive);
+    std::vector<Partition*> parts = drive.GetPartitions();
+    for (DWORD i = 0; i < parts.size(); i++)
+    {
+        FatxRecoveryScan scan = drive.FindDeletedFiles(parts.at(i));
+        for (DWORD x = 0; x < scan.entries.size(); x++)
+        {
+            const FatxDeletedEntry &deleted = scan.entries.at(x);
+            bool directory = (deleted.fileAttributes & FatxDirectory) != 0;
+
+            ListEntry entry = { parts.at(i)->name + "\\" + deleted.name, directory ? 0 : deleted.fileSize,
+                    directory };
+            result->entries.push_back(entry);
+        }
+
+        std::string prefix = parts.at(i)->name + ".";
+        result->AddField(prefix + "deleted", (UINT64)scan.entries.size());
+        result->AddField(prefix + "recoverable", (UINT64)scan.recoverableCount);
+        result->AddField(prefix + "partlyRecoverable", (UINT64)scan.partlyRecoverableCount);
+        result->AddField(prefix + "unrecoverable", (UINT64)scan.unrecoverableCount);
+    }
+    drive.Close();
+}
+
+ContainerFormat CliCommands::resolveFormat(std::string file, const CommandOptions &options,
+        CommandResult *result)
+{
+    result->format = (options.format != FormatUnknown) ? options.format : DetectFormat(file);
+    return result->format;
+}
+
+std::string CliCommands::toContainerPath(std::string path, char separator)
+{
+    for (size_t i = 0; i < path.size(); i++)
+        if (path.at(i) == '/' || path.at(i) == '\\')
+            path.at(i) = separator;
+    return path;
+}
+
+UINT64 CliCommands::fileLength(std::string path)
+{
+    FileIO io(path);
+    UINT64 length = io.Length();
+    io.Close();
+
+    return length;
+}
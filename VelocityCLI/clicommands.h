@@ -0,0 +1,118 @@
+#ifndef CLICOMMANDS_H
+#define CLICOMMANDS_H
+
+#include <string>
+#include <vector>
+
+#include "winnames.h"
+
+enum ContainerFormat
+{
+    FormatUnknown,
+    FormatStfs,
+    FormatSvod,
+    FormatFatx,
+    FormatGpd
+};
+
+struct ResultField
+{
+    std::string key;
+    std::string value;
+    bool isNumber;
+    UINT64 number;
+};
+
+struct ListEntry
+{
+    std::string path;
+    UINT64 size;
+    bool directory;
+};
+
+struct CommandResult
+{
+    std::string file;
+    ContainerFormat format;
+    bool success;
+    std::string error;
+
+    // extra information about what was done, in the order it should be shown
+    std::vector<ResultField> fields;
+    std::vector<ListEntry> entries;
+
+    void AddField(std::string key, std::string value);
+    void AddField(std::string key, UINT64 value);
+};
+
+struct CommandOptions
+{
+    // FormatUnknown means the format is detected from the file
+    ContainerFormat format;
+    std::string kvPath;
+};
+
+// the commands all throw strings on failure, like XboxInternals does
+class CliCommands
+{
+public:
+    // figure out what's in the file from its magic
+    static ContainerFormat DetectFormat(std::string path);
+
+    static std::string FormatName(ContainerFormat format);
+
+    // FormatUnknown if the name isn't recognized
+    static ContainerFormat ParseFormat(std::string name);
+
+    // list everything in the container
+    static void List(std::string file, const CommandOptions &options, CommandResult *result);
+
+    // extract a file from the container, an outPath of "-" writes it to stdout
+    static void Extract(std::string file, std::string pathInContainer, std::string outPath,
+            const CommandOptions &options, CommandResult *result);
+
+    // inject a file into the container, a localPath of "-" reads it from stdin
+    static void Inject(std::string file, std::string localPath, std::string pathInContainer,
+            const CommandOptions &options, CommandResult *result);
+
+    // copy a file or folder from one fatx drive into a folder on another, or the same, drive
+    static void Copy(std::string file, std::string pathInContainer, std::string destinationFile,
+            std::string destinationFolder, const CommandOptions &options, CommandResult *result);
+
+    // save a deleted file from a fatx drive to the local disk, the path is the partition and the
+    // file's name. The drive isn't changed
+    static void Recover(std::string file, std::string pathInContainer, std::string outPath,
+            const CommandOptions &options, CommandResult *result);
+
+    // fix the hashes of a package
+    static void Rehash(std::string file, const CommandOptions &options, CommandResult *result);
+
+    // fix the signature of a package with the key vault in the options
+    static void Resign(std::string file, const CommandOptions &options, CommandResult *result);
+
+    // check that the hashes of a package are correct, without modifying it
+    static void Verify(std::string file, const CommandOptions &options, CommandResult *result);
+
+    // remove the unused space from a gpd
+    static void Compact(std::string file, const CommandOptions &options, CommandResult *result);
+
+    // report how fragmented the files on each partition of a drive are
+    static void Fragmentation(std::string file, const CommandOptions &options, CommandResult *result);
+
+    // move the fragmented files on each partition of a drive into contiguous runs
+    static void Defragment(std::string file, const CommandOptions &options, CommandResult *result);
+
+    // list the deleted files on each partition of a drive, and how many of them can be recovered
+    static void Deleted(std::string file, const CommandOptions &options, CommandResult *result);
+
+private:
+    static ContainerFormat resolveFormat(std::string file, const CommandOptions &options,
+            CommandResult *result);
+
+    // convert a path to use the separators the container uses
+    static std::string toContainerPath(std::string path, char separator);
+
+    static UINT64 fileLength(std::string path);
+};
+
+#endif // CLICOMMANDS_H
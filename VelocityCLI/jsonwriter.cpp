@@ -0,0 +1,130 @@
+#include "jsonwriter.h"
+#include <cstdio>
+
+JsonWriter::JsonWriter(std::ostream &out) :
+    out(out), afterKey(false)
+{
+}
+
+void JsonWriter::BeginObject()
+{
+    separate();
+    out << "{";
+    hasValue.push_back(false);
+}
+
+void JsonWriter::EndObject()
+{
+    hasValue.pop_back();
+    out << "}";
+}
+
+void JsonWriter::BeginArray()
+{
+    separate();
+    out << "[";
+    hasValue.push_back(false);
+}
+
+void JsonWriter::EndArray()
+{
+    hasValue.pop_back();
+    out << "]";
+}
+
+void JsonWriter::Key(std::string key)
+{
+    separate();
+    out << Quote(key) << ":";
+    afterKey = true;
+}
+
+void JsonWriter::Value(std::string value)
+{
+    separate();
+    out << Quote(value);
+}
+
+void JsonWriter::Value(UINT64 value)
+{
+    separate();
+    out << value;
+}
+
+void JsonWriter::Value(double value)
+{
+    separate();
+
+    // json doesn't have infinity or nan
+    if (value != value || value - value != 0)
+    {
+        out << "null";
+        return;
+    }
+
+    char formatted[32];
+    sprintf(formatted, "%.9g", value);
+    out << formatted;
+}
+
+void JsonWriter::Value(bool value)
+{
+    separate();
+    out << (value ? "true" : "false");
+}
+
+std::string JsonWriter::Quote(std::string str)
+{
+    std::string toReturn = "\"";
+    for (size_t i = 0; i < str.size(); i++)
+    {
+        unsigned char c = str.at(i);
+        switch (c)
+        {
+            case '"':
+                toReturn += "\\\"";
+                break;
+            case '\\':
+                toReturn += "\\\\";
+                break;
+            case '\n':
+                toReturn += "\\n";
+                break;
+            case '\r':
+                toReturn += "\\r";
+                break;
+            case '\t':
+                toReturn += "\\t";
+                break;
+            default:
+                if (c < 0x20)
+                {
+                    char escaped[8];
+                    sprintf(escaped, "\\u%04X", c);
+                    toReturn += escaped;
+                }
+                else
+                    toReturn += c;
+                break;
+        }
+    }
+
+    return toReturn + "\"";
+}
+
+void JsonWriter::separate()
+{
+    // a value right after its key doesn't need a comma
+    if (afterKey)
+    {
+        afterKey = false;
+        return;
+    }
+
+    if (hasValue.size() == 0)
+        return;
+
+    if (hasValue.back())
+        out << ",";
+    hasValue.back() = true;
+}
@@ -0,0 +1,44 @@
+#ifndef JSONWRITER_H
+#define JSONWRITER_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "winnames.h"
+
+// writes json straight to a stream, the caller is responsible for nesting things properly
+class JsonWriter
+{
+public:
+    JsonWriter(std::ostream &out);
+
+    void BeginObject();
+    void EndObject();
+
+    void BeginArray();
+    void EndArray();
+
+    // the name of the next value in an object
+    void Key(std::string key);
+
+    void Value(std::string value);
+    void Value(UINT64 value);
+    void Value(double value);
+    void Value(bool value);
+
+    // escape a string and put it in quotes
+    static std::string Quote(std::string str);
+
+private:
+    std::ostream &out;
+
+    // whether or not a value has been written at each level, so we know when to put commas in
+    std::vector<bool> hasValue;
+    bool afterKey;
+
+    // put a comma in if the value isn't the first one at its level
+    void separate();
+};
+
+#endif // JSONWRITER_H
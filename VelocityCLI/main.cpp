@@ -0,0 +1,305 @@
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <botan/botan.h>
+
+#include "clicommands.h"
+#include "batchrunner.h"
+#include "jsonwriter.h"
+
+static void printUsage()
+{
+    std::cerr <<
+        "usage: velocity-cli [options] <command> [arguments]\n"
+        "\n"
+        "commands:\n"
+        "  list <file>...                         list the contents of packages, drives or gpds\n"
+        "  extract <file> <path> <out>            extract a file, use - as the out path for stdout\n"
+        "  inject <file> <local file> <path>      inject a file, use - as the local file for stdin\n"
+        "  copy <drive> <path> <drive> <folder>   copy a file or folder between fatx drives\n"
+        "  recover <drive> <path> <out>           save a deleted file, the path is partition\\name\n"
+        "  rehash <file>...                       fix the hashes of STFS and SVOD packages\n"
+        "  resign <file>...                       resign STFS and SVOD packages, needs --kv\n"
+        "  verify <file>...                       check the hashes of STFS packages\n"
+        "  compact <gpd>...                       remove the unused space from gpds\n"
+        "  fragmentation <drive>...               report how fragmented the files on fatx drives are\n"
+        "  defrag <drive>...                      make each file on fatx drives contiguous\n"
+        "  deleted <drive>...                     list the deleted files on fatx drives\n"
+        "\n"
+        "options:\n"
+        "  --json                  print the results as json\n"
+        "  -j, --jobs <count>      how many files to work on at once, defaults to the number of cores\n"
+        "  --format <format>       stfs, svod, fatx or gpd, detected from the file by default\n"
+        "  --kv <path>             the key vault used to resign\n"
+        "\n"
+        "Packages aren't rehashed or resigned after injecting, run rehash and resign afterwards.\n";
+}
+
+static void writeText(const std::vector<CommandResult> &results, std::ostream &out)
+{
+    for (DWORD i = 0; i < results.size(); i++)
+    {
+        const CommandResult &result = results.at(i);
+        if (!result.success)
+        {
+            std::cerr << result.file << ": " << result.error;
+            continue;
+        }
+
+        for (DWORD x = 0; x < result.entries.size(); x++)
+        {
+            const ListEntry &entry = result.entries.at(x);
+            if (entry.directory)
+                out << "<DIR>\t" << entry.path << "\n";
+            else
+                out << entry.size << "\t" << entry.path << "\n";
+        }
+
+        out << result.file << ": ok";
+        for (DWORD x = 0; x < result.fields.size(); x++)
+            out << " " << result.fields.at(x).key << "=" << result.fields.at(x).value;
+        out << "\n";
+    }
+}
+
+static void writeJson(std::string command, const std::vector<CommandResult> &results,
+        std::ostream &out)
+{
+    JsonWriter json(out);
+    json.BeginObject();
+    json.Key("command");
+    json.Value(command);
+
+    json.Key("results");
+    json.BeginArray();
+    for (DWORD i = 0; i < results.size(); i++)
+    {
+        const CommandResult &result = results.at(i);
+
+        json.BeginObject();
+        json.Key("file");
+        json.Value(result.file);
+        json.Key("format");
+        json.Value(CliCommands::FormatName(result.format));
+        json.Key("success");
+        json.Value(result.success);
+
+        if (!result.success)
+        {
+            // the errors all end in a new line
+            std::string error = result.error;
+            while (error.size() != 0 && error.at(error.size() - 1) == '\n')
+                error.erase(error.size() - 1);
+
+            json.Key("error");
+            json.Value(error);
+        }
+
+        for (DWORD x = 0; x < result.fields.size(); x++)
+        {
+            const ResultField &field = result.fields.at(x);
+            json.Key(field.key);
+            if (field.isNumber)
+                json.Value(field.number);
+            else
+                json.Value(field.value);
+        }
+
+        if (result.entries.size() != 0)
+        {
+            json.Key("entries");
+            json.BeginArray();
+            for (DWORD x = 0; x < result.entries.size(); x++)
+            {
+                const ListEntry &entry = result.entries.at(x);
+                json.BeginObject();
+                json.Key("path");
+                json.Value(entry.path);
+                json.Key("size");
+                json.Value(entry.size);
+                json.Key("directory");
+                json.Value(entry.directory);
+                json.EndObject();
+            }
+            json.EndArray();
+        }
+
+        json.EndObject();
+    }
+    json.EndArray();
+
+    json.EndObject();
+    out << "\n";
+}
+
+int main(int argc, char *argv[])
+{
+    // the batch commands resign on several threads at once
+    Botan::LibraryInitializer init("thread_safe=true");
+
+    CommandOptions options;
+    options.format = FormatUnknown;
+
+    bool jsonOutput = false;
+    DWORD jobCount = Thread::HardwareConcurrency();
+
+    std::string command;
+    std::vector<std::string> arguments;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = (i + 1 < argc);
+
+        if (arg == "--json")
+            jsonOutput = true;
+        else if ((arg == "-j" || arg == "--jobs") && hasValue)
+            jobCount = strtoul(argv[++i], NULL, 10);
+        else if (arg == "--format" && hasValue)
+        {
+            options.format = CliCommands::ParseFormat(argv[++i]);
+            if (options.format == FormatUnknown)
+            {
+                std::cerr << "velocity-cli: Unknown format '" << argv[i] << "'.\n";
+                return 2;
+            }
+        }
+        else if (arg == "--kv" && hasValue)
+            options.kvPath = argv[++i];
+        else if (arg == "-h" || arg == "--help")
+        {
+            printUsage();
+            return 0;
+        }
+        else if (arg.size() > 1 && arg.at(0) == '-')
+        {
+            std::cerr << "velocity-cli: Unknown option '" << arg << "'.\n";
+            printUsage();
+            return 2;
+        }
+        else if (command.empty())
+            command = arg;
+        else
+            arguments.push_back(arg);
+    }
+
+    std::vector<CommandResult> results;
+
+    // whether or not stdout is being used for file data, the results go to stderr if so
+    bool stdoutInUse = false;
+
+    if (command == "extract" && arguments.size() == 3)
+    {
+        stdoutInUse = (arguments.at(2) == "-");
+
+        results.resize(1);
+        results.at(0).file = arguments.at(0);
+        results.at(0).format = options.format;
+        results.at(0).success = true;
+
+        try
+        {
+            CliCommands::Extract(arguments.at(0), arguments.at(1), arguments.at(2), options, &results.at(0));
+        }
+        catch (std::string error)
+        {
+            results.at(0).success = false;
+            results.at(0).error = error;
+        }
+    }
+    else if (command == "inject" && arguments.size() == 3)
+    {
+        results.resize(1);
+        results.at(0).file = arguments.at(0);
+        results.at(0).format = options.format;
+        results.at(0).success = true;
+
+        try
+        {
+            CliCommands::Inject(arguments.at(0), arguments.at(1), arguments.at(2), options, &results.at(0));
+        }
+        catch (std::string error)
+        {
+            results.at(0).success = false;
+            results.at(0).error = error;
+        }
+    }
+    else if (command == "copy" && arguments.size() == 4)
+    {
+        results.resize(1);
+        results.at(0).file = arguments.at(0);
+        results.at(0).format = options.format;
+        results.at(0).success = true;
+
+        try
+        {
+            CliCommands::Copy(arguments.at(0), arguments.at(1), arguments.at(2), arguments.at(3), options,
+                    &results.at(0));
+        }
+        catch (std::string error)
+        {
+            results.at(0).success = false;
+            results.at(0).error = error;
+        }
+    }
+    else if (command == "recover" && arguments.size() == 3)
+    {
+        results.resize(1);
+        results.at(0).file = arguments.at(0);
+        results.at(0).format = options.format;
+        results.at(0).success = true;
+
+        try
+        {
+            CliCommands::Recover(arguments.at(0), arguments.at(1), arguments.at(2), options, &results.at(0));
+        }
+        catch (std::string error)
+        {
+            results.at(0).success = false;
+            results.at(0).error = error;
+        }
+    }
+    else
+    {
+        BatchCommand batchCommand = NULL;
+        if (command == "list")
+            batchCommand = CliCommands::List;
+        else if (command == "rehash")
+            batchCommand = CliCommands::Rehash;
+        else if (command == "resign")
+            batchCommand = CliCommands::Resign;
+        else if (command == "verify")
+            batchCommand = CliCommands::Verify;
+        else if (command == "compact")
+            batchCommand = CliCommands::Compact;
+        else if (command == "fragmentation")
+            batchCommand = CliCommands::Fragmentation;
+        else if (command == "defrag")
+            batchCommand = CliCommands::Defragment;
+        else if (command == "deleted")
+            batchCommand = CliCommands::Deleted;
+
+        if (batchCommand == NULL || arguments.size() == 0)
+        {
+            printUsage();
+            return 2;
+        }
+
+        BatchRunner runner(batchCommand, options, jobCount);
+        runner.Run(arguments, &results);
+    }
+
+    std::ostream &out = stdoutInUse ? std::cerr : std::cout;
+    if (jsonOutput)
+        writeJson(command, results, out);
+    else
+        writeText(results, out);
+
+    for (DWORD i = 0; i < results.size(); i++)
+        if (!results.at(i).success)
+            return 1;
+    return 0;
+}
@@ -0,0 +1,71 @@
+#include "stdstreamio.h"
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+StdStreamIO::StdStreamIO(FILE *stream) :
+    stream(stream), pos(0)
+{
+#ifdef _WIN32
+    // otherwise every 0x0A gets turned into 0x0D 0x0A
+    _setmode(_fileno(stream), _O_BINARY);
+#endif
+}
+
+void StdStreamIO::ReadBytes(BYTE *outBuffer, DWORD len)
+{
+    if (fread(outBuffer, 1, len, stream) != len)
+        throw std::string("StdStreamIO: Unexpected end of stream.\n");
+    pos += len;
+}
+
+void StdStreamIO::WriteBytes(BYTE *buffer, DWORD len)
+{
+    if (fwrite(buffer, 1, len, stream) != len)
+        throw std::string("StdStreamIO: Unable to write to the stream.\n");
+    pos += len;
+}
+
+void StdStreamIO::SetPosition(UINT64 position, std::ios_base::seek_dir dir)
+{
+    if ((dir == std::ios_base::beg && position == pos) || (dir == std::ios_base::cur && position == 0))
+        return;
+    throw std::string("StdStreamIO: Cannot seek in a stream.\n");
+}
+
+UINT64 StdStreamIO::GetPosition()
+{
+    return pos;
+}
+
+UINT64 StdStreamIO::Length()
+{
+    return pos;
+}
+
+void StdStreamIO::Flush()
+{
+    fflush(stream);
+}
+
+void StdStreamIO::Close()
+{
+    Flush();
+}
+
+void StdStreamIO::ReadAll(FILE *stream, std::string *outData)
+{
+#ifdef _WIN32
+    _setmode(_fileno(stream), _O_BINARY);
+#endif
+
+    char buffer[0x10000];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), stream)) != 0)
+        outData->append(buffer, read);
+
+    if (ferror(stream))
+        throw std::string("StdStreamIO: Unable to read from the stream.\n");
+}
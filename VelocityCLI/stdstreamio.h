@@ -0,0 +1,39 @@
+#ifndef STDSTREAMIO_H
+#define STDSTREAMIO_H
+
+#include <cstdio>
+#include "IO/BaseIO.h"
+
+// a forward only io over stdin or stdout, so files can be piped in and out of containers
+class StdStreamIO : public BaseIO
+{
+public:
+    // the stream is switched to binary mode, it isn't closed when the io is
+    StdStreamIO(FILE *stream);
+
+    void ReadBytes(BYTE *outBuffer, DWORD len);
+
+    void WriteBytes(BYTE *buffer, DWORD len);
+
+    // only seeking to the current position is allowed
+    void SetPosition(UINT64 position, std::ios_base::seek_dir dir = std::ios_base::beg);
+
+    // the amount of bytes read or written so far
+    UINT64 GetPosition();
+
+    // same as the position, the real length isn't known until the stream ends
+    UINT64 Length();
+
+    void Flush();
+
+    void Close();
+
+    // read the whole stream into memory
+    static void ReadAll(FILE *stream, std::string *outData);
+
+private:
+    FILE *stream;
+    UINT64 pos;
+};
+
+#endif // STDSTREAMIO_H
@@ -0,0 +1,262 @@
+#include "tests.h"
+
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+
+#include "IO/DeviceIO.h"
+#include "IO/FileIO.h"
+
+// the size of the images the tests run against
+#define IMAGE_SIZE 0x400000
+
+// the longest read or write the tests make
+#define MAX_TRANSFER 0x30000
+
+// picks the offsets and lengths, seeded so a failure happens the same way every run
+class TransferPicker
+{
+public:
+    TransferPicker(DWORD seed) : state(seed)
+    {
+    }
+
+    DWORD Next(DWORD below)
+    {
+        state = state * 1103515245 + 12345;
+        return (state >> 8) % below;
+    }
+
+    // a length that's usually less than a block, and now and then spans a lot of them
+    DWORD Length()
+    {
+        return (Next(8) == 0) ? Next(MAX_TRANSFER) + 1 : Next(0x600) + 1;
+    }
+
+    // an offset that leaves room for length bytes in the first range bytes of the image
+    DWORD Offset(DWORD length, DWORD range = IMAGE_SIZE)
+    {
+        return (length >= range) ? Next(IMAGE_SIZE - length + 1) : Next(range - length + 1);
+    }
+
+private:
+    DWORD state;
+};
+
+static std::string describe(const char *what, UINT64 offset, DWORD length)
+{
+    std::stringstream description;
+    description << what << " at 0x" << std::hex << offset << ", 0x" << length << " bytes";
+    return description.str();
+}
+
+// an image, and a copy of it that's only ever changed through FileIO to compare it with
+static std::string createImage(FixtureGenerator *fixtures, std::string name,
+        std::string *referencePath)
+{
+    std::string path = fixtures->CreateDataFile(name, IMAGE_SIZE);
+    *referencePath = fixtures->Path(name + ".reference");
+
+    FileIO in(path);
+    FileIO out(*referencePath, true);
+    std::vector<BYTE> buffer(IMAGE_SIZE);
+    in.ReadBytes(&buffer.at(0), IMAGE_SIZE);
+    out.WriteBytes(&buffer.at(0), IMAGE_SIZE);
+    in.Close();
+    out.Close();
+
+    return path;
+}
+
+static void readReference(FileIO &reference, UINT64 offset, BYTE *outBuffer, DWORD length)
+{
+    reference.SetPosition(offset);
+    reference.ReadBytes(outBuffer, length);
+}
+
+// compare the whole image with the reference once the device has been closed
+static void expectSameFiles(std::string path, std::string referencePath)
+{
+    std::vector<BYTE> image(IMAGE_SIZE), expected(IMAGE_SIZE);
+
+    FileIO imageFile(path);
+    imageFile.ReadBytes(&image.at(0), IMAGE_SIZE);
+    imageFile.Close();
+
+    FileIO referenceFile(referencePath);
+    referenceFile.ReadBytes(&expected.at(0), IMAGE_SIZE);
+    referenceFile.Close();
+
+    for (DWORD i = 0; i < IMAGE_SIZE; i++)
+        Expect(image.at(i) == expected.at(i), describe("the image on disk differs", i, 1));
+}
+
+// reads and writes at random offsets in the first range bytes, each one's made through the
+// reference too and every read's compared with what the reference holds. Keeping them close
+// together makes them land in the same blocks and read-ahead windows as each other
+static void mixedTransfers(DeviceIO &device, FileIO &reference, FixtureGenerator *fixtures,
+        DWORD seed, DWORD count, DWORD range)
+{
+    TransferPicker picker(seed);
+    std::vector<BYTE> data(MAX_TRANSFER), expected(MAX_TRANSFER);
+
+    for (DWORD i = 0; i < count; i++)
+    {
+        DWORD length = picker.Length();
+        UINT64 offset = picker.Offset(length, range);
+
+        switch (picker.Next(4))
+        {
+            case 0:
+                fixtures->FillRandom(&data.at(0), length);
+                device.SetPosition(offset);
+                device.WriteBytes(&data.at(0), length);
+                Expect(device.GetPosition() == offset + length,
+                        describe("wrong position after writing", offset, length));
+
+                reference.SetPosition(offset);
+                reference.WriteBytes(&data.at(0), length);
+                break;
+            case 1:
+                device.ReadBytesAt(offset, &data.at(0), length);
+                readReference(reference, offset, &expected.at(0), length);
+                Expect(memcmp(&data.at(0), &expected.at(0), length) == 0,
+                        describe("positional read differs", offset, length));
+                break;
+            default:
+                device.SetPosition(offset);
+                device.ReadBytes(&data.at(0), length);
+                readReference(reference, offset, &expected.at(0), length);
+                Expect(memcmp(&data.at(0), &expected.at(0), length) == 0,
+                        describe("read differs", offset, length));
+                break;
+        }
+
+        // the held back blocks are written now and then, not only when the device is closed
+        if (picker.Next(16) == 0)
+            device.Flush();
+    }
+}
+
+// positional reads from several places, without going through the read-ahead cache
+static void testPositionalReads(FixtureGenerator *fixtures)
+{
+    std::string referencePath;
+    std::string path = createImage(fixtures, "deviceio-pread.img", &referencePath);
+
+    DeviceIO device(path, true);
+    FileIO reference(referencePath);
+    Expect(device.GetLogicalBlockSize() > 1, "direct transfers should be made in whole blocks");
+
+    TransferPicker picker(1);
+    std::vector<BYTE> data(MAX_TRANSFER), expected(MAX_TRANSFER);
+    for (DWORD i = 0; i < 2000; i++)
+    {
+        DWORD length = picker.Length();
+        UINT64 offset = picker.Offset(length);
+
+        device.ReadBytesAt(offset, &data.at(0), length);
+        readReference(reference, offset, &expected.at(0), length);
+        Expect(memcmp(&data.at(0), &expected.at(0), length) == 0,
+                describe("positional read differs", offset, length));
+    }
+
+    device.Close();
+    reference.Close();
+    remove(referencePath.c_str());
+}
+
+// small reads one after the other, mostly served from the read-ahead cache
+static void testReadAhead(FixtureGenerator *fixtures)
+{
+    std::string referencePath;
+    std::string path = createImage(fixtures, "deviceio-readahead.img", &referencePath);
+
+    DeviceIO device(path, true);
+    FileIO reference(referencePath);
+    device.SetReadAheadSize(0x10000);
+
+    TransferPicker picker(2);
+    std::vector<BYTE> data(0x1000), expected(0x1000);
+    for (DWORD run = 0; run < 32; run++)
+    {
+        UINT64 offset = picker.Offset(0x40000);
+        device.SetPosition(offset);
+
+        for (UINT64 end = offset + 0x40000; offset < end; )
+        {
+            DWORD length = picker.Next(0x1000) + 1;
+            if (offset + length > end)
+                length = (DWORD)(end - offset);
+
+            device.ReadBytes(&data.at(0), length);
+            readReference(reference, offset, &expected.at(0), length);
+            Expect(memcmp(&data.at(0), &expected.at(0), length) == 0,
+                    describe("read differs", offset, length));
+
+            offset += length;
+        }
+    }
+
+    device.Close();
+    reference.Close();
+    remove(referencePath.c_str());
+}
+
+// unaligned writes that are held back as dirty blocks, mixed with reads that have to see them
+static void testWriteBack(FixtureGenerator *fixtures)
+{
+    std::string referencePath;
+    std::string path = createImage(fixtures, "deviceio-writeback.img", &referencePath);
+
+    {
+        DeviceIO device(path, true);
+        FileIO reference(referencePath);
+        device.SetReadAheadSize(0x10000);
+
+        mixedTransfers(device, reference, fixtures, 3, 3000, IMAGE_SIZE);
+        mixedTransfers(device, reference, fixtures, 5, 3000, 0x40000);
+
+        device.Close();
+        reference.Close();
+    }
+
+    expectSameFiles(path, referencePath);
+    remove(referencePath.c_str());
+}
+
+// images that aren't opened for direct transfers are read through a memory mapping
+static void testMappedImage(FixtureGenerator *fixtures)
+{
+    std::string referencePath;
+    std::string path = createImage(fixtures, "deviceio-mmap.img", &referencePath);
+
+    {
+        DeviceIO device(path);
+        FileIO reference(referencePath);
+        Expect(device.IsImage(), "a regular file should be opened as an image");
+        Expect(device.Length() == IMAGE_SIZE, "the image's length is wrong");
+
+        mixedTransfers(device, reference, fixtures, 4, 3000, IMAGE_SIZE);
+        mixedTransfers(device, reference, fixtures, 6, 3000, 0x40000);
+
+        device.Close();
+        reference.Close();
+    }
+
+    expectSameFiles(path, referencePath);
+    remove(referencePath.c_str());
+}
+
+void AddDeviceIOTests(std::vector<TestCase> *out)
+{
+    TestCase tests[] =
+    {
+        { "deviceio.pread", testPositionalReads },
+        { "deviceio.readahead", testReadAhead },
+        { "deviceio.writeback", testWriteBack },
+        { "deviceio.mmap", testMappedImage }
+    };
+
+    out->insert(out->end(), tests, tests + sizeof(tests) / sizeof(TestCase));
+}
@@ -0,0 +1,87 @@
+#include "tests.h"
+
+#include <sstream>
+
+#include "Fatx/FatxDrive.h"
+
+// 16 KiB clusters hold 256 entries, so a folder with this many files in it fills its first cluster
+// part of the way through a batch of FATX_COPY_BATCH_FILES
+#define FILES_ALREADY_THERE 10
+#define FILES_COPIED 250
+
+// copy a batch of files that makes the destination folder take another cluster, and then have the
+// copy fail before the batch is written. None of the clusters the batch was given can be left
+// marked in the FAT, and the drive's count of free clusters has to match what's on it
+static void testFailedCopyGrowingFolder(FixtureGenerator *fixtures)
+{
+    std::string sourcePath = fixtures->CreateFatxImage("fatx.copysource", 0x8000000, 1,
+            FILES_ALREADY_THERE + FILES_COPIED, 0x1000);
+    std::string destinationPath = fixtures->CreateFatxImage("fatx.copydestination", 0x2000000, 1,
+            FILES_ALREADY_THERE, 0x1000);
+
+    // the last file is bigger than the destination, so the copy fails on it
+    std::string bigPath = fixtures->CreateDataFile("fatx.big", 0x3000000);
+    {
+        FatxDrive source(sourcePath, FatxHarddrive);
+        source.InjectFile(source.GetFileEntry("Drive:\\Content\\Folder0"), "Big.bin", bigPath);
+        source.Close();
+    }
+
+    UINT64 freeBytes;
+    DWORD entryCount, clusterCount;
+    {
+        FatxDrive source(sourcePath, FatxHarddrive);
+        FatxDrive destination(destinationPath, FatxHarddrive);
+
+        FatxFileEntry *sourceFolder = source.GetFileEntry("Drive:\\Content\\Folder0");
+        source.GetChildFileEntries(sourceFolder);
+
+        std::vector<FatxFileEntry*> entries;
+        for (DWORD i = FILES_ALREADY_THERE; i < sourceFolder->cachedFiles.size(); i++)
+            entries.push_back(&sourceFolder->cachedFiles.at(i));
+
+        FatxFileEntry *folder = destination.GetFileEntry("Drive:\\Content\\Folder0");
+        bool failed = false;
+        try
+        {
+            source.CopyFiles(entries, &destination, folder);
+        }
+        catch (std::string error)
+        {
+            failed = true;
+        }
+        Expect(failed, "the copy didn't run out of space");
+
+        Partition *part = folder->partition;
+        freeBytes = (UINT64)part->freeClusters.ClusterCount() * part->clusterSize;
+        entryCount = folder->cachedFiles.size();
+        clusterCount = folder->clusterChain.size();
+
+        destination.Close();
+        source.Close();
+    }
+
+    FatxDrive destination(destinationPath, FatxHarddrive);
+    FatxFileEntry *folder = destination.GetFileEntry("Drive:\\Content\\Folder0");
+    destination.GetChildFileEntries(folder);
+
+    std::stringstream counts;
+    counts << "the drive counted 0x" << std::hex << freeBytes << " free bytes, but 0x" <<
+            destination.GetFreeMemory(folder->partition) << " are free";
+    Expect(destination.GetFreeMemory(folder->partition) == freeBytes, counts.str());
+    Expect(folder->cachedFiles.size() == entryCount,
+            "the folder has different entries once it's read again");
+    Expect(clusterCount > 1, "the folder didn't take another cluster");
+
+    destination.Close();
+}
+
+void AddFatxTests(std::vector<TestCase> *out)
+{
+    TestCase tests[] =
+    {
+        { "fatx.copy.failedbatch", testFailedCopyGrowingFolder }
+    };
+
+    out->insert(out->end(), tests, tests + sizeof(tests) / sizeof(TestCase));
+}
@@ -0,0 +1,126 @@
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <botan/botan.h>
+
+#include "tests.h"
+
+static void printUsage()
+{
+    std::cerr <<
+        "usage: velocity-tests [options]\n"
+        "\n"
+        "Checks XboxInternals against files generated in a scratch directory.\n"
+        "\n"
+        "options:\n"
+        "  --filter <text>         only run the tests with text in their name\n"
+        "  --scratch <directory>   where to put the files, defaults to velocity-tests-data\n"
+        "  --keep                  don't delete the files afterwards\n"
+        "  --list                  list the tests without running them\n";
+}
+
+void Expect(bool condition, const std::string &what)
+{
+    if (!condition)
+        throw what + "\n";
+}
+
+int main(int argc, char *argv[])
+{
+    Botan::LibraryInitializer init;
+
+    bool keepFiles = false, listOnly = false;
+    std::string filter;
+    std::string scratchDirectory = "velocity-tests-data";
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = (i + 1 < argc);
+
+        if (arg == "--keep")
+            keepFiles = true;
+        else if (arg == "--list")
+            listOnly = true;
+        else if (arg == "--filter" && hasValue)
+            filter = argv[++i];
+        else if (arg == "--scratch" && hasValue)
+            scratchDirectory = argv[++i];
+        else if (arg == "-h" || arg == "--help")
+        {
+            printUsage();
+            return 0;
+        }
+        else
+        {
+            std::cerr << "velocity-tests: Unknown option '" << arg << "'.\n";
+            printUsage();
+            return 2;
+        }
+    }
+
+    std::vector<TestCase> tests;
+    AddDeviceIOTests(&tests);
+    AddFatxTests(&tests);
+
+    if (listOnly)
+    {
+        for (DWORD i = 0; i < tests.size(); i++)
+            if (tests.at(i).name.find(filter) != std::string::npos)
+                std::cout << tests.at(i).name << "\n";
+        return 0;
+    }
+
+#ifdef _WIN32
+    bool createdScratch = (_mkdir(scratchDirectory.c_str()) == 0);
+#else
+    bool createdScratch = (mkdir(scratchDirectory.c_str(), 0755) == 0);
+#endif
+
+    DWORD failures = 0, run = 0;
+    {
+        FixtureGenerator fixtures(scratchDirectory);
+        if (keepFiles)
+            fixtures.Keep();
+
+        for (DWORD i = 0; i < tests.size(); i++)
+        {
+            if (tests.at(i).name.find(filter) == std::string::npos)
+                continue;
+
+            run++;
+            try
+            {
+                tests.at(i).run(&fixtures);
+                std::cout << "ok      " << tests.at(i).name << "\n";
+            }
+            catch (std::string error)
+            {
+                failures++;
+                std::cerr << "FAILED  " << tests.at(i).name << ": " << error;
+            }
+        }
+    }
+
+    if (createdScratch && !keepFiles)
+    {
+#ifdef _WIN32
+        _rmdir(scratchDirectory.c_str());
+#else
+        rmdir(scratchDirectory.c_str());
+#endif
+    }
+
+    std::cout << (run - failures) << " of " << run << " tests passed\n";
+    return (failures == 0) ? 0 : 1;
+}
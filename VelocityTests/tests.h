@@ -0,0 +1,27 @@
+#ifndef TESTS_H
+#define TESTS_H
+
+#include <string>
+#include <vector>
+
+#include "winnames.h"
+#include "fixtures.h"
+
+// a single correctness test, it throws a string when something doesn't match like the rest of
+// XboxInternals does
+struct TestCase
+{
+    // what's being tested, like deviceio.writeback
+    std::string name;
+
+    void (*run)(FixtureGenerator *fixtures);
+};
+
+// throw what as the failure if the condition doesn't hold
+void Expect(bool condition, const std::string &what);
+
+// the tests for each part of XboxInternals
+void AddDeviceIOTests(std::vector<TestCase> *out);
+void AddFatxTests(std::vector<TestCase> *out);
+
+#endif // TESTS_H
@@ -13,7 +13,7 @@ AvatarAsset::AvatarAsset(string assetPath) : ioPassedIn(false)
     readBlocks();
 }
 
-AvatarAsset::AvatarAsset(FileIO *io) : io(io), ioPassedIn(true)
+AvatarAsset::AvatarAsset(BaseIO *io) : io(io), ioPassedIn(true)
 {
     metadata.gender = (AssetGender)0;
     customColors.entries = NULL;
@@ -14,7 +14,7 @@ class XBOXINTERNALSSHARED_EXPORT AvatarAsset
 {
 public:
     AvatarAsset(string assetPath);
-    AvatarAsset(FileIO *io);
+    AvatarAsset(BaseIO *io);
     ~AvatarAsset(void);
 
     vector<STRBBlock> blocks;
@@ -32,7 +32,7 @@ public:
     void ReadBlockData(STRBBlock *block);
 
 private:
-    FileIO *io;
+    BaseIO *io;
     bool ioPassedIn;
     STRBHeader header;
     AssetMetadata metadata;
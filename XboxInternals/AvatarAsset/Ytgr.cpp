@@ -6,7 +6,7 @@ Ytgr::Ytgr(std::string filePath) : ioPassedIn(false)
     Parse();
 }
 
-Ytgr::Ytgr(FileIO *io) : ioPassedIn(true)
+Ytgr::Ytgr(BaseIO *io) : ioPassedIn(true)
 {
     this->io = io;
     Parse();
@@ -60,8 +60,7 @@ void Ytgr::Parse()
     // verify the hash
     BYTE block[0x1000];
     BYTE calculatedHash[0x14];
-    Botan::SHA_160 sha1;
-    sha1.clear();
+    Sha1 sha1;
 
     io->SetPosition(0x130);
     DWORD tempLen = contentLength;
@@ -69,16 +68,16 @@ void Ytgr::Parse()
     while (tempLen >= 0x1000)
     {
         io->ReadBytes(block, 0x1000);
-        sha1.update(block, 0x1000);
+        sha1.Update(block, 0x1000);
         tempLen -= 0x1000;
     }
     if (tempLen != 0)
     {
         io->ReadBytes(block, tempLen);
-        sha1.update(block, tempLen);
+        sha1.Update(block, tempLen);
     }
 
-    sha1.final(calculatedHash);
+    sha1.Final(calculatedHash);
 
     // make sure both the signature and hash are valid
     valid = valid && !memcmp(contentHash, calculatedHash, 0x14);
@@ -7,14 +7,14 @@
 #include "../Cryptography/XeKeys.h"
 #include "../Gpd/XdbfHelpers.h"
 #include "../Stfs/StfsConstants.h"
+#include "../Cryptography/Sha1.h"
 #include <botan/botan.h>
-#include <botan/sha160.h>
 
 class XBOXINTERNALSSHARED_EXPORT Ytgr
 {
 public:
     Ytgr(std::string filePath);
-    Ytgr(FileIO *io);
+    Ytgr(BaseIO *io);
     ~Ytgr();
 
     DWORD magic;
@@ -28,7 +28,7 @@ public:
     bool valid;
 
 private:
-    FileIO *io;
+    BaseIO *io;
     bool ioPassedIn;
 
     // parse Ytgr header
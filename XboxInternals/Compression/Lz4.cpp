@@ -0,0 +1,223 @@
+#include "Lz4.h"
+
+#include <string.h>
+
+// a match has to be at least this long to be worth encoding
+#define LZ4_MIN_MATCH       4
+
+// the last 5 bytes are always literals, and the last match has to start 12 bytes before the end
+#define LZ4_LAST_LITERALS   5
+#define LZ4_MF_LIMIT        12
+
+#define LZ4_MAX_DISTANCE    0xFFFF
+#define LZ4_HASH_LOG        12
+#define LZ4_RUN_MASK        0xF
+
+DWORD Lz4::CompressBound(DWORD len)
+{
+    return len + (len / 255) + 16;
+}
+
+DWORD Lz4::read32(const BYTE *buffer)
+{
+    DWORD value;
+    memcpy(&value, buffer, sizeof(DWORD));
+    return value;
+}
+
+DWORD Lz4::hash(DWORD value)
+{
+    return (value * 2654435761U) >> (32 - LZ4_HASH_LOG);
+}
+
+DWORD Lz4::Compress(const BYTE *buffer, DWORD len, BYTE *outBuffer, DWORD outCapacity)
+{
+    DWORD hashTable[1 << LZ4_HASH_LOG];
+    memset(hashTable, 0, sizeof(hashTable));
+
+    DWORD in = 0, anchor = 0, out = 0;
+
+    if (len >= LZ4_MF_LIMIT + 1)
+    {
+        DWORD matchLimit = len - LZ4_LAST_LITERALS;
+        DWORD mfLimit = len - LZ4_MF_LIMIT;
+
+        hashTable[hash(read32(buffer))] = 0;
+        in++;
+
+        while (true)
+        {
+            // look for a match, skipping ahead faster the longer nothing is found
+            DWORD ref;
+            DWORD attempts = 1 << 6;
+            bool found = false;
+            while (in <= mfLimit)
+            {
+                DWORD h = hash(read32(buffer + in));
+                ref = hashTable[h];
+                hashTable[h] = in;
+
+                if (ref < in && in - ref <= LZ4_MAX_DISTANCE && read32(buffer + ref) == read32(buffer + in))
+                {
+                    found = true;
+                    break;
+                }
+
+                in += attempts++ >> 6;
+            }
+
+            if (!found)
+                break;
+
+            // extend the match backwards into the literals
+            while (in > anchor && ref > 0 && buffer[in - 1] == buffer[ref - 1])
+            {
+                in--;
+                ref--;
+            }
+
+            DWORD literalLen = in - anchor;
+            DWORD matchStart = in;
+            DWORD distance = in - ref;
+            in += LZ4_MIN_MATCH;
+            ref += LZ4_MIN_MATCH;
+            while (in < matchLimit && buffer[in] == buffer[ref])
+            {
+                in++;
+                ref++;
+            }
+            DWORD matchLen = in - matchStart - LZ4_MIN_MATCH;
+
+            // token, literal length, literals, offset and match length
+            if ((UINT64)out + 1 + (literalLen / 255) + 1 + literalLen + 2 + (matchLen / 255) + 1 > outCapacity)
+                return 0;
+
+            BYTE *token = outBuffer + out++;
+            if (literalLen >= LZ4_RUN_MASK)
+            {
+                *token = LZ4_RUN_MASK << 4;
+                DWORD remaining = literalLen - LZ4_RUN_MASK;
+                for (; remaining >= 255; remaining -= 255)
+                    outBuffer[out++] = 255;
+                outBuffer[out++] = (BYTE)remaining;
+            }
+            else
+                *token = (BYTE)(literalLen << 4);
+
+            memcpy(outBuffer + out, buffer + anchor, literalLen);
+            out += literalLen;
+
+            outBuffer[out++] = (BYTE)distance;
+            outBuffer[out++] = (BYTE)(distance >> 8);
+
+            if (matchLen >= LZ4_RUN_MASK)
+            {
+                *token |= LZ4_RUN_MASK;
+                DWORD remaining = matchLen - LZ4_RUN_MASK;
+                for (; remaining >= 255; remaining -= 255)
+                    outBuffer[out++] = 255;
+                outBuffer[out++] = (BYTE)remaining;
+            }
+            else
+                *token |= (BYTE)matchLen;
+
+            anchor = in;
+            if (in > mfLimit)
+                break;
+
+            hashTable[hash(read32(buffer + in - 2))] = in - 2;
+        }
+    }
+
+    // the rest of the buffer is stored as literals
+    DWORD literalLen = len - anchor;
+    if ((UINT64)out + 1 + (literalLen / 255) + 1 + literalLen > outCapacity)
+        return 0;
+
+    if (literalLen >= LZ4_RUN_MASK)
+    {
+        outBuffer[out++] = LZ4_RUN_MASK << 4;
+        DWORD remaining = literalLen - LZ4_RUN_MASK;
+        for (; remaining >= 255; remaining -= 255)
+            outBuffer[out++] = 255;
+        outBuffer[out++] = (BYTE)remaining;
+    }
+    else
+        outBuffer[out++] = (BYTE)(literalLen << 4);
+
+    memcpy(outBuffer + out, buffer + anchor, literalLen);
+    out += literalLen;
+
+    return out;
+}
+
+void Lz4::Decompress(const BYTE *buffer, DWORD len, BYTE *outBuffer, DWORD outLen)
+{
+    DWORD in = 0, out = 0;
+
+    while (in < len)
+    {
+        BYTE token = buffer[in++];
+
+        // copy over the literals
+        DWORD literalLen = token >> 4;
+        if (literalLen == LZ4_RUN_MASK)
+        {
+            BYTE b;
+            do
+            {
+                if (in >= len)
+                    throw std::string("LZ4: Compressed data is corrupt.\n");
+                b = buffer[in++];
+                literalLen += b;
+            }
+            while (b == 255);
+        }
+
+        if (literalLen > len - in || literalLen > outLen - out)
+            throw std::string("LZ4: Compressed data is corrupt.\n");
+
+        memcpy(outBuffer + out, buffer + in, literalLen);
+        in += literalLen;
+        out += literalLen;
+
+        // the last sequence doesn't have a match
+        if (in == len)
+            break;
+
+        if (len - in < 2)
+            throw std::string("LZ4: Compressed data is corrupt.\n");
+
+        DWORD distance = buffer[in] | (buffer[in + 1] << 8);
+        in += 2;
+        if (distance == 0 || distance > out)
+            throw std::string("LZ4: Compressed data is corrupt.\n");
+
+        DWORD matchLen = token & LZ4_RUN_MASK;
+        if (matchLen == LZ4_RUN_MASK)
+        {
+            BYTE b;
+            do
+            {
+                if (in >= len)
+                    throw std::string("LZ4: Compressed data is corrupt.\n");
+                b = buffer[in++];
+                matchLen += b;
+            }
+            while (b == 255);
+        }
+        matchLen += LZ4_MIN_MATCH;
+
+        if (matchLen > outLen - out)
+            throw std::string("LZ4: Compressed data is corrupt.\n");
+
+        // the match can overlap what's being written, so it's copied a byte at a time
+        BYTE *match = outBuffer + out - distance;
+        for (DWORD i = 0; i < matchLen; i++)
+            outBuffer[out + i] = match[i];
+        out += matchLen;
+    }
+
+    if (out != outLen)
+        throw std::string("LZ4: Compressed data is corrupt.\n");
+}
@@ -0,0 +1,27 @@
+#ifndef LZ4_H
+#define LZ4_H
+
+#include "winnames.h"
+#include <iostream>
+
+#include "XboxInternals_global.h"
+
+// an implementation of the LZ4 block format, fast enough to keep up with a hard drive
+class XBOXINTERNALSSHARED_EXPORT Lz4
+{
+public:
+    // get the largest size that compressing len bytes can produce
+    static DWORD CompressBound(DWORD len);
+
+    // compress the buffer, returns the compressed length or 0 if it didn't fit in outCapacity bytes
+    static DWORD Compress(const BYTE *buffer, DWORD len, BYTE *outBuffer, DWORD outCapacity);
+
+    // decompress exactly outLen bytes, throws if the data is malformed
+    static void Decompress(const BYTE *buffer, DWORD len, BYTE *outBuffer, DWORD outLen);
+
+private:
+    static DWORD read32(const BYTE *buffer);
+    static DWORD hash(DWORD value);
+};
+
+#endif // LZ4_H
@@ -0,0 +1,568 @@
+#include "Sha1.h"
+#include <string.h>
+
+// the accelerated versions need a compiler that can target instruction sets per function, so
+// the rest of the library doesn't have to be built for a newer cpu than it runs on
+#if (defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)) && \
+        ((defined(_MSC_VER) && _MSC_VER >= 1900) || defined(__clang__) || \
+        (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#define SHA1_X86
+#endif
+
+#ifdef SHA1_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define SHA1_TARGET(features)
+#else
+#include <cpuid.h>
+#define SHA1_TARGET(features) __attribute__((target(features)))
+#endif
+#endif
+
+#define SHA1_BLOCK_SIZE 0x40
+#define SHA1_BLOCKS_PER_DATA_BLOCK (0x1000 / SHA1_BLOCK_SIZE)
+
+static const DWORD initialState[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+
+// the padding that follows a 0x1000 byte message, the length is in bits
+static const BYTE dataBlockPadding[SHA1_BLOCK_SIZE] =
+{
+    0x80, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x80, 0
+};
+
+static inline DWORD readBigEndian(const BYTE *data)
+{
+    return ((DWORD)data[0] << 24) | ((DWORD)data[1] << 16) | ((DWORD)data[2] << 8) | data[3];
+}
+
+static inline void writeBigEndian(DWORD value, BYTE *out)
+{
+    out[0] = (BYTE)(value >> 24);
+    out[1] = (BYTE)(value >> 16);
+    out[2] = (BYTE)(value >> 8);
+    out[3] = (BYTE)value;
+}
+
+static inline DWORD rotateLeft(DWORD value, int bits)
+{
+    return (value << bits) | (value >> (32 - bits));
+}
+
+static void compressPortable(DWORD *state, const BYTE *blocks, size_t blockCount)
+{
+    DWORD w[16];
+    for (; blockCount != 0; blockCount--, blocks += SHA1_BLOCK_SIZE)
+    {
+        for (int t = 0; t < 16; t++)
+            w[t] = readBigEndian(blocks + t * 4);
+
+        DWORD a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+        for (int t = 0; t < 80; t++)
+        {
+            if (t >= 16)
+                w[t & 15] = rotateLeft(w[(t - 3) & 15] ^ w[(t - 8) & 15] ^ w[(t - 14) & 15] ^ w[t & 15], 1);
+
+            DWORD f, k;
+            if (t < 20)
+            {
+                f = (b & c) | (~b & d);
+                k = 0x5A827999;
+            }
+            else if (t < 40)
+            {
+                f = b ^ c ^ d;
+                k = 0x6ED9EBA1;
+            }
+            else if (t < 60)
+            {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8F1BBCDC;
+            }
+            else
+            {
+                f = b ^ c ^ d;
+                k = 0xCA62C1D6;
+            }
+
+            DWORD temp = rotateLeft(a, 5) + f + e + k + w[t & 15];
+            e = d;
+            d = c;
+            c = rotateLeft(b, 30);
+            b = a;
+            a = temp;
+        }
+
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+    }
+}
+
+#ifdef SHA1_X86
+
+static void cpuid(DWORD leaf, DWORD subleaf, DWORD *registers)
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuidex(info, leaf, subleaf);
+    for (int i = 0; i < 4; i++)
+        registers[i] = info[i];
+#else
+    registers[0] = registers[1] = registers[2] = registers[3] = 0;
+    if (__get_cpuid_max(0, NULL) >= leaf)
+        __cpuid_count(leaf, subleaf, registers[0], registers[1], registers[2], registers[3]);
+#endif
+}
+
+// the register state the os saves on context switches, AVX can't be used unless it saves ymm
+static UINT64 readExtendedControlRegister()
+{
+#ifdef _MSC_VER
+    return _xgetbv(0);
+#else
+    DWORD low, high;
+    __asm__ __volatile__ ("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+    return ((UINT64)high << 32) | low;
+#endif
+}
+
+SHA1_TARGET("sse2,ssse3,sse4.1,sha")
+static void compressShaNi(DWORD *state, const BYTE *blocks, size_t blockCount)
+{
+    const __m128i byteSwap = _mm_set_epi64x(0x0001020304050607ULL, 0x08090A0B0C0D0E0FULL);
+
+    __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)state), 0x1B);
+    __m128i e0 = _mm_set_epi32(state[4], 0, 0, 0);
+    __m128i e1, msg0, msg1, msg2, msg3;
+
+    for (; blockCount != 0; blockCount--, blocks += SHA1_BLOCK_SIZE)
+    {
+        __m128i abcdSaved = abcd;
+        __m128i eSaved = e0;
+
+        // rounds 0 - 15, straight from the message
+        msg0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(blocks + 0x00)), byteSwap);
+        e0 = _mm_add_epi32(e0, msg0);
+        e1 = abcd;
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+
+        msg1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(blocks + 0x10)), byteSwap);
+        e1 = _mm_sha1nexte_epu32(e1, msg1);
+        e0 = abcd;
+        abcd = _mm_sha1rnds4_epu32(abcd, e1, 0);
+        msg0 = _mm_sha1msg1_epu32(msg0, msg1);
+
+        msg2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(blocks + 0x20)), byteSwap);
+        e0 = _mm_sha1nexte_epu32(e0, msg2);
+        e1 = abcd;
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+        msg1 = _mm_sha1msg1_epu32(msg1, msg2);
+        msg0 = _mm_xor_si128(msg0, msg2);
+
+        msg3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(blocks + 0x30)), byteSwap);
+        e1 = _mm_sha1nexte_epu32(e1, msg3);
+        e0 = abcd;
+        msg0 = _mm_sha1msg2_epu32(msg0, msg3);
+        abcd = _mm_sha1rnds4_epu32(abcd, e1, 0);
+        msg2 = _mm_sha1msg1_epu32(msg2, msg3);
+        msg1 = _mm_xor_si128(msg1, msg3);
+
+        // rounds 16 - 63, every four rounds schedule the message words for the ones after them
+#define SHA1_NI_ROUNDS(eIn, eOut, m0, m1, m2, m3, function) \
+        eIn = _mm_sha1nexte_epu32(eIn, m0); \
+        eOut = abcd; \
+        m1 = _mm_sha1msg2_epu32(m1, m0); \
+        abcd = _mm_sha1rnds4_epu32(abcd, eIn, function); \
+        m3 = _mm_sha1msg1_epu32(m3, m0); \
+        m2 = _mm_xor_si128(m2, m0);
+
+        SHA1_NI_ROUNDS(e0, e1, msg0, msg1, msg2, msg3, 0)
+        SHA1_NI_ROUNDS(e1, e0, msg1, msg2, msg3, msg0, 1)
+        SHA1_NI_ROUNDS(e0, e1, msg2, msg3, msg0, msg1, 1)
+        SHA1_NI_ROUNDS(e1, e0, msg3, msg0, msg1, msg2, 1)
+        SHA1_NI_ROUNDS(e0, e1, msg0, msg1, msg2, msg3, 1)
+        SHA1_NI_ROUNDS(e1, e0, msg1, msg2, msg3, msg0, 1)
+        SHA1_NI_ROUNDS(e0, e1, msg2, msg3, msg0, msg1, 2)
+        SHA1_NI_ROUNDS(e1, e0, msg3, msg0, msg1, msg2, 2)
+        SHA1_NI_ROUNDS(e0, e1, msg0, msg1, msg2, msg3, 2)
+        SHA1_NI_ROUNDS(e1, e0, msg1, msg2, msg3, msg0, 2)
+        SHA1_NI_ROUNDS(e0, e1, msg2, msg3, msg0, msg1, 2)
+        SHA1_NI_ROUNDS(e1, e0, msg3, msg0, msg1, msg2, 3)
+#undef SHA1_NI_ROUNDS
+
+        // rounds 64 - 79, there are no message words left to start scheduling
+        e0 = _mm_sha1nexte_epu32(e0, msg0);
+        e1 = abcd;
+        msg1 = _mm_sha1msg2_epu32(msg1, msg0);
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 3);
+        msg3 = _mm_sha1msg1_epu32(msg3, msg0);
+        msg2 = _mm_xor_si128(msg2, msg0);
+
+        e1 = _mm_sha1nexte_epu32(e1, msg1);
+        e0 = abcd;
+        msg2 = _mm_sha1msg2_epu32(msg2, msg1);
+        abcd = _mm_sha1rnds4_epu32(abcd, e1, 3);
+        msg3 = _mm_xor_si128(msg3, msg1);
+
+        e0 = _mm_sha1nexte_epu32(e0, msg2);
+        e1 = abcd;
+        msg3 = _mm_sha1msg2_epu32(msg3, msg2);
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 3);
+
+        e1 = _mm_sha1nexte_epu32(e1, msg3);
+        e0 = abcd;
+        abcd = _mm_sha1rnds4_epu32(abcd, e1, 3);
+
+        // add this block on to the state, for e that's the same as the next round's e
+        e0 = _mm_sha1nexte_epu32(e0, eSaved);
+        abcd = _mm_add_epi32(abcd, abcdSaved);
+    }
+
+    _mm_storeu_si128((__m128i*)state, _mm_shuffle_epi32(abcd, 0x1B));
+    state[4] = _mm_extract_epi32(e0, 3);
+}
+
+// The multi buffer versions hash one 0x1000 byte block per lane, all of the blocks are the same
+// length so the lanes never have to diverge. rotl, ch, maj and parity work on whole vectors
+#define SHA1_LANES_BODY(vector, lanes, set1, setLanes, add, xorv, andv, orv, andnot, slli, srli, \
+        store) \
+    vector state[5]; \
+    for (int i = 0; i < 5; i++) \
+        state[i] = set1(initialState[i]); \
+    \
+    vector w[16]; \
+    for (DWORD block = 0; block <= SHA1_BLOCKS_PER_DATA_BLOCK; block++) \
+    { \
+        for (int t = 0; t < 16; t++) \
+        { \
+            if (block == SHA1_BLOCKS_PER_DATA_BLOCK) \
+                w[t] = set1(readBigEndian(dataBlockPadding + t * 4)); \
+            else \
+            { \
+                DWORD words[lanes]; \
+                for (int lane = 0; lane < lanes; lane++) \
+                    words[lane] = readBigEndian(blocks[lane] + block * SHA1_BLOCK_SIZE + t * 4); \
+                w[t] = setLanes(words); \
+            } \
+        } \
+        \
+        vector a = state[0], b = state[1], c = state[2], d = state[3], e = state[4]; \
+        for (int t = 0; t < 80; t++) \
+        { \
+            if (t >= 16) \
+            { \
+                vector x = xorv(xorv(w[(t - 3) & 15], w[(t - 8) & 15]), xorv(w[(t - 14) & 15], w[t & 15])); \
+                w[t & 15] = orv(slli(x, 1), srli(x, 31)); \
+            } \
+            \
+            vector f, k; \
+            if (t < 20) \
+            { \
+                f = orv(andv(b, c), andnot(b, d)); \
+                k = set1(0x5A827999); \
+            } \
+            else if (t < 40) \
+            { \
+                f = xorv(xorv(b, c), d); \
+                k = set1(0x6ED9EBA1); \
+            } \
+            else if (t < 60) \
+            { \
+                f = orv(andv(b, c), andv(d, orv(b, c))); \
+                k = set1(0x8F1BBCDC); \
+            } \
+            else \
+            { \
+                f = xorv(xorv(b, c), d); \
+                k = set1(0xCA62C1D6); \
+            } \
+            \
+            vector temp = add(add(orv(slli(a, 5), srli(a, 27)), f), add(add(e, k), w[t & 15])); \
+            e = d; \
+            d = c; \
+            c = orv(slli(b, 30), srli(b, 2)); \
+            b = a; \
+            a = temp; \
+        } \
+        \
+        state[0] = add(state[0], a); \
+        state[1] = add(state[1], b); \
+        state[2] = add(state[2], c); \
+        state[3] = add(state[3], d); \
+        state[4] = add(state[4], e); \
+    } \
+    \
+    for (int i = 0; i < 5; i++) \
+    { \
+        DWORD words[lanes]; \
+        store(words, state[i]); \
+        for (int lane = 0; lane < lanes; lane++) \
+            writeBigEndian(words[lane], outHashes[lane] + i * 4); \
+    }
+
+#define SSE2_SET_LANES(words) _mm_set_epi32(words[3], words[2], words[1], words[0])
+#define SSE2_STORE(words, value) _mm_storeu_si128((__m128i*)(words), value)
+
+SHA1_TARGET("sse2")
+static void hashDataBlocksSse2(const BYTE **blocks, BYTE **outHashes)
+{
+    SHA1_LANES_BODY(__m128i, 4, _mm_set1_epi32, SSE2_SET_LANES, _mm_add_epi32, _mm_xor_si128,
+            _mm_and_si128, _mm_or_si128, _mm_andnot_si128, _mm_slli_epi32, _mm_srli_epi32, SSE2_STORE)
+}
+
+#define AVX2_SET_LANES(words) _mm256_set_epi32(words[7], words[6], words[5], words[4], words[3], \
+        words[2], words[1], words[0])
+#define AVX2_STORE(words, value) _mm256_storeu_si256((__m256i*)(words), value)
+
+SHA1_TARGET("avx2")
+static void hashDataBlocksAvx2(const BYTE **blocks, BYTE **outHashes)
+{
+    SHA1_LANES_BODY(__m256i, 8, _mm256_set1_epi32, AVX2_SET_LANES, _mm256_add_epi32,
+            _mm256_xor_si256, _mm256_and_si256, _mm256_or_si256, _mm256_andnot_si256,
+            _mm256_slli_epi32, _mm256_srli_epi32, AVX2_STORE)
+}
+
+#endif // SHA1_X86
+
+typedef void (*CompressFunction)(DWORD *state, const BYTE *blocks, size_t blockCount);
+
+// -1 until the cpu has been checked, it's only ever written with the same value so a race is harmless
+static volatile int currentBackend = -1;
+
+static Sha1Backend backend()
+{
+    if (currentBackend < 0)
+    {
+        if (Sha1::IsSupported(Sha1ShaNi))
+            currentBackend = Sha1ShaNi;
+        else if (Sha1::IsSupported(Sha1Avx2))
+            currentBackend = Sha1Avx2;
+        else if (Sha1::IsSupported(Sha1Sse2))
+            currentBackend = Sha1Sse2;
+        else
+            currentBackend = Sha1Portable;
+    }
+
+    return (Sha1Backend)currentBackend;
+}
+
+// the implementation used for a single message, only the SHA instructions beat the plain version
+static CompressFunction compressFunction()
+{
+#ifdef SHA1_X86
+    if (backend() == Sha1ShaNi)
+        return compressShaNi;
+#endif
+    return compressPortable;
+}
+
+static void hashDataBlock(CompressFunction compress, const BYTE *block, BYTE *outHash)
+{
+    DWORD state[5];
+    memcpy(state, initialState, sizeof(state));
+
+    compress(state, block, SHA1_BLOCKS_PER_DATA_BLOCK);
+    compress(state, dataBlockPadding, 1);
+
+    for (int i = 0; i < 5; i++)
+        writeBigEndian(state[i], outHash + i * 4);
+}
+
+Sha1::Sha1()
+{
+    Clear();
+}
+
+void Sha1::Clear()
+{
+    memcpy(state, initialState, sizeof(state));
+    bufferLength = 0;
+    totalLength = 0;
+}
+
+void Sha1::Update(const BYTE *data, size_t length)
+{
+    CompressFunction compress = compressFunction();
+    totalLength += length;
+
+    // finish off the block that's been started
+    if (bufferLength != 0)
+    {
+        size_t toCopy = SHA1_BLOCK_SIZE - bufferLength;
+        if (toCopy > length)
+            toCopy = length;
+
+        memcpy(buffer + bufferLength, data, toCopy);
+        bufferLength += toCopy;
+        data += toCopy;
+        length -= toCopy;
+
+        if (bufferLength != SHA1_BLOCK_SIZE)
+            return;
+
+        compress(state, buffer, 1);
+        bufferLength = 0;
+    }
+
+    // whole blocks are hashed straight from the data
+    size_t blockCount = length / SHA1_BLOCK_SIZE;
+    if (blockCount != 0)
+    {
+        compress(state, data, blockCount);
+        data += blockCount * SHA1_BLOCK_SIZE;
+        length -= blockCount * SHA1_BLOCK_SIZE;
+    }
+
+    memcpy(buffer, data, length);
+    bufferLength = length;
+}
+
+void Sha1::Final(BYTE *outHash)
+{
+    CompressFunction compress = compressFunction();
+    UINT64 bitLength = totalLength * 8;
+
+    // a 1 bit, then zeros up until the length at the end of the last block
+    buffer[bufferLength++] = 0x80;
+    if (bufferLength > SHA1_BLOCK_SIZE - 8)
+    {
+        memset(buffer + bufferLength, 0, SHA1_BLOCK_SIZE - bufferLength);
+        compress(state, buffer, 1);
+        bufferLength = 0;
+    }
+    memset(buffer + bufferLength, 0, SHA1_BLOCK_SIZE - 8 - bufferLength);
+
+    writeBigEndian((DWORD)(bitLength >> 32), buffer + SHA1_BLOCK_SIZE - 8);
+    writeBigEndian((DWORD)bitLength, buffer + SHA1_BLOCK_SIZE - 4);
+    compress(state, buffer, 1);
+
+    for (int i = 0; i < 5; i++)
+        writeBigEndian(state[i], outHash + i * 4);
+
+    Clear();
+}
+
+void Sha1::Hash(const BYTE *data, size_t length, BYTE *outHash)
+{
+    if (length == 0x1000)
+    {
+        hashDataBlock(compressFunction(), data, outHash);
+        return;
+    }
+
+    Sha1 sha1;
+    sha1.Update(data, length);
+    sha1.Final(outHash);
+}
+
+void Sha1::HashBlocks(const BYTE *blocks, size_t blockCount, BYTE *outHashes)
+{
+    size_t i = 0;
+
+#ifdef SHA1_X86
+    Sha1Backend current = backend();
+
+    // hash as many blocks at once as there are lanes, the leftovers are done one at a time
+    if (current == Sha1Avx2)
+    {
+        for (; blockCount - i >= 8; i += 8)
+        {
+            const BYTE *laneBlocks[8];
+            BYTE *laneHashes[8];
+            for (int lane = 0; lane < 8; lane++)
+            {
+                laneBlocks[lane] = blocks + (i + lane) * 0x1000;
+                laneHashes[lane] = outHashes + (i + lane) * 0x14;
+            }
+            hashDataBlocksAvx2(laneBlocks, laneHashes);
+        }
+    }
+    if (current == Sha1Avx2 || current == Sha1Sse2)
+    {
+        for (; blockCount - i >= 4; i += 4)
+        {
+            const BYTE *laneBlocks[4];
+            BYTE *laneHashes[4];
+            for (int lane = 0; lane < 4; lane++)
+            {
+                laneBlocks[lane] = blocks + (i + lane) * 0x1000;
+                laneHashes[lane] = outHashes + (i + lane) * 0x14;
+            }
+            hashDataBlocksSse2(laneBlocks, laneHashes);
+        }
+    }
+#endif
+
+    CompressFunction compress = compressFunction();
+    for (; i < blockCount; i++)
+        hashDataBlock(compress, blocks + i * 0x1000, outHashes + i * 0x14);
+}
+
+Sha1Backend Sha1::GetBackend()
+{
+    return backend();
+}
+
+bool Sha1::SetBackend(Sha1Backend backend)
+{
+    if (!IsSupported(backend))
+        return false;
+
+    currentBackend = backend;
+    return true;
+}
+
+bool Sha1::IsSupported(Sha1Backend backend)
+{
+    if (backend == Sha1Portable)
+        return true;
+
+#ifdef SHA1_X86
+    DWORD features[4], extendedFeatures[4];
+    cpuid(1, 0, features);
+    cpuid(7, 0, extendedFeatures);
+
+    bool sse2 = (features[3] & (1 << 26)) != 0;
+    bool ssse3 = (features[2] & (1 << 9)) != 0;
+    bool sse41 = (features[2] & (1 << 19)) != 0;
+    bool osSavesAvx = (features[2] & (1 << 27)) != 0 && (features[2] & (1 << 28)) != 0 &&
+            (readExtendedControlRegister() & 6) == 6;
+
+    switch (backend)
+    {
+        case Sha1Sse2:
+            return sse2;
+        case Sha1Avx2:
+            return sse2 && osSavesAvx && (extendedFeatures[1] & (1 << 5)) != 0;
+        case Sha1ShaNi:
+            return sse2 && ssse3 && sse41 && (extendedFeatures[1] & (1 << 29)) != 0;
+        default:
+            break;
+    }
+#endif
+
+    return false;
+}
+
+std::string Sha1::BackendToString(Sha1Backend backend)
+{
+    switch (backend)
+    {
+        case Sha1Portable:
+            return "Portable";
+        case Sha1Sse2:
+            return "SSE2";
+        case Sha1Avx2:
+            return "AVX2";
+        case Sha1ShaNi:
+            return "SHA-NI";
+        default:
+            return "Unknown";
+    }
+}
@@ -0,0 +1,63 @@
+#ifndef SHA1_H
+#define SHA1_H
+
+#include "winnames.h"
+#include <string>
+#include <stddef.h>
+
+#include "XboxInternals_global.h"
+
+enum Sha1Backend
+{
+    Sha1Portable,
+
+    // several independent blocks at once, one in each lane of the vector registers
+    Sha1Sse2,
+    Sha1Avx2,
+
+    // the SHA instructions on newer x86 cpus
+    Sha1ShaNi
+};
+
+// SHA-1, which is what all of the hashes in STFS, SVOD, content headers and avatar assets are. The
+// fastest implementation the cpu supports is picked the first time it's used
+class XBOXINTERNALSSHARED_EXPORT Sha1
+{
+public:
+    Sha1();
+
+    // add data to the hash
+    void Update(const BYTE *data, size_t length);
+
+    // write the 0x14 byte hash to outHash, and start over for the next one
+    void Final(BYTE *outHash);
+
+    // start over without finishing the hash
+    void Clear();
+
+    // hash a buffer of any length
+    static void Hash(const BYTE *data, size_t length, BYTE *outHash);
+
+    // hash blockCount 0x1000 byte blocks that are next to each other in memory, the 0x14 byte
+    // hashes are written one after the other to outHashes
+    static void HashBlocks(const BYTE *blocks, size_t blockCount, BYTE *outHashes);
+
+    // the implementation being used
+    static Sha1Backend GetBackend();
+
+    // use a different implementation, returns false if the cpu doesn't support it
+    static bool SetBackend(Sha1Backend backend);
+
+    // check if the cpu supports an implementation
+    static bool IsSupported(Sha1Backend backend);
+
+    static std::string BackendToString(Sha1Backend backend);
+
+private:
+    DWORD state[5];
+    BYTE buffer[0x40];
+    DWORD bufferLength;
+    UINT64 totalLength;
+};
+
+#endif // SHA1_H
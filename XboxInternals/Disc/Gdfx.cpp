@@ -1,4 +1,6 @@
 #include "Gdfx.h"
+#include "IO/MemoryIO.h"
+#include <ctype.h>
 
 void GdfxReadHeader(SvodMultiFileIO *io, GdfxHeader *header)
 {
@@ -30,7 +32,8 @@ bool GdfxReadFileEntry(SvodMultiFileIO *io, GdfxFileEntry *entry)
         return false;
 
     // parse the entry
-    entry->unknown = nextBytes;
+    entry->leftSubtree = (WORD)nextBytes;
+    entry->rightSubtree = (WORD)(nextBytes >> 16);
     entry->sector = io->ReadDword();
     entry->size = io->ReadDword();
     entry->attributes = io->ReadByte();
@@ -49,10 +52,52 @@ void GdfxWriteFileEntry(SvodMultiFileIO *io, GdfxFileEntry *entry)
     io->SetPosition(entry->address, entry->fileIndex);
 
     // Write the entry
-    io->Write(entry->unknown);
+    io->Write(entry->leftSubtree);
+    io->Write(entry->rightSubtree);
     io->Write(entry->sector);
     io->Write(entry->size);
     io->Write(entry->attributes);
     io->Write(entry->nameLen);
     io->Write(entry->name);
 }
+
+bool GdfxParseFileEntry(BYTE *sectorData, DWORD offset, GdfxFileEntry *entry)
+{
+    // entries never cross a sector boundary, the rest of the sector is padded with 0xFF
+    if (offset + 0xE > 0x800)
+        return false;
+
+    MemoryIO io(sectorData + offset, 0x800 - offset);
+    io.SetEndian(LittleEndian);
+
+    DWORD nextBytes = io.ReadDword();
+    if (nextBytes == 0xFFFFFFFF)
+        return false;
+
+    entry->leftSubtree = (WORD)nextBytes;
+    entry->rightSubtree = (WORD)(nextBytes >> 16);
+    entry->sector = io.ReadDword();
+    entry->size = io.ReadDword();
+    entry->attributes = io.ReadByte();
+    entry->nameLen = io.ReadByte();
+
+    if (offset + 0xE + entry->nameLen > 0x800)
+        throw string("GDFX: File entry name crosses a sector boundary\n");
+
+    entry->name = string((char*)sectorData + offset + 0xE, entry->nameLen);
+
+    return true;
+}
+
+int GdfxCompareNames(const string &a, const string &b)
+{
+    size_t len = (a.length() < b.length()) ? a.length() : b.length();
+    for (size_t i = 0; i < len; i++)
+    {
+        int diff = toupper((BYTE)a.at(i)) - toupper((BYTE)b.at(i));
+        if (diff != 0)
+            return diff;
+    }
+
+    return (int)a.length() - (int)b.length();
+}
@@ -19,8 +19,9 @@ struct GdfxHeader
 
 struct GdfxFileEntry
 {
-    // in the file
-    DWORD unknown;
+    // in the file, the subtree offsets are in DWORDs from the start of the directory (0 for none)
+    WORD leftSubtree;
+    WORD rightSubtree;
     DWORD sector;
     DWORD size;
     BYTE attributes;
@@ -29,7 +30,6 @@ struct GdfxFileEntry
 
     // extra stuff
     string filePath;
-    vector<GdfxFileEntry> files;
     DWORD address;
     DWORD fileIndex;
 };
@@ -56,4 +56,10 @@ bool GdfxReadFileEntry(SvodMultiFileIO *io, GdfxFileEntry *entry);
 // Write a file entry back to the listing
 void GdfxWriteFileEntry(SvodMultiFileIO *io, GdfxFileEntry *entry);
 
+// parse a file entry out of a directory sector that has already been read into memory, returns false on listing end
+bool GdfxParseFileEntry(BYTE *sectorData, DWORD offset, GdfxFileEntry *entry);
+
+// compare two entry names the way the directory's binary tree is ordered (case insensitive)
+int GdfxCompareNames(const string &a, const string &b);
+
 #endif // GDFX_H
@@ -1,4 +1,5 @@
 #include "Svod.h"
+#include <ctype.h>
 
 SVOD::SVOD(string rootPath)
 {
@@ -38,8 +39,8 @@ SVOD::SVOD(string rootPath)
     io->SetPosition(baseAddress, (DWORD)0);
     GdfxReadHeader(io, &header);
 
-    // read the file listing
-    ReadFileListing(&root, header.rootSector, header.rootSize, "/");
+    // the file listing is read on demand, one directory at a time
+    bufferedSector = 0xFFFFFFFF;
 }
 
 SVOD::~SVOD()
@@ -72,91 +73,190 @@ void SVOD::SectorToAddress(DWORD sector, DWORD *addressInDataFile, DWORD *dataFi
             trueSector != 0) ? 0 : 1)) * 0x1000;
 }
 
-void SVOD::ReadFileListing(vector<GdfxFileEntry> *entryList, DWORD sector, int size, string path)
+void SVOD::ReadDirectorySector(DWORD sector)
 {
-    DWORD eAddr, eIndex;
-    SectorToAddress(sector, &eAddr, &eIndex);
-    io->SetPosition(eAddr, eIndex);
+    if (sector == bufferedSector)
+        return;
 
-    GdfxFileEntry current;
+    DWORD addr, index;
+    SectorToAddress(sector, &addr, &index);
+    io->SetPosition(addr, index);
+    io->ReadBytes(sectorBuffer, 0x800);
 
-    while (GdfxReadFileEntry(io, &current) && size != 0)
-    {
-        // if it's a folder, then seek to it and read it's contents
-        if (current.attributes & GdfxDirectory)
-        {
-            // seek to the folder's files
-            DWORD seekAddr, seekIndex;
+    bufferedSector = sector;
+}
 
-            // preserve the current positon
-            io->GetPosition(&seekAddr, &seekIndex);
+GdfxFileEntry *SVOD::ReadFileEntry(DWORD directorySector, DWORD entryOffset, const string &path)
+{
+    DWORD sector = directorySector + (entryOffset / 0x800);
+    DWORD addr, index;
+    SectorToAddress(sector, &addr, &index);
+    addr += entryOffset % 0x800;
 
-            ReadFileListing(&current.files, current.sector, current.size, path + current.name + "/");
+    // check to see if the entry has already been read
+    UINT64 location = ((UINT64)index << 32) | addr;
+    std::map<UINT64, GdfxFileEntry*>::iterator cached = entriesByLocation.find(location);
+    if (cached != entriesByLocation.end())
+        return cached->second;
 
-            // reset position to current listing
-            io->SetPosition(seekAddr, seekIndex);
-        }
+    ReadDirectorySector(sector);
 
-        current.filePath = path;
-        entryList->push_back(current);
+    GdfxFileEntry entry;
+    if (!GdfxParseFileEntry(sectorBuffer, entryOffset % 0x800, &entry))
+        return NULL;
 
-        // seek to the next entry
-        eAddr += (current.nameLen + 0x11) & 0xFFFFFFFC;
-        io->SetPosition(eAddr);
+    entry.filePath = path;
+    entry.address = addr;
+    entry.fileIndex = index;
 
-        // check for end
-        if (io->ReadDword() == 0xFFFFFFFF)
-        {
-            if ((size - 0x800) <= 0)
-            {
-                std::sort(entryList->begin(), entryList->end(), compareFileEntries);
-                return;
-            }
-            else
-            {
-                size -= 0x800;
-                SectorToAddress(++sector, &eAddr, &eIndex);
-                io->SetPosition(eAddr, eIndex);
+    entries.push_back(entry);
+    GdfxFileEntry *stored = &entries.back();
 
-                // get position of next entry
-                io->GetPosition(&eAddr, &eIndex);
-            }
+    entriesByLocation[location] = stored;
+    pathCache[PathKey(path + entry.name)] = stored;
+
+    return stored;
+}
+
+const vector<GdfxFileEntry*> &SVOD::ReadFileListing(DWORD sector, DWORD size, const string &path)
+{
+    std::map<DWORD, vector<GdfxFileEntry*> >::iterator loaded = listings.find(sector);
+    if (loaded != listings.end())
+        return loaded->second;
+
+    vector<GdfxFileEntry*> &listing = listings[sector];
+
+    // the entries are packed into each sector of the directory, the end of a sector is marked with 0xFF
+    // unless the entries fill it exactly
+    for (DWORD sectorOffset = 0; sectorOffset < size; sectorOffset += 0x800)
+    {
+        DWORD entryOffset = 0;
+        GdfxFileEntry *entry;
+        while (entryOffset < 0x800 &&
+                (entry = ReadFileEntry(sector, sectorOffset + entryOffset, path)) != NULL)
+        {
+            listing.push_back(entry);
+            entryOffset += (entry->nameLen + 0x11) & 0xFFFFFFFC;
         }
+    }
+
+    std::stable_sort(listing.begin(), listing.end(), compareFileEntries);
+    return listing;
+}
 
-        // back up to the entry
-        io->SetPosition(eAddr);
+GdfxFileEntry *SVOD::FindFileEntry(DWORD sector, DWORD size, const string &name, const string &path)
+{
+    // the directory is a binary tree ordered by name, the root is the first entry
+    DWORD entryOffset = 0;
+
+    // a corrupted tree could loop forever, there can't be more entries than this
+    for (DWORD steps = (size / 0xE) + 1; steps--;)
+    {
+        if (entryOffset >= size)
+            return NULL;
 
-        // reset the directory
-        current.files.clear();
+        GdfxFileEntry *entry = ReadFileEntry(sector, entryOffset, path);
+        if (entry == NULL)
+            return NULL;
+
+        int comparison = GdfxCompareNames(name, entry->name);
+        if (comparison == 0)
+            return entry;
+
+        WORD subtree = (comparison < 0) ? entry->leftSubtree : entry->rightSubtree;
+        if (subtree == 0 || subtree == 0xFFFF)
+            return NULL;
+
+        entryOffset = subtree * 4;
     }
 
-    std::sort(entryList->begin(), entryList->end(), compareFileEntries);
+    return NULL;
+}
+
+const vector<GdfxFileEntry*> &SVOD::GetRootListing()
+{
+    return ReadFileListing(header.rootSector, header.rootSize, "/");
 }
 
-GdfxFileEntry SVOD::GetFileEntry(string path, vector<GdfxFileEntry> *listing)
+const vector<GdfxFileEntry*> &SVOD::GetDirectoryListing(const GdfxFileEntry *directory)
 {
-    string entryName = path.substr(1, path.substr(1).find_first_of('/'));
+    if (!(directory->attributes & GdfxDirectory))
+        throw string("SVOD: Entry is not a directory.\n");
 
-    // search for the entry
-    size_t i = 0;
-    for (; i < listing->size(); i++)
+    return ReadFileListing(directory->sector, directory->size,
+            directory->filePath + directory->name + "/");
+}
+
+GdfxFileEntry *SVOD::GetFileEntry(string path)
+{
+    // make sure all of the slashes are the same
+    for (DWORD i = 0; i < path.length(); i++)
+        if (path.at(i) == '\\')
+            path.at(i) = '/';
+    if (path.length() == 0 || path.at(0) != '/')
+        path = "/" + path;
+
+    std::map<string, GdfxFileEntry*>::iterator cached = pathCache.find(PathKey(path));
+    if (cached != pathCache.end())
+        return cached->second;
+
+    // walk down the path one directory at a time
+    GdfxFileEntry *entry = NULL;
+    DWORD sector = header.rootSector;
+    DWORD size = header.rootSize;
+    string currentPath = "/";
+
+    size_t nameStart = 0;
+    while (nameStart < path.length())
     {
-        if (listing->at(i).name == entryName)
+        size_t nameEnd = path.find('/', nameStart);
+        if (nameEnd == string::npos)
+            nameEnd = path.length();
+
+        string name = path.substr(nameStart, nameEnd - nameStart);
+        nameStart = nameEnd + 1;
+        if (name.length() == 0)
+            continue;
+
+        if (entry != NULL)
         {
-            // check to see if it's at the end
-            if (path.substr(1).find_first_of('/') == string::npos)
-                return listing->at(i);
-            else
-                break;
+            if (!(entry->attributes & GdfxDirectory))
+                return NULL;
+
+            sector = entry->sector;
+            size = entry->size;
         }
+
+        cached = pathCache.find(PathKey(currentPath + name));
+        if (cached != pathCache.end())
+            entry = cached->second;
+        else if (listings.find(sector) != listings.end())
+            return NULL;
+        else if ((entry = FindFileEntry(sector, size, name, currentPath)) == NULL)
+            return NULL;
+
+        currentPath += entry->name + "/";
     }
 
-    return GetFileEntry(path.substr(entryName.length() + 1), &listing->at(i).files);
+    return entry;
+}
+
+string SVOD::PathKey(const string &path)
+{
+    string key(path);
+    for (DWORD i = 0; i < key.length(); i++)
+        key.at(i) = toupper((BYTE)key.at(i));
+
+    return key;
 }
 
 SvodIO SVOD::GetSvodIO(string path)
 {
-    return GetSvodIO(GetFileEntry(path, &root));
+    GdfxFileEntry *entry = GetFileEntry(path);
+    if (entry == NULL)
+        throw string("SVOD: File entry not found.\n");
+
+    return GetSvodIO(*entry);
 }
 
 SvodIO SVOD::GetSvodIO(GdfxFileEntry entry)
@@ -169,7 +269,7 @@ void SVOD::Rehash(void (*progress)(DWORD, DWORD, void*), void *arg)
     DWORD fileCount = io->FileCount();
     BYTE master[0x1000] = {0};
     BYTE level0[0x1000] = {0};
-    BYTE currentBlock[0x1000];
+    vector<BYTE> dataBlocks(0xCC * 0x1000);
     BYTE prevHash[0x14] = {0};
 
     // iterate through all of the files
@@ -188,11 +288,11 @@ void SVOD::Rehash(void (*progress)(DWORD, DWORD, void*), void *arg)
             DWORD blockCount = (totalBlockCount >= 0xCC) ? 0xCC : totalBlockCount % 0xCC;
             totalBlockCount -= 0xCC;
 
-            // iterate through all of the blocks
-            for (DWORD y = 0; y < blockCount; y++)
+            // the blocks are all next to each other, so read them in at once and hash them together
+            if (blockCount != 0)
             {
-                io->ReadBytes(currentBlock, 0x1000);
-                HashBlock(currentBlock, level0 + y * 0x14);
+                io->ReadBytes(&dataBlocks.at(0), blockCount * 0x1000);
+                Sha1::HashBlocks(&dataBlocks.at(0), blockCount, level0);
             }
 
             // Write the table
@@ -234,25 +334,32 @@ void SVOD::Rehash(void (*progress)(DWORD, DWORD, void*), void *arg)
     rootFile->SetPosition(0x344);
     rootFile->ReadBytes(buff, dataLen);
 
-    Botan::SHA_160 sha1;
-    sha1.clear();
-    sha1.update(buff, dataLen);
-    sha1.final(metadata->headerHash);
+    Sha1::Hash(buff, dataLen, metadata->headerHash);
+    delete[] buff;
 
     metadata->WriteMetaData();
 }
 
 void SVOD::HashBlock(BYTE *block, BYTE *outHash)
 {
-    Botan::SHA_160 sha1;
-    sha1.clear();
-    sha1.update(block, 0x1000);
-    sha1.final(outHash);
+    Sha1::Hash(block, 0x1000, outHash);
 }
 
 void SVOD::WriteFileEntry(GdfxFileEntry *entry)
 {
     GdfxWriteFileEntry(io, entry);
+    bufferedSector = 0xFFFFFFFF;
+
+    // the name may have changed, so the entry's path needs to be updated
+    std::map<string, GdfxFileEntry*>::iterator i = pathCache.begin();
+    while (i != pathCache.end())
+    {
+        if (i->second == entry)
+            pathCache.erase(i++);
+        else
+            ++i;
+    }
+    pathCache[PathKey(entry->filePath + entry->name)] = entry;
 }
 
 DWORD SVOD::GetSectorCount()
@@ -263,7 +370,8 @@ DWORD SVOD::GetSectorCount()
     return (io->FileCount() * 0x14388) + ((fileLen - (0x1000 * (fileLen / 0xCD000))) / 0x800);
 }
 
-int compareFileEntries(GdfxFileEntry a, GdfxFileEntry b)
+bool compareFileEntries(const GdfxFileEntry *a, const GdfxFileEntry *b)
 {
-    return !(a.attributes & GdfxDirectory);
+    // directories first, otherwise keep the order on disc
+    return (a->attributes & GdfxDirectory) && !(b->attributes & GdfxDirectory);
 }
@@ -7,10 +7,12 @@
 #include "Stfs/XContentHeader.h"
 #include <iostream>
 #include <vector>
+#include <deque>
+#include <map>
 #include "IO/SvodIO.h"
 #include <algorithm>
 #include "botan/botan.h"
-#include "botan/sha160.h"
+#include "Cryptography/Sha1.h"
 
 #include "XboxInternals_global.h"
 
@@ -24,7 +26,15 @@ public:
     ~SVOD();
 
     XContentHeader *metadata;
-    vector<GdfxFileEntry> root;
+
+    // get the entries in the root directory, read from the disc on first access
+    const vector<GdfxFileEntry*> &GetRootListing();
+
+    // get the entries in a directory, read from the disc on first access
+    const vector<GdfxFileEntry*> &GetDirectoryListing(const GdfxFileEntry *directory);
+
+    // get a file entry from the path, must start with a /. returns NULL if it doesn't exist
+    GdfxFileEntry *GetFileEntry(string path);
 
     // get a SvodIO for the given entry
     SvodIO GetSvodIO(GdfxFileEntry entry);
@@ -55,16 +65,41 @@ private:
     DWORD baseAddress;
     DWORD offset;
 
-    // parse the file listing
-    void ReadFileListing(vector<GdfxFileEntry> *entryList, DWORD sector, int size, string path);
+    // every entry that has been read, pointers into it stay valid for the life of the system
+    std::deque<GdfxFileEntry> entries;
+
+    // entries by their location on disc ((fileIndex << 32) | address), so an entry is only ever read once
+    std::map<UINT64, GdfxFileEntry*> entriesByLocation;
+
+    // directory listings that have been loaded, keyed by the directory's first sector
+    std::map<DWORD, vector<GdfxFileEntry*> > listings;
+
+    // upper cased full path -> entry, for every entry that has been read
+    std::map<string, GdfxFileEntry*> pathCache;
+
+    // the last directory sector read, the binary tree search tends to stay within one sector
+    BYTE sectorBuffer[0x800];
+    DWORD bufferedSector;
+
+    // read a directory sector into sectorBuffer
+    void ReadDirectorySector(DWORD sector);
+
+    // read the entry at the offset (in bytes) into a directory, NULL if there isn't one
+    GdfxFileEntry *ReadFileEntry(DWORD directorySector, DWORD entryOffset, const string &path);
+
+    // parse the whole listing of a directory
+    const vector<GdfxFileEntry*> &ReadFileListing(DWORD sector, DWORD size, const string &path);
+
+    // search the directory's binary tree on disc for an entry, NULL if it doesn't exist
+    GdfxFileEntry *FindFileEntry(DWORD sector, DWORD size, const string &name, const string &path);
 
-    // get a file entry from the path, must start with a /
-    GdfxFileEntry GetFileEntry(string path, vector<GdfxFileEntry> *listing);
+    // the key used for an entry in the path cache
+    static string PathKey(const string &path);
 
     // hash a 0x1000 byte block
     void HashBlock(BYTE *block, BYTE *outHash);
 };
 
-int compareFileEntries(GdfxFileEntry a, GdfxFileEntry b);
+bool compareFileEntries(const GdfxFileEntry *a, const GdfxFileEntry *b);
 
 #endif // SVOD_H
@@ -0,0 +1,147 @@
+#include "FatxAllocationTable.h"
+#include "FatxConstants.h"
+#include "FatxHelpers.h"
+
+#include <string>
+
+// the most that's written to the device at once when committing
+#define FATX_COMMIT_MAX_WRITE 0x10000
+
+FatxAllocationTable::FatxAllocationTable() : device(NULL), part(NULL)
+{
+}
+
+void FatxAllocationTable::Open(BaseIO *device, Partition *part)
+{
+    this->device = device;
+    this->part = part;
+    dirtySectors.clear();
+}
+
+UINT64 FatxAllocationTable::entryAddress(DWORD cluster)
+{
+    if (cluster > part->clusterCount)
+        throw std::string("FATX: Cluster is greater than cluster count.\n");
+
+    return part->address + 0x1000 + (UINT64)cluster * part->clusterEntrySize;
+}
+
+BYTE *FatxAllocationTable::getSector(UINT64 address, bool forWriting)
+{
+    UINT64 sectorAddress = DOWN_TO_NEAREST_SECTOR(address);
+
+    std::map<UINT64, std::vector<BYTE> >::iterator sector = dirtySectors.find(sectorAddress);
+    if (sector != dirtySectors.end())
+        return &sector->second.at(0);
+
+    if (!forWriting)
+        return NULL;
+
+    std::vector<BYTE> &data = dirtySectors[sectorAddress];
+    data.resize(FAT_SECTOR_SIZE);
+
+    try
+    {
+        device->SetPosition(sectorAddress);
+        device->ReadBytes(&data.at(0), FAT_SECTOR_SIZE);
+    }
+    catch (...)
+    {
+        dirtySectors.erase(sectorAddress);
+        throw;
+    }
+
+    return &data.at(0);
+}
+
+DWORD FatxAllocationTable::GetEntry(DWORD cluster)
+{
+    UINT64 address = entryAddress(cluster);
+
+    // the changed sectors are newer than what's on the device
+    BYTE *sector = getSector(address, false);
+    if (sector == NULL)
+    {
+        device->SetPosition(address);
+        if (part->clusterEntrySize == FAT16)
+            return device->ReadWord();
+        return device->ReadDword();
+    }
+
+    BYTE *entry = sector + (address - DOWN_TO_NEAREST_SECTOR(address));
+    if (part->clusterEntrySize == FAT16)
+        return ((DWORD)entry[0] << 8) | entry[1];
+    return ((DWORD)entry[0] << 24) | ((DWORD)entry[1] << 16) | ((DWORD)entry[2] << 8) | entry[3];
+}
+
+void FatxAllocationTable::SetEntry(DWORD cluster, DWORD value)
+{
+    UINT64 address = entryAddress(cluster);
+    BYTE *entry = getSector(address, true) + (address - DOWN_TO_NEAREST_SECTOR(address));
+
+    if (part->clusterEntrySize == FAT16)
+    {
+        entry[0] = (BYTE)(value >> 8);
+        entry[1] = (BYTE)value;
+    }
+    else
+    {
+        entry[0] = (BYTE)(value >> 24);
+        entry[1] = (BYTE)(value >> 16);
+        entry[2] = (BYTE)(value >> 8);
+        entry[3] = (BYTE)value;
+    }
+}
+
+void FatxAllocationTable::SetChain(const std::vector<DWORD> &chain)
+{
+    for (size_t i = 0; i < chain.size(); i++)
+        SetEntry(chain.at(i), (i + 1 == chain.size()) ? FAT_CLUSTER_LAST : chain.at(i + 1));
+}
+
+void FatxAllocationTable::SetAll(const std::vector<DWORD> &clusters, DWORD value)
+{
+    for (size_t i = 0; i < clusters.size(); i++)
+        SetEntry(clusters.at(i), value);
+}
+
+void FatxAllocationTable::Commit()
+{
+    if (dirtySectors.empty())
+        return;
+
+    std::vector<BYTE> run;
+    run.reserve(FATX_COMMIT_MAX_WRITE);
+
+    std::map<UINT64, std::vector<BYTE> >::iterator sector = dirtySectors.begin();
+    while (sector != dirtySectors.end())
+    {
+        // gather up the sectors that follow each other so they're written at once
+        UINT64 runAddress = sector->first;
+        run.clear();
+        while (sector != dirtySectors.end() && sector->first == runAddress + run.size() &&
+                run.size() + FAT_SECTOR_SIZE <= FATX_COMMIT_MAX_WRITE)
+        {
+            run.insert(run.end(), sector->second.begin(), sector->second.end());
+            ++sector;
+        }
+
+        device->SetPosition(runAddress);
+        device->WriteBytes(&run.at(0), run.size());
+    }
+
+    dirtySectors.clear();
+
+    // make sure the FAT is on the device before anything that points to it
+    device->Flush();
+}
+
+void FatxAllocationTable::Discard()
+{
+    dirtySectors.clear();
+}
+
+bool FatxAllocationTable::HasChanges() const
+{
+    return !dirtySectors.empty();
+}
@@ -0,0 +1,56 @@
+#ifndef FATXALLOCATIONTABLE_H
+#define FATXALLOCATIONTABLE_H
+
+#include "../winnames.h"
+#include "../IO/BaseIO.h"
+#include "XboxInternals_global.h"
+
+#include <map>
+#include <vector>
+
+struct Partition;
+
+// A partition's FAT (chainmap). Changes are made to copies of the sectors they're in, and nothing is
+// written to the device until Commit, so an operation that edits the same part of the FAT several
+// times only writes it once. Commit before writing the directory entries that point to the chains
+class XBOXINTERNALSSHARED_EXPORT FatxAllocationTable
+{
+public:
+    FatxAllocationTable();
+
+    // set the device and partition the table belongs to, must be called before anything else
+    void Open(BaseIO *device, Partition *part);
+
+    // get the entry for cluster, including changes that haven't been committed
+    DWORD GetEntry(DWORD cluster);
+
+    // set the entry for cluster
+    void SetEntry(DWORD cluster, DWORD value);
+
+    // link the clusters together in order, and mark the last one as the end of the chain
+    void SetChain(const std::vector<DWORD> &chain);
+
+    // set the entries of all the clusters to value
+    void SetAll(const std::vector<DWORD> &clusters, DWORD value);
+
+    // write the changed sectors to the device, the ones that are next to each other are written together
+    void Commit();
+
+    // throw away the changes that haven't been committed
+    void Discard();
+
+    // check if there are changes that haven't been committed
+    bool HasChanges() const;
+
+private:
+    // get the copy of the sector the address is in, reading it in if this is its first change
+    BYTE *getSector(UINT64 address, bool forWriting);
+
+    UINT64 entryAddress(DWORD cluster);
+
+    BaseIO *device;
+    Partition *part;
+    std::map<UINT64, std::vector<BYTE> > dirtySectors;
+};
+
+#endif // FATXALLOCATIONTABLE_H
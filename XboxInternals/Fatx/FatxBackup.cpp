@@ -0,0 +1,811 @@
+#include "FatxBackup.h"
+
+#include "../IO/DeviceIO.h"
+#include "../IO/MemoryIO.h"
+#include "../IO/AsyncCopy.h"
+#include "../Compression/Lz4.h"
+#include "../Threading/Thread.h"
+#include "../Cryptography/Sha1.h"
+
+#include <string.h>
+#include <algorithm>
+#include <deque>
+#include <map>
+
+// an extent read from the device, on its way to the backup file
+struct BackupJob
+{
+    DWORD sequence;
+    DWORD index;
+    DWORD length;
+    BYTE *data;
+    BYTE *compressed;
+    FatxBackupExtent extent;
+};
+
+/* The device is read on the calling thread, the extents are then hashed and compressed
+   by the workers, and the writer puts them into the backup file in the order they were read.
+   There's only a limited amount of extents in flight so the memory usage stays bounded. */
+class BackupPipeline
+{
+public:
+    BackupPipeline(FileIO *out, FatxBackup *base, std::vector<FatxBackupExtent> &extents,
+            DWORD maxInFlight) :
+        out(out), base(base), extents(extents), maxInFlight(maxInFlight), inFlight(0),
+        jobsRead(0), nextToWrite(0), doneReading(false), aborted(false)
+    {
+    }
+
+    // called by a thread that failed, so that the others don't wait forever
+    void Abort()
+    {
+        MutexLocker locker(mutex);
+        aborted = true;
+        jobReady.Broadcast();
+        jobDone.Broadcast();
+        slotFree.Broadcast();
+    }
+
+    FileIO *out;
+    FatxBackup *base;
+    std::vector<FatxBackupExtent> &extents;
+
+    Mutex mutex;
+    Condition jobReady;
+    Condition jobDone;
+    Condition slotFree;
+
+    std::deque<BackupJob*> pending;
+    std::map<DWORD, BackupJob*> finished;
+
+    DWORD maxInFlight;
+    DWORD inFlight;
+    DWORD jobsRead;
+    DWORD nextToWrite;
+    bool doneReading;
+    bool aborted;
+};
+
+class BackupWorker : public Thread
+{
+public:
+    BackupWorker(BackupPipeline *pipeline) :
+        pipeline(pipeline)
+    {
+    }
+
+protected:
+    void Run()
+    {
+        try
+        {
+            while (true)
+            {
+                BackupJob *job;
+                {
+                    MutexLocker locker(pipeline->mutex);
+                    while (pipeline->pending.empty() && !pipeline->doneReading && !pipeline->aborted)
+                        pipeline->jobReady.Wait(pipeline->mutex);
+
+                    if (pipeline->aborted || pipeline->pending.empty())
+                        return;
+
+                    job = pipeline->pending.front();
+                    pipeline->pending.pop_front();
+                }
+
+                process(job);
+
+                MutexLocker locker(pipeline->mutex);
+                pipeline->finished[job->sequence] = job;
+                pipeline->jobDone.Broadcast();
+            }
+        }
+        catch (...)
+        {
+            pipeline->Abort();
+            throw;
+        }
+    }
+
+private:
+    void process(BackupJob *job)
+    {
+        FatxBackupExtent &extent = job->extent;
+
+        Sha1::Hash(job->data, job->length, extent.hash);
+
+        // unchanged extents are left in the base backup
+        if (pipeline->base != NULL)
+        {
+            const FatxBackupExtent &baseExtent = pipeline->base->GetExtent(job->index);
+            if (baseExtent.state != FatxBackupExtentFree && memcmp(baseExtent.hash, extent.hash, 0x14) == 0)
+            {
+                extent.state = FatxBackupExtentInBase;
+                return;
+            }
+        }
+
+        // data that doesn't compress is stored as it is
+        extent.state = FatxBackupExtentStored;
+        DWORD compressedLength = Lz4::Compress(job->data, job->length, job->compressed, job->length - 1);
+        if (compressedLength != 0)
+        {
+            extent.compressed = true;
+            extent.storedLength = compressedLength;
+        }
+        else
+        {
+            extent.compressed = false;
+            extent.storedLength = job->length;
+        }
+    }
+
+    BackupPipeline *pipeline;
+};
+
+class BackupWriter : public Thread
+{
+public:
+    BackupWriter(BackupPipeline *pipeline) :
+        pipeline(pipeline)
+    {
+    }
+
+protected:
+    void Run()
+    {
+        try
+        {
+            while (true)
+            {
+                BackupJob *job;
+                {
+                    MutexLocker locker(pipeline->mutex);
+                    while (!pipeline->aborted && pipeline->finished.count(pipeline->nextToWrite) == 0 &&
+                            !(pipeline->doneReading && pipeline->nextToWrite == pipeline->jobsRead))
+                        pipeline->jobDone.Wait(pipeline->mutex);
+
+                    if (pipeline->aborted || pipeline->finished.count(pipeline->nextToWrite) == 0)
+                        return;
+
+                    std::map<DWORD, BackupJob*>::iterator it = pipeline->finished.find(pipeline->nextToWrite);
+                    job = it->second;
+                    pipeline->finished.erase(it);
+                }
+
+                FatxBackupExtent &extent = job->extent;
+                if (extent.state == FatxBackupExtentStored)
+                {
+                    extent.offset = pipeline->out->GetPosition();
+                    pipeline->out->WriteBytes(extent.compressed ? job->compressed : job->data, extent.storedLength);
+                }
+                pipeline->extents.at(job->index) = extent;
+
+                delete[] job->data;
+                delete[] job->compressed;
+                delete job;
+
+                MutexLocker locker(pipeline->mutex);
+                pipeline->nextToWrite++;
+                pipeline->inFlight--;
+                pipeline->slotFree.Signal();
+            }
+        }
+        catch (...)
+        {
+            pipeline->Abort();
+            throw;
+        }
+    }
+
+private:
+    BackupPipeline *pipeline;
+};
+
+// presents the backup as an image of the drive, so that it can be copied back with AsyncCopy
+class BackupImageIO : public BaseIO
+{
+public:
+    BackupImageIO(FatxBackup *backup) :
+        backup(backup), pos(0), cachedExtent(0xFFFFFFFF)
+    {
+        cache = new BYTE[backup->GetExtentSize()];
+    }
+
+    ~BackupImageIO()
+    {
+        delete[] cache;
+    }
+
+    void SetPosition(UINT64 position, std::ios_base::seek_dir dir = std::ios_base::beg)
+    {
+        if (dir == std::ios_base::cur)
+            position += pos;
+        else if (dir == std::ios_base::end)
+            position += Length();
+
+        pos = position;
+    }
+
+    UINT64 GetPosition()
+    {
+        return pos;
+    }
+
+    UINT64 Length()
+    {
+        return backup->GetDeviceLength();
+    }
+
+    void ReadBytes(BYTE *outBuffer, DWORD len)
+    {
+        DWORD extentSize = backup->GetExtentSize();
+
+        while (len > 0)
+        {
+            DWORD index = pos / extentSize;
+            DWORD startInExtent = pos % extentSize;
+            DWORD extentLength = backup->GetExtentLength(index);
+            DWORD toRead = (len > extentLength - startInExtent) ? extentLength - startInExtent : len;
+
+            // whole extents go straight into the caller's buffer
+            if (startInExtent == 0 && toRead == extentLength)
+                backup->ReadExtent(index, outBuffer);
+            else
+            {
+                if (cachedExtent != index)
+                {
+                    backup->ReadExtent(index, cache);
+                    cachedExtent = index;
+                }
+                memcpy(outBuffer, cache + startInExtent, toRead);
+            }
+
+            outBuffer += toRead;
+            pos += toRead;
+            len -= toRead;
+        }
+    }
+
+    void WriteBytes(BYTE *, DWORD)
+    {
+        throw std::string("FATX Backup: Backups can't be written to.\n");
+    }
+
+    void Flush()
+    {
+    }
+
+    void Close()
+    {
+    }
+
+private:
+    FatxBackup *backup;
+    UINT64 pos;
+    BYTE *cache;
+    DWORD cachedExtent;
+};
+
+FatxBackup::FatxBackup(std::string backupPath) :
+    io(NULL), base(NULL), backupPath(backupPath), compressedBuffer(NULL)
+{
+    io = new FileIO(backupPath);
+
+    try
+    {
+        readHeader();
+        openBase();
+    }
+    catch (...)
+    {
+        delete base;
+        delete io;
+        throw;
+    }
+
+    compressedBuffer = new BYTE[extentSize];
+}
+
+FatxBackup::~FatxBackup()
+{
+    delete base;
+
+    io->Close();
+    delete io;
+
+    delete[] compressedBuffer;
+}
+
+bool FatxBackup::IsFatxBackup(std::string path)
+{
+    try
+    {
+        FileIO file(path);
+        if (file.Length() < FATX_BACKUP_HEADER_SIZE)
+            return false;
+
+        file.SetPosition(0);
+        bool isBackup = (file.ReadDword() == FATX_BACKUP_MAGIC);
+        file.Close();
+
+        return isBackup;
+    }
+    catch (...)
+    {
+        return false;
+    }
+}
+
+void FatxBackup::readHeader()
+{
+    if (io->Length() < FATX_BACKUP_HEADER_SIZE)
+        throw std::string("FATX Backup: File is too small to be a backup.\n");
+
+    io->SetPosition(0);
+    if (io->ReadDword() != FATX_BACKUP_MAGIC)
+        throw std::string("FATX Backup: Invalid magic.\n");
+    if (io->ReadDword() != FATX_BACKUP_VERSION)
+        throw std::string("FATX Backup: Unsupported backup version.\n");
+
+    deviceLength = io->ReadUInt64();
+    extentSize = io->ReadDword();
+    DWORD extentCount = io->ReadDword();
+    io->ReadBytes(id, 0x14);
+    io->ReadBytes(baseId, 0x14);
+
+    if (extentSize == 0 || extentCount != (deviceLength + extentSize - 1) / extentSize)
+        throw std::string("FATX Backup: Invalid extent table.\n");
+
+    WORD pathLength = io->ReadWord();
+    if (pathLength > FATX_BACKUP_MAX_PATH)
+        throw std::string("FATX Backup: Invalid base backup path.\n");
+    basePath = io->ReadString(pathLength);
+
+    // read the whole table at once rather than an entry at a time
+    DWORD tableSize = extentCount * FATX_BACKUP_ENTRY_SIZE;
+    if (io->Length() < FATX_BACKUP_HEADER_SIZE + (UINT64)tableSize)
+        throw std::string("FATX Backup: Extent table is truncated.\n");
+
+    BYTE *table = new BYTE[tableSize];
+    try
+    {
+        io->SetPosition(FATX_BACKUP_HEADER_SIZE);
+        io->ReadBytes(table, tableSize);
+    }
+    catch (...)
+    {
+        delete[] table;
+        throw;
+    }
+
+    MemoryIO tableIO(table, tableSize);
+    tableIO.SetPosition(0);
+    extents.resize(extentCount);
+    for (DWORD i = 0; i < extentCount; i++)
+    {
+        FatxBackupExtent &extent = extents.at(i);
+        extent.state = tableIO.ReadByte();
+        extent.compressed = (tableIO.ReadByte() != 0);
+        tableIO.ReadWord();
+        extent.storedLength = tableIO.ReadDword();
+        extent.offset = tableIO.ReadUInt64();
+        tableIO.ReadBytes(extent.hash, 0x14);
+
+        if (extent.state > FatxBackupExtentInBase || extent.storedLength > extentSize)
+        {
+            delete[] table;
+            throw std::string("FATX Backup: Invalid extent table.\n");
+        }
+    }
+
+    delete[] table;
+}
+
+void FatxBackup::openBase()
+{
+    if (basePath.empty())
+        return;
+
+    // the backups may have been moved together, so also look in this backup's folder
+    std::string path = basePath;
+    if (!IsFatxBackup(path))
+    {
+        size_t nameStart = basePath.find_last_of("/\\");
+        size_t folderEnd = backupPath.find_last_of("/\\");
+        std::string name = (nameStart == std::string::npos) ? basePath : basePath.substr(nameStart + 1);
+        path = (folderEnd == std::string::npos) ? name : backupPath.substr(0, folderEnd + 1) + name;
+
+        if (!IsFatxBackup(path))
+            throw std::string("FATX Backup: Could not find the backup this one is based on, " + basePath +
+                    ".\n");
+    }
+
+    base = new FatxBackup(path);
+
+    if (memcmp(base->GetId(), baseId, 0x14) != 0 || base->GetDeviceLength() != deviceLength ||
+            base->GetExtentSize() != extentSize)
+        throw std::string("FATX Backup: The backup this one is based on has been changed.\n");
+}
+
+void FatxBackup::Create(BaseIO *device, std::string outPath,
+        const std::vector<FatxBackupRange> &freeRanges, std::string basePath,
+        void(*progress)(void*, DWORD, DWORD), void *arg)
+{
+    if (basePath.size() > FATX_BACKUP_MAX_PATH)
+        throw std::string("FATX Backup: Base backup path is too long.\n");
+
+    UINT64 deviceLength = device->Length();
+    DWORD extentSize = FATX_BACKUP_EXTENT_SIZE;
+    DWORD extentCount = (deviceLength + extentSize - 1) / extentSize;
+
+    // open the base first, there's no point in reading the drive if it's unusable
+    FatxBackup *base = NULL;
+    if (!basePath.empty())
+    {
+        base = new FatxBackup(basePath);
+        if (base->GetDeviceLength() != deviceLength || base->GetExtentSize() != extentSize)
+        {
+            delete base;
+            throw std::string("FATX Backup: The base backup is of a different device.\n");
+        }
+    }
+
+    std::vector<FatxBackupExtent> extents(extentCount);
+    for (DWORD i = 0; i < extentCount; i++)
+    {
+        extents.at(i).state = FatxBackupExtentFree;
+        extents.at(i).compressed = false;
+        extents.at(i).storedLength = 0;
+        extents.at(i).offset = 0;
+        memset(extents.at(i).hash, 0, 0x14);
+    }
+
+    DWORD tableSize = extentCount * FATX_BACKUP_ENTRY_SIZE;
+    FileIO *out = NULL;
+    std::string error;
+
+    DWORD workerCount = Thread::HardwareConcurrency();
+    BackupPipeline pipeline(NULL, base, extents, workerCount * 4);
+    std::vector<BackupWorker*> workers;
+    BackupWriter writer(&pipeline);
+
+    try
+    {
+        out = new FileIO(outPath, true);
+        pipeline.out = out;
+
+        // the header and extent table are filled in once everything has been written
+        BYTE *zeroes = new BYTE[0x10000];
+        memset(zeroes, 0, 0x10000);
+        for (UINT64 left = FATX_BACKUP_HEADER_SIZE + (UINT64)tableSize; left > 0; )
+        {
+            DWORD len = (left > 0x10000) ? 0x10000 : (DWORD)left;
+            out->WriteBytes(zeroes, len);
+            left -= len;
+        }
+        delete[] zeroes;
+
+        for (DWORD i = 0; i < workerCount; i++)
+        {
+            workers.push_back(new BackupWorker(&pipeline));
+            workers.back()->Start();
+        }
+        writer.Start();
+
+        DeviceIO *image = dynamic_cast<DeviceIO*>(device);
+        if (image != NULL && !image->IsImage())
+            image = NULL;
+
+        std::vector<FatxBackupRange>::const_iterator freeRange = freeRanges.begin();
+        for (DWORD i = 0; i < extentCount; i++)
+        {
+            UINT64 address = (UINT64)i * extentSize;
+            DWORD length = (deviceLength - address > extentSize) ? extentSize : (DWORD)(deviceLength - address);
+
+            // skip the extents that only hold free clusters
+            while (freeRange != freeRanges.end() && freeRange->address + freeRange->length <= address)
+                ++freeRange;
+            if (freeRange != freeRanges.end() && freeRange->address <= address &&
+                    freeRange->address + freeRange->length >= address + length)
+            {
+                if (progress && (i & 0x3F) == 0)
+                    progress(arg, i, extentCount);
+                continue;
+            }
+
+            {
+                MutexLocker locker(pipeline.mutex);
+                while (pipeline.inFlight >= pipeline.maxInFlight && !pipeline.aborted)
+                    pipeline.slotFree.Wait(pipeline.mutex);
+
+                if (pipeline.aborted)
+                    break;
+            }
+
+            BackupJob *job = new BackupJob;
+            job->index = i;
+            job->length = length;
+            job->data = new BYTE[length];
+            job->compressed = new BYTE[length];
+            job->extent = extents.at(i);
+
+            try
+            {
+                // the holes in a sparse image read back as zeroes, so there's no need to read them
+                if (image != NULL && image->InHole(address, length))
+                    memset(job->data, 0, length);
+                else
+                {
+                    device->SetPosition(address);
+                    device->ReadBytes(job->data, length);
+                }
+            }
+            catch (...)
+            {
+                delete[] job->data;
+                delete[] job->compressed;
+                delete job;
+                throw;
+            }
+
+            {
+                MutexLocker locker(pipeline.mutex);
+                job->sequence = pipeline.jobsRead++;
+                pipeline.inFlight++;
+                pipeline.pending.push_back(job);
+                pipeline.jobReady.Signal();
+            }
+
+            if (progress)
+                progress(arg, i, extentCount);
+        }
+
+        {
+            MutexLocker locker(pipeline.mutex);
+            pipeline.doneReading = true;
+            pipeline.jobReady.Broadcast();
+            pipeline.jobDone.Broadcast();
+        }
+    }
+    catch (std::string readError)
+    {
+        error = readError;
+        pipeline.Abort();
+    }
+    catch (...)
+    {
+        pipeline.Abort();
+    }
+
+    // wait for everything to be written, keeping the first error that happened
+    bool failed = pipeline.aborted;
+    for (size_t i = 0; i < workers.size(); i++)
+    {
+        try
+        {
+            workers.at(i)->Join();
+        }
+        catch (std::string workerError)
+        {
+            if (error.empty())
+                error = workerError;
+        }
+        delete workers.at(i);
+    }
+    try
+    {
+        writer.Join();
+    }
+    catch (std::string writerError)
+    {
+        if (error.empty())
+            error = writerError;
+    }
+
+    // free whatever didn't make it into the backup
+    for (size_t i = 0; i < pipeline.pending.size(); i++)
+    {
+        delete[] pipeline.pending.at(i)->data;
+        delete[] pipeline.pending.at(i)->compressed;
+        delete pipeline.pending.at(i);
+    }
+    for (std::map<DWORD, BackupJob*>::iterator it = pipeline.finished.begin(); it != pipeline.finished.end(); ++it)
+    {
+        delete[] it->second->data;
+        delete[] it->second->compressed;
+        delete it->second;
+    }
+
+    if (failed || pipeline.aborted)
+    {
+        delete base;
+        if (out != NULL)
+        {
+            out->Close();
+            delete out;
+        }
+
+        if (error.empty())
+            error = "FATX Backup: Failed to create the backup.\n";
+        throw error;
+    }
+
+    // Write the extent table
+    BYTE *table = new BYTE[tableSize];
+    MemoryIO tableIO(table, tableSize);
+    tableIO.SetPosition(0);
+    for (DWORD i = 0; i < extentCount; i++)
+        writeExtentEntry(&tableIO, extents.at(i));
+
+    BYTE backupId[0x14];
+    calculateId(extents, backupId);
+
+    BYTE baseBackupId[0x14];
+    memset(baseBackupId, 0, 0x14);
+    if (base != NULL)
+        memcpy(baseBackupId, base->GetId(), 0x14);
+    delete base;
+
+    try
+    {
+        out->SetPosition(0);
+        out->Write((DWORD)FATX_BACKUP_MAGIC);
+        out->Write((DWORD)FATX_BACKUP_VERSION);
+        out->Write(deviceLength);
+        out->Write(extentSize);
+        out->Write(extentCount);
+        out->WriteBytes(backupId, 0x14);
+        out->WriteBytes(baseBackupId, 0x14);
+        out->Write((WORD)basePath.size());
+        out->Write(basePath, -1, false);
+
+        out->SetPosition(FATX_BACKUP_HEADER_SIZE);
+        out->WriteBytes(table, tableSize);
+        out->Flush();
+    }
+    catch (...)
+    {
+        delete[] table;
+        out->Close();
+        delete out;
+        throw;
+    }
+
+    delete[] table;
+    out->Close();
+    delete out;
+
+    if (progress)
+        progress(arg, extentCount, extentCount);
+}
+
+void FatxBackup::Restore(BaseIO *device, void(*progress)(void*, DWORD, DWORD), void *arg)
+{
+    if (device->Length() < deviceLength)
+        throw std::string("FATX Backup: The device is smaller than the one that was backed up.\n");
+
+    // only the extents that were backed up are written, merged into runs
+    std::vector<CopyRange> ranges;
+    for (DWORD i = 0; i < extents.size(); i++)
+    {
+        if (extents.at(i).state == FatxBackupExtentFree)
+            continue;
+
+        UINT64 address = (UINT64)i * extentSize;
+        if (!ranges.empty() && ranges.back().sourceOffset + ranges.back().len == address)
+            ranges.back().len += GetExtentLength(i);
+        else
+        {
+            CopyRange range = { address, address, GetExtentLength(i) };
+            ranges.push_back(range);
+        }
+    }
+
+    // the extents are decompressed and verified on the reading thread, while the device is written
+    BackupImageIO image(this);
+    AsyncCopy copy(&image, device, extentSize);
+    copy.Copy(ranges, progress, arg);
+
+    device->Flush();
+
+    if (ranges.empty() && progress)
+        progress(arg, 1, 1);
+}
+
+void FatxBackup::ReadExtent(DWORD index, BYTE *outBuffer)
+{
+    const FatxBackupExtent &extent = extents.at(index);
+    DWORD length = GetExtentLength(index);
+
+    switch (extent.state)
+    {
+        case FatxBackupExtentFree:
+            throw std::string("FATX Backup: Extent wasn't backed up.\n");
+
+        case FatxBackupExtentInBase:
+            if (base == NULL)
+                throw std::string("FATX Backup: Extent is in a base backup, but there isn't one.\n");
+            base->ReadExtent(index, outBuffer);
+            return;
+    }
+
+    io->SetPosition(extent.offset);
+    if (extent.compressed)
+    {
+        io->ReadBytes(compressedBuffer, extent.storedLength);
+        Lz4::Decompress(compressedBuffer, extent.storedLength, outBuffer, length);
+    }
+    else
+    {
+        if (extent.storedLength != length)
+            throw std::string("FATX Backup: Invalid extent length.\n");
+        io->ReadBytes(outBuffer, length);
+    }
+
+    // make sure that nothing is restored from a damaged backup
+    BYTE hash[0x14];
+    Sha1::Hash(outBuffer, length, hash);
+
+    if (memcmp(hash, extent.hash, 0x14) != 0)
+        throw std::string("FATX Backup: Extent hash mismatch, the backup is corrupt.\n");
+}
+
+DWORD FatxBackup::GetExtentLength(DWORD index)
+{
+    UINT64 address = (UINT64)index * extentSize;
+    return (deviceLength - address > extentSize) ? extentSize : (DWORD)(deviceLength - address);
+}
+
+const FatxBackupExtent &FatxBackup::GetExtent(DWORD index)
+{
+    return extents.at(index);
+}
+
+DWORD FatxBackup::GetExtentCount()
+{
+    return extents.size();
+}
+
+DWORD FatxBackup::GetExtentSize()
+{
+    return extentSize;
+}
+
+UINT64 FatxBackup::GetDeviceLength()
+{
+    return deviceLength;
+}
+
+std::string FatxBackup::GetBasePath()
+{
+    return basePath;
+}
+
+const BYTE *FatxBackup::GetId()
+{
+    return id;
+}
+
+void FatxBackup::calculateId(const std::vector<FatxBackupExtent> &extents, BYTE *outId)
+{
+    Sha1 sha1;
+    for (size_t i = 0; i < extents.size(); i++)
+    {
+        BYTE used = (extents.at(i).state != FatxBackupExtentFree);
+        sha1.Update(&used, 1);
+        sha1.Update(extents.at(i).hash, 0x14);
+    }
+    sha1.Final(outId);
+}
+
+void FatxBackup::writeExtentEntry(BaseIO *io, const FatxBackupExtent &extent)
+{
+    io->Write(extent.state);
+    io->Write((BYTE)(extent.compressed ? 1 : 0));
+    io->Write((WORD)0);
+    io->Write(extent.storedLength);
+    io->Write(extent.offset);
+    io->WriteBytes((BYTE*)extent.hash, 0x14);
+}
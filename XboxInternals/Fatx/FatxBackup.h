@@ -0,0 +1,117 @@
+#ifndef FATXBACKUP_H
+#define FATXBACKUP_H
+
+#include "../IO/BaseIO.h"
+#include "../IO/FileIO.h"
+#include "XboxInternals_global.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#define FATX_BACKUP_MAGIC           0x46424B50  // FBKP
+#define FATX_BACKUP_VERSION         1
+
+// the drive is backed up in pieces of this size, each one is hashed and compressed on its own
+#define FATX_BACKUP_EXTENT_SIZE     0x100000
+
+// the header is followed by the extent table, and then the data of the stored extents
+#define FATX_BACKUP_HEADER_SIZE     0x400
+#define FATX_BACKUP_ENTRY_SIZE      0x24
+#define FATX_BACKUP_MAX_PATH        (FATX_BACKUP_HEADER_SIZE - 0x42)
+
+enum FatxBackupExtentState
+{
+    // the extent only holds free clusters, nothing was stored for it
+    FatxBackupExtentFree = 0,
+
+    // the extent's data is stored in this backup
+    FatxBackupExtentStored = 1,
+
+    // the extent hasn't changed since the base backup, its data is in there
+    FatxBackupExtentInBase = 2
+};
+
+struct FatxBackupExtent
+{
+    BYTE state;
+    bool compressed;
+    DWORD storedLength;
+    UINT64 offset;
+    BYTE hash[0x14];
+};
+
+// a range of bytes on the device that doesn't need to be backed up
+struct FatxBackupRange
+{
+    UINT64 address;
+    UINT64 length;
+};
+
+class XBOXINTERNALSSHARED_EXPORT FatxBackup
+{
+public:
+    // open an existing backup, along with the backups it's based on
+    FatxBackup(std::string backupPath);
+    ~FatxBackup();
+
+    // check whether the file is one of these backups rather than a raw image of the drive
+    static bool IsFatxBackup(std::string path);
+
+    /* Back up the device to outPath, the extents that are completely covered by the free
+       ranges (sorted by address) are skipped. When a base backup is given, only the extents
+       whose hashes don't match the ones in it are stored. */
+    static void Create(BaseIO *device, std::string outPath,
+            const std::vector<FatxBackupRange> &freeRanges, std::string basePath = "",
+            void(*progress)(void*, DWORD, DWORD) = NULL, void *arg = NULL);
+
+    // Write all of the recorded extents back to the device, free extents are left alone
+    void Restore(BaseIO *device, void(*progress)(void*, DWORD, DWORD) = NULL, void *arg = NULL);
+
+    // read the contents of an extent, from the base backups if needed
+    void ReadExtent(DWORD index, BYTE *outBuffer);
+
+    // get the length of an extent, only the last one can be shorter than the extent size
+    DWORD GetExtentLength(DWORD index);
+
+    const FatxBackupExtent &GetExtent(DWORD index);
+
+    DWORD GetExtentCount();
+
+    DWORD GetExtentSize();
+
+    UINT64 GetDeviceLength();
+
+    // get the path of the backup this one is based on, empty if it's a full backup
+    std::string GetBasePath();
+
+    // get the hash that identifies the contents of this backup
+    const BYTE *GetId();
+
+private:
+    void readHeader();
+
+    // open the base backup, looking next to this one if it was moved
+    void openBase();
+
+    // the id is the hash of the extent hashes, so it only depends on what was backed up
+    static void calculateId(const std::vector<FatxBackupExtent> &extents, BYTE *outId);
+
+    static void writeExtentEntry(BaseIO *io, const FatxBackupExtent &extent);
+
+    FileIO *io;
+    FatxBackup *base;
+
+    std::string backupPath;
+    std::string basePath;
+    UINT64 deviceLength;
+    DWORD extentSize;
+    BYTE id[0x14];
+    BYTE baseId[0x14];
+    std::vector<FatxBackupExtent> extents;
+
+    // holds the compressed data of an extent while it's being read
+    BYTE *compressedBuffer;
+};
+
+#endif // FATXBACKUP_H
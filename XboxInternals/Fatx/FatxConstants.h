@@ -7,7 +7,11 @@
 #include "../winnames.h"
 
 #include "../Stfs/StfsDefinitions.h"
+#include "FatxFreeSpace.h"
+#include "FatxAllocationTable.h"
+#include "FatxLookup.h"
 
+#include <deque>
 #include <vector>
 #include <iostream>
 
@@ -87,9 +91,14 @@ struct FatxFileEntry
     bool readDirectories;
     INT64 address;
     DWORD magic;
-    std::vector<FatxFileEntry> cachedFiles;
+
+    // entries are never moved once they're in a folder, so pointers to them stay good
+    std::deque<FatxFileEntry> cachedFiles;
+    FatxNameIndex childIndex;
     std::vector<DWORD> clusterChain;
-    std::string path;
+
+    // the folder the entry is in, NULL for the root of a partition
+    FatxFileEntry *parent;
 };
 
 struct Partition
@@ -117,7 +126,13 @@ struct Partition
     DWORD fatEntryShift;
     UINT64 allocationTableSize;
     UINT64 freeMemory;
-    std::vector<DWORD> freeClusters;
+    FatxFreeSpace freeClusters;
+
+    // whether the FAT's been scanned for the free clusters yet, a full partition has none
+    bool freeMemoryCounted;
+
+    // changes to the FAT are made through this so they can be written together
+    FatxAllocationTable allocationTable;
 };
 
 enum FatxDirentAttributes
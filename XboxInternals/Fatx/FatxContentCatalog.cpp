@@ -0,0 +1,437 @@
+#include "FatxContentCatalog.h"
+#include "FatxDrive.h"
+#include "../IO/MemoryIO.h"
+#include "../Stfs/XContentHeader.h"
+
+#include <algorithm>
+#include <cwctype>
+
+class FatxCatalogWorker : public Thread
+{
+public:
+    FatxCatalogWorker(FatxContentCatalog *catalog) :
+        catalog(catalog)
+    {
+    }
+
+protected:
+    void Run()
+    {
+        FatxContentCatalog::HeaderJob *job;
+        while (catalog->takeJob(&job))
+        {
+            FatxContentCatalog::parseHeader(job->header, catalog->files->at(job->index),
+                    &catalog->parsed->at(job->index));
+            delete job;
+        }
+    }
+
+private:
+    FatxContentCatalog *catalog;
+};
+
+FatxContentCatalog::FatxContentCatalog(FatxDrive *drive, BaseIO *device, Partition *part,
+        DWORD workerCount) :
+    drive(drive), device(device), part(part), workerCount(workerCount), doneReading(false),
+    files(NULL), parsed(NULL)
+{
+    if (this->workerCount == 0)
+        this->workerCount = Thread::HardwareConcurrency();
+}
+
+static bool compareStartingClusters(FatxFileEntry *a, FatxFileEntry *b)
+{
+    return a->startingCluster < b->startingCluster;
+}
+
+void FatxContentCatalog::Build(void(*progress)(void*, DWORD, DWORD), void *arg)
+{
+    std::vector<FatxFileEntry*> files;
+    collectFiles(&part->root, files);
+
+    // read the headers in the order they're on the device, so the reads are mostly sequential
+    std::sort(files.begin(), files.end(), compareStartingClusters);
+
+    std::vector<ParsedHeader> parsed(files.size());
+    DWORD workers = (workerCount < files.size()) ? workerCount : files.size();
+
+    if (workers <= 1)
+    {
+        std::vector<BYTE> header;
+        for (DWORD i = 0; i < files.size(); i++)
+        {
+            readHeader(files.at(i), header);
+            parseHeader(header, files.at(i), &parsed.at(i));
+
+            if (progress)
+                progress(arg, i + 1, files.size());
+        }
+    }
+    else
+    {
+        this->files = &files;
+        this->parsed = &parsed;
+        doneReading = false;
+
+        std::vector<FatxCatalogWorker*> pool;
+        for (DWORD i = 0; i < workers; i++)
+        {
+            pool.push_back(new FatxCatalogWorker(this));
+            pool.back()->Start();
+        }
+
+        // the device can only be used from one thread, so the headers are all read on this one
+        std::string error;
+        bool failed = false;
+        try
+        {
+            for (DWORD i = 0; i < files.size(); i++)
+            {
+                HeaderJob *job = new HeaderJob;
+                job->index = i;
+                try
+                {
+                    readHeader(files.at(i), job->header);
+                }
+                catch (...)
+                {
+                    delete job;
+                    throw;
+                }
+
+                {
+                    MutexLocker locker(queueMutex);
+                    while (queue.size() >= workers * FATX_CATALOG_QUEUE_DEPTH)
+                        jobTaken.Wait(queueMutex);
+
+                    queue.push_back(job);
+                    jobReady.Signal();
+                }
+
+                if (progress)
+                    progress(arg, i + 1, files.size());
+            }
+        }
+        catch (std::string readError)
+        {
+            failed = true;
+            error = readError;
+        }
+        catch (...)
+        {
+            failed = true;
+            error = "FATX: Error reading the package headers.\n";
+        }
+
+        // let the workers finish what's left in the queue and stop
+        {
+            MutexLocker locker(queueMutex);
+            doneReading = true;
+            jobReady.Broadcast();
+        }
+
+        for (DWORD i = 0; i < pool.size(); i++)
+        {
+            try
+            {
+                pool.at(i)->Join();
+            }
+            catch (std::string workerError)
+            {
+                if (!failed)
+                    error = workerError;
+                failed = true;
+            }
+            delete pool.at(i);
+        }
+
+        this->files = NULL;
+        this->parsed = NULL;
+
+        if (failed)
+            throw error;
+    }
+
+    WriteLocker locker(lock);
+    entries.clear();
+    byTitle.clear();
+    byContentType.clear();
+    byProfile.clear();
+
+    for (DWORD i = 0; i < parsed.size(); i++)
+        if (parsed.at(i).valid)
+            addEntry(parsed.at(i).entry);
+}
+
+bool FatxContentCatalog::Update(FatxFileEntry *entry)
+{
+    std::string path = FatxDrive::GetFolderPath(entry) + entry->name;
+
+    ParsedHeader parsed;
+    parsed.valid = false;
+
+    if (!(entry->fileAttributes & FatxDirectory) && entry->nameLen != FATX_ENTRY_DELETED &&
+            entry->fileSize >= FATX_CATALOG_MIN_PACKAGE_SIZE)
+    {
+        std::vector<BYTE> header;
+        readHeader(entry, header);
+        parseHeader(header, entry, &parsed);
+    }
+
+    WriteLocker locker(lock);
+    std::map<std::string, FatxCatalogEntry>::iterator existing = entries.find(path);
+    if (existing != entries.end())
+        removeEntry(existing);
+
+    if (parsed.valid)
+        addEntry(parsed.entry);
+    return parsed.valid;
+}
+
+void FatxContentCatalog::Remove(std::string path)
+{
+    WriteLocker locker(lock);
+
+    std::map<std::string, FatxCatalogEntry>::iterator entry = entries.find(path);
+    if (entry != entries.end())
+        removeEntry(entry);
+
+    // everything in the folder starts with its path
+    std::string folderPath = path + "\\";
+    entry = entries.lower_bound(folderPath);
+    while (entry != entries.end() && entry->first.compare(0, folderPath.size(), folderPath) == 0)
+    {
+        std::map<std::string, FatxCatalogEntry>::iterator next = entry;
+        ++next;
+        removeEntry(entry);
+        entry = next;
+    }
+}
+
+bool FatxContentCatalog::Find(std::string path, FatxCatalogEntry *outEntry)
+{
+    ReadLocker locker(lock);
+
+    std::map<std::string, FatxCatalogEntry>::iterator entry = entries.find(path);
+    if (entry == entries.end())
+        return false;
+
+    *outEntry = entry->second;
+    return true;
+}
+
+std::vector<FatxCatalogEntry> FatxContentCatalog::FindByTitle(DWORD titleID)
+{
+    return findInIndex(byTitle, titleID);
+}
+
+std::vector<FatxCatalogEntry> FatxContentCatalog::FindByContentType(ContentType contentType)
+{
+    return findInIndex(byContentType, (DWORD)contentType);
+}
+
+std::vector<FatxCatalogEntry> FatxContentCatalog::FindByProfile(UINT64 profileID)
+{
+    return findInIndex(byProfile, profileID);
+}
+
+static std::wstring toLower(std::wstring text)
+{
+    for (size_t i = 0; i < text.size(); i++)
+        text.at(i) = towlower(text.at(i));
+    return text;
+}
+
+std::vector<FatxCatalogEntry> FatxContentCatalog::Search(std::wstring text)
+{
+    ReadLocker locker(lock);
+
+    text = toLower(text);
+
+    std::vector<FatxCatalogEntry> found;
+    std::map<std::string, FatxCatalogEntry>::iterator entry;
+    for (entry = entries.begin(); entry != entries.end(); ++entry)
+    {
+        if (toLower(entry->second.displayName).find(text) != std::wstring::npos ||
+                toLower(entry->second.titleName).find(text) != std::wstring::npos)
+            found.push_back(entry->second);
+    }
+
+    return found;
+}
+
+std::vector<FatxCatalogEntry> FatxContentCatalog::GetEntries()
+{
+    ReadLocker locker(lock);
+
+    std::vector<FatxCatalogEntry> all;
+    all.reserve(entries.size());
+
+    std::map<std::string, FatxCatalogEntry>::iterator entry;
+    for (entry = entries.begin(); entry != entries.end(); ++entry)
+        all.push_back(entry->second);
+
+    return all;
+}
+
+DWORD FatxContentCatalog::Count()
+{
+    ReadLocker locker(lock);
+    return entries.size();
+}
+
+Partition *FatxContentCatalog::GetPartition()
+{
+    return part;
+}
+
+void FatxContentCatalog::collectFiles(FatxFileEntry *folder, std::vector<FatxFileEntry*> &files)
+{
+    drive->GetChildFileEntries(folder);
+
+    for (size_t i = 0; i < folder->cachedFiles.size(); i++)
+    {
+        FatxFileEntry *entry = &folder->cachedFiles.at(i);
+        if (entry->nameLen == FATX_ENTRY_DELETED)
+            continue;
+
+        if (entry->fileAttributes & FatxDirectory)
+            collectFiles(entry, files);
+        else if (entry->fileSize >= FATX_CATALOG_MIN_PACKAGE_SIZE)
+            files.push_back(entry);
+    }
+}
+
+void FatxContentCatalog::readHeader(FatxFileEntry *file, std::vector<BYTE> &outHeader)
+{
+    if (file->clusterChain.size() == 0)
+        drive->ReadClusterChain(file);
+
+    DWORD length = (file->fileSize < FATX_CATALOG_HEADER_SIZE) ? file->fileSize : FATX_CATALOG_HEADER_SIZE;
+    outHeader.resize(length);
+
+    // the header's usually in consecutive clusters, so it only takes one read
+    DWORD read = 0;
+    for (size_t i = 0; i < file->clusterChain.size() && read < length; )
+    {
+        DWORD runLength = 1;
+        while (i + runLength < file->clusterChain.size() &&
+                file->clusterChain.at(i + runLength) == file->clusterChain.at(i) + runLength)
+            runLength++;
+
+        UINT64 runBytes = (UINT64)runLength * part->clusterSize;
+        DWORD toRead = (runBytes < length - read) ? (DWORD)runBytes : length - read;
+
+        device->SetPosition(FatxIO::ClusterToOffset(part, file->clusterChain.at(i)));
+        device->ReadBytes(&outHeader.at(read), toRead);
+
+        read += toRead;
+        i += runLength;
+    }
+
+    // the chain's shorter than the file says it is
+    outHeader.resize(read);
+}
+
+void FatxContentCatalog::parseHeader(std::vector<BYTE> &header, FatxFileEntry *file,
+        ParsedHeader *outParsed)
+{
+    outParsed->valid = false;
+    if (header.size() < FATX_CATALOG_MIN_PACKAGE_SIZE)
+        return;
+
+    // don't bother with anything that's not a package
+    DWORD magic = ((DWORD)header.at(0) << 24) | ((DWORD)header.at(1) << 16) |
+            ((DWORD)header.at(2) << 8) | header.at(3);
+    if (magic != CON && magic != LIVE && magic != PIRS)
+        return;
+
+    try
+    {
+        MemoryIO io(&header.at(0), header.size());
+        XContentHeader metadata(&io);
+
+        FatxCatalogEntry &entry = outParsed->entry;
+        entry.path = FatxDrive::GetFolderPath(file) + file->name;
+        entry.magic = metadata.magic;
+        entry.titleID = metadata.titleID;
+        entry.contentType = metadata.contentType;
+        entry.displayName = metadata.displayName;
+        entry.titleName = metadata.titleName;
+        entry.size = file->fileSize;
+
+        entry.profileID = 0;
+        for (int i = 0; i < 8; i++)
+            entry.profileID = (entry.profileID << 8) | metadata.profileID[i];
+
+        outParsed->valid = true;
+    }
+    catch (...)
+    {
+        // a corrupt header, it's left out of the catalog
+    }
+}
+
+void FatxContentCatalog::addEntry(const FatxCatalogEntry &entry)
+{
+    entries[entry.path] = entry;
+    byTitle.insert(std::make_pair(entry.titleID, entry.path));
+    byContentType.insert(std::make_pair((DWORD)entry.contentType, entry.path));
+    byProfile.insert(std::make_pair(entry.profileID, entry.path));
+}
+
+void FatxContentCatalog::removeEntry(std::map<std::string, FatxCatalogEntry>::iterator entry)
+{
+    removeFromIndex(byTitle, entry->second.titleID, entry->first);
+    removeFromIndex(byContentType, (DWORD)entry->second.contentType, entry->first);
+    removeFromIndex(byProfile, entry->second.profileID, entry->first);
+    entries.erase(entry);
+}
+
+template <typename Key>
+void FatxContentCatalog::removeFromIndex(std::multimap<Key, std::string> &index, Key key,
+        const std::string &path)
+{
+    typedef typename std::multimap<Key, std::string>::iterator Iterator;
+
+    std::pair<Iterator, Iterator> range = index.equal_range(key);
+    for (Iterator i = range.first; i != range.second; ++i)
+    {
+        if (i->second == path)
+        {
+            index.erase(i);
+            return;
+        }
+    }
+}
+
+template <typename Key>
+std::vector<FatxCatalogEntry> FatxContentCatalog::findInIndex(std::multimap<Key, std::string> &index,
+        Key key)
+{
+    typedef typename std::multimap<Key, std::string>::iterator Iterator;
+
+    ReadLocker locker(lock);
+
+    std::vector<FatxCatalogEntry> found;
+    std::pair<Iterator, Iterator> range = index.equal_range(key);
+    for (Iterator i = range.first; i != range.second; ++i)
+        found.push_back(entries.find(i->second)->second);
+
+    return found;
+}
+
+bool FatxContentCatalog::takeJob(HeaderJob **outJob)
+{
+    MutexLocker locker(queueMutex);
+    while (queue.empty() && !doneReading)
+        jobReady.Wait(queueMutex);
+
+    if (queue.empty())
+        return false;
+
+    *outJob = queue.front();
+    queue.pop_front();
+    jobTaken.Signal();
+    return true;
+}
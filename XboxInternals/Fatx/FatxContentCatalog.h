@@ -0,0 +1,147 @@
+#ifndef FATXCONTENTCATALOG_H
+#define FATXCONTENTCATALOG_H
+
+#include "../winnames.h"
+#include "../IO/BaseIO.h"
+#include "../Stfs/StfsConstants.h"
+#include "../Threading/Thread.h"
+#include "FatxConstants.h"
+#include "XboxInternals_global.h"
+
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+// the most of a package that's read in to parse its header, the metadata and thumbnails all fit in it
+#define FATX_CATALOG_HEADER_SIZE 0xC000
+
+// files smaller than this can't hold a full header, so they aren't read in at all
+#define FATX_CATALOG_MIN_PACKAGE_SIZE 0x971A
+
+// how many headers can be waiting to be parsed for each worker
+#define FATX_CATALOG_QUEUE_DEPTH 8
+
+class FatxDrive;
+
+struct FatxCatalogEntry
+{
+    // the full path to the package on the drive
+    std::string path;
+
+    Magic magic;
+    DWORD titleID;
+    ContentType contentType;
+    std::wstring displayName;
+    std::wstring titleName;
+
+    // the size of the package file, not counting its data files
+    UINT64 size;
+
+    // the profile the content belongs to, 0 if it isn't tied to one
+    UINT64 profileID;
+};
+
+/* An index of the headers of every package on a partition. Building it reads the start of each
+   package in a single request, in the order they are on the device, while a pool of workers
+   parses the headers that have already been read. Once it's built it can be kept up to date by
+   updating and removing single entries, which FatxDrive does when it injects or removes a file. */
+class XBOXINTERNALSSHARED_EXPORT FatxContentCatalog
+{
+public:
+    // a workerCount of 0 uses one for each core
+    FatxContentCatalog(FatxDrive *drive, BaseIO *device, Partition *part, DWORD workerCount = 0);
+
+    // read in every package on the partition, the progress is the number of files read
+    void Build(void(*progress)(void*, DWORD, DWORD) = NULL, void *arg = NULL);
+
+    // read the header of the file and add it to the catalog, or replace what was there. If it's not
+    // a package anything at its path is removed, and false is returned
+    bool Update(FatxFileEntry *entry);
+
+    // remove the package at path, or every package in it if it's a folder
+    void Remove(std::string path);
+
+    // get the package at path, false if it's not in the catalog
+    bool Find(std::string path, FatxCatalogEntry *outEntry);
+
+    std::vector<FatxCatalogEntry> FindByTitle(DWORD titleID);
+
+    std::vector<FatxCatalogEntry> FindByContentType(ContentType contentType);
+
+    std::vector<FatxCatalogEntry> FindByProfile(UINT64 profileID);
+
+    // get the packages whose display or title name contain text, ignoring case
+    std::vector<FatxCatalogEntry> Search(std::wstring text);
+
+    // get all of the packages, sorted by path
+    std::vector<FatxCatalogEntry> GetEntries();
+
+    DWORD Count();
+
+    Partition *GetPartition();
+
+private:
+    // a header that's been read in and is waiting to be parsed
+    struct HeaderJob
+    {
+        DWORD index;
+        std::vector<BYTE> header;
+    };
+
+    struct ParsedHeader
+    {
+        bool valid;
+        FatxCatalogEntry entry;
+    };
+
+    // add all of the files under folder that could be packages to files
+    void collectFiles(FatxFileEntry *folder, std::vector<FatxFileEntry*> &files);
+
+    // read the start of the file from the device, as few reads as possible are made
+    void readHeader(FatxFileEntry *file, std::vector<BYTE> &outHeader);
+
+    // parse the header that was read in, the entry is invalid if it's not a package
+    static void parseHeader(std::vector<BYTE> &header, FatxFileEntry *file, ParsedHeader *outParsed);
+
+    void addEntry(const FatxCatalogEntry &entry);
+
+    void removeEntry(std::map<std::string, FatxCatalogEntry>::iterator entry);
+
+    // remove path from one of the lookup indexes
+    template <typename Key>
+    static void removeFromIndex(std::multimap<Key, std::string> &index, Key key, const std::string &path);
+
+    template <typename Key>
+    std::vector<FatxCatalogEntry> findInIndex(std::multimap<Key, std::string> &index, Key key);
+
+    // used by the workers, false once everything's been parsed
+    bool takeJob(HeaderJob **outJob);
+
+    FatxDrive *drive;
+    BaseIO *device;
+    Partition *part;
+    DWORD workerCount;
+
+    // the packages, along with indexes of their paths for looking them up in other ways
+    std::map<std::string, FatxCatalogEntry> entries;
+    std::multimap<DWORD, std::string> byTitle;
+    std::multimap<DWORD, std::string> byContentType;
+    std::multimap<UINT64, std::string> byProfile;
+
+    // the headers are handed from the thread reading them to the workers through this
+    Mutex queueMutex;
+    Condition jobReady;
+    Condition jobTaken;
+    std::deque<HeaderJob*> queue;
+    bool doneReading;
+    std::vector<FatxFileEntry*> *files;
+    std::vector<ParsedHeader> *parsed;
+
+    // the catalog can be queried from one thread while another one updates it
+    ReadWriteLock lock;
+
+    friend class FatxCatalogWorker;
+};
+
+#endif // FATXCONTENTCATALOG_H
@@ -0,0 +1,287 @@
+#include "FatxCopier.h"
+#include "FatxDrive.h"
+
+FatxCopier::FatxCopier(FatxDrive *source, BaseIO *sourceDevice, FatxDrive *destination,
+        BaseIO *destinationDevice) :
+    source(source), sourceDevice(sourceDevice), destination(destination),
+    destinationDevice(destinationDevice), batchBytes(0), batchWritten(0), totalFiles(0),
+    progress(NULL), arg(NULL)
+{
+}
+
+FatxCopyResult FatxCopier::Copy(const std::vector<FatxFileEntry*> &entries,
+        FatxFileEntry *destinationFolder, void(*progress)(void*, DWORD, DWORD), void *arg)
+{
+    if (!(destinationFolder->fileAttributes & FatxDirectory))
+        throw std::string("FATX: Destination entry is not a directory.\n");
+
+    // a folder can't be copied into itself on the same drive, it'd never finish
+    if (source == destination)
+    {
+        for (size_t i = 0; i < entries.size(); i++)
+            for (FatxFileEntry *folder = destinationFolder; folder != NULL; folder = folder->parent)
+                if (folder == entries.at(i))
+                    throw std::string("FATX: Cannot copy a folder into itself.\n");
+    }
+
+    this->progress = progress;
+    this->arg = arg;
+    result.filesCopied = 0;
+    result.foldersCreated = 0;
+    result.bytesCopied = 0;
+    batch.clear();
+    batchBytes = 0;
+    batchWritten = 0;
+
+    totalFiles = 0;
+    for (size_t i = 0; i < entries.size(); i++)
+        totalFiles += countFiles(entries.at(i));
+
+    // the free clusters have to be known before any can be given out
+    destination->GetFreeMemory(destinationFolder->partition);
+
+    try
+    {
+        for (size_t i = 0; i < entries.size(); i++)
+            copyEntry(entries.at(i), destinationFolder);
+        flushBatch();
+    }
+    catch (...)
+    {
+        discardBatch();
+        throw;
+    }
+
+    if (progress && totalFiles == 0)
+        progress(arg, 1, 1);
+
+    return result;
+}
+
+DWORD FatxCopier::countFiles(FatxFileEntry *entry)
+{
+    if (!(entry->fileAttributes & FatxDirectory))
+        return 1;
+
+    source->GetChildFileEntries(entry);
+
+    DWORD count = 0;
+    for (size_t i = 0; i < entry->cachedFiles.size(); i++)
+        if (entry->cachedFiles.at(i).nameLen != FATX_ENTRY_DELETED)
+            count += countFiles(&entry->cachedFiles.at(i));
+    return count;
+}
+
+void FatxCopier::copyEntry(FatxFileEntry *entry, FatxFileEntry *folder)
+{
+    if (entry->fileAttributes & FatxDirectory)
+    {
+        // the files waiting to be written are in the folder this one's going in
+        flushBatch();
+
+        FatxFileEntry *created = destination->CreateFolder(folder, entry->name);
+        created->fileAttributes = entry->fileAttributes;
+        created->creationDate = entry->creationDate;
+        created->lastWriteDate = entry->lastWriteDate;
+        created->lastAccessDate = entry->lastAccessDate;
+
+        FatxIO createdIO = destination->GetFatxIO(created);
+        createdIO.WriteEntryToDisk();
+        result.foldersCreated++;
+
+        source->GetChildFileEntries(entry);
+        for (size_t i = 0; i < entry->cachedFiles.size(); i++)
+            if (entry->cachedFiles.at(i).nameLen != FATX_ENTRY_DELETED)
+                copyEntry(&entry->cachedFiles.at(i), created);
+
+        flushBatch();
+        return;
+    }
+
+    if (entry->clusterChain.size() == 0)
+        source->ReadClusterChain(entry);
+
+    // the clusters are allocated now, but the entry isn't written until the data's been copied
+    FatxFileEntry newEntry;
+    newEntry.name = entry->name;
+    newEntry.fileSize = entry->fileSize;
+    newEntry.fileAttributes = entry->fileAttributes;
+    newEntry.magic = entry->magic;
+
+    // the folder's new cluster is committed along with the whole FAT, so the chains of the files
+    // waiting to be written can't be in it yet
+    if (destination->folderIsFull(folder))
+        flushBatch();
+
+    FatxFileEntry *created = destination->createFileEntry(folder, &newEntry, true, false);
+    created->creationDate = entry->creationDate;
+    created->lastWriteDate = entry->lastWriteDate;
+    created->lastAccessDate = entry->lastAccessDate;
+
+    PendingFile pending;
+    pending.entry = created;
+    mapRanges(entry, created, pending.ranges);
+
+    batch.push_back(pending);
+    batchBytes += entry->fileSize;
+
+    if (batchBytes >= FATX_COPY_BATCH_SIZE || batch.size() >= FATX_COPY_BATCH_FILES)
+        flushBatch();
+}
+
+void FatxCopier::flushBatch()
+{
+    if (batch.size() == 0)
+        return;
+
+    std::vector<CopyRange> ranges;
+    for (size_t i = 0; i < batch.size(); i++)
+        ranges.insert(ranges.end(), batch.at(i).ranges.begin(), batch.at(i).ranges.end());
+
+    // the data goes first, then the FAT, and the entries last so they never point to garbage
+    copyRanges(ranges);
+    destinationDevice->Flush();
+
+    Partition *part = batch.at(0).entry->partition;
+    part->allocationTable.Commit();
+
+    for (size_t i = 0; i < batch.size(); i++)
+    {
+        FatxFileEntry *entry = batch.at(i).entry;
+
+        FatxIO entryIO = destination->GetFatxIO(entry);
+        entryIO.WriteEntryToDisk();
+        batchWritten++;
+
+        result.bytesCopied += entry->fileSize;
+    }
+    destinationDevice->Flush();
+
+    // keep the destination's catalog up to date, like injecting does
+    FatxContentCatalog *catalog = destination->contentCatalog;
+    if (catalog != NULL && catalog->GetPartition() == part)
+        for (size_t i = 0; i < batch.size(); i++)
+            catalog->Update(batch.at(i).entry);
+
+    result.filesCopied += batch.size();
+    batch.clear();
+    batchBytes = 0;
+    batchWritten = 0;
+
+    if (progress)
+        progress(arg, result.filesCopied, totalFiles);
+}
+
+void FatxCopier::discardBatch()
+{
+    if (batch.size() != 0)
+    {
+        // nothing on the drive points to the clusters of the entries that weren't written
+        batch.at(0).entry->partition->allocationTable.Discard();
+
+        // the batch is all in one folder, so the last one made is taken out first
+        for (size_t i = batch.size(); i > batchWritten; i--)
+            destination->discardFileEntry(batch.at(i - 1).entry);
+    }
+
+    batch.clear();
+    batchBytes = 0;
+    batchWritten = 0;
+}
+
+void FatxCopier::getExtents(FatxFileEntry *entry, std::vector<Range> &outExtents)
+{
+    Partition *part = entry->partition;
+    UINT64 bytesLeft = entry->fileSize;
+
+    for (size_t i = 0; i < entry->clusterChain.size() && bytesLeft != 0; )
+    {
+        DWORD runLength = 1;
+        while (i + runLength < entry->clusterChain.size() &&
+                entry->clusterChain.at(i + runLength) == entry->clusterChain.at(i) + runLength)
+            runLength++;
+
+        Range extent;
+        extent.start = FatxIO::ClusterToOffset(part, entry->clusterChain.at(i));
+        extent.len = (UINT64)runLength * part->clusterSize;
+        if (extent.len > bytesLeft)
+            extent.len = bytesLeft;
+        outExtents.push_back(extent);
+
+        bytesLeft -= extent.len;
+        i += runLength;
+    }
+
+    if (bytesLeft != 0)
+        throw std::string("FATX: Cluster chain not sufficient enough for file size.\n");
+}
+
+void FatxCopier::mapRanges(FatxFileEntry *from, FatxFileEntry *to, std::vector<CopyRange> &outRanges)
+{
+    std::vector<Range> fromExtents, toExtents;
+    getExtents(from, fromExtents);
+    getExtents(to, toExtents);
+
+    // both cover the whole file, but the runs don't have to line up when the cluster sizes differ
+    size_t fromIndex = 0, toIndex = 0;
+    UINT64 fromOffset = 0, toOffset = 0;
+    while (fromIndex < fromExtents.size() && toIndex < toExtents.size())
+    {
+        const Range &fromExtent = fromExtents.at(fromIndex);
+        const Range &toExtent = toExtents.at(toIndex);
+
+        UINT64 len = fromExtent.len - fromOffset;
+        if (toExtent.len - toOffset < len)
+            len = toExtent.len - toOffset;
+
+        CopyRange range = { fromExtent.start + fromOffset, toExtent.start + toOffset, len };
+        outRanges.push_back(range);
+
+        fromOffset += len;
+        toOffset += len;
+        if (fromOffset == fromExtent.len)
+        {
+            fromIndex++;
+            fromOffset = 0;
+        }
+        if (toOffset == toExtent.len)
+        {
+            toIndex++;
+            toOffset = 0;
+        }
+    }
+}
+
+void FatxCopier::copyRanges(const std::vector<CopyRange> &ranges)
+{
+    if (sourceDevice != destinationDevice)
+    {
+        // the source is read on another thread while the destination's being written to
+        AsyncCopy copy(sourceDevice, destinationDevice);
+        copy.Copy(ranges);
+        return;
+    }
+
+    // an io can only be used by one thread, so copying on the same drive is done in turns
+    std::vector<BYTE> buffer(ASYNCCOPY_DEFAULT_CHUNK_SIZE);
+    for (size_t i = 0; i < ranges.size(); i++)
+    {
+        UINT64 sourceOffset = ranges.at(i).sourceOffset;
+        UINT64 destOffset = ranges.at(i).destOffset;
+        UINT64 len = ranges.at(i).len;
+
+        while (len != 0)
+        {
+            DWORD chunk = (len > buffer.size()) ? buffer.size() : len;
+
+            sourceDevice->SetPosition(sourceOffset);
+            sourceDevice->ReadBytes(&buffer.at(0), chunk);
+            destinationDevice->SetPosition(destOffset);
+            destinationDevice->WriteBytes(&buffer.at(0), chunk);
+
+            sourceOffset += chunk;
+            destOffset += chunk;
+            len -= chunk;
+        }
+    }
+}
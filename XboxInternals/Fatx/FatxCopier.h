@@ -0,0 +1,92 @@
+#ifndef FATXCOPIER_H
+#define FATXCOPIER_H
+
+#include "../winnames.h"
+#include "../IO/BaseIO.h"
+#include "../IO/AsyncCopy.h"
+#include "../IO/FatxIO.h"
+#include "FatxConstants.h"
+#include "XboxInternals_global.h"
+
+#include <vector>
+
+// the most data that's copied before the FAT and the entries of the files in it are written
+#define FATX_COPY_BATCH_SIZE 0x4000000
+
+// the most files that are copied before the FAT and their entries are written
+#define FATX_COPY_BATCH_FILES 256
+
+class FatxDrive;
+
+struct FatxCopyResult
+{
+    DWORD filesCopied;
+    DWORD foldersCreated;
+    UINT64 bytesCopied;
+};
+
+/* Copies files and folders from one FATX drive straight to another, without going through the
+   local disk. The files are given clusters on the destination the same way injected ones are, so
+   they're contiguous whenever there's a long enough run free. The data's streamed between the
+   devices by an AsyncCopy, and it's done in batches of files: their data is copied, then the FAT
+   is written once for all of them, and then their entries. The partitions can have different
+   cluster sizes. */
+class XBOXINTERNALSSHARED_EXPORT FatxCopier
+{
+public:
+    FatxCopier(FatxDrive *source, BaseIO *sourceDevice, FatxDrive *destination,
+            BaseIO *destinationDevice);
+
+    // copy the entries, and everything in the folders, into destinationFolder. The progress is the
+    // number of files copied
+    FatxCopyResult Copy(const std::vector<FatxFileEntry*> &entries, FatxFileEntry *destinationFolder,
+            void(*progress)(void*, DWORD, DWORD) = NULL, void *arg = NULL);
+
+private:
+    // a file that's been given clusters on the destination, but whose entry hasn't been written yet
+    struct PendingFile
+    {
+        FatxFileEntry *entry;
+        std::vector<CopyRange> ranges;
+    };
+
+    // count the files in entry, or 1 if it's a file
+    DWORD countFiles(FatxFileEntry *entry);
+
+    // copy the entry into folder on the destination
+    void copyEntry(FatxFileEntry *entry, FatxFileEntry *folder);
+
+    // copy the data of the batched files, and then write their chains and entries
+    void flushBatch();
+
+    // take the batched files whose entries haven't been written back out of their folder
+    void discardBatch();
+
+    // get where the file's data is on its device, in order, as (address, length)
+    void getExtents(FatxFileEntry *entry, std::vector<Range> &outExtents);
+
+    // line up the extents of the source and destination files, splitting them where either one
+    // moves on to a different run of clusters
+    void mapRanges(FatxFileEntry *from, FatxFileEntry *to, std::vector<CopyRange> &outRanges);
+
+    // copy the ranges from the source device to the destination one
+    void copyRanges(const std::vector<CopyRange> &ranges);
+
+    FatxDrive *source;
+    BaseIO *sourceDevice;
+    FatxDrive *destination;
+    BaseIO *destinationDevice;
+
+    std::vector<PendingFile> batch;
+    UINT64 batchBytes;
+
+    // how many of the batched files have had their entries written
+    size_t batchWritten;
+
+    FatxCopyResult result;
+    DWORD totalFiles;
+    void(*progress)(void*, DWORD, DWORD);
+    void *arg;
+};
+
+#endif // FATXCOPIER_H
@@ -0,0 +1,257 @@
+#include "FatxDefragmenter.h"
+#include "FatxDrive.h"
+
+#include <map>
+
+FatxDefragmenter::FatxDefragmenter(FatxDrive *drive, BaseIO *device, Partition *part) :
+    drive(drive), device(device), part(part)
+{
+}
+
+DWORD FatxDefragmenter::CountExtents(const std::vector<DWORD> &chain)
+{
+    if (chain.size() == 0)
+        return 0;
+
+    DWORD extents = 1;
+    for (size_t i = 1; i < chain.size(); i++)
+        if (chain.at(i) != chain.at(i - 1) + 1)
+            extents++;
+    return extents;
+}
+
+void FatxDefragmenter::collectEntries(FatxFileEntry *folder, std::vector<FatxFileEntry*> &entries)
+{
+    drive->GetChildFileEntries(folder);
+
+    for (size_t i = 0; i < folder->cachedFiles.size(); i++)
+    {
+        FatxFileEntry *entry = &folder->cachedFiles.at(i);
+        if (entry->nameLen == FATX_ENTRY_DELETED)
+            continue;
+
+        if (entry->clusterChain.size() == 0)
+            drive->ReadClusterChain(entry);
+        entries.push_back(entry);
+
+        if (entry->fileAttributes & FatxDirectory)
+            collectEntries(entry, entries);
+    }
+}
+
+FatxFragmentationReport FatxDefragmenter::Analyze()
+{
+    FatxFragmentationReport report;
+    report.fileCount = 0;
+    report.fragmentedFileCount = 0;
+    report.clusterCount = 0;
+    report.extentCount = 0;
+    report.freeRunCount = 0;
+    report.largestFreeRun = 0;
+    report.score = 0;
+
+    std::vector<FatxFileEntry*> entries;
+    if (part->root.clusterChain.size() == 0)
+        drive->ReadClusterChain(&part->root);
+    entries.push_back(&part->root);
+    collectEntries(&part->root, entries);
+
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        FatxFileEntry *entry = entries.at(i);
+        if (entry->clusterChain.size() == 0)
+            continue;
+
+        FatxFileFragmentation file;
+        file.path = FatxDrive::GetFolderPath(entry) + entry->name;
+        file.directory = (entry->fileAttributes & FatxDirectory) != 0;
+        file.clusterCount = entry->clusterChain.size();
+        file.extentCount = CountExtents(entry->clusterChain);
+        report.files.push_back(file);
+
+        report.fileCount++;
+        report.clusterCount += file.clusterCount;
+        report.extentCount += file.extentCount;
+        if (file.extentCount > 1)
+            report.fragmentedFileCount++;
+    }
+
+    // each extent after an entry's first one starts with a cluster that doesn't follow on
+    if (report.clusterCount != 0)
+        report.score = (double)(report.extentCount - report.fileCount) / report.clusterCount;
+
+    drive->GetFreeMemory(part);
+    const std::map<DWORD, DWORD> &runs = part->freeClusters.Runs();
+    for (std::map<DWORD, DWORD>::const_iterator run = runs.begin(); run != runs.end(); ++run)
+    {
+        report.freeRunCount++;
+        if (run->second > report.largestFreeRun)
+            report.largestFreeRun = run->second;
+    }
+
+    return report;
+}
+
+FatxDefragmentationResult FatxDefragmenter::Defragment(void(*progress)(void*, DWORD, DWORD), void *arg)
+{
+    FatxDefragmentationResult result;
+    result.filesMoved = 0;
+    result.filesSkipped = 0;
+    result.bytesMoved = 0;
+
+    // the free space has to be known to find runs to move the files into
+    drive->GetFreeMemory(part);
+
+    std::vector<FatxFileEntry*> entries;
+    collectEntries(&part->root, entries);
+
+    // the folders come before what's in them, so their entries are at the right addresses by the
+    // time they're moved
+    std::vector<FatxFileEntry*> fragmented;
+    for (size_t i = 0; i < entries.size(); i++)
+        if (CountExtents(entries.at(i)->clusterChain) > 1 && validChain(entries.at(i)->clusterChain))
+            fragmented.push_back(entries.at(i));
+
+    for (size_t i = 0; i < fragmented.size(); i++)
+    {
+        if (moveEntry(fragmented.at(i), result.bytesMoved))
+            result.filesMoved++;
+        else
+            result.filesSkipped++;
+
+        if (progress)
+            progress(arg, i + 1, fragmented.size());
+    }
+
+    if (progress && fragmented.size() == 0)
+        progress(arg, 1, 1);
+
+    part->freeMemory = (UINT64)part->freeClusters.ClusterCount() * part->clusterSize;
+    return result;
+}
+
+bool FatxDefragmenter::moveEntry(FatxFileEntry *entry, UINT64 &bytesMoved)
+{
+    DWORD count = entry->clusterChain.size();
+    DWORD newStart;
+    if (!part->freeClusters.AllocateRun(count, newStart))
+        return false;
+
+    std::vector<DWORD> newChain(count);
+    for (DWORD i = 0; i < count; i++)
+        newChain.at(i) = newStart + i;
+
+    FatxAllocationTable &allocationTable = part->allocationTable;
+    try
+    {
+        // the data, and then the chain that holds it, are written while nothing points to them yet
+        bytesMoved += copyClusters(entry, newStart);
+        device->Flush();
+
+        allocationTable.SetChain(newChain);
+        allocationTable.Commit();
+    }
+    catch (...)
+    {
+        allocationTable.Discard();
+        part->freeClusters.Free(newStart, count);
+        throw;
+    }
+
+    // now the entry can be switched over to the new chain
+    std::vector<DWORD> oldChain = entry->clusterChain;
+    entry->startingCluster = newStart;
+    entry->clusterChain = newChain;
+
+    FatxIO entryIO = drive->GetFatxIO(entry);
+    entryIO.WriteEntryToDisk();
+    device->Flush();
+
+    // and once nothing uses the old clusters they can be freed
+    allocationTable.SetAll(oldChain, FAT_CLUSTER_AVAILABLE);
+    allocationTable.Commit();
+    part->freeClusters.Free(oldChain);
+
+    if (entry->fileAttributes & FatxDirectory)
+        relocateChildren(entry, oldChain);
+
+    return true;
+}
+
+UINT64 FatxDefragmenter::copyClusters(FatxFileEntry *entry, DWORD newStart)
+{
+    if (buffer.size() == 0)
+        buffer.resize(FATX_DEFRAG_BUFFER_SIZE);
+
+    // all of a folder's clusters hold entries, but a file's data ends at its size
+    UINT64 bytesLeft = (UINT64)entry->clusterChain.size() * part->clusterSize;
+    if (!(entry->fileAttributes & FatxDirectory) && entry->fileSize < bytesLeft)
+        bytesLeft = entry->fileSize;
+
+    UINT64 copied = 0;
+    UINT64 destination = FatxIO::ClusterToOffset(part, newStart);
+
+    for (size_t i = 0; i < entry->clusterChain.size() && bytesLeft != 0; )
+    {
+        // copy each run of consecutive clusters in pieces as large as the buffer
+        DWORD runLength = 1;
+        while (i + runLength < entry->clusterChain.size() &&
+                entry->clusterChain.at(i + runLength) == entry->clusterChain.at(i) + runLength)
+            runLength++;
+
+        UINT64 source = FatxIO::ClusterToOffset(part, entry->clusterChain.at(i));
+        UINT64 runBytes = (UINT64)runLength * part->clusterSize;
+        if (runBytes > bytesLeft)
+            runBytes = bytesLeft;
+
+        while (runBytes != 0)
+        {
+            DWORD chunk = (runBytes > buffer.size()) ? buffer.size() : runBytes;
+
+            device->SetPosition(source);
+            device->ReadBytes(&buffer.at(0), chunk);
+            device->SetPosition(destination);
+            device->WriteBytes(&buffer.at(0), chunk);
+
+            source += chunk;
+            destination += chunk;
+            runBytes -= chunk;
+            bytesLeft -= chunk;
+            copied += chunk;
+        }
+
+        i += runLength;
+    }
+
+    return copied;
+}
+
+void FatxDefragmenter::relocateChildren(FatxFileEntry *folder, const std::vector<DWORD> &oldChain)
+{
+    std::map<DWORD, DWORD> clusterIndices;
+    for (size_t i = 0; i < oldChain.size(); i++)
+        clusterIndices[oldChain.at(i)] = i;
+
+    for (size_t i = 0; i < folder->cachedFiles.size(); i++)
+    {
+        FatxFileEntry *child = &folder->cachedFiles.at(i);
+
+        UINT64 offset = child->address - part->clusterStartingAddress;
+        DWORD oldCluster = (offset / part->clusterSize) + 1;
+
+        std::map<DWORD, DWORD>::iterator index = clusterIndices.find(oldCluster);
+        if (index == clusterIndices.end())
+            throw std::string("FATX: Entry isn't in the folder that was moved.\n");
+
+        child->address = FatxIO::ClusterToOffset(part, folder->clusterChain.at(index->second)) +
+                (offset % part->clusterSize);
+    }
+}
+
+bool FatxDefragmenter::validChain(const std::vector<DWORD> &chain)
+{
+    for (size_t i = 0; i < chain.size(); i++)
+        if (chain.at(i) < 2 || chain.at(i) > part->clusterCount)
+            return false;
+    return true;
+}
@@ -0,0 +1,99 @@
+#ifndef FATXDEFRAGMENTER_H
+#define FATXDEFRAGMENTER_H
+
+#include "../winnames.h"
+#include "../IO/BaseIO.h"
+#include "FatxConstants.h"
+#include "XboxInternals_global.h"
+
+#include <string>
+#include <vector>
+
+// the most that's read from the device at once when moving a file
+#define FATX_DEFRAG_BUFFER_SIZE 0x100000
+
+class FatxDrive;
+
+// how a single file or folder is laid out on the partition
+struct FatxFileFragmentation
+{
+    std::string path;
+    bool directory;
+    DWORD clusterCount;
+
+    // the number of runs of consecutive clusters the entry is stored in, 1 if it's contiguous
+    DWORD extentCount;
+};
+
+struct FatxFragmentationReport
+{
+    // every entry that has clusters, in the order they're found
+    std::vector<FatxFileFragmentation> files;
+
+    DWORD fileCount;
+    DWORD fragmentedFileCount;
+    DWORD clusterCount;
+    DWORD extentCount;
+
+    // how the free space is split up
+    DWORD freeRunCount;
+    DWORD largestFreeRun;
+
+    // the fraction of all the clusters in use that don't follow on from the one before them in
+    // their chain, so each one is a seek when the entry is read. 0 when every file is contiguous,
+    // and a few fragmented files on a big partition barely move it
+    double score;
+};
+
+struct FatxDefragmentationResult
+{
+    DWORD filesMoved;
+
+    // the fragmented files there wasn't a long enough run of free clusters for
+    DWORD filesSkipped;
+
+    UINT64 bytesMoved;
+};
+
+/* Moves each fragmented file on a partition into a single run of free clusters. The data's
+   copied over first, then the new chain is put in the FAT, then the entry is pointed at it, and
+   only after that are the old clusters freed. If it's interrupted the worst that can happen is
+   that the clusters of the file being moved are left marked as used. Nothing else can be using
+   the partition while it runs. */
+class XBOXINTERNALSSHARED_EXPORT FatxDefragmenter
+{
+public:
+    FatxDefragmenter(FatxDrive *drive, BaseIO *device, Partition *part);
+
+    // read in all the entries on the partition and see how fragmented they are
+    FatxFragmentationReport Analyze();
+
+    // move the fragmented files, the progress is the number of them that have been looked at
+    FatxDefragmentationResult Defragment(void(*progress)(void*, DWORD, DWORD) = NULL, void *arg = NULL);
+
+    // count the runs of consecutive clusters in the chain
+    static DWORD CountExtents(const std::vector<DWORD> &chain);
+
+private:
+    // add all of the entries under folder to entries, parents come before their children
+    void collectEntries(FatxFileEntry *folder, std::vector<FatxFileEntry*> &entries);
+
+    // move the entry into a run of free clusters, false if there isn't one long enough
+    bool moveEntry(FatxFileEntry *entry, UINT64 &bytesMoved);
+
+    // copy the entry's data from its clusters to the run of clusters starting at newStart
+    UINT64 copyClusters(FatxFileEntry *entry, DWORD newStart);
+
+    // the entries in a folder that was moved are at different addresses now
+    void relocateChildren(FatxFileEntry *folder, const std::vector<DWORD> &oldChain);
+
+    // make sure all of the clusters in the chain are real ones, so a broken chain isn't moved
+    bool validChain(const std::vector<DWORD> &chain);
+
+    FatxDrive *drive;
+    BaseIO *device;
+    Partition *part;
+    std::vector<BYTE> buffer;
+};
+
+#endif // FATXDEFRAGMENTER_H
@@ -15,7 +15,20 @@
 #include <unistd.h>
 #endif
 
-FatxDrive::FatxDrive(std::string drivePath, FatxDriveType type)  : type(type)
+#include <iomanip>
+
+static bool isRegularFile(const std::string &path)
+{
+#ifdef _WIN32
+    DWORD attributes = GetFileAttributesA(path.c_str());
+    return attributes != INVALID_FILE_ATTRIBUTES && !(attributes & FILE_ATTRIBUTE_DIRECTORY);
+#else
+    struct stat64 fileInfo;
+    return stat64(path.c_str(), &fileInfo) == 0 && S_ISREG(fileInfo.st_mode);
+#endif
+}
+
+FatxDrive::FatxDrive(std::string drivePath, FatxDriveType type)  : type(type), contentCatalog(NULL)
 {
     // convert it to a wstring
     std::wstring wsDrivePath;
@@ -25,18 +38,18 @@ FatxDrive::FatxDrive(std::string drivePath, FatxDriveType type)  : type(type)
     loadFatxDrive(wsDrivePath);
 }
 
-FatxDrive::FatxDrive(BaseIO *io, FatxDriveType type) : io(io), type(type)
+FatxDrive::FatxDrive(BaseIO *io, FatxDriveType type) : io(io), type(type), contentCatalog(NULL)
 {
     loadFatxDrive();
 }
 
-FatxDrive::FatxDrive(std::wstring drivePath, FatxDriveType type) : type(type)
+FatxDrive::FatxDrive(std::wstring drivePath, FatxDriveType type) : type(type), contentCatalog(NULL)
 {
     loadFatxDrive(drivePath);
 }
 
 #ifdef __WIN32
-FatxDrive::FatxDrive(void* deviceHandle, FatxDriveType type) : type(type)
+FatxDrive::FatxDrive(void* deviceHandle, FatxDriveType type) : type(type), contentCatalog(NULL)
 {
     loadFatxDrive(deviceHandle);
 }
@@ -131,6 +144,8 @@ void FatxDrive::processBootSector(Partition *part)
     part->clusterStartingAddress = part->address + (INT64)partitionSize + 0x1000;
     part->lastFreeClusterFound = 1;
     part->freeMemory = 0;
+    part->freeMemoryCounted = false;
+    part->allocationTable.Open(io, part);
 
     // setup the root
     part->root.startingCluster = part->rootDirectoryCluster;
@@ -139,7 +154,7 @@ void FatxDrive::processBootSector(Partition *part)
     part->root.partition = part;
     part->root.fileAttributes = FatxDirectory;
     part->root.address = -1;
-    part->root.path = "Drive:\\";
+    part->root.parent = NULL;
     part->drive = this;
 }
 
@@ -205,12 +220,12 @@ void FatxDrive::CreateFileX(FatxFileEntry *parent, std::string name)
 }
 
 FatxFileEntry* FatxDrive::createFileEntry(FatxFileEntry *parent, FatxFileEntry *newEntry,
-        bool errorIfAlreadyExists)
+        bool errorIfAlreadyExists, bool writeEntry)
 {
     if (!(parent->fileAttributes & FatxDirectory))
         throw std::string("FATX: Parent file entry is not a directory.\n");
 
-    newEntry->path = parent->path + parent->name + "\\";
+    newEntry->parent = parent;
 
     // set the times
     DWORD currentTime = MSTimeToDWORD(TimetToMSTime(time(NULL)));
@@ -225,21 +240,21 @@ FatxFileEntry* FatxDrive::createFileEntry(FatxFileEntry *parent, FatxFileEntry *
     // get the child entries
     GetChildFileEntries(parent);
 
-    for (size_t i = 0; i < parent->cachedFiles.size(); i++)
-        if (parent->cachedFiles.at(i).name == newEntry->name)
+    FatxFileEntry *existing = parent->childIndex.Find(parent->cachedFiles, newEntry->name, true);
+    if (existing != NULL)
+    {
+        // if it's deleted, it's okay!
+        if (existing->nameLen != FATX_ENTRY_DELETED)
         {
-            // if it's deleted, it's okay!
-            if (parent->cachedFiles.at(i).nameLen != FATX_ENTRY_DELETED)
-            {
-                if (errorIfAlreadyExists)
-                    throw std::string("FATX: Entry already exists.\n");
-                else
-                    return NULL;
-            }
-
-            newEntry->address = parent->cachedFiles.at(i).address;
+            if (errorIfAlreadyExists)
+                throw std::string("FATX: Entry already exists.\n");
+            else
+                return NULL;
         }
 
+        newEntry->address = existing->address;
+    }
+
     // set the name length
     newEntry->nameLen = newEntry->name.length();
 
@@ -248,8 +263,9 @@ FatxFileEntry* FatxDrive::createFileEntry(FatxFileEntry *parent, FatxFileEntry *
         UINT64 freeEntryAddress = parent->cachedFiles.size() * FATX_ENTRY_SIZE;
         FatxIO parentIO = GetFatxIO(parent);
 
+        // growing the folder commits the whole FAT, so it's only done when there's no room left
         parent->fileSize = parent->cachedFiles.size() * FATX_ENTRY_SIZE;
-        if (parent->clusterChain.size() < 1 || parent->fileSize >= parent->partition->clusterSize)
+        if (folderIsFull(parent))
         {
             parentIO.AllocateMemory(FATX_ENTRY_SIZE);
             parentIO.SetPosition(parent->fileSize);
@@ -265,14 +281,39 @@ FatxFileEntry* FatxDrive::createFileEntry(FatxFileEntry *parent, FatxFileEntry *
     DWORD fileSize = newEntry->fileSize;
     newEntry->fileSize = 0;
 
+    // the entry isn't written until its clusters are in the FAT
     FatxIO childIO(static_cast<DeviceIO*>(io), newEntry);
-    childIO.AllocateMemory(fileSize);
-    childIO.WriteEntryToDisk();
+    childIO.AllocateMemory(fileSize, false);
+    if (writeEntry)
+        childIO.Commit();
 
     parent->cachedFiles.push_back(*newEntry);
+    parent->childIndex.Add(newEntry->name, parent->cachedFiles.size() - 1);
     return &parent->cachedFiles.at(parent->cachedFiles.size() - 1);
 }
 
+bool FatxDrive::folderIsFull(FatxFileEntry *folder)
+{
+    GetChildFileEntries(folder);
+
+    UINT64 used = (UINT64)(folder->cachedFiles.size() + 1) * FATX_ENTRY_SIZE;
+    return used > (UINT64)folder->clusterChain.size() * folder->partition->clusterSize;
+}
+
+void FatxDrive::discardFileEntry(FatxFileEntry *entry)
+{
+    FatxFileEntry *parent = entry->parent;
+    Partition *part = entry->partition;
+    std::vector<DWORD> clusters = entry->clusterChain;
+
+    // the next entry made in the folder goes in its slot, so the folder's left without a hole
+    parent->childIndex.Remove(parent->cachedFiles, entry);
+    parent->cachedFiles.pop_back();
+
+    if (part->freeMemoryCounted)
+        part->freeClusters.Free(clusters);
+}
+
 FatxFileEntry* FatxDrive::CreateFolder(FatxFileEntry *parent, std::string folderName)
 {
     if (this->FileExists(parent, folderName))
@@ -301,7 +342,9 @@ FatxFileEntry* FatxDrive::CreatePath(std::string folderPath)
     if (elems.size() < 3)
         throw std::string("FATX: Invalid folder path given.");
 
-    std::string currentPath = elems.at(0) + "\\" + elems.at(1);
+    lastEntry = GetFileEntry(elems.at(0) + "\\" + elems.at(1));
+    if (lastEntry == NULL)
+        throw std::string("FATX: Invalid folder path given.");
 
     for (size_t i = 2; i < elems.size(); i++)
     {
@@ -310,37 +353,55 @@ FatxFileEntry* FatxDrive::CreatePath(std::string folderPath)
         newEntry.name = elems.at(i);
         newEntry.fileAttributes = FatxDirectory;
 
-        lastEntry = this->createFileEntry(GetFileEntry(currentPath), &newEntry, false);
-        currentPath += "\\" + elems.at(i);
+        // the entries don't move, so the folder that's there already can be used as it is
+        FatxFileEntry *folder = this->createFileEntry(lastEntry, &newEntry, false);
+        if (folder == NULL)
+            folder = lastEntry->childIndex.Find(lastEntry->cachedFiles, elems.at(i));
+        lastEntry = folder;
     }
 
     return lastEntry;
 }
 
 void FatxDrive::RemoveFile(FatxFileEntry *entry, void(*progress)(void*), void *arg)
+{
+    // mark the entries deleted first, and then free all of their clusters at once
+    std::vector<DWORD> clusters;
+    removeEntries(entry, clusters, progress, arg);
+
+    Partition *part = entry->partition;
+    part->allocationTable.SetAll(clusters, FAT_CLUSTER_AVAILABLE);
+    part->allocationTable.Commit();
+
+    // the free clusters are only tracked once they've been read in
+    if (part->freeMemoryCounted)
+        part->freeClusters.Free(clusters);
+
+    if (contentCatalog != NULL && contentCatalog->GetPartition() == part)
+        contentCatalog->Remove(GetFolderPath(entry) + entry->name);
+
+    // the entries are only marked deleted, so they're still where the cache points. It's cleared so
+    // their paths aren't found any more
+    MutexLocker locker(lookupMutex);
+    pathCache.Clear();
+}
+
+void FatxDrive::removeEntries(FatxFileEntry *entry, std::vector<DWORD> &clusters,
+        void(*progress)(void*), void *arg)
 {
     // read the data
     GetChildFileEntries(entry);
     ReadClusterChain(entry);
 
+    // entries that were already deleted don't own their clusters any more
     for (size_t i = 0; i < entry->cachedFiles.size(); i++)
-        RemoveFile(&entry->cachedFiles.at(i), progress, arg);
+        if (entry->cachedFiles.at(i).nameLen != FATX_ENTRY_DELETED)
+            removeEntries(&entry->cachedFiles.at(i), clusters, progress, arg);
 
-    // set all the clusters to available
-    entry->clusterChain.push_back(entry->startingCluster);
-    FatxIO::SetAllClusters(static_cast<DeviceIO*>(io), entry->partition, entry->clusterChain,
-            FAT_CLUSTER_AVAILABLE);
-
-    // generate cluster ranges for fast insertion into the cluster chain
-    std::vector<Range> clusterRanges;
-    FatxIO::GetConsecutive(entry->clusterChain, clusterRanges, true);
-
-    // inject all of the ranges back into the cluster chain
-    for (DWORD i = 1; i < clusterRanges.size(); i++)
-    {
-        clusterRanges.at(i).start = entry->clusterChain.at(clusterRanges.at(i).start);
-        injectRange(entry->partition->freeClusters, clusterRanges.at(i));
-    }
+    // empty files don't have any clusters
+    for (size_t i = 0; i < entry->clusterChain.size(); i++)
+        if (entry->clusterChain.at(i) != 0 && entry->clusterChain.at(i) <= entry->partition->clusterCount)
+            clusters.push_back(entry->clusterChain.at(i));
 
     // update the entry
     entry->clusterChain.clear();
@@ -384,15 +445,39 @@ void FatxDrive::InjectFile(FatxFileEntry *parent, std::string name, std::string
 
     // set other stuff
     entry.fileAttributes = 0;
-    inFile.SetPosition(0);
-    entry.magic = inFile.ReadDword();
+    entry.magic = 0;
+    if (fileSize >= 4)
+    {
+        inFile.SetPosition(0);
+        entry.magic = inFile.ReadDword();
+    }
     inFile.Close();
 
-    // create the entry
-    createFileEntry(parent, &entry);
+    // create the entry, it's written once the data is
+    FatxFileEntry *created = createFileEntry(parent, &entry, true, false);
 
-    FatxIO fatxIO = GetFatxIO(&entry);
-    fatxIO.ReplaceFile(filePath, progress, arg);
+    try
+    {
+        FatxIO fatxIO = GetFatxIO(created);
+        fatxIO.ReplaceFile(filePath, progress, arg);
+    }
+    catch (...)
+    {
+        // the entry was never written, so nothing on the drive points to its clusters
+        created->partition->allocationTable.Discard();
+        discardFileEntry(created);
+        throw;
+    }
+
+    if (contentCatalog != NULL && contentCatalog->GetPartition() == created->partition)
+        contentCatalog->Update(created);
+}
+
+FatxCopyResult FatxDrive::CopyFiles(const std::vector<FatxFileEntry*> &entries, FatxDrive *destination,
+        FatxFileEntry *destinationFolder, void (*progress)(void *, DWORD, DWORD), void *arg)
+{
+    FatxCopier copier(this, io, destination, destination->io);
+    return copier.Copy(entries, destinationFolder, progress, arg);
 }
 
 void FatxDrive::GetFileEntryMagic(FatxFileEntry *entry)
@@ -405,6 +490,12 @@ void FatxDrive::GetFileEntryMagic(FatxFileEntry *entry)
 }
 
 void FatxDrive::GetChildFileEntries(FatxFileEntry *entry, void(*progress)(void*, bool), void *arg)
+{
+    MutexLocker locker(lookupMutex);
+    readChildFileEntries(entry, progress, arg);
+}
+
+void FatxDrive::readChildFileEntries(FatxFileEntry *entry, void(*progress)(void*, bool), void *arg)
 {
     // if all entries have been read, skip this
     if (entry->readDirectories || !(entry->fileAttributes & FatxDirectory))
@@ -414,77 +505,44 @@ void FatxDrive::GetChildFileEntries(FatxFileEntry *entry, void(*progress)(void*,
     if (entry->clusterChain.size() == 0)
         ReadClusterChain(entry);
 
-    // find out how many entries are in a single cluster
-    DWORD entriesInCluster = entry->partition->clusterSize / FATX_ENTRY_SIZE;
-
-    bool doneForGood = false;
+    // the index is built again along with the entries
+    entry->childIndex.Clear();
 
-    // read all entries
-    for (size_t i = 0; i < entry->clusterChain.size(); i++)
+    BYTE *cluster = new BYTE[entry->partition->clusterSize];
+    try
     {
-        UINT64 posCur = FatxIO::ClusterToOffset(entry->partition, entry->clusterChain.at(i));
-
-        // go to the cluster offset
-        io->SetPosition(posCur);
-
-        for (DWORD x = 0; x < entriesInCluster; x++)
+        // read all entries, a cluster at a time
+        std::vector<FatxFileEntry> clusterEntries;
+        for (size_t i = 0; i < entry->clusterChain.size(); i++)
         {
-            // read the name length
-            FatxFileEntry newEntry;
-            newEntry.nameLen = io->ReadByte();
-
-            // check if there are no more entries
-            if (newEntry.nameLen == 0xFF || newEntry.nameLen == 0)
-            {
-                doneForGood = true;
-                break;
-            }
-
-            // calcualte the address
-            newEntry.address = posCur + (x * 0x40);
+            UINT64 posCur = FatxIO::ClusterToOffset(entry->partition, entry->clusterChain.at(i));
+            io->SetPosition(posCur);
+            io->ReadBytes(cluster, entry->partition->clusterSize);
 
-            // read the attributes
-            newEntry.fileAttributes = io->ReadByte();
+            clusterEntries.clear();
+            bool doneForGood = !readDirectoryCluster(entry, cluster, posCur, clusterEntries);
 
-            // read the name (0xFF is the null terminator)
-            bool subtract = true;
-            if (newEntry.nameLen == FATX_ENTRY_DELETED)
-                newEntry.name = io->ReadString(-1, 0xFF, true, FATX_ENTRY_MAX_NAME_LENGTH);
-            else
+            for (size_t x = 0; x < clusterEntries.size(); x++)
             {
-                newEntry.name = io->ReadString(newEntry.nameLen);
-                subtract = false;
-            }
-
-            // seek past the name
-            io->SetPosition(io->GetPosition() + (FATX_ENTRY_MAX_NAME_LENGTH - newEntry.name.length()) -
-                    subtract);
-
-            // read the rest of the entry information
-            newEntry.startingCluster = io->ReadDword();
-            if (newEntry.startingCluster == entry->startingCluster)
-                throw std::string("FATX: FAT has circular link.\n");
+                // add it to the file cache
+                entry->cachedFiles.push_back(clusterEntries.at(x));
+                entry->childIndex.Add(clusterEntries.at(x).name, entry->cachedFiles.size() - 1);
 
-            newEntry.fileSize = io->ReadDword();
-            newEntry.creationDate = io->ReadDword();
-            newEntry.lastWriteDate = io->ReadDword();
-            newEntry.lastAccessDate = io->ReadDword();
-            newEntry.partition = entry->partition;
-            newEntry.readDirectories = false;
-            newEntry.path = entry->path + entry->name + "\\";
-            newEntry.magic = 0;
-
-            // add it to the file cache
-            entry->cachedFiles.push_back(newEntry);
+                // update progress if needed
+                if (progress)
+                    progress(arg, false);
+            }
 
-            // update progress if needed
-            if (progress)
-                progress(arg, false);
+            if (doneForGood)
+                break;
         }
-
-        if (doneForGood)
-            break;
     }
+    catch (...)
+    {
+        delete[] cluster;
+        throw;
+    }
+    delete[] cluster;
 
     // update progress if needed
     if (progress)
@@ -494,6 +552,62 @@ void FatxDrive::GetChildFileEntries(FatxFileEntry *entry, void(*progress)(void*,
     entry->readDirectories = true;
 }
 
+bool FatxDrive::readDirectoryCluster(FatxFileEntry *folder, BYTE *cluster, UINT64 clusterAddress,
+        std::vector<FatxFileEntry> &outEntries)
+{
+    Partition *part = folder->partition;
+    MemoryIO clusterIO(cluster, part->clusterSize);
+
+    // find out how many entries are in a single cluster
+    DWORD entriesInCluster = part->clusterSize / FATX_ENTRY_SIZE;
+
+    for (DWORD x = 0; x < entriesInCluster; x++)
+    {
+        clusterIO.SetPosition(x * FATX_ENTRY_SIZE);
+
+        // read the name length
+        FatxFileEntry newEntry;
+        newEntry.nameLen = clusterIO.ReadByte();
+
+        // check if there are no more entries
+        if (newEntry.nameLen == 0xFF || newEntry.nameLen == 0)
+            return false;
+
+        // calcualte the address
+        newEntry.address = clusterAddress + (x * FATX_ENTRY_SIZE);
+
+        // read the attributes
+        newEntry.fileAttributes = clusterIO.ReadByte();
+
+        // read the name (0xFF is the null terminator)
+        if (newEntry.nameLen == FATX_ENTRY_DELETED)
+            newEntry.name = clusterIO.ReadString(-1, 0xFF, true, FATX_ENTRY_MAX_NAME_LENGTH);
+        else
+            newEntry.name = clusterIO.ReadString(newEntry.nameLen);
+
+        // seek past the name
+        clusterIO.SetPosition(x * FATX_ENTRY_SIZE + 2 + FATX_ENTRY_MAX_NAME_LENGTH);
+
+        // read the rest of the entry information
+        newEntry.startingCluster = clusterIO.ReadDword();
+        if (newEntry.startingCluster == folder->startingCluster)
+            throw std::string("FATX: FAT has circular link.\n");
+
+        newEntry.fileSize = clusterIO.ReadDword();
+        newEntry.creationDate = clusterIO.ReadDword();
+        newEntry.lastWriteDate = clusterIO.ReadDword();
+        newEntry.lastAccessDate = clusterIO.ReadDword();
+        newEntry.partition = part;
+        newEntry.readDirectories = false;
+        newEntry.parent = folder;
+        newEntry.magic = 0;
+
+        outEntries.push_back(newEntry);
+    }
+
+    return true;
+}
+
 void FatxDrive::ReadClusterChain(FatxFileEntry *entry)
 {
     // clear the current chain
@@ -503,7 +617,6 @@ void FatxDrive::ReadClusterChain(FatxFileEntry *entry)
     bool clusterSizeIs2 = (entry->partition->clusterEntrySize == FAT16);
     DWORD lastCluster =  (clusterSizeIs2) ? FAT_CLUSTER16_LAST : FAT_CLUSTER_LAST;
     DWORD availableCluster = (clusterSizeIs2) ? FAT_CLUSTER16_AVAILABLE : FAT_CLUSTER_AVAILABLE;
-    INT64 clusterMapAddress = entry->partition->address + 0x1000;
 
     // start with the starting cluster
     DWORD previousCluster = entry->startingCluster;
@@ -513,14 +626,8 @@ void FatxDrive::ReadClusterChain(FatxFileEntry *entry)
         // add it to the cluster chain
         entry->clusterChain.push_back(previousCluster);
 
-        // seek to the next cluster
-        io->SetPosition(clusterMapAddress + (previousCluster * entry->partition->clusterEntrySize));
-
-        // read the cluster
-        if (clusterSizeIs2)
-            previousCluster = io->ReadWord();
-        else
-            previousCluster = io->ReadDword();
+        // read the next cluster, the table has any changes that haven't been written yet
+        previousCluster = entry->partition->allocationTable.GetEntry(previousCluster);
     }
 }
 
@@ -529,131 +636,80 @@ void FatxDrive::Close()
     io->Close();
 }
 
-void FatxDrive::CreateBackup(std::string outPath, void (*progress)(void *, DWORD, DWORD), void *arg)
+void FatxDrive::CreateBackup(std::string outPath, void (*progress)(void *, DWORD, DWORD), void *arg,
+        std::string basePath)
 {
-    // create a file on the local disk to store the backup
-    FileIO outBackup(outPath, true);
+    std::vector<FatxBackupRange> freeRanges = getFreeRanges();
+    FatxBackup::Create(io, outPath, freeRanges, basePath, progress, arg);
+}
 
-    UINT64 driveLen = io->Length();
-    io->SetPosition(0);
+static bool compareFreeRanges(const FatxBackupRange &a, const FatxBackupRange &b)
+{
+    return a.address < b.address;
+}
 
-    BYTE *buffer = new BYTE[0x100000];
+std::vector<FatxBackupRange> FatxDrive::getFreeRanges()
+{
+    std::vector<FatxBackupRange> freeRanges;
 
-    // start writing the drive contents to the local disk
-    DWORD i = 0;
-    UINT64 totalProgress = driveLen / 0x100000;
-    while (driveLen >= 0x100000)
+    for (size_t i = 0; i < partitions.size(); i++)
     {
-        io->ReadBytes(buffer, 0x100000);
-        outBackup.WriteBytes(buffer, 0x100000);
+        Partition *part = partitions.at(i);
+        if (!part->freeMemoryCounted)
+            GetFreeMemory(part);
 
-        if (progress)
-            progress(arg, i, totalProgress);
+        UINT64 partitionEnd = part->address + part->size;
+        const std::map<DWORD, DWORD> &runs = part->freeClusters.Runs();
+        for (std::map<DWORD, DWORD>::const_iterator run = runs.begin(); run != runs.end(); ++run)
+        {
+            // the first entries in the FAT are reserved, they don't map to any data
+            DWORD start = run->first, length = run->second;
+            if (start <= 1)
+            {
+                DWORD reserved = 2 - start;
+                if (length <= reserved)
+                    continue;
+                start += reserved;
+                length -= reserved;
+            }
 
-        driveLen -= 0x100000;
-        i++;
-    }
+            FatxBackupRange range;
+            range.address = FatxIO::ClusterToOffset(part, start);
+            range.length = (UINT64)length * part->clusterSize;
+            if (range.address + range.length > partitionEnd)
+                range.length = (range.address < partitionEnd) ? partitionEnd - range.address : 0;
 
-    if (driveLen > 0)
-    {
-        // read the crap at the end
-        io->ReadBytes(buffer, driveLen);
-        outBackup.WriteBytes(buffer, driveLen);
+            if (range.length != 0)
+                freeRanges.push_back(range);
+        }
     }
 
-    if (progress)
-        progress(arg, totalProgress, totalProgress);
-
-    outBackup.Close();
-
-    delete buffer;
+    std::sort(freeRanges.begin(), freeRanges.end(), compareFreeRanges);
+    return freeRanges;
 }
 
 void FatxDrive::RestoreFromBackup(std::string backupPath, void (*progress)(void *, DWORD, DWORD),
         void *arg)
 {
-    /* Here's the thing... fstream is trash. It will only handle files up to 2GB or 4GB,
-       at least on my windows 7 machine. That's a huge problem because drive backups will
-       most likely be a lot larger than that. SOOOOOO it looks like I'll have to use OS
-       specific functions in order to get this to work properly. It makes more sense
-       to just make the FileIO class use the OS specific functions to begin with, but
-       the ReadFile/WriteFile functions are slower than fstream functions, probably because
-       they don't cache a bunch of stuff.
-    */
-
-    BYTE *buffer = new BYTE[0x100000];
-    UINT64 bytesLeft;
-
-#ifdef __WIN32
-    std::wstring wBackupPath;
-    wBackupPath.assign(backupPath.begin(), backupPath.end());
-    HANDLE hFile = CreateFile(wBackupPath.c_str(), GENERIC_READ, NULL, NULL, OPEN_EXISTING,
-            FILE_ATTRIBUTE_NORMAL, NULL);
-
-    if (hFile == INVALID_HANDLE_VALUE)
-        throw std::string("FATX: Could not open drive backup.");
-
-    DWORD high;
-    DWORD low = GetFileSize(hFile, &high);
-    bytesLeft = ((UINT64)high << 32) | low;
-
-    SetFilePointer(hFile, 0, 0, FILE_BEGIN);
-#else
-    struct stat sb;
-    stat(backupPath.c_str(), &sb);
-    bytesLeft = sb.st_size;
-
-    int backupFile = open(backupPath.c_str(), O_RDWR);
-    if (backupFile == -1)
-        throw std::string("FATX: Could not open drive backup.");
-
-    lseek(backupFile, 0, SEEK_SET);
-#endif
-
-    io->SetPosition(0);
-
-    UINT64 totalProgress = bytesLeft / 0x100000;
-    DWORD i = 0;
-    while (bytesLeft >= 0x100000)
+    // only the recorded extents need to be written for the sparse backups
+    if (FatxBackup::IsFatxBackup(backupPath))
     {
-#ifdef __WIN32
-        high = (i * (UINT64)0x100000) >> 32;
-        SetFilePointer(hFile, (i * (UINT64)0x100000) & 0xFFFFFFFF, (PLONG)&high, FILE_BEGIN);
-
-        ReadFile(hFile, buffer, 0x100000, &high, NULL);
-#else
-        lseek(backupFile, (UINT64)i * (UINT64)0x100000, SEEK_SET);
-        read(backupFile, buffer, 0x100000);
-#endif
-        io->WriteBytes(buffer, 0x100000);
-        bytesLeft -= 0x100000;
+        FatxBackup backup(backupPath);
+        backup.Restore(io, progress, arg);
 
-        if (progress)
-            progress(arg, i, totalProgress);
-        i++;
+        ReloadDrive();
+        return;
     }
 
-    if (bytesLeft > 0)
-    {
-#ifdef __WIN32
-        SetFilePointer(hFile, (i * (UINT64)0x100000) & 0xFFFFFFFF, (PLONG)&high, FILE_BEGIN);
-        ReadFile(hFile, buffer, bytesLeft, &high, NULL);
-#else
-        lseek(backupFile, (UINT64)i * (UINT64)0x100000, SEEK_SET);
-        read(backupFile, buffer, bytesLeft);
-#endif
-        io->WriteBytes(buffer, bytesLeft);
-    }
+    // older backups are a raw image of the whole drive
+    FileIO backup(backupPath);
+    UINT64 backupLength = backup.Length();
 
-    if (progress)
-        progress(arg, totalProgress, totalProgress);
+    AsyncCopy copy(&backup, io);
+    copy.Copy(0, 0, backupLength, progress, arg);
 
-#ifdef __WIN32
-    CloseHandle(hFile);
-#else
-    close(backupFile);
-#endif
-    delete[] buffer;
+    backup.Close();
+    io->Flush();
 
     // reload the entire drive
     ReloadDrive();
@@ -725,6 +781,8 @@ bool FatxDrive::validFileChar(char c)
 
 FatxDrive::~FatxDrive()
 {
+    delete contentCatalog;
+
     if (type == FatxHarddrive)
     {
         delete[] securityBlob.msLogo;
@@ -760,30 +818,6 @@ void FatxDrive::loadProfiles()
     GetChildFileEntries(contentRoot);
 }
 
-void FatxDrive::injectRange(vector<DWORD> &clusters, Range &range)
-{
-    // do a binary search to find the position to inject the clusters
-    int start = 0, end = clusters.size() - 1, pos = 0;
-    while (start < end)
-    {
-        pos = (start + end) / 2;
-        if (clusters.at(pos) < range.start)
-            start = pos + 1;
-        else if (clusters.at(pos) > range.start)
-            end = pos - 1;
-        else if (clusters.at(pos) == range.start)
-            throw std::string("FATX: Error freeing cluster, cluster already free.\n");
-    }
-
-    // generate the range of clusters to inject
-    vector<DWORD> sillyRange;
-    for (DWORD i = 0; i < range.len; i++)
-        sillyRange.push_back(range.start + i);
-
-    // insert that range, yo
-    clusters.insert(clusters.begin() + start, sillyRange.begin(), sillyRange.end());
-}
-
 void FatxDrive::loadFatxDrive(std::wstring drivePath)
 {
     if (type == FatxHarddrive)
@@ -793,16 +827,32 @@ void FatxDrive::loadFatxDrive(std::wstring drivePath)
     }
     else if (type == FatxFlashDrive)
     {
-        std::vector<std::string> dataFiles;
-        std::stringstream ss;
-        for (int i = 0; i < 3; i++)
+        std::string path(drivePath.begin(), drivePath.end());
+
+        // an image of the data files joined together is read like a hard drive image
+        if (isRegularFile(path))
+            io = new DeviceIO(drivePath);
+        else
         {
-            ss << "F:/Xbox360/Data000" << i;
-            dataFiles.push_back(ss.str());
-            ss.str(std::string());
-        }
+            if (path.size() != 0 && (path.at(path.size() - 1) == '/' || path.at(path.size() - 1) == '\\'))
+                path.erase(path.size() - 1);
 
-        io = new MultiFileIO(dataFiles);
+            // the data files are numbered from Data0000, and there are at least 3 of them
+            std::vector<std::string> dataFiles;
+            for (int i = 0; ; i++)
+            {
+                std::stringstream ss;
+                ss << path << "/Data" << std::setw(4) << std::setfill('0') << i;
+                if (!isRegularFile(ss.str()))
+                    break;
+                dataFiles.push_back(ss.str());
+            }
+
+            if (dataFiles.size() < 3)
+                throw std::string("FATX: The folder doesn't have the flash drive's data files in it.\n");
+
+            io = new MultiFileIO(dataFiles);
+        }
     }
 
     loadFatxDrive();
@@ -956,10 +1006,39 @@ void FatxDrive::loadFatxDrive()
     }
 }
 
+void FatxDrive::findFreeClusters(Partition *part, const BYTE *fat, DWORD firstCluster, DWORD count,
+        FatxFreeSpace &freeClusters, DWORD &runStart, DWORD &runLength)
+{
+    bool clusterSizeIs2 = (part->clusterEntrySize == FAT16);
+    for (DWORD i = 0; i < count; i++)
+    {
+        bool available;
+        if (clusterSizeIs2)
+            available = ((fat[i * 2] << 8) | fat[i * 2 + 1]) == FAT_CLUSTER16_AVAILABLE;
+        else
+            available = (((DWORD)fat[i * 4] << 24) | ((DWORD)fat[i * 4 + 1] << 16) |
+                    ((DWORD)fat[i * 4 + 2] << 8) | fat[i * 4 + 3]) == FAT_CLUSTER_AVAILABLE;
+        if (!available)
+            continue;
+
+        // extend the run being read in, or add it and start a new one
+        DWORD cluster = firstCluster + i;
+        if (runLength != 0 && runStart + runLength == cluster)
+        {
+            runLength++;
+            continue;
+        }
+
+        freeClusters.Free(runStart, runLength);
+        runStart = cluster;
+        runLength = 1;
+    }
+}
+
 UINT64 FatxDrive::GetFreeMemory(Partition *part, void(*progress)(void*, bool), void *arg)
 {
-    if (part->freeMemory != 0)
-        return (UINT64)part->freeClusters.size() * (UINT64)part->clusterSize;
+    if (part->freeMemoryCounted)
+        return (UINT64)part->freeClusters.ClusterCount() * (UINT64)part->clusterSize;
 
     // allocate memory for a buffer to minimize the amount of reads
     BYTE *buffer = new BYTE[0x50000];
@@ -967,51 +1046,43 @@ UINT64 FatxDrive::GetFreeMemory(Partition *part, void(*progress)(void*, bool), v
     // seek to the chainmap
     io->SetPosition(part->address + 0x1000);
 
-    // check if it's FAT16
-    bool clusterSizeIs2 = (part->clusterEntrySize == FAT16);
+    // the free clusters are collected into runs as they're found
+    part->freeClusters.Clear();
+    DWORD runStart = 0, runLength = 0;
 
     UINT64 bytesLeft = (UINT64)part->clusterCount * (UINT64)part->clusterEntrySize;
-    DWORD readSize;
-    DWORD x = 0;
-    while (bytesLeft > 0)
+    DWORD cluster = 0;
+    try
     {
-        // calculate the read size
-        readSize = (bytesLeft > 0x50000) ? 0x50000 : bytesLeft;
-        bytesLeft -= readSize;
+        while (bytesLeft > 0)
+        {
+            // calculate the read size
+            DWORD readSize = (bytesLeft > 0x50000) ? 0x50000 : bytesLeft;
+            bytesLeft -= readSize;
 
-        // read in the segment
-        io->ReadBytes(buffer, readSize);
-        MemoryIO memory(buffer, 0x50000);
-        memory.SetPosition(0);
+            // read in the segment
+            io->ReadBytes(buffer, readSize);
 
-        // update progress if needed
-        if (progress)
-            progress(arg, false);
+            // update progress if needed
+            if (progress)
+                progress(arg, false);
 
-        // iterate through all of the clusters
-        if (clusterSizeIs2)
-        {
-            for (DWORD i = 0; i < (readSize / 2); i++)
-            {
-                if (memory.ReadWord() == FAT_CLUSTER16_AVAILABLE)
-                    part->freeClusters.push_back(x + i);
-            }
-            x += 0x28000;
-        }
-        else
-        {
-            for (DWORD i = 0; i < (readSize / 4); i++)
-            {
-                DWORD test = memory.ReadDword();
-                if (test == FAT_CLUSTER_AVAILABLE)
-                    part->freeClusters.push_back(x + i);
-            }
-            x += 0x14000;
+            // iterate through all of the clusters
+            DWORD count = readSize / part->clusterEntrySize;
+            findFreeClusters(part, buffer, cluster, count, part->freeClusters, runStart, runLength);
+            cluster += count;
         }
     }
+    catch (...)
+    {
+        delete[] buffer;
+        throw;
+    }
+    part->freeClusters.Free(runStart, runLength);
 
     // calculate the amount of free memory
-    part->freeMemory = (UINT64)part->freeClusters.size() * (UINT64)part->clusterSize;
+    part->freeMemory = (UINT64)part->freeClusters.ClusterCount() * (UINT64)part->clusterSize;
+    part->freeMemoryCounted = true;
 
     // cleanup
     delete[] buffer;
@@ -1022,14 +1093,100 @@ UINT64 FatxDrive::GetFreeMemory(Partition *part, void(*progress)(void*, bool), v
     return part->freeMemory;
 }
 
+void FatxDrive::MountPartitions(void(*partitionReady)(void*, Partition*), void *arg)
+{
+    FatxMounter mounter(this);
+    mounter.Start();
+
+    Partition *part;
+    while ((part = mounter.WaitForNext()) != NULL)
+        if (partitionReady)
+            partitionReady(arg, part);
+}
+
+FatxFragmentationReport FatxDrive::GetFragmentationReport(Partition *part)
+{
+    FatxDefragmenter defragmenter(this, io, part);
+    return defragmenter.Analyze();
+}
+
+FatxDefragmentationResult FatxDrive::Defragment(Partition *part, void (*progress)(void *, DWORD, DWORD),
+        void *arg)
+{
+    FatxDefragmenter defragmenter(this, io, part);
+    return defragmenter.Defragment(progress, arg);
+}
+
+FatxRecoveryScan FatxDrive::FindDeletedFiles(Partition *part, void (*progress)(void *, DWORD, DWORD),
+        void *arg)
+{
+    FatxRecovery recovery(this, io, part);
+    return recovery.Scan(progress, arg);
+}
+
+FatxFileEntry *FatxDrive::RecoverFile(const FatxDeletedEntry &deleted, std::string newName)
+{
+    FatxRecovery recovery(this, io, deleted.partition);
+    FatxFileEntry *entry = recovery.Restore(deleted, newName);
+
+    if (contentCatalog != NULL && contentCatalog->GetPartition() == entry->partition)
+        recatalogEntries(entry);
+
+    return entry;
+}
+
+void FatxDrive::ExtractDeletedFile(const FatxDeletedEntry &deleted, std::string outPath,
+        void (*progress)(void *, DWORD, DWORD), void *arg)
+{
+    FatxRecovery recovery(this, io, deleted.partition);
+    recovery.Extract(deleted, outPath, progress, arg);
+}
+
+FatxContentCatalog *FatxDrive::GetContentCatalog(void (*progress)(void *, DWORD, DWORD), void *arg)
+{
+    if (contentCatalog != NULL)
+        return contentCatalog;
+
+    Partition *content = NULL;
+    for (size_t i = 0; i < partitions.size(); i++)
+        if (partitions.at(i)->name == "Content")
+            content = partitions.at(i);
+
+    if (content == NULL)
+        throw std::string("FATX: The drive doesn't have a Content partition.\n");
+
+    FatxContentCatalog *catalog = new FatxContentCatalog(this, io, content);
+    try
+    {
+        catalog->Build(progress, arg);
+    }
+    catch (...)
+    {
+        delete catalog;
+        throw;
+    }
+
+    contentCatalog = catalog;
+    return contentCatalog;
+}
+
 void FatxDrive::ReloadDrive()
 {
+    // the partitions the catalog points to are about to be replaced
+    delete contentCatalog;
+    contentCatalog = NULL;
+
     if (type == FatxHarddrive)
         delete[] securityBlob.msLogo;
 
+    // every entry goes along with its partition, so nothing in the cache is any good after this
     for (int i = 0, count = partitions.size(); i < count; i++)
         delete partitions[i];
     partitions.clear();
+    {
+        MutexLocker locker(lookupMutex);
+        pathCache.Clear();
+    }
 
     loadFatxDrive();
 }
@@ -1041,47 +1198,34 @@ bool FatxDrive::FileExists(std::string filePath)
 
 bool FatxDrive::FileExists(FatxFileEntry *folder, std::string fileName, bool checkDeleted)
 {
-    GetChildFileEntries(folder);
-
-    for (size_t i = 0; i < folder->cachedFiles.size(); i++)
-    {
-        // there's a better way to do this, but...
-        if (folder->cachedFiles.at(i).name == fileName)
-        {
-            if (folder->cachedFiles.at(i).nameLen == FATX_ENTRY_DELETED)
-            {
-                if (checkDeleted)
-                    return true;
-            }
-            else
-                return true;
-        }
-    }
-
-    return false;
+    MutexLocker locker(lookupMutex);
+    readChildFileEntries(folder, NULL, NULL);
+    return folder->childIndex.Find(folder->cachedFiles, fileName, checkDeleted) != NULL;
 }
 
 FatxFileEntry* FatxDrive::GetFileEntry(std::string filePath)
 {
     // make sure the path starts with "Drive:\\"
-    if (filePath.size() < 7 || filePath.substr(0, 7) != "Drive:\\")
+    if (filePath.size() < 7 || filePath.compare(0, 7, "Drive:\\") != 0)
         throw string("FATX: Invalid path name.");
 
-    // strip off the prefix
-    filePath = filePath.substr(7);
+    MutexLocker locker(lookupMutex);
 
-    // get the partition
-    std::string partitionName = filePath.substr(0, filePath.find('\\'));
+    FatxFileEntry *cached = pathCache.Find(filePath);
+    if (cached != NULL)
+        return cached;
 
-    if (filePath.find('\\') == std::string::npos)
-        filePath = "";
-    else
-        filePath = filePath.substr(filePath.find('\\') + 1);
+    // get the partition
+    size_t nameStart = 7;
+    size_t nameEnd = filePath.find('\\', nameStart);
+    if (nameEnd == std::string::npos)
+        nameEnd = filePath.size();
+    std::string partitionName = filePath.substr(nameStart, nameEnd - nameStart);
 
     Partition *part = NULL;
     for (DWORD i = 0; i < partitions.size(); i++)
     {
-        if (partitions.at(i)->name == partitionName)
+        if (FatxNameIndex::NamesEqual(partitions.at(i)->name, partitionName))
         {
             part = partitions.at(i);
             break;
@@ -1092,41 +1236,94 @@ FatxFileEntry* FatxDrive::GetFileEntry(std::string filePath)
     if (part == NULL)
         return NULL;
 
+    // walk down the path a name at a time, finding each one in the folder's index
     FatxFileEntry *parent = &part->root;
-    while ((int)filePath.find('\\') >= 0 || filePath.size() > 0)
+    while (nameEnd < filePath.size())
     {
-        // load all the entries children (not recursively)
-        GetChildFileEntries(parent);
-
-        // get the next file name
-        std::string fileName = filePath.substr(0, filePath.find('\\'));
+        // a backslash on the end doesn't change anything
+        nameStart = nameEnd + 1;
+        if (nameStart == filePath.size())
+            break;
 
-        if (filePath.find('\\') == std::string::npos)
-            filePath = "";
-        else
-            filePath = filePath.substr(filePath.find('\\') + 1);
+        nameEnd = filePath.find('\\', nameStart);
+        if (nameEnd == std::string::npos)
+            nameEnd = filePath.size();
 
-        // check and see if the sub-directory exists
-        FatxFileEntry *foundEntry = NULL;
-        for (DWORD i = 0; i < parent->cachedFiles.size(); i++)
-        {
-            if (parent->cachedFiles.at(i).name == fileName &&
-                    parent->cachedFiles.at(i).nameLen != FATX_ENTRY_DELETED)
-            {
-                foundEntry = &parent->cachedFiles.at(i);
-                break;
-            }
-        }
+        // load all the entries children (not recursively)
+        readChildFileEntries(parent, NULL, NULL);
 
+        FatxFileEntry *foundEntry = parent->childIndex.Find(parent->cachedFiles,
+                filePath.substr(nameStart, nameEnd - nameStart));
         if (foundEntry == NULL)
             return NULL;
 
         parent = foundEntry;
     }
 
+    pathCache.Add(filePath, parent);
     return parent;
 }
 
+void FatxDrive::RenameFile(FatxFileEntry *entry, std::string newName)
+{
+    if (newName.size() == 0 || !ValidFileName(newName))
+        throw std::string("FATX: Invalid file name.\n");
+
+    FatxFileEntry *parent = entry->parent;
+    if (parent == NULL)
+        throw std::string("FATX: Cannot rename the root of a partition.\n");
+
+    FatxFileEntry *existing = parent->childIndex.Find(parent->cachedFiles, newName);
+    if (existing != NULL && existing != entry)
+        throw std::string("FATX: Entry already exists.\n");
+
+    std::string oldPath = GetFolderPath(entry) + entry->name;
+    DWORD index = parent->childIndex.Remove(parent->cachedFiles, entry);
+
+    entry->name = newName;
+    entry->nameLen = newName.length();
+    parent->childIndex.Add(entry->name, index);
+
+    FatxIO entryIO = GetFatxIO(entry);
+    entryIO.WriteEntryToDisk();
+
+    // everything in the entry is in the catalog by its path
+    if (contentCatalog != NULL && contentCatalog->GetPartition() == entry->partition)
+    {
+        contentCatalog->Remove(oldPath);
+        recatalogEntries(entry);
+    }
+
+    // the entry hasn't moved, but it's cached by its old path, and so is everything in it
+    MutexLocker locker(lookupMutex);
+    pathCache.Clear();
+}
+
+void FatxDrive::recatalogEntries(FatxFileEntry *entry)
+{
+    contentCatalog->Update(entry);
+
+    // the catalog reads every folder on the partition, so there's nothing in ones that weren't
+    if (!(entry->fileAttributes & FatxDirectory) || !entry->readDirectories)
+        return;
+
+    for (size_t i = 0; i < entry->cachedFiles.size(); i++)
+        if (entry->cachedFiles.at(i).nameLen != FATX_ENTRY_DELETED)
+            recatalogEntries(&entry->cachedFiles.at(i));
+}
+
+std::string FatxDrive::GetFolderPath(FatxFileEntry *entry)
+{
+    std::vector<FatxFileEntry*> folders;
+    for (FatxFileEntry *folder = entry->parent; folder != NULL; folder = folder->parent)
+        folders.push_back(folder);
+
+    std::string path = "Drive:\\";
+    for (size_t i = folders.size(); i > 0; i--)
+        path += folders.at(i - 1)->name + "\\";
+    return path;
+}
+
 void FatxDrive::SetDriveName(std::wstring name)
 {
     FatxFileEntry *nameEntry = GetFileEntry("Drive:\\Content\\name.txt");
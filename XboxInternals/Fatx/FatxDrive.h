@@ -11,7 +11,14 @@
 #include "../IO/FatxIO.h"
 #include "../IO/MemoryIO.h"
 #include "../IO/MultiFileIO.h"
+#include "FatxBackup.h"
+#include "FatxDefragmenter.h"
+#include "FatxContentCatalog.h"
+#include "FatxCopier.h"
+#include "FatxMounter.h"
+#include "FatxRecovery.h"
 #include "../Cryptography/XeKeys.h"
+#include "../Threading/Thread.h"
 #include "../Cryptography/XeCrypt.h"
 
 #include <iostream>
@@ -28,6 +35,9 @@ public:
     #ifdef __WIN32
     FatxDrive(void* deviceHandle, FatxDriveType type = FatxHarddrive);
     #endif
+
+    // the path can be the device or an image of it in a regular file. For flash drives it can also
+    // be the folder with the drive's data files in it
     FatxDrive(std::string drivePath, FatxDriveType type = FatxHarddrive);
     FatxDrive(std::wstring drivePath, FatxDriveType type = FatxHarddrive);
     ~FatxDrive();
@@ -41,7 +51,9 @@ public:
     // get a FatxIO for the given entry
     FatxIO GetFatxIO(FatxFileEntry *entry);
 
-    // populate entry's cachedFiles vector (only if it's a directory)
+    // populate entry's cachedFiles vector (only if it's a directory). Like GetFileEntry and
+    // FileExists it can be called from more than one thread at once, everything that writes to the
+    // drive still has to be the only thing using it
     void GetChildFileEntries(FatxFileEntry *entry, void(*progress)(void*, bool) = NULL,
             void *arg = NULL);
 
@@ -79,31 +91,67 @@ public:
     // determines if a file in the specified folder exists
     bool FileExists(FatxFileEntry *folder, std::string fileName, bool checkDeleted = false);
 
-    // get the FatxFileEntry from its path
+    // copy the entries, along with everything in the folders, into a folder on the destination drive
+    FatxCopyResult CopyFiles(const std::vector<FatxFileEntry*> &entries, FatxDrive *destination,
+            FatxFileEntry *destinationFolder, void(*progress)(void*, DWORD, DWORD) = NULL,
+            void *arg = NULL);
+
+    // get the FatxFileEntry from its path, names are compared ignoring case
     FatxFileEntry* GetFileEntry(std::string filePath);
 
+    // give the entry a new name and write it to disk
+    void RenameFile(FatxFileEntry *entry, std::string newName);
+
     // sets the drive name
     void SetDriveName(std::wstring name);
 
     // close the underlying io
     void Close();
 
-    // Write the entire contents of the drive to the local disk
+    // Write the used parts of the drive to the local disk, compressed. If a base backup is given
+    // only the parts that changed since it was made are written
     void CreateBackup(std::string outPath, void(*progress)(void*, DWORD, DWORD) = NULL,
-            void *arg = NULL);
+            void *arg = NULL, std::string basePath = "");
 
-    // re-Write the entire contents of the drive using a backup from the local disk
+    // re-Write the contents of the drive using a backup from the local disk, raw images are supported too
     void RestoreFromBackup(std::string backupPath, void(*progress)(void*, DWORD, DWORD) = NULL,
             void *arg = NULL);
 
     // get the amount of free bytes on the device
     UINT64 GetFreeMemory(Partition *part, void(*progress)(void*, bool) = NULL, void *arg = NULL);
 
+    // count the free memory and read the root folder of every partition, the partitions are read at
+    // the same time and partitionReady is called with each one as soon as it can be used
+    void MountPartitions(void(*partitionReady)(void*, Partition*) = NULL, void *arg = NULL);
+
+    // get how fragmented the files and folders on the partition are
+    FatxFragmentationReport GetFragmentationReport(Partition *part);
+
+    // move the fragmented files and folders on the partition so each one is in a single run of clusters
+    FatxDefragmentationResult Defragment(Partition *part, void(*progress)(void*, DWORD, DWORD) = NULL,
+            void *arg = NULL);
+
+    // find the deleted files and folders on the partition by reading through all of its clusters,
+    // including the ones in folders that have been deleted
+    FatxRecoveryScan FindDeletedFiles(Partition *part, void(*progress)(void*, DWORD, DWORD) = NULL,
+            void *arg = NULL);
+
+    // put an entry found by FindDeletedFiles back in its folder, with a new name if one's given
+    FatxFileEntry *RecoverFile(const FatxDeletedEntry &deleted, std::string newName = "");
+
+    // save what's left of a deleted file to the local disk, the drive isn't changed
+    void ExtractDeletedFile(const FatxDeletedEntry &deleted, std::string outPath,
+            void(*progress)(void*, DWORD, DWORD) = NULL, void *arg = NULL);
+
+    // get the catalog of the packages on the Content partition, it's built the first time and then
+    // kept up to date as files are injected and removed through the drive
+    FatxContentCatalog *GetContentCatalog(void(*progress)(void*, DWORD, DWORD) = NULL, void *arg = NULL);
+
     // reload the entire drive, called after restoring
     void ReloadDrive();
 
-    // convert a cluster to an offset
-    static INT64 ClusterToOffset(Partition *part, DWORD cluster);
+    // get the path of the folder the entry is in, with a backslash on the end
+    static std::string GetFolderPath(FatxFileEntry *entry);
 
     // check to see whether or not a file name is valid
     static bool ValidFileName(std::string fileName);
@@ -118,9 +166,18 @@ public:
     FlashDriveConfigurationData configurationData;
 
 private:
-    // Writes the 'newEntry' to disk, in the 'parent' folder
+    // Writes the 'newEntry' to disk, in the 'parent' folder. If writeEntry is false, its clusters are
+    // only allocated and committing them and writing the entry is up to the caller
     FatxFileEntry* createFileEntry(FatxFileEntry *parent, FatxFileEntry *newEntry,
-            bool errorIfAlreadyExists = true);
+            bool errorIfAlreadyExists = true, bool writeEntry = true);
+
+    // check if the next entry made in the folder needs another cluster to go in
+    bool folderIsFull(FatxFileEntry *folder);
+
+    // take an entry made by createFileEntry without writing it back out of its folder, and give
+    // its clusters back. It has to be the last entry added to the folder, and its FAT changes have
+    // to be discarded by the caller
+    void discardFileEntry(FatxFileEntry *entry);
 
     // open up a physical drive
     void loadFatxDrive(std::wstring drivePath);
@@ -139,8 +196,28 @@ private:
     // load all the profiles on the device
     void loadProfiles();
 
-    // inject a range of clustes into the chain
-    void injectRange(vector<DWORD> &clusters, Range &range);
+    // get the ranges of the drive that are only made up of free clusters, sorted by address
+    std::vector<FatxBackupRange> getFreeRanges();
+
+    // add the free clusters in count entries of the FAT, starting with firstCluster's, to freeClusters.
+    // The run that's being read in is kept going from one part of the FAT to the next
+    static void findFreeClusters(Partition *part, const BYTE *fat, DWORD firstCluster, DWORD count,
+            FatxFreeSpace &freeClusters, DWORD &runStart, DWORD &runLength);
+
+    // GetChildFileEntries for when lookupMutex is already held
+    void readChildFileEntries(FatxFileEntry *entry, void(*progress)(void*, bool), void *arg);
+
+    // read the entries in one of the folder's clusters into outEntries, false once the end of the
+    // folder's been reached
+    static bool readDirectoryCluster(FatxFileEntry *folder, BYTE *cluster, UINT64 clusterAddress,
+            std::vector<FatxFileEntry> &outEntries);
+
+    // mark the entry and everything in it deleted, and add their clusters to clusters
+    void removeEntries(FatxFileEntry *entry, std::vector<DWORD> &clusters, void(*progress)(void*),
+            void *arg);
+
+    // add the entry and everything in it back to the catalog after it's been renamed
+    void recatalogEntries(FatxFileEntry *entry);
 
     // counts the largest amount of consecutive unset bits
     static BYTE cntlzw(DWORD x);
@@ -152,6 +229,15 @@ private:
     std::vector<Partition*> partitions;
     std::vector<FatxFileEntry*> profiles;
     FatxDriveType type;
+    FatxContentCatalog *contentCatalog;
+    FatxPathCache pathCache;
+
+    // held while the path cache is used, and while a folder's entries are read in the first time
+    // it's looked in, so lookups from more than one thread don't change them at the same time
+    Mutex lookupMutex;
+
+    friend class FatxCopier;
+    friend class FatxMounter;
 };
 
 #endif // FATXDRIVE_H
@@ -0,0 +1,207 @@
+#include "FatxFreeSpace.h"
+
+#include <algorithm>
+#include <string>
+
+FatxFreeSpace::FatxFreeSpace() : clusterCount(0)
+{
+}
+
+bool FatxFreeSpace::LongestFirst::operator()(const std::pair<DWORD, DWORD> &a,
+        const std::pair<DWORD, DWORD> &b) const
+{
+    if (a.first != b.first)
+        return a.first > b.first;
+    return a.second < b.second;
+}
+
+void FatxFreeSpace::addRun(DWORD start, DWORD length)
+{
+    runs[start] = length;
+    runsByLength.insert(std::make_pair(length, start));
+    clusterCount += length;
+}
+
+void FatxFreeSpace::removeRun(std::map<DWORD, DWORD>::iterator run)
+{
+    runsByLength.erase(std::make_pair(run->second, run->first));
+    clusterCount -= run->second;
+    runs.erase(run);
+}
+
+void FatxFreeSpace::Free(DWORD cluster, DWORD count)
+{
+    if (count == 0)
+        return;
+
+    DWORD start = cluster, end = cluster + count;
+
+    // find the first run after the clusters being freed
+    std::map<DWORD, DWORD>::iterator next = runs.lower_bound(start);
+    if (next != runs.end() && next->first < end)
+        throw std::string("FATX: Error freeing cluster, cluster already free.\n");
+
+    // merge with the run before it if they touch
+    if (next != runs.begin())
+    {
+        std::map<DWORD, DWORD>::iterator previous = next;
+        --previous;
+
+        DWORD previousEnd = previous->first + previous->second;
+        if (previousEnd > start)
+            throw std::string("FATX: Error freeing cluster, cluster already free.\n");
+        if (previousEnd == start)
+        {
+            start = previous->first;
+            removeRun(previous);
+        }
+    }
+
+    // and with the one after it
+    if (next != runs.end() && next->first == end)
+    {
+        end += next->second;
+        removeRun(next);
+    }
+
+    addRun(start, end - start);
+}
+
+void FatxFreeSpace::Free(std::vector<DWORD> clusters)
+{
+    std::sort(clusters.begin(), clusters.end());
+    clusters.erase(std::unique(clusters.begin(), clusters.end()), clusters.end());
+
+    // free them a run at a time
+    for (size_t i = 0; i < clusters.size(); )
+    {
+        size_t runEnd = i + 1;
+        while (runEnd < clusters.size() && clusters.at(runEnd) == clusters.at(runEnd - 1) + 1)
+            runEnd++;
+
+        Free(clusters.at(i), runEnd - i);
+        i = runEnd;
+    }
+}
+
+std::vector<DWORD> FatxFreeSpace::Allocate(DWORD count)
+{
+    if (count > clusterCount)
+        throw std::string("FATX: Cannot find requested amount of free clusters.\n");
+
+    std::vector<DWORD> clusters;
+    clusters.reserve(count);
+
+    while (count != 0)
+    {
+        std::pair<DWORD, DWORD> longest = *runsByLength.begin();
+        DWORD start = longest.second, length = longest.first;
+        DWORD toTake = (length > count) ? count : length;
+
+        for (DWORD i = 0; i < toTake; i++)
+            clusters.push_back(start + i);
+
+        // whatever's left of the run stays free
+        removeRun(runs.find(start));
+        if (toTake != length)
+            addRun(start + toTake, length - toTake);
+
+        count -= toTake;
+    }
+
+    return clusters;
+}
+
+bool FatxFreeSpace::AllocateRun(DWORD count, DWORD &outStart)
+{
+    if (count == 0 || count > clusterCount)
+        return false;
+
+    // the runs are sorted longest first, so the one before the first run that's too short is the
+    // shortest one it fits in
+    std::set<std::pair<DWORD, DWORD>, LongestFirst>::iterator fit =
+            runsByLength.lower_bound(std::make_pair(count, (DWORD)0xFFFFFFFF));
+    if (fit == runsByLength.begin())
+        return false;
+    --fit;
+
+    DWORD start = fit->second, length = fit->first;
+    removeRun(runs.find(start));
+    if (length != count)
+        addRun(start + count, length - count);
+
+    outStart = start;
+    return true;
+}
+
+bool FatxFreeSpace::AllocateRange(DWORD cluster, DWORD count)
+{
+    if (count == 0)
+        return true;
+
+    // find the run the clusters would have to be in
+    std::map<DWORD, DWORD>::iterator run = runs.upper_bound(cluster);
+    if (run == runs.begin())
+        return false;
+    --run;
+
+    DWORD start = run->first, end = run->first + run->second;
+    if ((UINT64)cluster + count > end)
+        return false;
+
+    // whatever's on either side of them stays free
+    removeRun(run);
+    if (cluster != start)
+        addRun(start, cluster - start);
+    if (cluster + count != end)
+        addRun(cluster + count, end - (cluster + count));
+
+    return true;
+}
+
+DWORD FatxFreeSpace::CountFree(DWORD cluster, DWORD count) const
+{
+    UINT64 end = (UINT64)cluster + count;
+
+    // start with the run that has the first cluster in it, if there is one
+    std::map<DWORD, DWORD>::const_iterator run = runs.upper_bound(cluster);
+    if (run != runs.begin())
+    {
+        --run;
+        if ((UINT64)run->first + run->second <= cluster)
+            ++run;
+    }
+
+    DWORD free = 0;
+    for (; run != runs.end() && run->first < end; ++run)
+    {
+        UINT64 overlapStart = (run->first > cluster) ? run->first : cluster;
+        UINT64 overlapEnd = (UINT64)run->first + run->second;
+        if (overlapEnd > end)
+            overlapEnd = end;
+        free += overlapEnd - overlapStart;
+    }
+    return free;
+}
+
+DWORD FatxFreeSpace::ClusterCount() const
+{
+    return clusterCount;
+}
+
+bool FatxFreeSpace::Empty() const
+{
+    return clusterCount == 0;
+}
+
+void FatxFreeSpace::Clear()
+{
+    runs.clear();
+    runsByLength.clear();
+    clusterCount = 0;
+}
+
+const std::map<DWORD, DWORD> &FatxFreeSpace::Runs() const
+{
+    return runs;
+}
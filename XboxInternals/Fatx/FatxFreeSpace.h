@@ -0,0 +1,64 @@
+#ifndef FATXFREESPACE_H
+#define FATXFREESPACE_H
+
+#include "../winnames.h"
+#include "XboxInternals_global.h"
+
+#include <map>
+#include <set>
+#include <vector>
+
+// the free clusters on a partition, stored as runs of consecutive clusters so that freeing and
+// allocating them doesn't have to touch every cluster in between
+class XBOXINTERNALSSHARED_EXPORT FatxFreeSpace
+{
+public:
+    FatxFreeSpace();
+
+    // mark count clusters starting at cluster as free, they're merged with the runs next to them
+    void Free(DWORD cluster, DWORD count = 1);
+
+    // mark all of the clusters as free, they can be in any order and contain duplicates
+    void Free(std::vector<DWORD> clusters);
+
+    // take count clusters out of the free space, the longest runs are used first
+    std::vector<DWORD> Allocate(DWORD count);
+
+    // take count consecutive clusters out of the free space from the shortest run they fit in, false
+    // if there isn't a run that long
+    bool AllocateRun(DWORD count, DWORD &outStart);
+
+    // take the count clusters starting at cluster out of the free space, false if they aren't all free
+    bool AllocateRange(DWORD cluster, DWORD count);
+
+    // how many of the count clusters starting at cluster are free
+    DWORD CountFree(DWORD cluster, DWORD count) const;
+
+    // the total number of free clusters
+    DWORD ClusterCount() const;
+
+    bool Empty() const;
+
+    void Clear();
+
+    // the free runs, the key is the first cluster and the value is the run's length
+    const std::map<DWORD, DWORD> &Runs() const;
+
+private:
+    struct LongestFirst
+    {
+        bool operator()(const std::pair<DWORD, DWORD> &a, const std::pair<DWORD, DWORD> &b) const;
+    };
+
+    void addRun(DWORD start, DWORD length);
+    void removeRun(std::map<DWORD, DWORD>::iterator run);
+
+    std::map<DWORD, DWORD> runs;
+
+    // (length, start) of every run, so the longest one can be found without searching
+    std::set<std::pair<DWORD, DWORD>, LongestFirst> runsByLength;
+
+    DWORD clusterCount;
+};
+
+#endif // FATXFREESPACE_H
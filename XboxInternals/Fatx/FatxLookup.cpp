@@ -0,0 +1,168 @@
+#include "FatxLookup.h"
+#include "FatxConstants.h"
+
+// the first amount of buckets, enough for a folder that fits in a 16 KiB cluster
+#define FATX_NAME_INDEX_MIN_BUCKETS 0x100
+
+static char lowerCase(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? (c - 'A' + 'a') : c;
+}
+
+FatxNameIndex::FatxNameIndex() : count(0)
+{
+}
+
+void FatxNameIndex::Clear()
+{
+    buckets.clear();
+    count = 0;
+}
+
+DWORD FatxNameIndex::hashName(const std::string &name)
+{
+    // FNV-1a of the lower case name
+    DWORD hash = 0x811C9DC5;
+    for (size_t i = 0; i < name.size(); i++)
+    {
+        hash ^= (BYTE)lowerCase(name.at(i));
+        hash *= 0x01000193;
+    }
+    return hash;
+}
+
+bool FatxNameIndex::NamesEqual(const std::string &a, const std::string &b)
+{
+    if (a.size() != b.size())
+        return false;
+
+    for (size_t i = 0; i < a.size(); i++)
+        if (lowerCase(a.at(i)) != lowerCase(b.at(i)))
+            return false;
+    return true;
+}
+
+void FatxNameIndex::grow()
+{
+    std::vector<std::vector<std::pair<DWORD, DWORD> > > old;
+    old.swap(buckets);
+
+    DWORD bucketCount = old.size() ? old.size() * 2 : FATX_NAME_INDEX_MIN_BUCKETS;
+    buckets.resize(bucketCount);
+
+    for (size_t i = 0; i < old.size(); i++)
+        for (size_t x = 0; x < old.at(i).size(); x++)
+            buckets.at(old.at(i).at(x).first & (bucketCount - 1)).push_back(old.at(i).at(x));
+}
+
+void FatxNameIndex::Add(const std::string &name, DWORD index)
+{
+    if (count >= buckets.size())
+        grow();
+
+    DWORD hash = hashName(name);
+    buckets.at(hash & (buckets.size() - 1)).push_back(std::make_pair(hash, index));
+    count++;
+}
+
+DWORD FatxNameIndex::Remove(std::deque<FatxFileEntry> &files, FatxFileEntry *entry)
+{
+    if (buckets.size() != 0)
+    {
+        std::vector<std::pair<DWORD, DWORD> > &bucket =
+                buckets.at(hashName(entry->name) & (buckets.size() - 1));
+        for (size_t i = 0; i < bucket.size(); i++)
+        {
+            DWORD index = bucket.at(i).second;
+            if (index < files.size() && &files.at(index) == entry)
+            {
+                bucket.erase(bucket.begin() + i);
+                count--;
+                return index;
+            }
+        }
+    }
+
+    throw std::string("FATX: Entry is not in the folder.\n");
+}
+
+FatxFileEntry *FatxNameIndex::Find(std::deque<FatxFileEntry> &files, const std::string &name,
+        bool includeDeleted) const
+{
+    if (buckets.size() == 0)
+        return NULL;
+
+    DWORD hash = hashName(name);
+    const std::vector<std::pair<DWORD, DWORD> > &bucket = buckets.at(hash & (buckets.size() - 1));
+
+    FatxFileEntry *deleted = NULL;
+    for (size_t i = 0; i < bucket.size(); i++)
+    {
+        if (bucket.at(i).first != hash || bucket.at(i).second >= files.size())
+            continue;
+
+        FatxFileEntry *entry = &files.at(bucket.at(i).second);
+        if (!NamesEqual(entry->name, name))
+            continue;
+
+        if (entry->nameLen != FATX_ENTRY_DELETED)
+            return entry;
+        deleted = entry;
+    }
+
+    return includeDeleted ? deleted : NULL;
+}
+
+FatxPathCache::FatxPathCache(DWORD capacity) : capacity(capacity)
+{
+}
+
+std::string FatxPathCache::key(const std::string &path)
+{
+    std::string lower = path;
+    for (size_t i = 0; i < lower.size(); i++)
+        lower.at(i) = lowerCase(lower.at(i));
+    return lower;
+}
+
+FatxFileEntry *FatxPathCache::Find(const std::string &path)
+{
+    std::map<std::string, CachedPath>::iterator cached = paths.find(key(path));
+    if (cached == paths.end())
+        return NULL;
+
+    // move it to the front so it's the last to be forgotten
+    uses.splice(uses.begin(), uses, cached->second.use);
+    return cached->second.entry;
+}
+
+void FatxPathCache::Add(const std::string &path, FatxFileEntry *entry)
+{
+    if (capacity == 0)
+        return;
+
+    std::string pathKey = key(path);
+    std::map<std::string, CachedPath>::iterator cached = paths.find(pathKey);
+    if (cached != paths.end())
+    {
+        cached->second.entry = entry;
+        uses.splice(uses.begin(), uses, cached->second.use);
+        return;
+    }
+
+    if (paths.size() >= capacity)
+    {
+        paths.erase(uses.back());
+        uses.pop_back();
+    }
+
+    uses.push_front(pathKey);
+    CachedPath newPath = { entry, uses.begin() };
+    paths[pathKey] = newPath;
+}
+
+void FatxPathCache::Clear()
+{
+    paths.clear();
+    uses.clear();
+}
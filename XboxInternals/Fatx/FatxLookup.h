@@ -0,0 +1,84 @@
+#ifndef FATXLOOKUP_H
+#define FATXLOOKUP_H
+
+#include "../winnames.h"
+#include "XboxInternals_global.h"
+
+#include <deque>
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+// how many paths FatxDrive remembers the entries of
+#define FATX_PATH_CACHE_SIZE 1024
+
+struct FatxFileEntry;
+
+// finds the entries in a folder by name, ignoring case like FATX does. It holds the indices of the
+// entries in the folder's cachedFiles, so it has to be told about every entry added to them
+class XBOXINTERNALSSHARED_EXPORT FatxNameIndex
+{
+public:
+    FatxNameIndex();
+
+    void Clear();
+
+    // add the entry at index in cachedFiles
+    void Add(const std::string &name, DWORD index);
+
+    // remove the entry from the index before it's renamed, and get its index in files
+    DWORD Remove(std::deque<FatxFileEntry> &files, FatxFileEntry *entry);
+
+    // find the entry in files named name. Entries that aren't deleted come first, and deleted
+    // ones are only returned if includeDeleted is set. NULL if there isn't one
+    FatxFileEntry *Find(std::deque<FatxFileEntry> &files, const std::string &name,
+            bool includeDeleted = false) const;
+
+    // compare two names the way FATX does
+    static bool NamesEqual(const std::string &a, const std::string &b);
+
+private:
+    static DWORD hashName(const std::string &name);
+
+    // double the amount of buckets once there are more entries than buckets
+    void grow();
+
+    // (hash, index) of every entry, in the bucket picked by the hash
+    std::vector<std::vector<std::pair<DWORD, DWORD> > > buckets;
+    DWORD count;
+};
+
+// remembers the entries at the paths that were looked up last, it has to be cleared whenever an
+// entry's removed or renamed
+class XBOXINTERNALSSHARED_EXPORT FatxPathCache
+{
+public:
+    FatxPathCache(DWORD capacity = FATX_PATH_CACHE_SIZE);
+
+    // get the entry at path, NULL if it's not cached
+    FatxFileEntry *Find(const std::string &path);
+
+    // remember the entry at path, the one used least recently is forgotten if it's full
+    void Add(const std::string &path, FatxFileEntry *entry);
+
+    void Clear();
+
+private:
+    // paths are compared ignoring case, so they're stored in lower case
+    static std::string key(const std::string &path);
+
+    struct CachedPath
+    {
+        FatxFileEntry *entry;
+        std::list<std::string>::iterator use;
+    };
+
+    DWORD capacity;
+    std::map<std::string, CachedPath> paths;
+
+    // the paths, used most recently first
+    std::list<std::string> uses;
+};
+
+#endif // FATXLOOKUP_H
@@ -0,0 +1,285 @@
+#include "FatxMounter.h"
+#include "FatxDrive.h"
+
+class FatxMountWorker : public Thread
+{
+public:
+    FatxMountWorker(FatxMounter *mounter) :
+        mounter(mounter)
+    {
+    }
+
+protected:
+    void Run()
+    {
+        FatxMounter::MountTask *task;
+        while (mounter->takeTask(&task))
+        {
+            mounter->mount(task);
+            mounter->taskDone(task);
+        }
+    }
+
+private:
+    FatxMounter *mounter;
+};
+
+FatxMounter::FatxMounter(FatxDrive *drive, DWORD threadCount) :
+    drive(drive), device(dynamic_cast<DeviceIO*>(drive->io)), threadCount(threadCount), nextTask(0),
+    handedBack(0), stopping(false)
+{
+}
+
+FatxMounter::~FatxMounter()
+{
+    stop();
+
+    for (size_t i = 0; i < tasks.size(); i++)
+        delete tasks.at(i);
+}
+
+void FatxMounter::Start()
+{
+    std::vector<Partition*> partitions = drive->GetPartitions();
+    for (size_t i = 0; i < partitions.size(); i++)
+    {
+        Partition *part = partitions.at(i);
+
+        MountTask *task = new MountTask;
+        task->part = part;
+        task->countFreeMemory = !part->freeMemoryCounted;
+        task->readRoot = !part->root.readDirectories;
+        task->failed = false;
+        tasks.push_back(task);
+    }
+
+    if (device == NULL)
+        return;
+
+    // there's no point in having more threads than partitions
+    DWORD threads = (threadCount < tasks.size()) ? threadCount : tasks.size();
+    for (DWORD i = 0; i < threads; i++)
+    {
+        pool.push_back(new FatxMountWorker(this));
+        pool.back()->Start();
+    }
+}
+
+Partition *FatxMounter::WaitForNext()
+{
+    if (handedBack == tasks.size())
+        return NULL;
+
+    MountTask *task;
+    if (device == NULL)
+    {
+        // the io can only be used from this thread, so the partitions are read in order
+        task = tasks.at(handedBack);
+        if (task->countFreeMemory)
+            drive->GetFreeMemory(task->part);
+        if (task->readRoot)
+            drive->GetChildFileEntries(&task->part->root);
+        handedBack++;
+        return task->part;
+    }
+
+    {
+        MutexLocker locker(mutex);
+        while (finished.empty())
+            taskFinished.Wait(mutex);
+
+        task = finished.front();
+        finished.pop_front();
+    }
+    handedBack++;
+
+    if (task->failed)
+        throw task->error;
+
+    publish(task);
+    return task->part;
+}
+
+void FatxMounter::Finish()
+{
+    while (WaitForNext() != NULL)
+        ;
+}
+
+void FatxMounter::mount(MountTask *task)
+{
+    try
+    {
+        if (task->countFreeMemory)
+            readFreeClusters(task);
+        if (task->readRoot)
+            readRoot(task);
+    }
+    catch (std::string error)
+    {
+        task->failed = true;
+        task->error = error;
+    }
+    catch (...)
+    {
+        task->failed = true;
+        task->error = "FATX: Error reading the partition " + task->part->name + ".\n";
+    }
+}
+
+void FatxMounter::readFreeClusters(MountTask *task)
+{
+    Partition *part = task->part;
+
+    BYTE *buffer = DeviceIO::AllocateAligned(FATX_MOUNT_READ_SIZE);
+    try
+    {
+        DWORD runStart = 0, runLength = 0;
+        UINT64 address = part->address + 0x1000;
+        UINT64 bytesLeft = (UINT64)part->clusterCount * (UINT64)part->clusterEntrySize;
+        DWORD cluster = 0;
+
+        while (bytesLeft > 0)
+        {
+            // the other partitions can't be handed back while this one's going, so stop early
+            {
+                MutexLocker locker(mutex);
+                if (stopping)
+                    break;
+            }
+
+            DWORD readSize = (bytesLeft > FATX_MOUNT_READ_SIZE) ? FATX_MOUNT_READ_SIZE : bytesLeft;
+            device->ReadBytesAt(address, buffer, readSize);
+
+            DWORD count = readSize / part->clusterEntrySize;
+            FatxDrive::findFreeClusters(part, buffer, cluster, count, task->freeClusters, runStart,
+                    runLength);
+
+            cluster += count;
+            address += readSize;
+            bytesLeft -= readSize;
+        }
+        task->freeClusters.Free(runStart, runLength);
+    }
+    catch (...)
+    {
+        DeviceIO::FreeAligned(buffer);
+        throw;
+    }
+    DeviceIO::FreeAligned(buffer);
+}
+
+DWORD FatxMounter::readFatEntry(Partition *part, DWORD cluster)
+{
+    if (cluster > part->clusterCount)
+        throw std::string("FATX: Cluster is greater than cluster count.\n");
+
+    BYTE entry[4];
+    device->ReadBytesAt(part->address + 0x1000 + (UINT64)cluster * part->clusterEntrySize, entry,
+            part->clusterEntrySize);
+
+    if (part->clusterEntrySize == FAT16)
+        return ((DWORD)entry[0] << 8) | entry[1];
+    return ((DWORD)entry[0] << 24) | ((DWORD)entry[1] << 16) | ((DWORD)entry[2] << 8) | entry[3];
+}
+
+void FatxMounter::readRoot(MountTask *task)
+{
+    Partition *part = task->part;
+    FatxFileEntry *root = &part->root;
+
+    // the same as FatxDrive::ReadClusterChain, without the changes that haven't been committed
+    bool clusterSizeIs2 = (part->clusterEntrySize == FAT16);
+    DWORD lastCluster = (clusterSizeIs2) ? FAT_CLUSTER16_LAST : FAT_CLUSTER_LAST;
+    DWORD availableCluster = (clusterSizeIs2) ? FAT_CLUSTER16_AVAILABLE : FAT_CLUSTER_AVAILABLE;
+
+    DWORD cluster = root->startingCluster;
+    while (cluster != lastCluster && cluster != availableCluster)
+    {
+        task->rootChain.push_back(cluster);
+        if (task->rootChain.size() > part->clusterCount)
+            throw std::string("FATX: FAT has circular link.\n");
+
+        cluster = readFatEntry(part, cluster);
+    }
+
+    BYTE *buffer = DeviceIO::AllocateAligned(part->clusterSize);
+    try
+    {
+        for (size_t i = 0; i < task->rootChain.size(); i++)
+        {
+            UINT64 address = FatxIO::ClusterToOffset(part, task->rootChain.at(i));
+            device->ReadBytesAt(address, buffer, part->clusterSize);
+
+            if (!FatxDrive::readDirectoryCluster(root, buffer, address, task->rootEntries))
+                break;
+        }
+    }
+    catch (...)
+    {
+        DeviceIO::FreeAligned(buffer);
+        throw;
+    }
+    DeviceIO::FreeAligned(buffer);
+}
+
+void FatxMounter::publish(MountTask *task)
+{
+    Partition *part = task->part;
+
+    if (task->countFreeMemory && !part->freeMemoryCounted)
+    {
+        part->freeClusters = task->freeClusters;
+        part->freeMemory = (UINT64)part->freeClusters.ClusterCount() * (UINT64)part->clusterSize;
+        part->freeMemoryCounted = true;
+    }
+
+    MutexLocker locker(drive->lookupMutex);
+    if (task->readRoot && !part->root.readDirectories)
+    {
+        FatxFileEntry *root = &part->root;
+        root->clusterChain = task->rootChain;
+        root->childIndex.Clear();
+
+        for (size_t i = 0; i < task->rootEntries.size(); i++)
+        {
+            root->cachedFiles.push_back(task->rootEntries.at(i));
+            root->childIndex.Add(task->rootEntries.at(i).name, root->cachedFiles.size() - 1);
+        }
+
+        root->fileSize = root->cachedFiles.size() * FATX_ENTRY_SIZE;
+        root->readDirectories = true;
+    }
+}
+
+bool FatxMounter::takeTask(MountTask **outTask)
+{
+    MutexLocker locker(mutex);
+    if (stopping || nextTask == tasks.size())
+        return false;
+
+    *outTask = tasks.at(nextTask++);
+    return true;
+}
+
+void FatxMounter::taskDone(MountTask *task)
+{
+    MutexLocker locker(mutex);
+    finished.push_back(task);
+    taskFinished.Signal();
+}
+
+void FatxMounter::stop()
+{
+    {
+        MutexLocker locker(mutex);
+        stopping = true;
+    }
+
+    for (size_t i = 0; i < pool.size(); i++)
+    {
+        pool.at(i)->Join();
+        delete pool.at(i);
+    }
+    pool.clear();
+}
@@ -0,0 +1,104 @@
+#ifndef FATXMOUNTER_H
+#define FATXMOUNTER_H
+
+#include "../winnames.h"
+#include "../IO/DeviceIO.h"
+#include "../Threading/Thread.h"
+#include "FatxConstants.h"
+#include "FatxFreeSpace.h"
+#include "XboxInternals_global.h"
+
+#include <deque>
+#include <string>
+#include <vector>
+
+// the most partitions that are read at once
+#define FATX_MOUNT_THREADS 4
+
+// the amount of the FAT that's read at once
+#define FATX_MOUNT_READ_SIZE 0x100000
+
+class FatxDrive;
+
+/* Reads the FAT and the root folder of every partition on a drive. The partitions are in separate
+   parts of the device, so they're read at the same time on a pool of threads, and each one is handed
+   back as soon as it's done rather than once they all are. The threads only read the device with
+   DeviceIO::ReadBytesAt, and everything they find is only put in the partition by the thread that
+   takes it from WaitForNext, so nothing that's shared is changed behind the caller's back. When the
+   drive isn't on a DeviceIO, the partitions are read one at a time by WaitForNext instead. */
+class XBOXINTERNALSSHARED_EXPORT FatxMounter
+{
+public:
+    FatxMounter(FatxDrive *drive, DWORD threadCount = FATX_MOUNT_THREADS);
+
+    // waits for the threads that are still going
+    ~FatxMounter();
+
+    // start reading the partitions that don't know their free space or haven't had their root
+    // folder read yet. The drive can't be written to until all of them have been handed back
+    void Start();
+
+    // wait for the next partition to be done and fill in its free space and root folder. NULL once
+    // all of them have been handed back. Errors from reading a partition are thrown here
+    Partition *WaitForNext();
+
+    // hand back all of the partitions that are left
+    void Finish();
+
+private:
+    struct MountTask
+    {
+        Partition *part;
+        bool countFreeMemory;
+        bool readRoot;
+
+        FatxFreeSpace freeClusters;
+        std::vector<DWORD> rootChain;
+        std::vector<FatxFileEntry> rootEntries;
+
+        bool failed;
+        std::string error;
+    };
+
+    // read everything the task needs from the device, called on the pool's threads
+    void mount(MountTask *task);
+
+    // find the free clusters in the partition's FAT
+    void readFreeClusters(MountTask *task);
+
+    // read the root folder's cluster chain and the entries in it
+    void readRoot(MountTask *task);
+
+    // read the FAT entry for cluster
+    DWORD readFatEntry(Partition *part, DWORD cluster);
+
+    // put what the task found in its partition
+    void publish(MountTask *task);
+
+    // take the next task that hasn't been started, false if there isn't one or it's stopping
+    bool takeTask(MountTask **outTask);
+
+    // called by a thread once it's done with a task
+    void taskDone(MountTask *task);
+
+    // stop the threads and wait for them
+    void stop();
+
+    FatxDrive *drive;
+    DeviceIO *device;
+    DWORD threadCount;
+
+    std::vector<MountTask*> tasks;
+    std::vector<Thread*> pool;
+
+    Mutex mutex;
+    Condition taskFinished;
+    DWORD nextTask;
+    std::deque<MountTask*> finished;
+    DWORD handedBack;
+    bool stopping;
+
+    friend class FatxMountWorker;
+};
+
+#endif // FATXMOUNTER_H
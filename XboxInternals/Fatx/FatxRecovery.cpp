@@ -0,0 +1,465 @@
+#include "FatxRecovery.h"
+#include "FatxDrive.h"
+#include "../IO/AsyncCopy.h"
+#include "../IO/FileIO.h"
+#include "../Threading/Thread.h"
+
+#include <algorithm>
+
+// reads the next chunk of the partition while the last one's being scanned
+class FatxRecoveryReader : public Thread
+{
+public:
+    FatxRecoveryReader(DeviceIO *device) :
+        device(device), offset(0), buffer(NULL), len(0)
+    {
+    }
+
+    void Read(UINT64 offset, BYTE *buffer, DWORD len)
+    {
+        this->offset = offset;
+        this->buffer = buffer;
+        this->len = len;
+        Start();
+    }
+
+protected:
+    void Run()
+    {
+        device->ReadBytesAt(offset, buffer, len);
+    }
+
+private:
+    DeviceIO *device;
+    UINT64 offset;
+    BYTE *buffer;
+    DWORD len;
+};
+
+static DWORD readDword(const BYTE *buffer)
+{
+    return ((DWORD)buffer[0] << 24) | ((DWORD)buffer[1] << 16) | ((DWORD)buffer[2] << 8) |
+            buffer[3];
+}
+
+// sorts the deleted entries by where their data starts
+struct StartsBefore
+{
+    const std::vector<FatxDeletedEntry> *entries;
+
+    bool operator()(size_t a, size_t b) const
+    {
+        return entries->at(a).startingCluster < entries->at(b).startingCluster;
+    }
+};
+
+FatxRecovery::FatxRecovery(FatxDrive *drive, BaseIO *device, Partition *part) :
+    drive(drive), device(device), part(part)
+{
+}
+
+FatxRecoveryScan FatxRecovery::Scan(void (*progress)(void *, DWORD, DWORD), void *arg)
+{
+    FatxRecoveryScan scan;
+    scan.folderClusterCount = 0;
+    scan.recoverableCount = 0;
+    scan.partlyRecoverableCount = 0;
+    scan.unrecoverableCount = 0;
+
+    // the free clusters are needed to tell what can be recovered
+    drive->GetFreeMemory(part);
+
+    DWORD clustersPerRead = FATX_RECOVERY_READ_SIZE / part->clusterSize;
+    if (clustersPerRead == 0)
+        clustersPerRead = 1;
+    DWORD readCount = (part->clusterCount + clustersPerRead - 1) / clustersPerRead;
+
+    // a DeviceIO can be read from another thread, so the next chunk's read while this one's scanned
+    DeviceIO *deviceIO = dynamic_cast<DeviceIO*>(device);
+    FatxRecoveryReader reader(deviceIO);
+    bool reading = false;
+
+    // the holes in a sparse image are all zeroes, so there can't be a folder in them
+    std::vector<DWORD> firstClusters;
+    for (DWORD i = 0; i < readCount; i++)
+    {
+        // clusters are numbered from 1
+        DWORD firstCluster = i * clustersPerRead + 1;
+        if (deviceIO == NULL || !deviceIO->InHole(FatxIO::ClusterToOffset(part, firstCluster),
+                (UINT64)chunkClusters(firstCluster, clustersPerRead) * part->clusterSize))
+            firstClusters.push_back(firstCluster);
+    }
+
+    BYTE *buffers[2];
+    buffers[0] = DeviceIO::AllocateAligned(clustersPerRead * part->clusterSize);
+    buffers[1] = DeviceIO::AllocateAligned(clustersPerRead * part->clusterSize);
+
+    try
+    {
+        for (size_t i = 0; i < firstClusters.size(); i++)
+        {
+            DWORD firstCluster = firstClusters.at(i);
+            DWORD count = chunkClusters(firstCluster, clustersPerRead);
+
+            BYTE *buffer = buffers[i % 2];
+            if (deviceIO != NULL)
+            {
+                if (!reading)
+                    reader.Read(FatxIO::ClusterToOffset(part, firstCluster), buffer,
+                            count * part->clusterSize);
+                reader.Join();
+                reading = false;
+
+                if (i + 1 < firstClusters.size())
+                {
+                    DWORD nextCluster = firstClusters.at(i + 1);
+                    reader.Read(FatxIO::ClusterToOffset(part, nextCluster), buffers[(i + 1) % 2],
+                            chunkClusters(nextCluster, clustersPerRead) * part->clusterSize);
+                    reading = true;
+                }
+            }
+            else
+            {
+                device->SetPosition(FatxIO::ClusterToOffset(part, firstCluster));
+                device->ReadBytes(buffer, count * part->clusterSize);
+            }
+
+            for (DWORD x = 0; x < count; x++)
+                if (scanCluster(buffer + x * part->clusterSize, firstCluster + x, scan.entries))
+                    scan.folderClusterCount++;
+
+            if (progress)
+                progress(arg, i + 1, firstClusters.size());
+        }
+    }
+    catch (...)
+    {
+        // the reader can't be left writing to the buffers
+        if (reading)
+        {
+            try
+            {
+                reader.Join();
+            }
+            catch (...)
+            {
+            }
+        }
+
+        DeviceIO::FreeAligned(buffers[0]);
+        DeviceIO::FreeAligned(buffers[1]);
+        throw;
+    }
+    DeviceIO::FreeAligned(buffers[0]);
+    DeviceIO::FreeAligned(buffers[1]);
+
+    estimateRecoverability(scan);
+    return scan;
+}
+
+DWORD FatxRecovery::chunkClusters(DWORD firstCluster, DWORD clustersPerRead)
+{
+    DWORD count = part->clusterCount - (firstCluster - 1);
+    return (count > clustersPerRead) ? clustersPerRead : count;
+}
+
+bool FatxRecovery::scanCluster(const BYTE *cluster, DWORD clusterIndex,
+        std::vector<FatxDeletedEntry> &outEntries)
+{
+    size_t firstFound = outEntries.size();
+    DWORD entriesInCluster = part->clusterSize / FATX_ENTRY_SIZE;
+
+    DWORD x;
+    for (x = 0; x < entriesInCluster; x++)
+    {
+        const BYTE *entry = cluster + x * FATX_ENTRY_SIZE;
+
+        // check if there are no more entries
+        if (entry[0] == 0xFF || entry[0] == 0)
+            break;
+
+        // a single entry that doesn't make sense means it's not a folder, so nothing in it counts
+        std::string name;
+        if (!validEntry(entry, name))
+        {
+            outEntries.resize(firstFound);
+            return false;
+        }
+
+        if (entry[0] != FATX_ENTRY_DELETED)
+            continue;
+
+        FatxDeletedEntry deleted;
+        deleted.partition = part;
+        deleted.name = name;
+        deleted.fileAttributes = entry[1];
+        deleted.startingCluster = readDword(entry + 0x2C);
+        deleted.fileSize = readDword(entry + 0x30);
+        deleted.creationDate = readDword(entry + 0x34);
+        deleted.lastWriteDate = readDword(entry + 0x38);
+        deleted.lastAccessDate = readDword(entry + 0x3C);
+        deleted.address = FatxIO::ClusterToOffset(part, clusterIndex) + x * FATX_ENTRY_SIZE;
+        deleted.folderCluster = clusterIndex;
+
+        // folders don't have a size, so only the first cluster of one can be found
+        if (deleted.startingCluster == 0)
+            deleted.clusterCount = 0;
+        else if (deleted.fileAttributes & FatxDirectory)
+            deleted.clusterCount = 1;
+        else
+        {
+            UINT64 clusters = ((UINT64)deleted.fileSize + part->clusterSize - 1) /
+                    part->clusterSize;
+            deleted.clusterCount = (clusters == 0) ? 1 : (DWORD)clusters;
+        }
+
+        deleted.freeClusterCount = 0;
+        deleted.folderDeleted = false;
+        deleted.recoverability = FatxUnrecoverable;
+        outEntries.push_back(deleted);
+    }
+
+    return x != 0;
+}
+
+bool FatxRecovery::validEntry(const BYTE *entry, std::string &outName)
+{
+    BYTE nameLen = entry[0];
+
+    // deleted entries lose their name length, so the name goes up to the first 0xFF
+    if (nameLen == FATX_ENTRY_DELETED)
+    {
+        nameLen = 0;
+        while (nameLen < FATX_ENTRY_MAX_NAME_LENGTH && entry[2 + nameLen] != 0xFF)
+            nameLen++;
+    }
+    else if (nameLen > FATX_ENTRY_MAX_NAME_LENGTH)
+        return false;
+
+    if (nameLen == 0)
+        return false;
+
+    // there's no such thing as a volume label on FATX
+    if (entry[1] & 0x08)
+        return false;
+
+    if (readDword(entry + 0x2C) > part->clusterCount)
+        return false;
+
+    outName.assign((const char*)entry + 2, nameLen);
+    return FatxDrive::ValidFileName(outName);
+}
+
+void FatxRecovery::estimateRecoverability(FatxRecoveryScan &scan)
+{
+    std::vector<FatxDeletedEntry> &entries = scan.entries;
+    std::vector<bool> overwritten(entries.size(), false);
+
+    // when two deleted entries were in the same clusters, the one written last is what's in them
+    std::vector<size_t> byStart;
+    for (size_t i = 0; i < entries.size(); i++)
+        if (entries.at(i).clusterCount != 0)
+            byStart.push_back(i);
+
+    StartsBefore startsBefore = { &entries };
+    std::sort(byStart.begin(), byStart.end(), startsBefore);
+
+    for (size_t i = 1; i < byStart.size(); i++)
+    {
+        FatxDeletedEntry &previous = entries.at(byStart.at(i - 1));
+        FatxDeletedEntry &current = entries.at(byStart.at(i));
+        if ((UINT64)previous.startingCluster + previous.clusterCount <= current.startingCluster)
+            continue;
+
+        bool previousIsOlder = (previous.lastWriteDate < current.lastWriteDate);
+        overwritten.at(previousIsOlder ? byStart.at(i - 1) : byStart.at(i)) = true;
+
+        // keep comparing against the one that reaches further
+        if ((UINT64)previous.startingCluster + previous.clusterCount >
+                (UINT64)current.startingCluster + current.clusterCount)
+            std::swap(byStart.at(i - 1), byStart.at(i));
+    }
+
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        FatxDeletedEntry &deleted = entries.at(i);
+        deleted.folderDeleted = (part->freeClusters.CountFree(deleted.folderCluster, 1) != 0);
+
+        if (deleted.clusterCount == 0)
+            deleted.recoverability = FatxRecoverable;
+        else if ((UINT64)deleted.startingCluster + deleted.clusterCount - 1 > part->clusterCount)
+            deleted.recoverability = FatxUnrecoverable;
+        else
+        {
+            deleted.freeClusterCount = part->freeClusters.CountFree(deleted.startingCluster,
+                    deleted.clusterCount);
+
+            if (deleted.freeClusterCount == 0)
+                deleted.recoverability = FatxUnrecoverable;
+            else if (deleted.freeClusterCount != deleted.clusterCount || overwritten.at(i))
+                deleted.recoverability = FatxPartlyRecoverable;
+            else
+                deleted.recoverability = FatxRecoverable;
+        }
+
+        if (deleted.recoverability == FatxRecoverable)
+            scan.recoverableCount++;
+        else if (deleted.recoverability == FatxPartlyRecoverable)
+            scan.partlyRecoverableCount++;
+        else
+            scan.unrecoverableCount++;
+    }
+}
+
+FatxFileEntry *FatxRecovery::Restore(const FatxDeletedEntry &deleted, std::string newName)
+{
+    if (deleted.partition != part)
+        throw std::string("FATX: The entry isn't on this partition.\n");
+    if (deleted.recoverability != FatxRecoverable)
+        throw std::string("FATX: Some of the entry's clusters have been used again, it can only "
+                "be extracted.\n");
+
+    std::string name = (newName.size() != 0) ? newName : deleted.name;
+    if (!FatxDrive::ValidFileName(name))
+        throw std::string("FATX: Invalid file name.\n");
+
+    // the partition may have changed since it was scanned
+    drive->GetFreeMemory(part);
+    if (part->freeClusters.CountFree(deleted.folderCluster, 1) != 0)
+        throw std::string("FATX: The folder the entry was in has been deleted, recover it "
+                "first.\n");
+    if (deleted.clusterCount != 0 &&
+            part->freeClusters.CountFree(deleted.startingCluster, deleted.clusterCount) !=
+            deleted.clusterCount)
+        throw std::string("FATX: Some of the entry's clusters have been used again, it can only "
+                "be extracted.\n");
+
+    if (folders.size() == 0)
+        mapFolders(&part->root);
+
+    std::map<DWORD, FatxFileEntry*>::iterator found = folders.find(deleted.folderCluster);
+    if (found == folders.end())
+        throw std::string("FATX: The entry isn't in a folder on the partition.\n");
+    FatxFileEntry *folder = found->second;
+
+    // a new entry can have been written in the slot since, and the deleted one stays in the
+    // folder's entries next to it until the folder's read again, so the slot's only used if
+    // nothing live is in it
+    FatxFileEntry *entry = NULL;
+    for (size_t i = 0; i < folder->cachedFiles.size(); i++)
+    {
+        FatxFileEntry *candidate = &folder->cachedFiles.at(i);
+        if (candidate->address != deleted.address)
+            continue;
+
+        if (candidate->nameLen != FATX_ENTRY_DELETED)
+        {
+            entry = NULL;
+            break;
+        }
+        if (entry == NULL)
+            entry = candidate;
+    }
+
+    if (entry == NULL)
+        throw std::string("FATX: The entry has already been recovered, or its slot has been used "
+                "again.\n");
+    if (drive->FileExists(folder, name))
+        throw std::string("FATX: Entry already exists.\n");
+
+    // the clusters go in the FAT before the entry points to them
+    std::vector<DWORD> chain;
+    if (deleted.clusterCount != 0)
+    {
+        if (!part->freeClusters.AllocateRange(deleted.startingCluster, deleted.clusterCount))
+            throw std::string("FATX: Some of the entry's clusters have been used again, it can "
+                    "only be extracted.\n");
+
+        for (DWORD i = 0; i < deleted.clusterCount; i++)
+            chain.push_back(deleted.startingCluster + i);
+
+        try
+        {
+            part->allocationTable.SetChain(chain);
+            part->allocationTable.Commit();
+        }
+        catch (...)
+        {
+            part->allocationTable.Discard();
+            part->freeClusters.Free(deleted.startingCluster, deleted.clusterCount);
+            throw;
+        }
+    }
+
+    DWORD index = folder->childIndex.Remove(folder->cachedFiles, entry);
+
+    entry->name = name;
+    entry->nameLen = name.length();
+    entry->fileAttributes = deleted.fileAttributes;
+    entry->startingCluster = deleted.startingCluster;
+    entry->fileSize = deleted.fileSize;
+    entry->creationDate = deleted.creationDate;
+    entry->lastWriteDate = deleted.lastWriteDate;
+    entry->lastAccessDate = deleted.lastAccessDate;
+    entry->clusterChain = chain;
+    folder->childIndex.Add(entry->name, index);
+
+    // what was read from the folder when it was deleted went past the cluster it got back. The
+    // path cache can't point into it, nothing in a deleted folder can be looked up by its path
+    if (entry->fileAttributes & FatxDirectory)
+    {
+        entry->cachedFiles.clear();
+        entry->childIndex.Clear();
+        entry->readDirectories = false;
+        entry->fileSize = 0;
+
+        if (deleted.clusterCount != 0)
+            folders[deleted.startingCluster] = entry;
+    }
+
+    FatxIO entryIO = drive->GetFatxIO(entry);
+    entryIO.WriteEntryToDisk();
+
+    return entry;
+}
+
+void FatxRecovery::Extract(const FatxDeletedEntry &deleted, std::string outPath,
+        void (*progress)(void *, DWORD, DWORD), void *arg)
+{
+    if (deleted.fileAttributes & FatxDirectory)
+        throw std::string("FATX: Only files can be extracted.\n");
+    if (deleted.recoverability == FatxUnrecoverable)
+        throw std::string("FATX: None of the entry's clusters are free any more.\n");
+
+    FileIO outFile(outPath, true);
+
+    if (deleted.fileSize != 0)
+    {
+        // the clusters are consecutive, so it's all one range
+        AsyncCopy copy(device, &outFile);
+        copy.Copy(FatxIO::ClusterToOffset(part, deleted.startingCluster), 0, deleted.fileSize,
+                progress, arg);
+    }
+    else if (progress)
+        progress(arg, 1, 1);
+
+    outFile.Flush();
+    outFile.Close();
+}
+
+void FatxRecovery::mapFolders(FatxFileEntry *folder)
+{
+    drive->GetChildFileEntries(folder);
+    if (folder->clusterChain.size() == 0)
+        drive->ReadClusterChain(folder);
+
+    for (size_t i = 0; i < folder->clusterChain.size(); i++)
+        folders[folder->clusterChain.at(i)] = folder;
+
+    for (size_t i = 0; i < folder->cachedFiles.size(); i++)
+    {
+        FatxFileEntry *entry = &folder->cachedFiles.at(i);
+        if (entry->nameLen != FATX_ENTRY_DELETED && (entry->fileAttributes & FatxDirectory))
+            mapFolders(entry);
+    }
+}
@@ -0,0 +1,122 @@
+#ifndef FATXRECOVERY_H
+#define FATXRECOVERY_H
+
+#include "../winnames.h"
+#include "../IO/BaseIO.h"
+#include "FatxConstants.h"
+#include "XboxInternals_global.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+// the amount of the partition's clusters that's read at once when scanning
+#define FATX_RECOVERY_READ_SIZE 0x800000
+
+class FatxDrive;
+
+enum FatxRecoverability
+{
+    // all of the clusters the entry needs are still free
+    FatxRecoverable,
+
+    // some of them have been used again, or another deleted file that was written later was in them
+    FatxPartlyRecoverable,
+
+    // none of them are free, or the entry points outside of the partition
+    FatxUnrecoverable
+};
+
+// a deleted entry found by scanning a partition
+struct FatxDeletedEntry
+{
+    Partition *partition;
+
+    std::string name;
+    BYTE fileAttributes;
+    DWORD startingCluster;
+    DWORD fileSize;
+
+    // times
+    DWORD creationDate;
+    DWORD lastWriteDate;
+    DWORD lastAccessDate;
+
+    // where the entry is, and the cluster of the folder it's in
+    INT64 address;
+    DWORD folderCluster;
+
+    // the clusters the data's in if they were consecutive, which is how they're recovered. Folders
+    // only get their first cluster back
+    DWORD clusterCount;
+    DWORD freeClusterCount;
+
+    // whether the folder the entry's in has been deleted too, it has to be recovered first
+    bool folderDeleted;
+
+    FatxRecoverability recoverability;
+};
+
+struct FatxRecoveryScan
+{
+    // every deleted entry found, in the order they're on the partition
+    std::vector<FatxDeletedEntry> entries;
+
+    // the clusters that looked like they were part of a folder
+    DWORD folderClusterCount;
+
+    DWORD recoverableCount;
+    DWORD partlyRecoverableCount;
+    DWORD unrecoverableCount;
+};
+
+/* Finds deleted files on a partition without going through the folders. Every cluster on the
+   partition is read in large sequential chunks, apart from the holes in sparse images, and the
+   ones that look like folder clusters have their deleted entries picked out, so entries in folders
+   that have since been deleted are found too. FATX doesn't keep a deleted file's cluster chain,
+   so the clusters are assumed to be consecutive from the starting cluster, which is how they're
+   allocated on a drive that isn't fragmented. A file is put back by taking those clusters out of
+   the free space, linking them in the FAT and writing the entry's name length again. */
+class XBOXINTERNALSSHARED_EXPORT FatxRecovery
+{
+public:
+    FatxRecovery(FatxDrive *drive, BaseIO *device, Partition *part);
+
+    // read every cluster on the partition and collect the deleted entries, the progress is the
+    // number of chunks that have been read
+    FatxRecoveryScan Scan(void(*progress)(void*, DWORD, DWORD) = NULL, void *arg = NULL);
+
+    // put the entry back in its folder, with a new name if one's given. Only entries whose
+    // clusters are all free can be put back
+    FatxFileEntry *Restore(const FatxDeletedEntry &deleted, std::string newName = "");
+
+    // copy what's in the entry's clusters to the local disk without changing the partition, this
+    // works for entries that are only partly recoverable too
+    void Extract(const FatxDeletedEntry &deleted, std::string outPath,
+            void(*progress)(void*, DWORD, DWORD) = NULL, void *arg = NULL);
+
+private:
+    // the number of clusters in the chunk starting at firstCluster, only the last one can be short
+    DWORD chunkClusters(DWORD firstCluster, DWORD clustersPerRead);
+
+    // pick the deleted entries out of the cluster if it looks like a folder cluster, false if not
+    bool scanCluster(const BYTE *cluster, DWORD clusterIndex,
+            std::vector<FatxDeletedEntry> &outEntries);
+
+    // check that the entry at the start of entry is one FATX could have written
+    bool validEntry(const BYTE *entry, std::string &outName);
+
+    // work out how much of each entry can be recovered
+    void estimateRecoverability(FatxRecoveryScan &scan);
+
+    // map each cluster of every folder that isn't deleted to the folder
+    void mapFolders(FatxFileEntry *folder);
+
+    FatxDrive *drive;
+    BaseIO *device;
+    Partition *part;
+
+    std::map<DWORD, FatxFileEntry*> folders;
+};
+
+#endif // FATXRECOVERY_H
@@ -8,14 +8,20 @@ AvatarAwardGpd::AvatarAwardGpd(string gpdPath) : GpdBase(gpdPath)
     init();
 }
 
-AvatarAwardGpd::AvatarAwardGpd(FileIO *io) : GpdBase(io)
+AvatarAwardGpd::AvatarAwardGpd(BaseIO *io) : GpdBase(io)
 {
     init();
 }
 
+AvatarAwardGpd::AvatarAwardGpd(BaseIO *io, string gpdPath) : GpdBase(io)
+{
+    init();
+    switchToFile(gpdPath, true);
+}
+
 void AvatarAwardGpd::CleanGpd()
 {
-    xdbf->Clean();
+    Clean();
 }
 
 void AvatarAwardGpd::init()
@@ -15,7 +15,11 @@ class XBOXINTERNALSSHARED_EXPORT AvatarAwardGpd : public GpdBase
 {
 public:
     AvatarAwardGpd(string gpdPath);
-    AvatarAwardGpd(FileIO *io);
+    AvatarAwardGpd(BaseIO *io);
+
+    // Description: read the gpd from io, then use the file at gpdPath for any writes. The caller
+    // keeps ownership of io and can free it once the gpd has been constructed
+    AvatarAwardGpd(BaseIO *io, string gpdPath);
     ~AvatarAwardGpd(void);
 
     vector<struct AvatarAward> avatarAwards;
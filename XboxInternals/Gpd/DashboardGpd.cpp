@@ -9,14 +9,14 @@ DashboardGpd::DashboardGpd(string gpdPath) : GpdBase(gpdPath)
     init();
 }
 
-DashboardGpd::DashboardGpd(FileIO *io) : GpdBase(io)
+DashboardGpd::DashboardGpd(BaseIO *io) : GpdBase(io)
 {
     init();
 }
 
 void DashboardGpd::CleanGpd()
 {
-    xdbf->Clean();
+    Clean();
 }
 
 void DashboardGpd::init()
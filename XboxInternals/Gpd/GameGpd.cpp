@@ -7,16 +7,21 @@ GameGpd::GameGpd(string filePath) : GpdBase(filePath), filePath(filePath)
     StopWriting();
 }
 
-GameGpd::GameGpd(FileIO *io) : GpdBase(io)
+GameGpd::GameGpd(BaseIO *io) : GpdBase(io)
 {
     init();
 }
 
+GameGpd::GameGpd(BaseIO *io, string filePath) : GpdBase(io), filePath(filePath)
+{
+    init();
+    switchToFile(filePath, false);
+}
+
 void GameGpd::CleanGpd()
 {
     StartWriting();
-    xdbf->Clean();
-    io = xdbf->io;
+    Clean();
     StopWriting();
 }
 
@@ -193,6 +198,7 @@ bool GameGpd::GetAchievementThumbnail(AchievementEntry *entry, ImageEntry *out)
         if (images.at(i).entry.id == entry->imageID)
         {
             *out = images.at(i);
+            GetImageData(out);
             return true;
         }
     }
@@ -235,12 +241,19 @@ void GameGpd::init()
 
 void GameGpd::StartWriting()
 {
+    // gpds read from an io that was passed in stay open the whole time
+    if (filePath.empty())
+        return;
+
     io = new FileIO(filePath);
     xdbf->io = io;
 }
 
 void GameGpd::StopWriting()
 {
+    if (filePath.empty())
+        return;
+
     io->Close();
     delete io;
     io = NULL;
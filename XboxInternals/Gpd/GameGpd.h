@@ -14,7 +14,11 @@ class XBOXINTERNALSSHARED_EXPORT GameGpd : public GpdBase
 {
 public:
     GameGpd(string gpdPath);
-    GameGpd(FileIO *io);
+    GameGpd(BaseIO *io);
+
+    // Description: read the gpd from io, then use the file at gpdPath for any writes. The caller
+    // keeps ownership of io and can free it once the gpd has been constructed
+    GameGpd(BaseIO *io, string gpdPath);
 
     ~GameGpd(void);
 
@@ -39,7 +43,7 @@ public:
     // Description: get the type of an achievement
     static string GetAchievementType(AchievementEntry *entry);
 
-    // Decription: retrieves the thumbnail image for the achievement passed in, returns true if found and false if not
+    // Decription: retrieves the thumbnail image for the achievement passed in (reading its data if needed), returns true if found and false if not
     bool GetAchievementThumbnail(AchievementEntry *entry, ImageEntry *out);
 
     // Description: unlock all of the achievements in the Gpd offline and Write them to the file
@@ -1,7 +1,8 @@
 #include "GpdBase.h"
 
 
-GpdBase::GpdBase(string path) : ioPassedIn(false)
+GpdBase::GpdBase(string path) : ioPassedIn(false), gpdPath(path), imageCacheLimit(0),
+    cachedImageBytes(0)
 {
     io = new FileIO(path);
     xdbf = new Xdbf(io);
@@ -9,7 +10,7 @@ GpdBase::GpdBase(string path) : ioPassedIn(false)
     init();
 }
 
-GpdBase::GpdBase(FileIO *io) : ioPassedIn(true), io(io)
+GpdBase::GpdBase(BaseIO *io) : ioPassedIn(true), io(io), imageCacheLimit(0), cachedImageBytes(0)
 {
     xdbf = new Xdbf(io);
 
@@ -18,20 +19,13 @@ GpdBase::GpdBase(FileIO *io) : ioPassedIn(true), io(io)
 
 void GpdBase::init()
 {
-    // read all the images
+    // only keep track of the images, their data is read when it's needed
     for (DWORD i = 0; i < xdbf->images.size(); i++)
     {
-        // set up the information
         ImageEntry image;
         image.entry = xdbf->images.at(i);
         image.initialLength = image.length = image.entry.length;
-        image.image = new BYTE[image.length];
 
-        // read in the image
-        io->SetPosition(xdbf->GetRealAddress(image.entry.addressSpecifier));
-        io->ReadBytes(image.image, image.length);
-
-        // add the image to the vector
         images.push_back(image);
     }
 
@@ -158,18 +152,28 @@ void GpdBase::DeleteSettingEntry(SettingEntry setting)
 
 void GpdBase::DeleteImageEntry(ImageEntry image)
 {
-    // remove the entry from the list
+    // find the entry in the list
     DWORD i;
     for (i = 0 ; i < images.size(); i++)
-    {
         if (images.at(i).entry.id == image.entry.id)
+            break;
+    if (i >= images.size())
+        throw string("Gpd: Error deleting image entry. Image doesn't exist.\n");
+
+    // forget about its data if it was read from the file
+    for (std::list<UINT64>::iterator x = recentImages.begin(); x != recentImages.end(); ++x)
+    {
+        if (*x == image.entry.id)
         {
-            images.erase(images.begin() + i);
+            recentImages.erase(x);
+            cachedImageBytes -= images.at(i).length;
             break;
         }
     }
-    if (i > images.size())
-        throw string("Gpd: Error deleting image entry. Image doesn't exist.\n");
+
+    // the list owns the data, copies of the entry only share it
+    delete[] images.at(i).image;
+    images.erase(images.begin() + i);
 
     // delete the entry from the file
     xdbf->DeleteEntry(image.entry);
@@ -323,6 +327,10 @@ void GpdBase::WriteSettingEntry(SettingEntry setting)
 
 void GpdBase::WriteImageEntry(ImageEntry image)
 {
+    // an image that was never read can't have changed
+    if (image.image == NULL)
+        return;
+
     // allocate memory if needed
     if (image.length != image.initialLength)
     {
@@ -342,10 +350,30 @@ void GpdBase::Close()
         io->Close();
 }
 
+void GpdBase::switchToFile(string path, bool keepOpen)
+{
+    // the io that was passed in still belongs to the caller
+    if (!ioPassedIn && io)
+    {
+        io->Close();
+        delete io;
+    }
+
+    gpdPath = path;
+    io = keepOpen ? new FileIO(path) : NULL;
+    xdbf->io = io;
+    ioPassedIn = false;
+}
+
 void GpdBase::Clean()
 {
+    BaseIO *oldIO = io;
     xdbf->Clean();
     io = xdbf->io;
+
+    // files are recreated when they're cleaned, the new one belongs to the gpd
+    if (io != oldIO)
+        ioPassedIn = false;
 }
 
 SettingEntry GpdBase::GetSetting(UINT64 id)
@@ -356,6 +384,122 @@ SettingEntry GpdBase::GetSetting(UINT64 id)
     return SettingEntry();
 }
 
+BYTE *GpdBase::GetImageData(ImageEntry *image)
+{
+    // the images in the list own the data, so the copies of them share it
+    ImageEntry *stored = findImage(image->entry.id);
+    if (stored == NULL)
+        return image->image;
+
+    if (stored->image == NULL)
+    {
+        readImageData(stored);
+
+        recentImages.push_front(stored->entry.id);
+        cachedImageBytes += stored->length;
+    }
+    else if (!recentImages.empty() && recentImages.front() != stored->entry.id)
+    {
+        // move it to the front of the recently used list
+        for (std::list<UINT64>::iterator i = recentImages.begin(); i != recentImages.end(); ++i)
+        {
+            if (*i == stored->entry.id)
+            {
+                recentImages.erase(i);
+                recentImages.push_front(stored->entry.id);
+                break;
+            }
+        }
+    }
+
+    trimImageCache();
+
+    image->image = stored->image;
+    image->length = stored->length;
+    return image->image;
+}
+
+void GpdBase::SetImageCacheLimit(DWORD bytes)
+{
+    imageCacheLimit = bytes;
+    trimImageCache();
+}
+
+ImageEntry *GpdBase::findImage(UINT64 id)
+{
+    for (DWORD i = 0; i < images.size(); i++)
+        if (images.at(i).entry.id == id)
+            return &images.at(i);
+    return NULL;
+}
+
+void GpdBase::readImageData(ImageEntry *image)
+{
+    // the entries move around when the file is cleaned, so get the current one from the xdbf
+    XdbfEntry entry = image->entry;
+    for (DWORD i = 0; i < xdbf->images.size(); i++)
+    {
+        if (xdbf->images.at(i).id == entry.id)
+        {
+            entry = xdbf->images.at(i);
+            break;
+        }
+    }
+
+    // some gpds are only opened while they're being written to
+    BaseIO *imageIO = io;
+    if (imageIO == NULL)
+    {
+        if (gpdPath.empty())
+            throw string("Gpd: Error reading image entry. The gpd isn't open.\n");
+        imageIO = new FileIO(gpdPath);
+    }
+
+    BYTE *data = new BYTE[entry.length];
+    try
+    {
+        imageIO->SetPosition(xdbf->GetRealAddress(entry.addressSpecifier));
+        imageIO->ReadBytes(data, entry.length);
+    }
+    catch (...)
+    {
+        delete[] data;
+        if (imageIO != io)
+            delete imageIO;
+        throw;
+    }
+
+    if (imageIO != io)
+    {
+        imageIO->Close();
+        delete imageIO;
+    }
+
+    image->entry = entry;
+    image->image = data;
+    image->length = image->initialLength = entry.length;
+}
+
+void GpdBase::trimImageCache()
+{
+    if (imageCacheLimit == 0)
+        return;
+
+    // always keep the image that was just used
+    while (cachedImageBytes > imageCacheLimit && recentImages.size() > 1)
+    {
+        ImageEntry *image = findImage(recentImages.back());
+        recentImages.pop_back();
+
+        if (image == NULL || image->image == NULL)
+            continue;
+
+        cachedImageBytes -= image->length;
+        delete[] image->image;
+        image->image = NULL;
+    }
+}
+
 GpdBase::~GpdBase(void)
 {
     // deallocate all of the image memory
@@ -371,6 +515,7 @@ GpdBase::~GpdBase(void)
             delete settings.at(i).str;
     }
 
-    delete io;
+    if (!ioPassedIn)
+        delete io;
     delete xdbf;
 }
@@ -4,6 +4,7 @@
 #include "Xdbf.h"
 #include "XdbfDefininitions.h"
 #include <vector>
+#include <list>
 
 #include "XboxInternals_global.h"
 
@@ -13,7 +14,7 @@ using std::vector;
 class XBOXINTERNALSSHARED_EXPORT GpdBase
 {
 public:
-    GpdBase(FileIO *io);
+    GpdBase(BaseIO *io);
     GpdBase(string gpdPath);
 
     ~GpdBase(void);
@@ -50,9 +51,24 @@ public:
     // Description: get a setting entry from its id
     SettingEntry GetSetting(UINT64 id);
 
+    // Description: get the data of an image, it's only read from the file the first time it's needed
+    BYTE *GetImageData(ImageEntry *image);
+
+    // Description: limit how many bytes of image data are kept in memory, the least recently used
+    // images are released when it's exceeded. 0 keeps every image that's been read, which is the
+    // default. When there's a limit, the data is only valid until the next call to GetImageData
+    void SetImageCacheLimit(DWORD bytes);
+
 protected:
     bool ioPassedIn;
-    FileIO *io;
+    BaseIO *io;
+
+    // the path of the gpd, used to read images when the io isn't open
+    string gpdPath;
+
+    // Description: stop using the io the gpd was read from and work with the file at path instead,
+    // it's left closed if keepOpen isn't set
+    void switchToFile(string path, bool keepOpen);
 
 private:
     // Description: read the string entry passed in
@@ -61,6 +77,20 @@ private:
     // Description: read the setting entry passed in
     SettingEntry readSettingEntry(XdbfEntry entry);
 
-    // read in all of the images, settings, and strings
+    // read in all of the settings and strings, the images are read when they're needed
     void init();
+
+    // Description: find the image with the id passed in
+    ImageEntry *findImage(UINT64 id);
+
+    // Description: read the data of an image from the file
+    void readImageData(ImageEntry *image);
+
+    // Description: release the least recently used images until the cache is under its limit
+    void trimImageCache();
+
+    // ids of the images that were read from the file, the most recently used first
+    std::list<UINT64> recentImages;
+    DWORD imageCacheLimit;
+    DWORD cachedImageBytes;
 };
@@ -1,4 +1,5 @@
 #include "Xdbf.h"
+#include "IO/MemoryIO.h"
 #include <stdio.h>
 
 Xdbf::Xdbf(string gpdPath) : ioPassedIn(false)
@@ -11,7 +12,7 @@ Xdbf::Xdbf(string gpdPath) : ioPassedIn(false)
     readFreeMemoryTable();
 }
 
-Xdbf::Xdbf(FileIO *io) : io(io), ioPassedIn(true)
+Xdbf::Xdbf(BaseIO *io) : io(io), ioPassedIn(true)
 {
     init();
     readHeader();
@@ -21,72 +22,60 @@ Xdbf::Xdbf(FileIO *io) : io(io), ioPassedIn(true)
 
 void Xdbf::Clean()
 {
-    // create a temporary file to Write the old Gpd's used memory to
-    string tempFileName;
+    // work out how big the gpd will be with only the used memory in it
+    DWORD cleanedLength = GetRealAddress(0) + GetEntryGroupLength(&achievements) +
+            GetEntryGroupLength(&images) + GetEntryGroupLength(&settings) +
+            GetEntryGroupLength(&titlesPlayed) + GetEntryGroupLength(&strings) +
+            GetEntryGroupLength(&avatarAwards);
 
-#ifdef _WIN32
-    // Opening a file using the path returned by tmpnam() may result in a "permission denied" error on Windows.
-    // Not sure why it happens but tweaking the manifest/UAC properties makes a difference.
-    char *tempFileName_c = _tempnam(NULL, NULL);
-    if (!tempFileName_c)
-        throw string("Xdbf: Failed to generate temporary file name.\n");
-    tempFileName = string(tempFileName_c);
-    free(tempFileName_c);
-    tempFileName_c = NULL;
-#else
-    char tempFileName_c[L_tmpnam];
-    if (!tmpnam(tempFileName_c))
-        throw string("Xdbf: Failed to generate temporary file name.\n");
-    tempFileName = string(tempFileName_c);
-#endif
+    // the cleaned gpd is built up in a new buffer
+    BYTE *cleaned = new BYTE[cleanedLength];
+    memset(cleaned, 0, cleanedLength);
 
-    FileIO tempFile(tempFileName.c_str(), true);
-
-    // Write the old header
-    tempFile.SetPosition(0);
-    tempFile.Write(header.magic);
-    tempFile.Write(header.version);
-    tempFile.Write(header.entryTableLength);
-    tempFile.Write(header.entryCount);
-    tempFile.Write(header.freeMemTableLength);
-    tempFile.Write((DWORD)1);
-
-    // seek to the first position in the file where data can be written
-    tempFile.SetPosition(GetRealAddress(0) - 1);
-    tempFile.Write((BYTE)0);
-
-    tempFile.Flush();
+    try
+    {
+        MemoryIO cleanedIO(cleaned, cleanedLength);
 
-    // Write all of the achievements
-    WriteNewEntryGroup(&achievements, &tempFile);
+        // Write the old header
+        cleanedIO.SetPosition(0);
+        cleanedIO.Write(header.magic);
+        cleanedIO.Write(header.version);
+        cleanedIO.Write(header.entryTableLength);
+        cleanedIO.Write(header.entryCount);
+        cleanedIO.Write(header.freeMemTableLength);
+        cleanedIO.Write((DWORD)1);
 
-    // Write all of the images
-    WriteNewEntryGroup(&images, &tempFile);
+        // seek to the first position in the file where data can be written
+        cleanedIO.SetPosition(GetRealAddress(0));
 
-    // Write all of the settings
-    WriteNewEntryGroup(&settings, &tempFile);
+        // Write all of the achievements
+        WriteNewEntryGroup(&achievements, &cleanedIO);
 
-    // Write all of the title entries
-    WriteNewEntryGroup(&titlesPlayed, &tempFile);
+        // Write all of the images
+        WriteNewEntryGroup(&images, &cleanedIO);
 
-    // Write all of the strings
-    WriteNewEntryGroup(&strings, &tempFile);
+        // Write all of the settings
+        WriteNewEntryGroup(&settings, &cleanedIO);
 
-    // Write all of the achievements
-    WriteNewEntryGroup(&avatarAwards, &tempFile);
+        // Write all of the title entries
+        WriteNewEntryGroup(&titlesPlayed, &cleanedIO);
 
-    tempFile.Close();
-    io->Close();
+        // Write all of the strings
+        WriteNewEntryGroup(&strings, &cleanedIO);
 
-    // delete the original file
-    remove(io->GetFilePath().c_str());
+        // Write all of the achievements
+        WriteNewEntryGroup(&avatarAwards, &cleanedIO);
 
-    // move the temp file to the old file's location
-    rename(tempFileName.c_str(), io->GetFilePath().c_str());
+        // replace the old gpd with the cleaned one
+        replaceContents(cleaned, cleanedLength);
+    }
+    catch (...)
+    {
+        delete[] cleaned;
+        throw;
+    }
 
-    string path = io->GetFilePath();
-    delete io;
-    io = new FileIO(path);
+    delete[] cleaned;
 
     // Write the updated entry table
     WriteEntryListing();
@@ -112,7 +101,55 @@ void Xdbf::Clean()
     readEntryTable();
 }
 
-void Xdbf::WriteNewEntryGroup(XdbfEntryGroup *group, FileIO *newIO)
+DWORD Xdbf::GetEntryGroupLength(XdbfEntryGroup *group)
+{
+    DWORD length = group->syncs.entry.length + group->syncData.entry.length;
+    for (DWORD i = 0; i < group->entries.size(); i++)
+        length += group->entries.at(i).length;
+    return length;
+}
+
+DWORD Xdbf::GetEntryGroupLength(vector<XdbfEntry> *group)
+{
+    DWORD length = 0;
+    for (DWORD i = 0; i < group->size(); i++)
+        length += group->at(i).length;
+    return length;
+}
+
+void Xdbf::replaceContents(BYTE *buffer, DWORD length)
+{
+    // files are recreated so that they shrink down to the new length
+    FileIO *fileIO = dynamic_cast<FileIO*>(io);
+    if (fileIO != NULL)
+    {
+        string path = fileIO->GetFilePath();
+        io->Close();
+        delete io;
+        io = new FileIO(path, true);
+    }
+
+    // memory that's able to shrink is cut down to the new length too
+    MemoryIO *memoryIO = dynamic_cast<MemoryIO*>(io);
+    if (memoryIO != NULL && memoryIO->IsGrowable())
+        memoryIO->Resize(length);
+
+    io->SetPosition(0);
+    io->Write(buffer, length);
+
+    // anything left over at the end becomes free memory, so don't leave the old data in it
+    UINT64 ioLength = io->Length();
+    if (ioLength > length)
+    {
+        BYTE zeros[0x1000] = {0};
+        for (UINT64 pos = length; pos < ioLength; pos += 0x1000)
+            io->Write(zeros, (ioLength - pos > 0x1000) ? 0x1000 : (DWORD)(ioLength - pos));
+    }
+
+    io->Flush();
+}
+
+void Xdbf::WriteNewEntryGroup(XdbfEntryGroup *group, BaseIO *newIO)
 {
     // iterate through all of the entries
     for (DWORD i = 0; i < group->entries.size(); i++)
@@ -123,14 +160,14 @@ void Xdbf::WriteNewEntryGroup(XdbfEntryGroup *group, FileIO *newIO)
     WriteNewEntry(&group->syncData.entry, newIO);
 }
 
-void Xdbf::WriteNewEntryGroup(vector<XdbfEntry> *group, FileIO *newIO)
+void Xdbf::WriteNewEntryGroup(vector<XdbfEntry> *group, BaseIO *newIO)
 {
     // iterate through all of the entries
     for (DWORD i = 0; i < group->size(); i++)
         WriteNewEntry(&group->at(i), newIO);
 }
 
-void Xdbf::WriteNewEntry(XdbfEntry *entry, FileIO *newIO)
+void Xdbf::WriteNewEntry(XdbfEntry *entry, BaseIO *newIO)
 {
     // read in the entry data
     BYTE *buffer = new BYTE[entry->length];
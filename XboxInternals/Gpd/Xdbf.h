@@ -16,7 +16,7 @@ class XBOXINTERNALSSHARED_EXPORT Xdbf
 {
 public:
     Xdbf(string gpdPath);
-    Xdbf(FileIO *io);
+    Xdbf(BaseIO *io);
     ~Xdbf();
 
     XdbfEntryGroup achievements;
@@ -50,12 +50,13 @@ public:
     // Description: move the sync to the queue
     void UpdateEntry(XdbfEntry *entry);
 
-    // Description: remove all the unused memory in the file
+    // Description: remove all the unused memory, the cleaned gpd is built in a new buffer that
+    // replaces the contents of the io. Files and growable memory shrink down to the new size
     void Clean();
 
     // Description: re-Write an entry
     void ReWriteEntry(XdbfEntry entry, BYTE *entryBuffer);
-    FileIO *io;
+    BaseIO *io;
 
 private:
     bool ioPassedIn;
@@ -114,13 +115,22 @@ private:
     void WriteEntry(XdbfEntry *entry);
 
     // Description: Write an entry group to the file that has syncs, used when cleaning
-    void WriteNewEntryGroup(XdbfEntryGroup *group, FileIO *newIO);
+    void WriteNewEntryGroup(XdbfEntryGroup *group, BaseIO *newIO);
 
     // Description: Write an entry group that doesn't have syncs, used when cleaning
-    void WriteNewEntryGroup(vector<XdbfEntry> *group, FileIO *newIO);
+    void WriteNewEntryGroup(vector<XdbfEntry> *group, BaseIO *newIO);
 
     // Description: Write entry to the new file, used when cleaing
-    void WriteNewEntry(XdbfEntry *entry, FileIO *newIO);
+    void WriteNewEntry(XdbfEntry *entry, BaseIO *newIO);
+
+    // Description: get the amount of memory an entry group uses, used when cleaning
+    DWORD GetEntryGroupLength(XdbfEntryGroup *group);
+
+    // Description: get the amount of memory an entry group uses, used when cleaning
+    DWORD GetEntryGroupLength(vector<XdbfEntry> *group);
+
+    // Description: overwrite the io with the cleaned gpd
+    void replaceContents(BYTE *buffer, DWORD length);
 };
 
 bool compareEntries(XdbfEntry a, XdbfEntry b);
@@ -123,6 +123,7 @@ struct StringEntry
 
 struct ImageEntry
 {
+    // images in a gpd aren't read until GpdBase::GetImageData is called, this is NULL until then
     BYTE *image;
     DWORD length;
 
@@ -0,0 +1,204 @@
+#include "AsyncCopy.h"
+#include "DeviceIO.h"
+#include "../Threading/Thread.h"
+
+struct CopyChunk
+{
+    UINT64 sourceOffset;
+    UINT64 destOffset;
+    DWORD len;
+};
+
+// the state shared between the reader and the writer
+struct CopyState
+{
+    std::vector<CopyChunk> chunks;
+
+    Mutex mutex;
+    Condition filled;
+    Condition emptied;
+
+    // the amount of chunks that have been read and written so far
+    DWORD readCount;
+    DWORD writeCount;
+
+    bool aborted;
+};
+
+class AsyncCopyReader : public Thread
+{
+public:
+    AsyncCopyReader(AsyncCopy *copy, CopyState *state) :
+        copy(copy), state(state)
+    {
+    }
+
+protected:
+    void Run()
+    {
+        try
+        {
+            for (DWORD i = 0; i < state->chunks.size(); i++)
+            {
+                // wait for the writer to free up a buffer
+                {
+                    MutexLocker locker(state->mutex);
+                    while (i - state->writeCount >= copy->queueDepth && !state->aborted)
+                        state->emptied.Wait(state->mutex);
+
+                    if (state->aborted)
+                        return;
+                }
+
+                const CopyChunk &chunk = state->chunks.at(i);
+                copy->source->SetPosition(chunk.sourceOffset);
+                copy->source->ReadBytes(copy->buffers.at(i % copy->queueDepth), chunk.len);
+
+                MutexLocker locker(state->mutex);
+                state->readCount++;
+                state->filled.Signal();
+            }
+        }
+        catch (...)
+        {
+            MutexLocker locker(state->mutex);
+            state->aborted = true;
+            state->filled.Signal();
+            throw;
+        }
+    }
+
+private:
+    AsyncCopy *copy;
+    CopyState *state;
+};
+
+AsyncCopy::AsyncCopy(BaseIO *source, BaseIO *destination, DWORD chunkSize, DWORD queueDepth) :
+    source(source), destination(destination), chunkSize(chunkSize), queueDepth(queueDepth)
+{
+    if (chunkSize == 0)
+        throw std::string("AsyncCopy: Invalid chunk size.\n");
+
+    // with less than two buffers nothing would overlap
+    if (this->queueDepth < 2)
+        this->queueDepth = 2;
+
+    try
+    {
+        for (DWORD i = 0; i < this->queueDepth; i++)
+            buffers.push_back(DeviceIO::AllocateAligned(chunkSize));
+    }
+    catch (...)
+    {
+        for (DWORD i = 0; i < buffers.size(); i++)
+            DeviceIO::FreeAligned(buffers.at(i));
+        throw;
+    }
+}
+
+AsyncCopy::~AsyncCopy()
+{
+    for (DWORD i = 0; i < buffers.size(); i++)
+        DeviceIO::FreeAligned(buffers.at(i));
+}
+
+void AsyncCopy::Copy(UINT64 sourceOffset, UINT64 destOffset, UINT64 len,
+        void(*progress)(void*, DWORD, DWORD), void *arg)
+{
+    std::vector<CopyRange> ranges;
+    CopyRange range = { sourceOffset, destOffset, len };
+    ranges.push_back(range);
+
+    Copy(ranges, progress, arg);
+}
+
+void AsyncCopy::Copy(const std::vector<CopyRange> &ranges, void(*progress)(void*, DWORD, DWORD),
+        void *arg)
+{
+    CopyState state;
+    state.readCount = 0;
+    state.writeCount = 0;
+    state.aborted = false;
+
+    // split the ranges up into pieces that fit in the buffers
+    for (DWORD i = 0; i < ranges.size(); i++)
+    {
+        const CopyRange &range = ranges.at(i);
+        for (UINT64 done = 0; done < range.len; )
+        {
+            CopyChunk chunk;
+            chunk.sourceOffset = range.sourceOffset + done;
+            chunk.destOffset = range.destOffset + done;
+            chunk.len = (range.len - done > chunkSize) ? chunkSize : (DWORD)(range.len - done);
+            state.chunks.push_back(chunk);
+
+            done += chunk.len;
+        }
+    }
+
+    DWORD chunkCount = state.chunks.size();
+    if (chunkCount == 0)
+        return;
+
+    AsyncCopyReader reader(this, &state);
+    reader.Start();
+
+    try
+    {
+        for (DWORD i = 0; i < chunkCount; i++)
+        {
+            // wait for the reader to fill the next buffer
+            {
+                MutexLocker locker(state.mutex);
+                while (state.readCount == i && !state.aborted)
+                    state.filled.Wait(state.mutex);
+
+                if (state.readCount == i)
+                    break;
+            }
+
+            const CopyChunk &chunk = state.chunks.at(i);
+            destination->SetPosition(chunk.destOffset);
+            destination->WriteBytes(buffers.at(i % queueDepth), chunk.len);
+
+            {
+                MutexLocker locker(state.mutex);
+                state.writeCount++;
+                state.emptied.Signal();
+            }
+
+            if (progress)
+                progress(arg, i + 1, chunkCount);
+        }
+    }
+    catch (...)
+    {
+        {
+            MutexLocker locker(state.mutex);
+            state.aborted = true;
+            state.emptied.Signal();
+        }
+
+        try
+        {
+            reader.Join();
+        }
+        catch (...)
+        {
+        }
+        throw;
+    }
+
+    // rethrows the reader's error if it failed
+    reader.Join();
+}
+
+DWORD AsyncCopy::GetChunkSize()
+{
+    return chunkSize;
+}
+
+DWORD AsyncCopy::GetQueueDepth()
+{
+    return queueDepth;
+}
@@ -0,0 +1,57 @@
+#ifndef ASYNCCOPY_H
+#define ASYNCCOPY_H
+
+#include "BaseIO.h"
+#include "XboxInternals_global.h"
+
+#include <iostream>
+#include <vector>
+
+#define ASYNCCOPY_DEFAULT_CHUNK_SIZE    0x100000
+#define ASYNCCOPY_DEFAULT_QUEUE_DEPTH   4
+
+// len bytes at sourceOffset in the source are copied to destOffset in the destination
+struct CopyRange
+{
+    UINT64 sourceOffset;
+    UINT64 destOffset;
+    UINT64 len;
+};
+
+/* Copies data between two ios with the reads and writes overlapping. The source is read on
+   its own thread into a ring of aligned buffers, while the calling thread writes them out
+   in order, so both sides are kept busy and the copy runs at the speed of the slower one.
+   Each io is only ever used by one thread. */
+class XBOXINTERNALSSHARED_EXPORT AsyncCopy
+{
+public:
+    AsyncCopy(BaseIO *source, BaseIO *destination, DWORD chunkSize = ASYNCCOPY_DEFAULT_CHUNK_SIZE,
+            DWORD queueDepth = ASYNCCOPY_DEFAULT_QUEUE_DEPTH);
+    ~AsyncCopy();
+
+    // copy the ranges in order, ranges larger than the chunk size are split up. The progress
+    // is reported in chunks after each one is written
+    void Copy(const std::vector<CopyRange> &ranges, void(*progress)(void*, DWORD, DWORD) = NULL,
+            void *arg = NULL);
+
+    // copy len bytes from sourceOffset to destOffset
+    void Copy(UINT64 sourceOffset, UINT64 destOffset, UINT64 len,
+            void(*progress)(void*, DWORD, DWORD) = NULL, void *arg = NULL);
+
+    DWORD GetChunkSize();
+
+    DWORD GetQueueDepth();
+
+private:
+    BaseIO *source;
+    BaseIO *destination;
+    DWORD chunkSize;
+    DWORD queueDepth;
+
+    // the ring of buffers that the reader fills and the writer empties
+    std::vector<BYTE*> buffers;
+
+    friend class AsyncCopyReader;
+};
+
+#endif // ASYNCCOPY_H
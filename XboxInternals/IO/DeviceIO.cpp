@@ -1,14 +1,18 @@
 #include "DeviceIO.h"
 #include <string.h>
 #include <errno.h>
+#include <stdlib.h>
 
 #ifdef _WIN32
 #include <windows.h>
 #include <WinIoCtl.h>
+#include <malloc.h>
 #else
 #include <fcntl.h>
 #include <sys/types.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #if __APPLE__
 #include <sys/disk.h>
 #elif __linux
@@ -18,278 +22,467 @@
 #endif
 
 #ifdef __linux
-#define SECTOR_COUNT BLKGETSIZE
-#define SECTOR_SIZE BLKSSZGET
-#elif __APPLE__
-#define SECTOR_COUNT DKIOCGETBLOCKCOUNT
-#define SECTOR_SIZE DKIOCGETBLOCKSIZE
+#define PREAD pread64
+#define PWRITE pwrite64
+#define LSEEK lseek64
+#else
+#define PREAD pread
+#define PWRITE pwrite
+#define LSEEK lseek
 #endif
 
+// every buffer handed to the device is aligned to this, it's a multiple of every block size in use
+#define DEVICEIO_BUFFER_ALIGNMENT 0x1000
+
 class DeviceIO::Impl
 {
 public:
 #ifdef _WIN32
     HANDLE deviceHandle;
-    OVERLAPPED offset;
 #else
     int device;
-    INT64 offset;
 #endif
+
+    // if true, the buffers and offsets given to the device must be block aligned
+    bool unbuffered;
+
+    // an aligned buffer used to Write from memory that isn't aligned
+    BYTE *bounce;
+
+    // whether it's an image in a regular file, and the whole of it mapped into memory if it is
+    bool image;
+    BYTE *mapping;
 };
 
 #ifdef __WIN32
 DeviceIO::DeviceIO(void* deviceHandle) :
-    impl(new Impl), lastReadOffset(-1)
+    impl(new Impl), pos(0), readAhead(NULL), readAheadLength(0)
 {
-    pos = 0;
     if ((HANDLE)deviceHandle == INVALID_HANDLE_VALUE)
         throw std::string("DeviceIO: Invalid device handle.\n");
 
     this->impl->deviceHandle = (HANDLE)deviceHandle;
-    memset(&impl->offset, 0, sizeof(OVERLAPPED));
+    this->impl->unbuffered = true;
+    this->impl->bounce = NULL;
+    this->impl->image = false;
+    this->impl->mapping = NULL;
+
+    loadGeometry();
 }
 #endif
 
-DeviceIO::DeviceIO(std::string devicePath) :
-    impl(new Impl), lastReadOffset(-1)
+DeviceIO::DeviceIO(std::string devicePath, bool directIO) :
+    impl(new Impl), pos(0), readAhead(NULL), readAheadLength(0)
 {
     // convert it to a wstring
     std::wstring wsDevicePath;
     wsDevicePath.assign(devicePath.begin(), devicePath.end());
 
     // load the device
-    loadDevice(wsDevicePath);
+    loadDevice(wsDevicePath, directIO);
 }
 
-DeviceIO::DeviceIO(std::wstring devicePath) :
-    impl(new Impl), lastReadOffset(-1)
+DeviceIO::DeviceIO(std::wstring devicePath, bool directIO) :
+    impl(new Impl), pos(0), readAhead(NULL), readAheadLength(0)
 {
     // load the device
-    loadDevice(devicePath);
+    loadDevice(devicePath, directIO);
 }
 
 DeviceIO::~DeviceIO()
 {
+    // don't lose anything that's been held back, but a destructor can't throw
+    try
+    {
+        writeDirtyBlocks();
+    }
+    catch (...)
+    {
+    }
+
+    for (std::map<UINT64, BYTE*>::iterator i = dirtyBlocks.begin(); i != dirtyBlocks.end(); ++i)
+        FreeAligned(i->second);
+
+    FreeAligned(readAhead);
+
     if (impl)
     {
+        unmapImage();
+        FreeAligned(impl->bounce);
         delete impl;
     }
 }
 
 void DeviceIO::ReadBytes(BYTE *outBuffer, DWORD len)
 {
-    UINT64 endingPos = pos + len;
-    if ((pos & 0x1FF) == 0 && (len & 0x1FF) == 0)
-    {
-#ifdef _WIN32
-        bool success = ReadFile(
-                    impl->deviceHandle,   // Device to read from
-                    outBuffer,            // Output buffer
-                    len,                  // Length to read
-                    NULL,                 // Pointer to the number of bytes read
-                    &impl->offset);       // OVERLAPPED structure containing the offset to read from
-
-        if (!success)
-            throw std::string("DeviceIO: Error reading from device, may be disconnected.\n");
-#else
-        read(impl->device, outBuffer, len);
-#endif
-
-        SetPosition(endingPos);
+    if (pos + len > Length())
+        throw std::string("DeviceIO: Cannot read beyond the end of the stream.\n");
 
+    // the read-ahead cache would only be another copy of what's mapped
+    if (impl->mapping != NULL)
+    {
+        memcpy(outBuffer, impl->mapping + pos, len);
+        pos += len;
         return;
     }
 
-    UINT64 originalPos = pos;
-    SetPosition(DOWN_TO_NEAREST_SECTOR(pos));
+    UINT64 startPos = pos;
+    BYTE *startBuffer = outBuffer;
+    DWORD startLen = len;
 
-    if (lastReadOffset != pos)
+    while (len > 0)
     {
-#ifdef _WIN32
-        bool success = ReadFile(
-                    impl->deviceHandle,   // Device to read from
-                    lastReadData,         // Output buffer
-                    FAT_SECTOR_SIZE,                // Length to read
-                    NULL,                 // Pointer to the number of bytes read
-                    &impl->offset);       // OVERLAPPED structure containing the offset to read from
-
-        if (!success)
-            throw std::string("DeviceIO: Error reading from device, may be disconnected.\n");
-#else
-        read(impl->device, lastReadData, FAT_SECTOR_SIZE);
-#endif
-
-        lastReadOffset = pos;
+        // copy over whatever is already in the read-ahead cache
+        if (readAheadLength != 0 && pos >= readAheadOffset && pos < readAheadOffset + readAheadLength)
+        {
+            DWORD available = (DWORD)(readAheadOffset + readAheadLength - pos);
+            DWORD toCopy = (len > available) ? available : len;
+
+            memcpy(outBuffer, readAhead + (pos - readAheadOffset), toCopy);
+
+            outBuffer += toCopy;
+            pos += toCopy;
+            len -= toCopy;
+            continue;
+        }
+
+        // large aligned reads go straight into the caller's buffer
+        DWORD alignedLen = len & ~(logicalBlockSize - 1);
+        bool bufferAligned = !impl->unbuffered || ((size_t)outBuffer % DEVICEIO_BUFFER_ALIGNMENT) == 0;
+        if (alignedLen >= readAheadSize && (pos & (logicalBlockSize - 1)) == 0 && bufferAligned)
+        {
+            readBlocks(pos, outBuffer, alignedLen);
+
+            outBuffer += alignedLen;
+            pos += alignedLen;
+            len -= alignedLen;
+            continue;
+        }
+
+        fillReadAhead(pos);
     }
 
-    // copy over the data requested
-    WORD bytesLeftInSector = FAT_SECTOR_SIZE - (originalPos & 0x1FF);
-    WORD neededBytes = (len > bytesLeftInSector) ? bytesLeftInSector : len;
-    memcpy(outBuffer, lastReadData + (originalPos & 0x1FF), neededBytes);
-
-    len -= neededBytes;
-    outBuffer += neededBytes;
+    // the device doesn't have the held back blocks yet
+    overlayDirtyBlocks(startPos, startBuffer, startLen);
+}
 
-    if (len == 0)
+void DeviceIO::ReadBytesAt(UINT64 offset, BYTE *outBuffer, DWORD len)
+{
+    if (offset + len > Length())
+        throw std::string("DeviceIO: Cannot read beyond the end of the stream.\n");
+
+    UINT64 blockMask = logicalBlockSize - 1;
+    bool bufferAligned = !impl->unbuffered || ((size_t)outBuffer % DEVICEIO_BUFFER_ALIGNMENT) == 0;
+    if ((offset & blockMask) == 0 && (len & blockMask) == 0 && bufferAligned)
+        readBlocks(offset, outBuffer, len);
+    else
     {
-        SetPosition(endingPos);
-        return;
+        // read the whole blocks the range is in, the last one can be cut short by the end of the device
+        UINT64 start = offset & ~blockMask;
+        UINT64 end = (offset + len + blockMask) & ~blockMask;
+        if (end > Length())
+            end = Length();
+
+        BYTE *blocks = AllocateAligned((DWORD)(end - start));
+        try
+        {
+            readBlocks(start, blocks, (DWORD)(end - start));
+        }
+        catch (...)
+        {
+            FreeAligned(blocks);
+            throw;
+        }
+
+        memcpy(outBuffer, blocks + (offset - start), len);
+        FreeAligned(blocks);
     }
 
-    // seek to the next sector
-    SetPosition(pos + FAT_SECTOR_SIZE); // 0x200
+    overlayDirtyBlocks(offset, outBuffer, len);
+}
 
-    INT64 downTo = DOWN_TO_NEAREST_SECTOR(len);
+void DeviceIO::WriteBytes(BYTE *buffer, DWORD len)
+{
+    // nothing to do
+    if (len == 0)
+        return;
 
-    // read the consecutive sectors
-#ifdef _WIN32
-    bool success = ReadFile(
-                impl->deviceHandle,                 // Device to read from
-                outBuffer,                          // Output buffer
-                downTo,                             // Length to read
-                NULL,                               // Pointer to the number of bytes read
-                &impl->offset);                     // OVERLAPPED structure containing the offset to read from
-
-    if (!success)
-        throw std::string("DeviceIO: Error reading from device, may be disconnected.\n");
-#else
-    read(impl->device, outBuffer, downTo);
-#endif
+    // We can't Write beyond the end of the stream
+    if (pos + len > Length())
+        throw std::string("DeviceIO: Cannot Write beyond the end of the stream.\n");
 
-    // update all our values
-    SetPosition(DOWN_TO_NEAREST_SECTOR(endingPos));
-    outBuffer += downTo;
-    len &= 0x1FF;
+    UINT64 blockMask = logicalBlockSize - 1;
 
-    if (len == 0)
+    // the unaligned head only covers part of a block, so it's patched and held back
+    if ((pos & blockMask) != 0)
     {
-        SetPosition(endingPos);
-        return;
+        UINT64 blockOffset = pos & ~blockMask;
+        DWORD startInBlock = (DWORD)(pos - blockOffset);
+        DWORD bytesToWrite = logicalBlockSize - startInBlock;
+        if (bytesToWrite > len)
+            bytesToWrite = len;
+
+        writePartialBlock(blockOffset, startInBlock, buffer, bytesToWrite);
+
+        buffer += bytesToWrite;
+        pos += bytesToWrite;
+        len -= bytesToWrite;
     }
 
-    // read the stragglers
-#ifdef _WIN32
-    success = ReadFile(
-            impl->deviceHandle,                 // Device to read from
-            lastReadData,                       // Output buffer
-            FAT_SECTOR_SIZE,                              // Length to read
-            NULL,                               // Pointer to the number of bytes read
-            &impl->offset);                     // OVERLAPPED structure containing the offset to read from
-
-    if (!success)
-        throw std::string("DeviceIO: Error reading from device, may be disconnected.\n");
-#else
-    read(impl->device, lastReadData, FAT_SECTOR_SIZE);
-#endif
+    // the aligned middle is written in one transfer
+    DWORD alignedLen = len & ~blockMask;
+    if (alignedLen != 0)
+    {
+        discardDirtyBlocks(pos, alignedLen);
+        writeBlocks(pos, buffer, alignedLen);
+        updateReadAhead(pos, buffer, alignedLen);
 
-    lastReadOffset = pos;
+        buffer += alignedLen;
+        pos += alignedLen;
+        len -= alignedLen;
+    }
 
-    // copy over the requested data
-    memcpy(outBuffer, lastReadData, len);
+    // and the tail is handled just like the head
+    if (len != 0)
+    {
+        writePartialBlock(pos, 0, buffer, len);
+        pos += len;
+    }
 
-    SetPosition(endingPos);
+    if (dirtyBlocks.size() * logicalBlockSize >= DEVICEIO_MAX_DIRTY_BYTES)
+        writeDirtyBlocks();
 }
 
-void DeviceIO::WriteBytes(BYTE *buffer, DWORD len)
+void DeviceIO::writePartialBlock(UINT64 blockOffset, DWORD startInBlock, BYTE *buffer, DWORD len)
 {
-    UINT64 endingPos = pos + len;
-    if ((pos & 0x1FF) == 0 && (len & 0x1FF) == 0)
+    BYTE *block;
+
+    std::map<UINT64, BYTE*>::iterator dirty = dirtyBlocks.find(blockOffset);
+    if (dirty != dirtyBlocks.end())
+        block = dirty->second;
+    else
     {
-#ifdef _WIN32
-        bool success = WriteFile(
-                    impl->deviceHandle,     // Device to read from
-                    buffer,                 // Output buffer
-                    len,                    // Length to read
-                    NULL,                   // Pointer to the number of bytes read
-                    &impl->offset);         // OVERLAPPED structure containing the offset to read from
-
-        if (!success)
-            throw std::string("DeviceIO: Error writing to the device, may be disconnected.\n");
-#else
-        write(impl->device, buffer, len);
-#endif
+        // only the first Write to a block has to read it
+        block = AllocateAligned(logicalBlockSize);
+
+        UINT64 originalPos = pos;
+        try
+        {
+            SetPosition(blockOffset);
+            ReadBytes(block, logicalBlockSize);
+        }
+        catch (...)
+        {
+            FreeAligned(block);
+            pos = originalPos;
+            throw;
+        }
+        pos = originalPos;
+
+        dirtyBlocks[blockOffset] = block;
+    }
 
-        SetPosition(endingPos);
+    memcpy(block + startInBlock, buffer, len);
+    updateReadAhead(blockOffset + startInBlock, buffer, len);
+}
 
+void DeviceIO::writeDirtyBlocks()
+{
+    if (dirtyBlocks.empty())
         return;
+
+    BYTE *run = AllocateAligned(readAheadSize);
+
+    try
+    {
+        std::map<UINT64, BYTE*>::iterator i = dirtyBlocks.begin();
+        while (i != dirtyBlocks.end())
+        {
+            // gather up consecutive blocks so they're written together
+            UINT64 runOffset = i->first;
+            DWORD runLength = 0;
+            while (i != dirtyBlocks.end() && i->first == runOffset + runLength &&
+                    runLength + logicalBlockSize <= readAheadSize)
+            {
+                memcpy(run + runLength, i->second, logicalBlockSize);
+                runLength += logicalBlockSize;
+                ++i;
+            }
+
+            writeBlocks(runOffset, run, runLength);
+        }
+    }
+    catch (...)
+    {
+        FreeAligned(run);
+        throw;
     }
 
-    // nothing to do
-    if (len == 0)
+    FreeAligned(run);
+
+    for (std::map<UINT64, BYTE*>::iterator i = dirtyBlocks.begin(); i != dirtyBlocks.end(); ++i)
+        FreeAligned(i->second);
+    dirtyBlocks.clear();
+}
+
+void DeviceIO::overlayDirtyBlocks(UINT64 offset, BYTE *outBuffer, DWORD len)
+{
+    if (dirtyBlocks.empty())
         return;
 
-    // We can't Write beyond the end of the stream
-    if (pos + len > Length())
-        throw std::string("DeviceIO: Cannot Write beyond the end of the stream.\n");
+    UINT64 end = offset + len;
+    std::map<UINT64, BYTE*>::iterator i = dirtyBlocks.lower_bound(offset & ~(UINT64)(
+                logicalBlockSize - 1));
+    for (; i != dirtyBlocks.end() && i->first < end; ++i)
+    {
+        UINT64 start = (i->first > offset) ? i->first : offset;
+        UINT64 stop = (i->first + logicalBlockSize < end) ? i->first + logicalBlockSize : end;
 
+        memcpy(outBuffer + (start - offset), i->second + (start - i->first), (size_t)(stop - start));
+    }
+}
 
-    UINT64 originalPos = pos;
-    UINT64 currentSector = DOWN_TO_NEAREST_SECTOR(pos);
+void DeviceIO::discardDirtyBlocks(UINT64 offset, DWORD len)
+{
+    std::map<UINT64, BYTE*>::iterator i = dirtyBlocks.lower_bound(offset);
+    while (i != dirtyBlocks.end() && i->first < offset + len)
+    {
+        FreeAligned(i->second);
+        dirtyBlocks.erase(i++);
+    }
+}
 
-    // Write the bytes up to the next sector
-    SetPosition(currentSector);
-    ReadBytes(lastReadData, FAT_SECTOR_SIZE);
-    lastReadOffset = currentSector;
-    WORD bytesLeftInSector = FAT_SECTOR_SIZE - (originalPos - currentSector);
-    WORD bytesToWrite = (len >= bytesLeftInSector) ? bytesLeftInSector : len;
-    memcpy(lastReadData + (originalPos - currentSector), buffer, bytesToWrite);
+void DeviceIO::readBlocks(UINT64 offset, BYTE *outBuffer, DWORD len)
+{
+    if (impl->mapping != NULL)
+    {
+        memcpy(outBuffer, impl->mapping + offset, len);
+        return;
+    }
 
-    // Write the actual data
-    SetPosition(currentSector);
+    while (len > 0)
+    {
 #ifdef _WIN32
-    DWORD bytesWritten;
-
-    WriteFile(
-        impl->deviceHandle,   // Device to read from
-        lastReadData,         // Data to Write
-        FAT_SECTOR_SIZE,                // Amount of data to Write
-        &bytesWritten,        // Pointer to number of bytes written
-        &impl->offset);       // OVERLAPPED structure containing the offset to Write from
+        OVERLAPPED overlapped;
+        memset(&overlapped, 0, sizeof(OVERLAPPED));
+        overlapped.Offset = (DWORD)offset;
+        overlapped.OffsetHigh = (DWORD)(offset >> 32);
+
+        DWORD bytesRead = 0;
+        if (!ReadFile(impl->deviceHandle, outBuffer, len, &bytesRead, &overlapped))
+            throw std::string("DeviceIO: Error reading from device, may be disconnected.\n");
 #else
-    write(impl->device, lastReadData, FAT_SECTOR_SIZE);
+        ssize_t bytesRead = PREAD(impl->device, outBuffer, len, offset);
+        if (bytesRead < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            throw std::string("DeviceIO: Error reading from device, may be disconnected.\n" +
+                    std::string(strerror(errno)));
+        }
 #endif
 
-    // update the values
-    buffer += bytesToWrite;
-    currentSector += FAT_SECTOR_SIZE;
-    len -= bytesToWrite;
+        if (bytesRead == 0)
+            throw std::string("DeviceIO: Unexpected end of device.\n");
+
+        outBuffer += bytesRead;
+        offset += bytesRead;
+        len -= bytesRead;
+    }
+}
 
-    // Write the rest of the data
+void DeviceIO::writeBlocks(UINT64 offset, BYTE *buffer, DWORD len)
+{
     while (len > 0)
     {
-        SetPosition(currentSector);
-        lastReadOffset = DOWN_TO_NEAREST_SECTOR(pos);
-        ReadBytes(lastReadData, FAT_SECTOR_SIZE);
-        bytesToWrite = (len >= FAT_SECTOR_SIZE) ? FAT_SECTOR_SIZE : len;
-        memcpy(lastReadData, buffer, bytesToWrite);
-
-        // go to the top of the sector
-        SetPosition(currentSector);
-
-        // update values
-        buffer += bytesToWrite;
-        currentSector += FAT_SECTOR_SIZE;
-        len -= bytesToWrite;
+        // unbuffered transfers need aligned memory, so copy it somewhere that is
+        BYTE *source = buffer;
+        DWORD toWrite = len;
+        if (impl->unbuffered && ((size_t)buffer % DEVICEIO_BUFFER_ALIGNMENT) != 0)
+        {
+            if (impl->bounce == NULL)
+                impl->bounce = AllocateAligned(readAheadSize);
+
+            toWrite = (len > readAheadSize) ? readAheadSize : len;
+            memcpy(impl->bounce, buffer, toWrite);
+            source = impl->bounce;
+        }
 
 #ifdef _WIN32
-        WriteFile(
-            impl->deviceHandle,   // Device to read from
-            lastReadData,         // Data to Write
-            FAT_SECTOR_SIZE,                // Amount of data to Write
-            &bytesWritten,        // Pointer to number of bytes written
-            &impl->offset);       // OVERLAPPED structure containing the offset to Write from
+        OVERLAPPED overlapped;
+        memset(&overlapped, 0, sizeof(OVERLAPPED));
+        overlapped.Offset = (DWORD)offset;
+        overlapped.OffsetHigh = (DWORD)(offset >> 32);
+
+        DWORD bytesWritten = 0;
+        if (!WriteFile(impl->deviceHandle, source, toWrite, &bytesWritten, &overlapped))
+            throw std::string("DeviceIO: Error writing to the device, may be disconnected.\n");
 #else
-        write(impl->device, buffer, FAT_SECTOR_SIZE);
+        ssize_t bytesWritten = PWRITE(impl->device, source, toWrite, offset);
+        if (bytesWritten < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            throw std::string("DeviceIO: Error writing to the device, may be disconnected.\n" +
+                    std::string(strerror(errno)));
+        }
 #endif
+
+        if (bytesWritten == 0)
+            throw std::string("DeviceIO: Unexpected end of device.\n");
+
+        buffer += bytesWritten;
+        offset += bytesWritten;
+        len -= bytesWritten;
     }
+}
+
+void DeviceIO::fillReadAhead(UINT64 offset)
+{
+    if (readAhead == NULL)
+        readAhead = AllocateAligned(readAheadSize);
+
+    UINT64 start = offset & ~(UINT64)(logicalBlockSize - 1);
+    DWORD toRead = readAheadSize;
+    if (start + toRead > Length())
+        toRead = (DWORD)(Length() - start);
 
-    // set the position
-    SetPosition(endingPos);
+    // invalidate it first in case the read fails
+    readAheadLength = 0;
+
+    readBlocks(start, readAhead, toRead);
+
+    // blocks that are still held back are newer than what was just read
+    overlayDirtyBlocks(start, readAhead, toRead);
+
+    readAheadOffset = start;
+    readAheadLength = toRead;
+}
+
+void DeviceIO::updateReadAhead(UINT64 offset, BYTE *buffer, DWORD len)
+{
+    if (readAheadLength == 0 || offset >= readAheadOffset + readAheadLength ||
+            offset + len <= readAheadOffset)
+        return;
+
+    UINT64 start = (offset > readAheadOffset) ? offset : readAheadOffset;
+    UINT64 end = (offset + len < readAheadOffset + readAheadLength) ? offset + len : readAheadOffset +
+            readAheadLength;
+
+    memcpy(readAhead + (start - readAheadOffset), buffer + (start - offset), (size_t)(end - start));
 }
 
 UINT64 DeviceIO::Length()
 {
-    UINT64 length;
+    return length;
+}
+
+void DeviceIO::loadGeometry()
+{
+    length = 0;
+    logicalBlockSize = FAT_SECTOR_SIZE;
+    physicalBlockSize = FAT_SECTOR_SIZE;
+
 #ifdef _WIN32
     DISK_GEOMETRY geometry;
     DWORD bytesReturned;
@@ -309,58 +502,172 @@ UINT64 DeviceIO::Length()
             geometry.Cylinders.LowPart; // Convert the BIG_INTEGER to UINT64
     length = cylinders * (UINT64)geometry.TracksPerCylinder	* (UINT64)geometry.SectorsPerTrack *
              (UINT64)geometry.BytesPerSector;
-#else
-    UINT64 numberOfSectors = 0;
+
+    if (geometry.BytesPerSector != 0)
+        logicalBlockSize = physicalBlockSize = geometry.BytesPerSector;
+
+    // files don't have a geometry, so it must be an image
+    LARGE_INTEGER fileSize;
+    if (length == 0 && GetFileSizeEx(impl->deviceHandle, &fileSize))
+    {
+        length = fileSize.QuadPart;
+        impl->image = true;
+    }
+#elif __linux
     int device = impl->device;
 
-    ioctl(device, SECTOR_COUNT, &numberOfSectors);
+    UINT64 bytes = 0;
+    if (ioctl(device, BLKGETSIZE64, &bytes) == 0)
+        length = bytes;
+
+    int logical = 0;
+    if (ioctl(device, BLKSSZGET, &logical) == 0 && logical > 0)
+        logicalBlockSize = logical;
 
-    UINT64 sectorSize = 0;
-    ioctl(device, SECTOR_SIZE, &sectorSize);
+    unsigned int physical = 0;
+    if (ioctl(device, BLKPBSZGET, &physical) == 0 && physical > 0)
+        physicalBlockSize = physical;
+#elif __APPLE__
+    int device = impl->device;
 
-    // calculate the length in bytes
-    length = (UINT64)numberOfSectors * (UINT64)sectorSize;
+    UINT64 numberOfBlocks = 0;
+    DWORD blockSize = 0;
+    if (ioctl(device, DKIOCGETBLOCKCOUNT, &numberOfBlocks) == 0 &&
+            ioctl(device, DKIOCGETBLOCKSIZE, &blockSize) == 0 && blockSize != 0)
+    {
+        length = numberOfBlocks * blockSize;
+        logicalBlockSize = blockSize;
+    }
+
+#ifdef DKIOCGETPHYSICALBLOCKSIZE
+    DWORD physical = 0;
+    if (ioctl(device, DKIOCGETPHYSICALBLOCKSIZE, &physical) == 0 && physical != 0)
+        physicalBlockSize = physical;
+#endif
 #endif
 
-    return length;
+#ifndef _WIN32
+    // an image is as long as the file, and there are no blocks to keep to unless the operating
+    // system's cache is being bypassed
+    if (impl->image)
+    {
+        struct stat fileInfo;
+        if (fstat(impl->device, &fileInfo) != 0)
+            throw std::string("DeviceIO: Error reading the length of the image.\n" +
+                    std::string(strerror(errno)));
+
+        length = fileInfo.st_size;
+        if (!impl->unbuffered)
+            logicalBlockSize = physicalBlockSize = 1;
+    }
+    else if (length == 0)
+    {
+        off_t end = LSEEK(impl->device, 0, SEEK_END);
+        if (end > 0)
+            length = end;
+    }
+#endif
+
+    // the block sizes must be powers of two that the aligned buffers can satisfy
+    if ((logicalBlockSize & (logicalBlockSize - 1)) != 0 || logicalBlockSize > DEVICEIO_BUFFER_ALIGNMENT)
+        throw std::string("DeviceIO: Unsupported device block size.\n");
+    if (physicalBlockSize < logicalBlockSize || (physicalBlockSize & (physicalBlockSize - 1)) != 0)
+        physicalBlockSize = logicalBlockSize;
+
+    SetReadAheadSize(DEVICEIO_DEFAULT_READ_AHEAD);
+    mapImage();
 }
 
-void DeviceIO::SetPosition(UINT64 address, std::ios_base::seek_dir dir)
+void DeviceIO::mapImage()
 {
-    if (dir != std::ios_base::beg)
-        throw std::string("DeviceIO: Unsupported seek direction\n");
+#ifndef _WIN32
+    // the whole image has to fit in the address space, and mapping it would defeat bypassing the cache
+    if (!impl->image || impl->unbuffered || length == 0 || sizeof(void*) < 8)
+        return;
 
-    pos = address;
-    address = DOWN_TO_NEAREST_SECTOR(address); // Round the position down to the nearest sector offset
+    // it's only read through the mapping, writes still go through pwrite which keeps it up to date
+    void *mapping = mmap(NULL, (size_t)length, PROT_READ, MAP_SHARED, impl->device, 0);
+    if (mapping == MAP_FAILED)
+        return;
 
-#ifdef _WIN32
-    impl->offset.Offset = (DWORD)address;
-    impl->offset.OffsetHigh = (DWORD)(address >> 32);
-#else
-    impl->offset = address;
+    impl->mapping = (BYTE*)mapping;
 #endif
+}
 
-#ifdef __linux__
-    lseek64(impl->device, address, SEEK_SET);
-#else
-#ifdef _WIN32
-    LONG addressHigh = impl->offset.OffsetHigh;
-    SetFilePointer(impl->deviceHandle, impl->offset.Offset, &addressHigh, FILE_BEGIN);
-#else
-    lseek(impl->device, address, SEEK_SET);
-#endif
+void DeviceIO::unmapImage()
+{
+#ifndef _WIN32
+    if (impl->mapping != NULL)
+        munmap(impl->mapping, (size_t)length);
 #endif
+    impl->mapping = NULL;
 }
 
-UINT64 DeviceIO::realPosition()
+bool DeviceIO::IsImage()
 {
-#ifdef _WIN32
-    return (UINT64)(((UINT64)impl->offset.OffsetHigh << 32) | impl->offset.Offset);
+    return impl->image;
+}
+
+bool DeviceIO::InHole(UINT64 offset, UINT64 len)
+{
+#if !defined(_WIN32) && defined(SEEK_DATA)
+    if (!impl->image || len == 0 || impl->device == -1)
+        return false;
+
+    // find the first data at or after the offset, ENXIO means there isn't any before the end
+    off_t data = LSEEK(impl->device, offset, SEEK_DATA);
+    if (data == -1)
+        return errno == ENXIO;
+
+    return (UINT64)data >= offset + len;
 #else
-    return impl->offset;
+    return false;
 #endif
 }
 
+void DeviceIO::SetReadAheadSize(DWORD size)
+{
+    // transfers are made in whole physical blocks, never smaller than the alignment of the buffers
+    DWORD unit = (physicalBlockSize > DEVICEIO_BUFFER_ALIGNMENT) ? physicalBlockSize :
+            DEVICEIO_BUFFER_ALIGNMENT;
+    size = (size + unit - 1) & ~(unit - 1);
+    if (size == 0)
+        size = unit;
+
+    FreeAligned(readAhead);
+    readAhead = NULL;
+    readAheadLength = 0;
+
+    FreeAligned(impl->bounce);
+    impl->bounce = NULL;
+
+    readAheadSize = size;
+}
+
+DWORD DeviceIO::GetReadAheadSize()
+{
+    return readAheadSize;
+}
+
+DWORD DeviceIO::GetLogicalBlockSize()
+{
+    return logicalBlockSize;
+}
+
+DWORD DeviceIO::GetPhysicalBlockSize()
+{
+    return physicalBlockSize;
+}
+
+void DeviceIO::SetPosition(UINT64 address, std::ios_base::seek_dir dir)
+{
+    if (dir != std::ios_base::beg)
+        throw std::string("DeviceIO: Unsupported seek direction\n");
+
+    // all transfers are positional, so there's nothing to tell the device
+    pos = address;
+}
+
 UINT64 DeviceIO::GetPosition()
 {
     return pos;
@@ -368,20 +675,31 @@ UINT64 DeviceIO::GetPosition()
 
 void DeviceIO::Close()
 {
+    writeDirtyBlocks();
+    unmapImage();
+
 #if defined _WIN32
     if (impl->deviceHandle != INVALID_HANDLE_VALUE)
         CloseHandle(impl->deviceHandle);
+    impl->deviceHandle = INVALID_HANDLE_VALUE;
 #else
-    close(impl->device);
+    if (impl->device != -1)
+        close(impl->device);
     impl->device = -1;
 #endif
+
+    readAheadLength = 0;
 }
 
-void DeviceIO::loadDevice(std::wstring devicePath)
+void DeviceIO::loadDevice(std::wstring devicePath, bool directIO)
 {
+    impl->bounce = NULL;
+    impl->image = false;
+    impl->mapping = NULL;
+
 #ifdef _WIN32
-    pos = 0;
-    memset(&impl->offset, 0, sizeof(OVERLAPPED));
+    // the device is always opened unbuffered on windows
+    impl->unbuffered = true;
 
     // Attempt to get a handle to the device
     impl->deviceHandle = CreateFile(
@@ -400,16 +718,80 @@ void DeviceIO::loadDevice(std::wstring devicePath)
     // need to convert this into a regular string, since open takes a char*
     std::string tempPath(devicePath.begin(), devicePath.end());
 
+    int flags = O_RDWR;
+#ifdef O_DIRECT
+    if (directIO)
+        flags |= O_DIRECT;
+#endif
+
     // Open the device
-    impl->device = open(tempPath.c_str(), O_RDWR);
+    impl->device = open(tempPath.c_str(), flags);
+
+    // images are often kept read only so they can't be changed by accident, they can still be read
+    if (impl->device == -1 && (errno == EACCES || errno == EROFS))
+    {
+        int openError = errno;
+
+        struct stat pathInfo;
+        if (stat(tempPath.c_str(), &pathInfo) == 0 && S_ISREG(pathInfo.st_mode))
+            impl->device = open(tempPath.c_str(), (flags & ~O_RDWR) | O_RDONLY);
+        else
+            errno = openError;
+    }
+
     if (impl->device == -1)
         throw std::string("DeviceIO: Error opening device.\n" + std::string(strerror(errno)));
+
+    struct stat fileInfo;
+    if (fstat(impl->device, &fileInfo) == 0 && S_ISREG(fileInfo.st_mode))
+        impl->image = true;
+
+#ifdef F_NOCACHE
+    if (directIO)
+        fcntl(impl->device, F_NOCACHE, 1);
+#endif
+
+    impl->unbuffered = directIO;
 #endif
+
+    loadGeometry();
 }
 
 void DeviceIO::Flush()
 {
+    writeDirtyBlocks();
+
 #ifdef __WIN32
     FlushFileBuffers(impl->deviceHandle);
+#else
+    fsync(impl->device);
+#endif
+}
+
+BYTE *DeviceIO::AllocateAligned(DWORD size)
+{
+    void *buffer = NULL;
+#ifdef _WIN32
+    buffer = _aligned_malloc(size, DEVICEIO_BUFFER_ALIGNMENT);
+#else
+    if (posix_memalign(&buffer, DEVICEIO_BUFFER_ALIGNMENT, size) != 0)
+        buffer = NULL;
+#endif
+
+    if (buffer == NULL)
+        throw std::string("DeviceIO: Out of memory.\n");
+
+    return (BYTE*)buffer;
+}
+
+void DeviceIO::FreeAligned(BYTE *buffer)
+{
+    if (buffer == NULL)
+        return;
+
+#ifdef _WIN32
+    _aligned_free(buffer);
+#else
+    free(buffer);
 #endif
 }
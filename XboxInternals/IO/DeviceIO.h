@@ -6,23 +6,38 @@
 
 #define FAT_SECTOR_SIZE 0x200
 
+// the amount of data read from the device at once for small or unaligned reads
+#define DEVICEIO_DEFAULT_READ_AHEAD 0x100000
+
+// the amount of partially written blocks held back before they're written to the device
+#define DEVICEIO_MAX_DIRTY_BYTES 0x100000
+
 #include "BaseIO.h"
 #include "../Fatx/FatxHelpers.h"
 #include "XboxInternals_global.h"
 
+#include <map>
+
 class XBOXINTERNALSSHARED_EXPORT DeviceIO : public BaseIO
 {
 public:
     #ifdef __WIN32
     DeviceIO(void* deviceHandle);
     #endif
-    
-    DeviceIO(std::string devicePath);
-    DeviceIO(std::wstring devicePath);
+
+    // directIO bypasses the operating system's cache (O_DIRECT on linux, F_NOCACHE on OS X). The
+    // path can also be a regular file holding an image of a device, those are opened read only
+    // if they can't be written to
+    DeviceIO(std::string devicePath, bool directIO = false);
+    DeviceIO(std::wstring devicePath, bool directIO = false);
     virtual ~DeviceIO();
 
     void ReadBytes(BYTE *outBuffer, DWORD len);
 
+    // read len bytes at offset without moving the position or using the read-ahead cache. It can be
+    // called from several threads at once, as long as nothing is being written
+    void ReadBytesAt(UINT64 offset, BYTE *outBuffer, DWORD len);
+
     void WriteBytes(BYTE *buffer, DWORD len);
 
     void SetPosition(UINT64 address, std::ios_base::seek_dir dir = std::ios_base::beg);
@@ -31,14 +46,71 @@ public:
 
     UINT64 Length();
 
+    // writes any held back blocks before closing the device
     void Close();
 
+    // Write all of the held back blocks to the device and flush its buffers
     void Flush();
 
+    // set the size of the read-ahead cache, it's rounded up to the physical block size
+    void SetReadAheadSize(DWORD size);
+
+    // get the size of the read-ahead cache
+    DWORD GetReadAheadSize();
+
+    // get the smallest unit the device can transfer, all transfers are aligned to this
+    DWORD GetLogicalBlockSize();
+
+    // get the block size the device actually writes in
+    DWORD GetPhysicalBlockSize();
+
+    // whether it's an image of a device in a regular file rather than the device itself. Images
+    // are read through a memory mapping when there's room for one, and written a byte at a time
+    // rather than in whole blocks
+    bool IsImage();
+
+    // whether all len bytes at offset are in a hole of a sparse image, so they'd read back as
+    // zeroes without anything being stored. Always false for devices
+    bool InHole(UINT64 offset, UINT64 len);
+
+    // allocate a buffer that's suitable for unbuffered transfers
+    static BYTE *AllocateAligned(DWORD size);
+    static void FreeAligned(BYTE *buffer);
+
 private:
-    void loadDevice(std::wstring devicePath);
+    void loadDevice(std::wstring devicePath, bool directIO);
+
+    // query the length and the block sizes of the device
+    void loadGeometry();
+
+    // map the image into memory so it can be read without copying it through the read-ahead cache
+    void mapImage();
+
+    void unmapImage();
+
+    // read whole logical blocks from the device at the offset, without touching the cache
+    void readBlocks(UINT64 offset, BYTE *outBuffer, DWORD len);
+
+    // Write whole logical blocks to the device at the offset, without touching the cache
+    void writeBlocks(UINT64 offset, BYTE *buffer, DWORD len);
+
+    // fill the read-ahead cache with the blocks starting at the one containing offset
+    void fillReadAhead(UINT64 offset);
+
+    // copy data that was just written into the read-ahead cache so it doesn't go stale
+    void updateReadAhead(UINT64 offset, BYTE *buffer, DWORD len);
+
+    // patch part of a block and hold it back until the next Flush
+    void writePartialBlock(UINT64 blockOffset, DWORD startInBlock, BYTE *buffer, DWORD len);
+
+    // Write all of the held back blocks, merged into runs of consecutive blocks
+    void writeDirtyBlocks();
+
+    // copy the held back blocks over the data read from the device
+    void overlayDirtyBlocks(UINT64 offset, BYTE *outBuffer, DWORD len);
 
-    UINT64 realPosition();
+    // forget the held back blocks in a range that's being overwritten
+    void discardDirtyBlocks(UINT64 offset, DWORD len);
 
     class Impl;
     Impl* impl;
@@ -46,8 +118,18 @@ private:
     std::string yolo;
 
     UINT64 pos;
-    BYTE lastReadData[FAT_SECTOR_SIZE];
-    UINT64 lastReadOffset;
+    UINT64 length;
+    DWORD logicalBlockSize;
+    DWORD physicalBlockSize;
+
+    // the read-ahead cache, holds readAheadLength bytes of the device starting at readAheadOffset
+    BYTE *readAhead;
+    DWORD readAheadSize;
+    UINT64 readAheadOffset;
+    DWORD readAheadLength;
+
+    // blocks that have been partially written but not yet sent to the device, keyed by offset
+    std::map<UINT64, BYTE*> dirtyBlocks;
 };
 
 #endif // DEVICEIO_H
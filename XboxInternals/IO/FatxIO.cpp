@@ -1,4 +1,5 @@
 #include "FatxIO.h"
+#include "../Fatx/FatxDrive.h"
 
 FatxIO::FatxIO(DeviceIO *device, FatxFileEntry *entry) : entry(entry), device(device)
 {
@@ -60,7 +61,7 @@ void FatxIO::Close()
     // nothing to close since this doesn't actually have a file open
 }
 
-int FatxIO::AllocateMemory(DWORD byteAmount)
+int FatxIO::AllocateMemory(DWORD byteAmount, bool commit)
 {
     // preserve the position
     UINT64 pos = device->GetPosition();
@@ -104,12 +105,12 @@ int FatxIO::AllocateMemory(DWORD byteAmount)
     if (fileIsNull)
         entry->startingCluster = entry->clusterChain.at(0);
 
-    // Write the cluster chain (only if it's changed)
+    // link the new clusters on to the chain (only if it's changed)
     if (clusterCount != 0)
-        WriteClusterChain(entry->partition, entry->startingCluster, entry->clusterChain);
+        entry->partition->allocationTable.SetChain(entry->clusterChain);
 
-    if (entry->address != -1)
-        WriteEntryToDisk();
+    if (commit)
+        Commit();
 
     // preserve the position
     device->SetPosition(pos);
@@ -194,116 +195,33 @@ void FatxIO::WriteBytes(BYTE *buffer, DWORD len)
 
 std::vector<DWORD> FatxIO::getFreeClusters(Partition *part, DWORD count)
 {
-    std::vector<DWORD> freeClusters(count);
-    std::vector<Range> consecutiveClusters;
-    std::vector<Range> usedRanges;
+    // the free clusters aren't known until the FAT's been scanned for them
+    if (!part->freeMemoryCounted && part->drive != NULL)
+        part->drive->GetFreeMemory(part);
 
     // check to see if we have enough free clusters left
-    if (count > part->freeClusters.size())
+    if (count > part->freeClusters.ClusterCount())
     {
         std::stringstream ss;
         ss << "FATX: Out of memory. There are only ";
-        ss << ByteSizeToString(part->freeClusters.size() * part->clusterSize).c_str();
+        ss << ByteSizeToString((UINT64)part->freeClusters.ClusterCount() * part->clusterSize).c_str();
         ss << " of free memory remaining on this partition.\n";
 
         throw ss.str();
     }
 
-    // get the consecutive clusters
-    GetConsecutive(part->freeClusters, consecutiveClusters);
-
-    // sort the consecutive clusters so that the longest ranges are at the beginning
-    std::sort(consecutiveClusters.begin(), consecutiveClusters.end(), compareRanges);
-
-    // first get clusters that are consecutive
-    DWORD i = 0, currentIndex = 0;
-    while (count > 0 && i < consecutiveClusters.size())
-    {
-        // get the amount of clusters to copy from the consecutive cluster range
-        DWORD clustersToCopy = (count > consecutiveClusters.at(i).len) ? consecutiveClusters.at(
-                    i).len : count;
-        std::vector<DWORD>::iterator rangeStart = part->freeClusters.begin() + consecutiveClusters.at(
-                    i).start;
-
-        // get that calculated amount of consecutive clusters
-        std::copy(rangeStart, rangeStart + clustersToCopy, freeClusters.begin() + currentIndex);
-
-        Range r = { consecutiveClusters.at(i).start, clustersToCopy };
-        usedRanges.push_back(r);
-
-        count -= clustersToCopy;
-        currentIndex += clustersToCopy;
-        i++;
-    }
-
-    // remove all of the used clusters
-    for (DWORD i = 0; i < usedRanges.size(); i++)
-        part->freeClusters.erase(part->freeClusters.begin() + usedRanges.at(i).start,
-                part->freeClusters.begin() + usedRanges.at(i).start + usedRanges.at(i).len);
-
-    // if we still need more clusters, then we'll just copy over non-consecutive ones that are left
-    std::copy(part->freeClusters.begin(), part->freeClusters.begin() + count,
-              freeClusters.begin() + currentIndex);
-    part->freeClusters.erase(part->freeClusters.begin(), part->freeClusters.begin() + count);
-
-    return freeClusters;
+    // the longest runs of free clusters are used first to keep the file together
+    return part->freeClusters.Allocate(count);
 }
 
-void FatxIO::SetAllClusters(DeviceIO *device, Partition *part, std::vector<DWORD> &clusters,
-        DWORD value)
+void FatxIO::Commit()
 {
-    // sort the clusters numerically, order doesn't matter any more since we're just setting them all to the same value
-    XeCrypt::InsertionSort(clusters.begin(), clusters.end());
-
-    // we'll work with the clusters in 0x10000 chunks to minimize the amount of reads
-    BYTE buffer[0x10000];
-
-    for (DWORD i = 0; i < clusters.size(); i++)
-    {
-        // seek to the lowest cluster in the chainmap, but round to get a fast read
-        UINT64 clusterEntryAddr = (part->address + 0x1000 + clusters.at(i) * part->clusterEntrySize);
-        device->SetPosition(DOWN_TO_NEAREST_SECTOR(clusterEntryAddr));
-
-        // read in a chunk of the chainmap
-        device->ReadBytes(buffer, 0x10000);
-
-        // open a MemoryIO on the memory for easier access
-        MemoryIO bufferIO(buffer, 0x10000);
-
-        // calculate the offset of the cluster in the buffer
-        UINT64 clusterEntryOffset = clusterEntryAddr - DOWN_TO_NEAREST_SECTOR(clusterEntryAddr);
-
-        // loop while still in the bounds of the buffer
-        while (clusterEntryOffset < 0x10000)
-        {
-            // seek to the address of the cluster in the buffer
-            bufferIO.SetPosition(clusterEntryOffset);
-
-            // set the cluster chain map entry to the value requested
-            if (part->clusterEntrySize == 2)
-                bufferIO.Write((WORD)value);
-            else
-                bufferIO.Write((DWORD)value);
-
-            if (i + 1 == clusters.size())
-            {
-                ++i;
-                break;
-            }
-
-            // calculate the value of the next cluster entry
-            clusterEntryOffset = (part->address + 0x1000 + clusters.at(++i) * part->clusterEntrySize) -
-                    DOWN_TO_NEAREST_SECTOR(clusterEntryAddr);
-        }
-        --i;
-
-        // once we're done then Write the block of memory back
-        device->SetPosition(DOWN_TO_NEAREST_SECTOR(clusterEntryAddr));
-        device->WriteBytes(buffer, 0x10000);
-    }
-
-    // flush the device just to be safe
+    // the data has to be on the device before the FAT says it's in use
     device->Flush();
+    entry->partition->allocationTable.Commit();
+
+    if (entry->address != -1)
+        WriteEntryToDisk();
 }
 
 void FatxIO::WriteEntryToDisk(std::vector<DWORD> *clusterChain)
@@ -323,6 +241,15 @@ void FatxIO::WriteEntryToDisk(std::vector<DWORD> *clusterChain)
     if (wantsToWriteClusterChain && entry->startingCluster != clusterChain->at(0))
         throw std::string("FATX: Entry starting cluster does not match with cluster chain.\n");
 
+    // the new chain goes in the FAT before the entry that points to it
+    if (wantsToWriteClusterChain)
+    {
+        FatxAllocationTable &allocationTable = entry->partition->allocationTable;
+        allocationTable.SetAll(entry->clusterChain, FAT_CLUSTER_AVAILABLE);
+        allocationTable.SetChain(*clusterChain);
+        allocationTable.Commit();
+    }
+
     device->SetPosition(entry->address);
     device->Write(nameLen);
     device->Write(entry->fileAttributes);
@@ -337,12 +264,6 @@ void FatxIO::WriteEntryToDisk(std::vector<DWORD> *clusterChain)
     device->Write(entry->creationDate);
     device->Write(entry->lastWriteDate);
     device->Write(entry->lastAccessDate);
-
-    if (wantsToWriteClusterChain)
-    {
-        SetAllClusters(device, entry->partition, entry->clusterChain, FAT_CLUSTER_AVAILABLE);
-        WriteClusterChain(entry->partition, entry->startingCluster, *clusterChain);
-    }
 }
 
 void FatxIO::ReplaceFile(std::string sourcePath, void (*progress)(void *, DWORD, DWORD), void *arg)
@@ -357,6 +278,7 @@ void FatxIO::ReplaceFile(std::string sourcePath, void (*progress)(void *, DWORD,
     if (fileSize == 0)
     {
         inFile.Close();
+        Commit();
         if (progress)
             progress(arg, 1, 1);
         return;
@@ -379,165 +301,65 @@ void FatxIO::ReplaceFile(std::string sourcePath, void (*progress)(void *, DWORD,
                   clustersToFree.begin());
 
         // set all of those clusters to free
-        SetAllClusters(device, entry->partition, clustersToFree, FAT_CLUSTER_AVAILABLE);
+        FatxAllocationTable &allocationTable = entry->partition->allocationTable;
+        allocationTable.SetAll(clustersToFree, FAT_CLUSTER_AVAILABLE);
+        if (entry->partition->freeMemoryCounted)
+            entry->partition->freeClusters.Free(clustersToFree);
 
-        // erase the now freed ones from the chain
+        // erase the now freed ones from the chain, and end it at the new last cluster
         entry->clusterChain.erase(entry->clusterChain.begin() + clusterCount, entry->clusterChain.end());
+        allocationTable.SetChain(entry->clusterChain);
     }
     // if the file is bigger then we need to allocate clustes
     else if (clusterCount > entry->clusterChain.size())
     {
-        AllocateMemory((clusterCount * entry->partition->clusterSize) - entry->fileSize);
+        AllocateMemory((clusterCount * entry->partition->clusterSize) - entry->fileSize, false);
     }
 
     entry->fileSize = fileSize;
-    WriteEntryToDisk();
 
     ///////////////////
     // START WRITING //
     ///////////////////
 
-    // calculate stuff
-    DWORD bufferSize = (entry->fileSize / 0x10);
-    if (bufferSize < 0x10000)
-        bufferSize = 0x10000;
-    else if (bufferSize > 0x100000)
-        bufferSize = 0x100000;
-
-    std::vector<Range> WriteRanges;
-    BYTE *buffer = new BYTE[bufferSize];
-    UINT64 pos;
-
-    // generate the read ranges
-    for (DWORD i = 0; i < entry->clusterChain.size() - 1; i++)
-    {
-        // calculate cluster's address
-        pos = FatxIO::ClusterToOffset(entry->partition, entry->clusterChain.at(i));
-
-        Range range = { pos, 0 };
-        do
-        {
-            range.len += entry->partition->clusterSize;
+    // the file is read while the previous chunk is being written to the device
+    std::vector<CopyRange> writeRanges;
+    getClusterRuns(writeRanges, false);
 
-            i++;
-        }
-        while ((entry->clusterChain.at(i - 1) + 1) == entry->clusterChain.at(i) &&
-                i < (entry->clusterChain.size() - 2) && (range.len + entry->partition->clusterSize) <= bufferSize);
-        i--;
-
-        WriteRanges.push_back(range);
-    }
+    AsyncCopy copy(&inFile, device);
+    copy.Copy(writeRanges, progress, arg);
 
-    DWORD finalClusterSize = entry->fileSize % entry->partition->clusterSize;
-    UINT64 finalClusterOffset = FatxIO::ClusterToOffset(entry->partition,
-            entry->clusterChain.at(entry->clusterChain.size() - 1));
-    Range lastRange = { finalClusterOffset , (finalClusterSize == 0) ? entry->partition->clusterSize : finalClusterSize };
-    WriteRanges.push_back(lastRange);
-
-    DWORD modulus = WriteRanges.size() / 100;
-    if (modulus == 0)
-        modulus = 1;
-    else if (modulus > 3)
-        modulus = 3;
-
-    // read all the data in
-    for (DWORD i = 0; i < WriteRanges.size(); i++)
-    {
-        // seek to the beginning of the range
-        device->SetPosition(WriteRanges.at(i).start);
-
-        // get the range from the device
-        inFile.ReadBytes(buffer, WriteRanges.at(i).len);
-        device->WriteBytes(buffer, WriteRanges.at(i).len);
-
-        // update progress if needed
-        if (progress && i % modulus == 0)
-            progress(arg, i, WriteRanges.size());
-    }
-
-    // clean up
     inFile.Close();
-    delete[] buffer;
 
-    // make sure it hits the end
-    if (progress)
-        progress(arg, WriteRanges.size(), WriteRanges.size());
+    // now that the data's there, the FAT and then the entry can point to it
+    Commit();
 }
 
-void FatxIO::WriteClusterChain(Partition *part, DWORD startingCluster,
-        std::vector<DWORD> clusterChain)
+void FatxIO::getClusterRuns(std::vector<CopyRange> &outRanges, bool deviceIsSource)
 {
-    if (startingCluster == 0 || clusterChain.size() == 0)
-        return;
-    else if (startingCluster > part->clusterCount)
-        throw std::string("FATX: Cluster is greater than cluster count.\n");
-
-    bool clusterSizeIs16 = part->clusterEntrySize == FAT16;
-
-    clusterChain.push_back(FAT_CLUSTER_LAST);
-
-    // we'll work with the clusters in 0x10000 chunks to minimize the amount of reads
-    BYTE buffer[0x10000];
+    DWORD clusterSize = entry->partition->clusterSize;
+    UINT64 fileOffset = 0;
 
-    for (DWORD i = 1; i < clusterChain.size(); i++)
+    for (DWORD i = 0; i < entry->clusterChain.size() && fileOffset < entry->fileSize; )
     {
-        // seek to the lowest cluster in the chainmap, but round to get a fast read
-        UINT64 clusterEntryAddr = (part->address + 0x1000 + clusterChain.at(i - 1) *
-                part->clusterEntrySize);
-        device->SetPosition(DOWN_TO_NEAREST_SECTOR(clusterEntryAddr));
-
-        // read in a chunk of the chainmap
-        device->ReadBytes(buffer, 0x10000);
-
-        // open a MemoryIO on the memory for easier access
-        MemoryIO bufferIO(buffer, 0x10000);
-
-        // calculate the offset of the cluster in the buffer
-        UINT64 clusterEntryOffset = clusterEntryAddr - DOWN_TO_NEAREST_SECTOR(clusterEntryAddr);
-
-        // loop while still in the bounds of the buffer
-        while (clusterEntryOffset < 0x10000)
-        {
-            // seek to the address of the cluster in the buffer
-            bufferIO.SetPosition(clusterEntryOffset);
-
-            // set the cluster chain map entry to the value requested
-            if (clusterSizeIs16)
-                bufferIO.Write((WORD)clusterChain.at(i));
-            else
-                bufferIO.Write((DWORD)clusterChain.at(i));
-
-            if (i + 1 == clusterChain.size())
-            {
-                ++i;
-                break;
-            }
-
-            // calculate the value of the next cluster entry
-            clusterEntryOffset = (part->address + 0x1000 + clusterChain.at(i++) * part->clusterEntrySize) -
-                    DOWN_TO_NEAREST_SECTOR(clusterEntryAddr);
-        }
-        --i;
-
-        // once we're done then Write the block of memory back
-        device->SetPosition(DOWN_TO_NEAREST_SECTOR(clusterEntryAddr));
-        device->WriteBytes(buffer, 0x10000);
+        // find the clusters that follow each other on the device
+        DWORD runLength = 1;
+        while (i + runLength < entry->clusterChain.size() &&
+                entry->clusterChain.at(i + runLength) == entry->clusterChain.at(i) + runLength)
+            runLength++;
+
+        UINT64 len = (UINT64)runLength * clusterSize;
+        if (fileOffset + len > entry->fileSize)
+            len = entry->fileSize - fileOffset;
+
+        UINT64 driveOffset = ClusterToOffset(entry->partition, entry->clusterChain.at(i));
+        CopyRange range = { deviceIsSource ? driveOffset : fileOffset,
+                deviceIsSource ? fileOffset : driveOffset, len };
+        outRanges.push_back(range);
+
+        fileOffset += len;
+        i += runLength;
     }
-
-    // flush the device just to be safe
-    device->Flush();
-
-    /*for (int i = 0; i < clusterChain.size(); i++)
-    {
-        device->SetPosition(part->address + 0x1000 + (previousCluster * part->clusterEntrySize));
-
-        if (clusterSizeIs16)
-            device->Write((WORD)clusterChain.at(i));
-        else
-            device->Write((DWORD)clusterChain.at(i));
-
-        previousCluster = clusterChain.at(i);
-    }*/
 }
 
 void FatxIO::GetConsecutive(std::vector<DWORD> &list, std::vector<Range> &outRanges,
@@ -566,54 +388,8 @@ void FatxIO::GetConsecutive(std::vector<DWORD> &list, std::vector<Range> &outRan
 void FatxIO::SaveFile(std::string savePath, void(*progress)(void*, DWORD, DWORD), void *arg)
 {
     // get the current position
-    UINT64 pos;
     UINT64 originalPos = device->GetPosition();
 
-    // seek to the beggining of the file
-    SetPosition(0);
-
-    // calculate stuff
-    DWORD bufferSize = (entry->fileSize / 0x10);
-    if (bufferSize < 0x10000)
-        bufferSize = 0x10000;
-    else if (bufferSize > 0x100000)
-        bufferSize = 0x100000;
-
-    std::vector<Range> readRanges;
-    BYTE *buffer = new BYTE[bufferSize];
-
-    // generate the read ranges
-    for (DWORD i = 0; i < entry->clusterChain.size() - 1; i++)
-    {
-        // calculate cluster's address
-        pos = ClusterToOffset(entry->partition, entry->clusterChain.at(i));
-
-        Range range = { pos, 0 };
-        do
-        {
-            range.len += entry->partition->clusterSize;
-
-            i++;
-        }
-        while ((entry->clusterChain.at(i - 1) + 1) == entry->clusterChain.at(i) &&
-                i < (entry->clusterChain.size() - 2) && (range.len + entry->partition->clusterSize) <= bufferSize);
-        i--;
-
-        readRanges.push_back(range);
-    }
-
-    DWORD finalClusterSize = entry->fileSize % entry->partition->clusterSize;
-    UINT64 finalClusterOffset = ClusterToOffset(entry->partition,
-            entry->clusterChain.at(entry->clusterChain.size() - 1));
-    Range lastRange = { finalClusterOffset , (finalClusterSize == 0) ? entry->partition->clusterSize : finalClusterSize};
-    readRanges.push_back(lastRange);
-
-    DWORD modulus = readRanges.size() / 100;
-    if (modulus == 0)
-        modulus = 1;
-    else if (modulus > 3)
-        modulus = 3;
-
     // open the new file
     FileIO outFile(savePath, true);
 
@@ -625,30 +401,16 @@ void FatxIO::SaveFile(std::string savePath, void(*progress)(void*, DWORD, DWORD)
         return;
     }
 
-    // read all the data in
-    for (DWORD i = 0; i < readRanges.size(); i++)
-    {
-        // seek to the beginning of the range
-        device->SetPosition(readRanges.at(i).start);
-
-        // get the range from the device
-        device->ReadBytes(buffer, readRanges.at(i).len);
-        outFile.WriteBytes(buffer, readRanges.at(i).len);
+    // the device is read while the previous chunk is being written to the file
+    std::vector<CopyRange> readRanges;
+    getClusterRuns(readRanges, true);
 
-        // update progress if needed
-        if (progress && i % modulus == 0)
-            progress(arg, i + 1, readRanges.size());
-    }
-
-    // make sure it hits the end
-    if (progress)
-        progress(arg, readRanges.size(), readRanges.size());
+    AsyncCopy copy(device, &outFile);
+    copy.Copy(readRanges, progress, arg);
 
     outFile.Flush();
     outFile.Close();
 
-    delete[] buffer;
-
     device->SetPosition(originalPos);
 }
 
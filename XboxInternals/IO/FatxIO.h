@@ -4,6 +4,7 @@
 #include "DeviceIO.h"
 #include "FileIO.h"
 #include "MemoryIO.h"
+#include "AsyncCopy.h"
 #include "../Fatx/FatxConstants.h"
 #include "../Cryptography/XeCrypt.h"
 
@@ -55,8 +56,13 @@ public:
     // does nothing, required implementation
     void Close();
 
-    // expands the cluster chain if necessary, returns the amount of new clusters allocated
-    int AllocateMemory(DWORD byteAmount);
+    // expands the cluster chain if necessary, returns the amount of new clusters allocated. If commit
+    // is false the changes to the FAT are held back, and the entry isn't written until Commit is called
+    int AllocateMemory(DWORD byteAmount, bool commit = true);
+
+    // write the data, then the changes to the FAT, and then the entry to the device, in that order so
+    // the entry never points to clusters that aren't in use yet
+    void Commit();
 
     // Write the entry to disk
     void WriteEntryToDisk(std::vector<DWORD> *clusterChain = NULL);
@@ -68,10 +74,6 @@ public:
     // convert a cluster to an offset
     static UINT64 ClusterToOffset(Partition *part, DWORD cluster);
 
-    // sets all the clusters equal to value
-    static void SetAllClusters(DeviceIO *device, Partition *part, std::vector<DWORD> &clusters,
-            DWORD value);
-
     // get the ranges of consecutive numbers in list where it's sorted
     static void GetConsecutive(std::vector<DWORD> &list, std::vector<Range> &outRanges,
             bool includeNonConsec = false);
@@ -80,8 +82,8 @@ private:
     // find count amount of free custers
     std::vector<DWORD> getFreeClusters(Partition *part, DWORD count);
 
-    // Writes the cluster chain (and links them correctly) starting from startingCluster
-    void WriteClusterChain(Partition *part, DWORD startingCluster, std::vector<DWORD> clusterChain);
+    // get the runs of consecutive clusters the file is stored in, paired with where they are in the file
+    void getClusterRuns(std::vector<CopyRange> &outRanges, bool deviceIsSource);
 
     DeviceIO *device;
     UINT64 pos;
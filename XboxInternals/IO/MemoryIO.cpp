@@ -1,11 +1,17 @@
 #include "MemoryIO.h"
 
 MemoryIO::MemoryIO(BYTE *data, size_t length) :
-    BaseIO(), memory(data), length(length)
+    BaseIO(), growable(false), memory(data), length(length), pos(0)
 {
 
 }
 
+MemoryIO::MemoryIO(size_t capacity) :
+    BaseIO(), growable(true), memory(NULL), length(0), pos(0)
+{
+    Reserve(capacity);
+}
+
 MemoryIO::~MemoryIO()
 {
 
@@ -13,7 +19,7 @@ MemoryIO::~MemoryIO()
 
 void MemoryIO::SetPosition(UINT64 pos, std::ios_base::seek_dir dir)
 {
-    DWORD newPos;
+    UINT64 newPos;
     switch (dir)
     {
         case std::ios_base::beg:
@@ -29,9 +35,10 @@ void MemoryIO::SetPosition(UINT64 pos, std::ios_base::seek_dir dir)
             throw std::string("MemoryIO: Unsupported seek direction\n");
     }
 
-    if (newPos > length)
+    // growable streams can seek past the end like a file, the gap is filled in when it's written to
+    if (newPos > length && !growable)
         throw std::string("MemoryIO: Cannot seek beyond the end of the stream\n");
-    this->pos = pos;
+    this->pos = newPos;
 }
 
 UINT64 MemoryIO::GetPosition()
@@ -46,12 +53,22 @@ UINT64 MemoryIO::Length()
 
 void MemoryIO::ReadBytes(BYTE *outBuffer, DWORD len)
 {
+    if (pos > length || len > length - pos)
+        throw std::string("MemoryIO: Cannot read beyond the end of the stream\n");
+
     memcpy(outBuffer, memory + pos, len);
     pos += len;
 }
 
 void MemoryIO::WriteBytes(BYTE *buffer, DWORD len)
 {
+    if (pos + len > length)
+    {
+        if (!growable)
+            throw std::string("MemoryIO: Cannot write beyond the end of the stream\n");
+        grow(pos + len);
+    }
+
     memcpy(memory + pos, buffer, len);
     pos += len;
 }
@@ -66,3 +83,82 @@ void MemoryIO::Flush()
 
 }
 
+bool MemoryIO::IsGrowable()
+{
+    return growable;
+}
+
+BYTE *MemoryIO::GetBuffer()
+{
+    return memory;
+}
+
+void MemoryIO::Reserve(size_t capacity)
+{
+    if (!growable)
+        throw std::string("MemoryIO: Cannot reserve memory for a fixed size stream\n");
+
+    if (capacity > storage.capacity())
+    {
+        storage.reserve(capacity);
+        memory = storage.empty() ? NULL : &storage[0];
+    }
+}
+
+void MemoryIO::Resize(UINT64 length)
+{
+    if (!growable)
+        throw std::string("MemoryIO: Cannot resize a fixed size stream\n");
+
+    if (length > this->length)
+        grow(length);
+    else
+    {
+        storage.resize((size_t)length);
+        this->length = length;
+        memory = storage.empty() ? NULL : &storage[0];
+    }
+}
+
+void MemoryIO::Shrink()
+{
+    if (!growable)
+        throw std::string("MemoryIO: Cannot shrink a fixed size stream\n");
+
+    std::vector<BYTE>(storage).swap(storage);
+    memory = storage.empty() ? NULL : &storage[0];
+}
+
+void MemoryIO::TakeBuffer(std::vector<BYTE> &out)
+{
+    if (!growable)
+        throw std::string("MemoryIO: Cannot take the memory of a fixed size stream\n");
+
+    out.clear();
+    out.swap(storage);
+
+    memory = NULL;
+    length = 0;
+    pos = 0;
+}
+
+void MemoryIO::grow(UINT64 length)
+{
+    if (length > (UINT64)storage.max_size())
+        throw std::string("MemoryIO: Stream is too large\n");
+
+    // grow geometrically so that writing a byte at a time doesn't reallocate every time
+    if (length > storage.capacity())
+    {
+        size_t capacity = storage.capacity() * 2;
+        if (capacity < length)
+            capacity = (size_t)length;
+        if (capacity < 0x1000)
+            capacity = 0x1000;
+        storage.reserve(capacity);
+    }
+
+    storage.resize((size_t)length);
+    this->length = length;
+    memory = &storage[0];
+}
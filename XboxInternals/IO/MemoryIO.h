@@ -3,12 +3,18 @@
 
 #include "winnames.h"
 #include <string.h>
+#include <vector>
 #include "BaseIO.h"
 
 class XBOXINTERNALSSHARED_EXPORT MemoryIO : public BaseIO
 {
 public:
+    // wrap an existing buffer, it can't grow and still belongs to the caller
     MemoryIO(BYTE *data, size_t length);
+
+    // create an empty stream that owns its memory and grows as it's written to
+    explicit MemoryIO(size_t capacity = 0);
+
     virtual ~MemoryIO();
 
     void SetPosition(UINT64 pos, std::ios_base::seek_dir dir = std::ios_base::beg);
@@ -21,11 +27,36 @@ public:
     void Close();
     void Flush();
 
+    // check if the stream owns its memory and is able to grow
+    bool IsGrowable();
+
+    // get the memory that holds the stream, only valid until the stream grows
+    BYTE *GetBuffer();
+
+    // make sure there's room for capacity bytes without having to reallocate, growable streams only
+    void Reserve(size_t capacity);
+
+    // change the length of the stream, new bytes are zeroed, growable streams only
+    void Resize(UINT64 length);
+
+    // free the memory reserved past the end of the stream, growable streams only
+    void Shrink();
+
+    // hand the stream's memory over to out without copying it, the stream is left empty
+    void TakeBuffer(std::vector<BYTE> &out);
+
 private:
+    // the memory used by growable streams
+    std::vector<BYTE> storage;
+    bool growable;
+
     BYTE *memory;
-    size_t length;
+    UINT64 length;
+
+    UINT64 pos;
 
-    DWORD pos;
+    // make sure there's room for length bytes in the stream
+    void grow(UINT64 length);
 };
 
 #endif // MEMORYSTREAM_H
@@ -1,5 +1,6 @@
 #include "SvodMultiFileIO.h"
 #include <dirent.h>
+#include <algorithm>
 
 using namespace std;
 
@@ -44,6 +45,9 @@ void SvodMultiFileIO::loadDirectories(string path)
                 files.push_back(fullName);
         }
         closedir (dir);
+
+        // readdir doesn't return the files in any particular order, but Data0000 has to come first
+        std::sort(files.begin(), files.end());
     }
     else
         throw string("MultiFileIO: Error opening directory\n");
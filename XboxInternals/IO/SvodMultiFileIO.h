@@ -1,5 +1,5 @@
-#ifndef MULTIFILEIO_H
-#define MULTIFILEIO_H
+#ifndef SVODMULTIFILEIO_H
+#define SVODMULTIFILEIO_H
 
 #include "IO/FileIO.h"
 #include <iostream>
@@ -56,4 +56,4 @@ private:
     void loadDirectories(string path);
 };
 
-#endif // MULTIFILEIO_H
+#endif // SVODMULTIFILEIO_H
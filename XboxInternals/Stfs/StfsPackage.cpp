@@ -308,8 +308,9 @@ DWORD StfsPackage::GetHashAddressOfBlock(DWORD blockNum)
             DWORD level1Off = ((topTable.entries[blockNum / 0x70E4].status & 0x40) << 6);
             DWORD pos = ((ComputeLevel1BackingHashBlockNumber(blockNum) << 0xC) + firstHashTableAddress +
                         level1Off) +( (blockNum % 0xAA) * 0x18);
-            io->SetPosition(pos + 0x14);
-            hashAddr += ((io->ReadByte() & 0x40) << 6);
+            BYTE status;
+            ReadAt(pos + 0x14, &status, 1);
+            hashAddr += ((status & 0x40) << 6);
             break;
     }
     return hashAddr;
@@ -320,14 +321,14 @@ HashEntry StfsPackage::GetBlockHashEntry(DWORD blockNum)
     if (blockNum >= metaData->stfsVolumeDescriptor.allocatedBlockCount)
         throw string("STFS: Reference to illegal block number.\n");
 
-    // go to the position of the hash address
-    io->SetPosition(GetHashAddressOfBlock(blockNum));
-
     // read the hash entry
+    BYTE rawEntry[0x18];
+    ReadAt(GetHashAddressOfBlock(blockNum), rawEntry, 0x18);
+
     HashEntry he;
-    io->ReadBytes(he.blockHash, 0x14);
-    he.status = io->ReadByte();
-    he.nextBlock = io->ReadInt24();
+    memcpy(he.blockHash, rawEntry, 0x14);
+    he.status = rawEntry[0x14];
+    he.nextBlock = (rawEntry[0x15] << 16) | (rawEntry[0x16] << 8) | rawEntry[0x17];
 
     return he;
 }
@@ -341,11 +342,17 @@ void StfsPackage::ExtractBlock(DWORD blockNum, BYTE *data, DWORD length)
     if (length > 0x1000)
         throw string("STFS: length cannot be greater 0x1000.\n");
 
-    // go to the block's position
-    io->SetPosition(BlockToAddress(blockNum));
-
     // read the data, and return
-    io->ReadBytes(data, length);
+    ReadAt(BlockToAddress(blockNum), data, length);
+}
+
+void StfsPackage::ReadAt(DWORD address, BYTE *outBuffer, DWORD length)
+{
+    // the seek and the read have to happen together, otherwise another reader could move the io
+    MutexLocker locker(ioMutex);
+
+    io->SetPosition(address);
+    io->ReadBytes(outBuffer, length);
 }
 
 void StfsPackage::ReadFileListing()
@@ -423,8 +430,14 @@ StfsFileListing StfsPackage::GetFileListing(bool forceUpdate)
 {
     // update the file listing from file if requested
     if(forceUpdate)
+    {
+        WriteLocker locker(lock);
         ReadFileListing();
+        return fileListing;
+    }
 
+    // the copy is the caller's snapshot, writers can't change it out from under them
+    ReadLocker locker(lock);
     return fileListing;
 }
 
@@ -440,11 +453,13 @@ DWORD StfsPackage::GetFileMagic(StfsFileEntry entry)
     if (entry.fileSize < 4)
         return 0;
 
-    // seek to the begining of the file in the package
-    io->SetPosition(BlockToAddress(entry.startingBlockNum));
+    ReadLocker locker(lock);
 
-    // read the magic
-    return io->ReadDword();
+    // read the magic from the begining of the file in the package
+    BYTE magic[4];
+    ReadAt(BlockToAddress(entry.startingBlockNum), magic, 4);
+
+    return (magic[0] << 24) | (magic[1] << 16) | (magic[2] << 8) | magic[3];
 }
 
 void StfsPackage::ExtractFile(string pathInPackage, string outPath, void (*extractProgress)(void*,
@@ -462,7 +477,7 @@ void StfsPackage::ExtractFile(StfsFileEntry *entry, string outPath, void (*extra
 {
     if (entry->nameLen == 0)
     {
-        except.str(std::string());
+        stringstream except;
         except << "STFS: File '" << entry->name.c_str() << "' doesn't exist in the package.\n";
         throw except.str();
     }
@@ -470,14 +485,30 @@ void StfsPackage::ExtractFile(StfsFileEntry *entry, string outPath, void (*extra
     // create/truncate our out file
     FileIO outFile(outPath, true);
 
+    ExtractFile(entry, &outFile, extractProgress, arg);
+
+    // cleanup
+    outFile.Close();
+}
+
+void StfsPackage::ExtractFile(StfsFileEntry *entry, BaseIO *outIO, void (*extractProgress)(void*,
+        DWORD, DWORD), void *arg)
+{
+    if (entry->nameLen == 0)
+    {
+        stringstream except;
+        except << "STFS: File '" << entry->name.c_str() << "' doesn't exist in the package.\n";
+        throw except.str();
+    }
+
+    ReadLocker locker(lock);
+
     // get the file size that we are extracting
     DWORD fileSize = entry->fileSize;
 
     // make a special case for files of size 0
     if (fileSize == 0)
     {
-        outFile.Close();
-
         // update progress if needed
         if (extractProgress != NULL)
             extractProgress(arg, 1, 1);
@@ -491,9 +522,9 @@ void StfsPackage::ExtractFile(StfsFileEntry *entry, string outPath, void (*extra
         // allocate 0xAA blocks of memory, for maximum efficiency, yo
         BYTE *buffer = new BYTE[0xAA000];
 
-        // seek to the begining of the file
+        // start at the begining of the file
         DWORD startAddress = BlockToAddress(entry->startingBlockNum);
-        io->SetPosition(startAddress);
+        DWORD address = startAddress;
 
         // calculate the number of blocks to read before we hit a table
         DWORD blockCount = (ComputeLevel0BackingHashBlockNumber(entry->startingBlockNum) + blockStep[0])
@@ -502,23 +533,22 @@ void StfsPackage::ExtractFile(StfsFileEntry *entry, string outPath, void (*extra
         // pick up the change at the begining, until we hit a hash table
         if ((DWORD)entry->blocksForFile <= blockCount)
         {
-            io->ReadBytes(buffer, entry->fileSize);
-            outFile.Write(buffer, entry->fileSize);
+            ReadAt(address, buffer, entry->fileSize);
+            outIO->Write(buffer, entry->fileSize);
 
             // update progress if needed
             if (extractProgress != NULL)
                 extractProgress(arg, entry->blocksForFile, entry->blocksForFile);
 
-            outFile.Close();
-
             // free the temp buffer
             delete[] buffer;
             return;
         }
         else
         {
-            io->ReadBytes(buffer, blockCount << 0xC);
-            outFile.Write(buffer, blockCount << 0xC);
+            ReadAt(address, buffer, blockCount << 0xC);
+            outIO->Write(buffer, blockCount << 0xC);
+            address += blockCount << 0xC;
 
             // update progress if needed
             if (extractProgress != NULL)
@@ -530,14 +560,14 @@ void StfsPackage::ExtractFile(StfsFileEntry *entry, string outPath, void (*extra
         while (tempSize >= 0xAA000)
         {
             // skip past the hash table(s)
-            DWORD currentPos = io->GetPosition();
-            io->SetPosition(currentPos + GetHashTableSkipSize(currentPos));
+            address += GetHashTableSkipSize(address);
 
             // read in the 0xAA blocks between the tables
-            io->ReadBytes(buffer, 0xAA000);
+            ReadAt(address, buffer, 0xAA000);
+            address += 0xAA000;
 
             // Write the bytes to the out file
-            outFile.Write(buffer, 0xAA000);
+            outIO->Write(buffer, 0xAA000);
 
             tempSize -= 0xAA000;
             blockCount += 0xAA;
@@ -551,14 +581,13 @@ void StfsPackage::ExtractFile(StfsFileEntry *entry, string outPath, void (*extra
         if (tempSize != 0)
         {
             // skip past the hash table(s)
-            DWORD currentPos = io->GetPosition();
-            io->SetPosition(currentPos + GetHashTableSkipSize(currentPos));
+            address += GetHashTableSkipSize(address);
 
             // read in the extra crap
-            io->ReadBytes(buffer, tempSize);
+            ReadAt(address, buffer, tempSize);
 
             // Write it to the out file
-            outFile.Write(buffer, tempSize);
+            outIO->Write(buffer, tempSize);
 
             // update progress if needed
             if (extractProgress != NULL)
@@ -584,7 +613,7 @@ void StfsPackage::ExtractFile(StfsFileEntry *entry, string outPath, void (*extra
         for(DWORD i = 0; i < fullReadCounts; i++)
         {
             ExtractBlock(block, data);
-            outFile.Write(data, 0x1000);
+            outIO->Write(data, 0x1000);
 
             block = GetBlockHashEntry(block).nextBlock;
 
@@ -597,16 +626,13 @@ void StfsPackage::ExtractFile(StfsFileEntry *entry, string outPath, void (*extra
         if (fileSize != 0)
         {
             ExtractBlock(block, data, fileSize);
-            outFile.Write(data, fileSize);
+            outIO->Write(data, fileSize);
 
             // call the extract progress function if needed
             if (extractProgress != NULL)
                 extractProgress(arg, entry->blocksForFile, entry->blocksForFile);
         }
     }
-
-    // cleanup
-    outFile.Close();
 }
 
 DWORD StfsPackage::GetHashTableSkipSize(DWORD tableAddress)
@@ -636,12 +662,20 @@ StfsFileEntry StfsPackage::GetFileEntry(string pathInPackage, bool checkFolders,
         StfsFileEntry *newEntry)
 {
     StfsFileEntry entry;
-    GetFileEntry(SplitString(pathInPackage, "\\"), &fileListing, &entry, newEntry, (newEntry != NULL),
-            checkFolders);
+    if (newEntry != NULL)
+    {
+        WriteLocker locker(lock);
+        GetFileEntry(SplitString(pathInPackage, "\\"), &fileListing, &entry, newEntry, true, checkFolders);
+    }
+    else
+    {
+        ReadLocker locker(lock);
+        GetFileEntry(SplitString(pathInPackage, "\\"), &fileListing, &entry, NULL, false, checkFolders);
+    }
 
     if (entry.nameLen == 0)
     {
-        except.str(std::string());
+        stringstream except;
         except << "STFS: File entry '" << pathInPackage.c_str() << "' cannot be found in the package.\n";
         throw except.str();
     }
@@ -651,6 +685,8 @@ StfsFileEntry StfsPackage::GetFileEntry(string pathInPackage, bool checkFolders,
 
 bool StfsPackage::FileExists(string pathInPackage)
 {
+    ReadLocker locker(lock);
+
     StfsFileEntry entry;
     GetFileEntry(SplitString(pathInPackage, "\\"), &fileListing, &entry);
     return (entry.nameLen != 0);
@@ -858,22 +894,15 @@ DWORD StfsPackage::GetHashTableEntryCount(DWORD index, Level lvl)
 
 void StfsPackage::Rehash()
 {
+    WriteLocker locker(lock);
+
     BYTE blockBuffer[0x1000];
+    vector<BYTE> dataBlocks(0xAA * 0x1000);
     switch (topLevel)
     {
         case Zero:
-            // set the position to the first data block in the file
-            io->SetPosition(BlockToAddress(0));
-            // iterate through all of the data blocks
-            for (DWORD i = 0; i < topTable.entryCount; i++)
-            {
-                // read in the current data block
-                io->ReadBytes(blockBuffer, 0x1000);
-
-                // hash the block
-                HashBlock(blockBuffer, topTable.entries[i].blockHash);
-            }
-
+            // hash all of the data blocks in the file
+            HashDataBlocks(0, &topTable, &dataBlocks.at(0));
             break;
 
         case One:
@@ -883,18 +912,8 @@ void StfsPackage::Rehash()
                 // get the current level0 hash table
                 HashTable level0Table = GetLevelNHashTable(i, Zero);
 
-                // set the position to the first data block in this table
-                io->SetPosition(BlockToAddress(i * 0xAA));
-
-                // iterate through all of the data blocks this table hashes
-                for (DWORD x = 0; x < level0Table.entryCount; x++)
-                {
-                    // read in the current data block
-                    io->ReadBytes(blockBuffer, 0x1000);
-
-                    // hash the block
-                    HashBlock(blockBuffer, level0Table.entries[x].blockHash);
-                }
+                // hash all of the data blocks this table hashes
+                HashDataBlocks(i * 0xAA, &level0Table, &dataBlocks.at(0));
 
                 // build the table for hashing and writing
                 BuildTableInMemory(&level0Table, blockBuffer);
@@ -921,18 +940,8 @@ void StfsPackage::Rehash()
                     // get the current level0 hash table
                     HashTable level0Table = GetLevelNHashTable((i * 0xAA) + x, Zero);
 
-                    // set the position to the first data block in this table
-                    io->SetPosition(BlockToAddress((i * 0x70E4) + (x * 0xAA)));
-
-                    // iterate through all of the data blocks hashed in this table
-                    for (DWORD y = 0; y < level0Table.entryCount; y++)
-                    {
-                        // read the current data block
-                        io->ReadBytes(blockBuffer, 0x1000);
-
-                        // hash the data block
-                        HashBlock(blockBuffer, level0Table.entries[y].blockHash);
-                    }
+                    // hash all of the data blocks hashed in this table
+                    HashDataBlocks((i * 0x70E4) + (x * 0xAA), &level0Table, &dataBlocks.at(0));
 
                     // build the table for hashing and writing
                     BuildTableInMemory(&level0Table, blockBuffer);
@@ -1007,12 +1016,9 @@ void StfsPackage::Rehash()
     io->ReadBytes(buffer, headerSize);
 
     // hash the header
-    Botan::SHA_160 sha1;
-    sha1.update(buffer, headerSize);
-    sha1.final(metaData->headerHash);
+    Sha1::Hash(buffer, headerSize, metaData->headerHash);
 
     delete[] buffer;
-    sha1.clear();
 
     metaData->WriteMetaData();
 }
@@ -1122,11 +1128,15 @@ DWORD StfsPackage::GetTableHashAddress(DWORD index, Level lvl)
 
 void StfsPackage::Resign(string kvPath)
 {
+    WriteLocker locker(lock);
+
     metaData->ResignHeader(kvPath);
 }
 
 void StfsPackage::Resign(BYTE* kvData, size_t length)
 {
+    WriteLocker locker(lock);
+
     metaData->ResignHeader(kvData, length);
 }
 
@@ -1142,11 +1152,23 @@ void StfsPackage::SetBlockStatus(DWORD blockNum, BlockStatusLevelZero status)
 
 void StfsPackage::HashBlock(BYTE *block, BYTE *outBuffer)
 {
-    // hash the block
-    Botan::SHA_160 sha1;
-    sha1.clear();
-    sha1.update(block, 0x1000);
-    sha1.final(outBuffer);
+    Sha1::Hash(block, 0x1000, outBuffer);
+}
+
+void StfsPackage::HashDataBlocks(DWORD startingBlockNum, HashTable *table, BYTE *buffer)
+{
+    if (table->entryCount == 0)
+        return;
+
+    // the data blocks a level 0 table hashes are all next to each other, so they can be read at once
+    io->SetPosition(BlockToAddress(startingBlockNum));
+    io->ReadBytes(buffer, table->entryCount * 0x1000);
+
+    BYTE hashes[0xAA * 0x14];
+    Sha1::HashBlocks(buffer, table->entryCount, hashes);
+
+    for (DWORD i = 0; i < table->entryCount; i++)
+        memcpy(table->entries[i].blockHash, hashes + i * 0x14, 0x14);
 }
 
 void StfsPackage::BuildTableInMemory(HashTable *table, BYTE *outBuffer)
@@ -1167,6 +1189,8 @@ void StfsPackage::BuildTableInMemory(HashTable *table, BYTE *outBuffer)
 
 void StfsPackage::RemoveFile(StfsFileEntry entry)
 {
+    WriteLocker locker(lock);
+
     bool found = false;
 
     vector<StfsFileEntry> files, folders;
@@ -1364,6 +1388,8 @@ void StfsPackage::WriteFileEntry(StfsFileEntry *entry)
 
 void StfsPackage::RemoveFile(string pathInPackage)
 {
+    WriteLocker locker(lock);
+
     RemoveFile(GetFileEntry(pathInPackage));
 }
 
@@ -1596,6 +1622,8 @@ void StfsPackage::UpdateEntry(string pathInPackage, StfsFileEntry entry)
 StfsFileEntry StfsPackage::InjectFile(string path, string pathInPackage,
         void(*injectProgress)(void*, DWORD, DWORD), void *arg)
 {
+    WriteLocker locker(lock);
+
     if(FileExists(pathInPackage))
         throw string("STFS: File already exists in the package.\n");
 
@@ -1727,6 +1755,8 @@ StfsFileEntry StfsPackage::InjectFile(string path, string pathInPackage,
 StfsFileEntry StfsPackage::InjectData(BYTE *data, DWORD length, string pathInPackage,
         void (*injectProgress)(void *, DWORD, DWORD), void *arg)
 {
+    WriteLocker locker(lock);
+
     if(FileExists(pathInPackage))
         throw string("STFS: File already exists in the package.\n");
 
@@ -1838,6 +1868,8 @@ StfsFileEntry StfsPackage::InjectData(BYTE *data, DWORD length, string pathInPac
 void StfsPackage::ReplaceFile(string path, StfsFileEntry *entry, string pathInPackage,
         void (*replaceProgress)(void *, DWORD, DWORD), void *arg)
 {
+    WriteLocker locker(lock);
+
     if (entry->nameLen == 0)
         throw string("STFS: File doesn't exists in the package.\n");
 
@@ -1978,12 +2010,16 @@ void StfsPackage::ReplaceFile(string path, StfsFileEntry *entry, string pathInPa
 void StfsPackage::ReplaceFile(string path, string pathInPackage, void (*replaceProgress)(void *,
         DWORD, DWORD), void *arg)
 {
+    WriteLocker locker(lock);
+
     StfsFileEntry entry = GetFileEntry(pathInPackage);
     ReplaceFile(path, &entry, pathInPackage, replaceProgress, arg);
 }
 
 void StfsPackage::RenameFile(string newName, string pathInPackage)
 {
+    WriteLocker locker(lock);
+
     StfsFileEntry entry = GetFileEntry(pathInPackage, true);
     entry.name = newName;
 
@@ -1996,11 +2032,15 @@ void StfsPackage::RenameFile(string newName, string pathInPackage)
 
 void StfsPackage::Close()
 {
+    WriteLocker locker(lock);
+
     io->Close();
 }
 
 void StfsPackage::CreateFolder(string pathInPackage)
 {
+    WriteLocker locker(lock);
+
     // split the string and open a io
     vector<string> split = SplitString(pathInPackage, "\\");
 
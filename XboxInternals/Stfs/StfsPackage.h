@@ -9,12 +9,13 @@
 #include <stdlib.h>
 #include "IO/FileIO.h"
 #include "XContentHeader.h"
+#include "Threading/Thread.h"
+#include "Cryptography/Sha1.h"
 
 #include <botan/botan.h>
 #include <botan/pubkey.h>
 #include <botan/rsa.h>
 #include <botan/emsa.h>
-#include <botan/sha160.h>
 #include <botan/emsa3.h>
 #include <botan/look_pk.h>
 
@@ -72,6 +73,9 @@ enum StfsPackageFlags
     StfsPackageFemale = 4     // only used when creating a packge
 };
 
+// any number of threads can read from a package at once (listing, extracting, magic lookups), the
+// functions that modify it wait for the readers to finish and run one at a time. The metadata isn't
+// covered by this, it's up to the caller
 class XBOXINTERNALSSHARED_EXPORT StfsPackage
 {
 public:
@@ -94,6 +98,10 @@ public:
     void ExtractFile(StfsFileEntry *entry, string outPath, void(*extractProgress)(void*, DWORD,
             DWORD) = NULL, void *arg = NULL);
 
+    // Description: extract a file (by FileEntry) to the current position of an io, such as a MemoryIO
+    void ExtractFile(StfsFileEntry *entry, BaseIO *outIO, void(*extractProgress)(void*, DWORD,
+            DWORD) = NULL, void *arg = NULL);
+
     // Description: get the file entry of a file's path, sets nameLen to '0' if not found
     StfsFileEntry GetFileEntry(string pathInPackage, bool checkFolders = false,
             StfsFileEntry *newEntry = NULL);
@@ -162,9 +170,14 @@ private:
     StfsFileListing writtenToFile;
 
     BaseIO *io;
-    stringstream except;
     bool ioPassedIn;
 
+    // readers share the lock, writers hold it on their own
+    ReadWriteLock lock;
+
+    // keeps the io's position from moving between a reader's seek and its read
+    Mutex ioMutex;
+
     Sex packageSex;
     DWORD blockStep[2];
     DWORD firstHashTableAddress;
@@ -182,12 +195,18 @@ private:
     // Description: set the out buffer to the sha1 of the block
     void HashBlock(BYTE *block, BYTE *outBuffer);
 
+    // Description: hash the data blocks in a level 0 table starting at startingBlockNum into its entries, buffer must hold 0xAA blocks
+    void HashDataBlocks(DWORD startingBlockNum, HashTable *table, BYTE *buffer);
+
     // Description: swap the table used so there is a backup of the data modified
     void SwapTable(DWORD index, Level lvl);
 
     // Description: extract a block's data
     void ExtractBlock(DWORD blockNum, BYTE *data, DWORD length = 0x1000);
 
+    // Description: read length bytes at the address, safe to call from multiple readers at once
+    void ReadAt(DWORD address, BYTE *outBuffer, DWORD length);
+
     // Description: convert a block number into a true block number, where the first block is the first hash table
     DWORD ComputeBackingDataBlockNumber(DWORD blockNum);
 
@@ -0,0 +1,60 @@
+#include "StfsPackageBuilder.h"
+
+// the size of the writes to the out io
+#define BUILDER_WRITE_SIZE 0x100000
+
+StfsPackageBuilder::StfsPackageBuilder(DWORD flags, size_t capacity) :
+    io(new MemoryIO(capacity)), package(NULL)
+{
+    try
+    {
+        package = new StfsPackage(io, flags | StfsPackageCreate);
+    }
+    catch (...)
+    {
+        delete io;
+        throw;
+    }
+}
+
+StfsPackageBuilder::~StfsPackageBuilder()
+{
+    delete package;
+    delete io;
+}
+
+StfsPackage *StfsPackageBuilder::GetPackage()
+{
+    return package;
+}
+
+UINT64 StfsPackageBuilder::GetLength()
+{
+    return io->Length();
+}
+
+void StfsPackageBuilder::Write(BaseIO *out, void(*progress)(void*, DWORD, DWORD), void *arg)
+{
+    BYTE *buffer = io->GetBuffer();
+    UINT64 length = io->Length();
+
+    DWORD chunkCount = (DWORD)((length + BUILDER_WRITE_SIZE - 1) / BUILDER_WRITE_SIZE);
+    for (DWORD i = 0; i < chunkCount; i++)
+    {
+        UINT64 offset = (UINT64)i * BUILDER_WRITE_SIZE;
+        DWORD len = (length - offset > BUILDER_WRITE_SIZE) ? BUILDER_WRITE_SIZE : (DWORD)(length - offset);
+        out->Write(buffer + offset, len);
+
+        if (progress)
+            progress(arg, i + 1, chunkCount);
+    }
+
+    out->Flush();
+}
+
+void StfsPackageBuilder::Save(string path, void(*progress)(void*, DWORD, DWORD), void *arg)
+{
+    FileIO out(path, true);
+    Write(&out, progress, arg);
+    out.Close();
+}
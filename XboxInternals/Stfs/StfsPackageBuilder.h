@@ -0,0 +1,36 @@
+#pragma once
+
+#include "StfsPackage.h"
+#include "IO/MemoryIO.h"
+
+#include "XboxInternals_global.h"
+
+// builds a new package entirely in memory, so injecting files and rehashing never touch the disk.
+// The finished package is written out sequentially in one go
+class XBOXINTERNALSSHARED_EXPORT StfsPackageBuilder
+{
+public:
+    // Description: start a new package in memory, StfsPackageCreate is implied. capacity is how much
+    // memory to reserve up front, if the final size is roughly known
+    StfsPackageBuilder(DWORD flags = 0, size_t capacity = 0);
+    ~StfsPackageBuilder();
+
+    // Description: get the package being built, it's filled in, rehashed and resigned like any other
+    StfsPackage *GetPackage();
+
+    // Description: get the current size of the package
+    UINT64 GetLength();
+
+    // Description: write the package to the current position of out in a single sequential pass
+    void Write(BaseIO *out, void(*progress)(void*, DWORD, DWORD) = NULL, void *arg = NULL);
+
+    // Description: write the package to a new file, the file is overwritten if it exists
+    void Save(string path, void(*progress)(void*, DWORD, DWORD) = NULL, void *arg = NULL);
+
+private:
+    StfsPackageBuilder(const StfsPackageBuilder&);
+    StfsPackageBuilder &operator=(const StfsPackageBuilder&);
+
+    MemoryIO *io;
+    StfsPackage *package;
+};
@@ -253,10 +253,7 @@ void XContentHeader::FixHeaderHash()
     io->ReadBytes(data, realHeaderSize);
 
     // hash the data
-    Botan::SHA_160 sha1;
-    sha1.clear();
-    sha1.update(data, realHeaderSize);
-    sha1.final(headerHash);
+    Sha1::Hash(data, realHeaderSize, headerHash);
 
     delete[] data;
 
@@ -541,10 +538,7 @@ void XContentHeader::ResignHeader(BaseIO& kvIo)
     io->ReadBytes(buffer, realHeaderSize);
 
     // hash the header
-    Botan::SHA_160 sha1;
-    sha1.clear();
-    sha1.update(buffer, realHeaderSize);
-    sha1.final(headerHash);
+    Sha1::Hash(buffer, realHeaderSize, headerHash);
 
     delete[] buffer;
 
@@ -8,6 +8,7 @@
 #include "../AvatarAsset/AvatarAssetDefinintions.h"
 #include "../Gpd/XdbfHelpers.h"
 #include "../Cryptography/XeCrypt.h"
+#include "../Cryptography/Sha1.h"
 
 #include <iostream>
 
@@ -15,7 +16,6 @@
 #include <botan/pubkey.h>
 #include <botan/rsa.h>
 #include <botan/emsa.h>
-#include <botan/sha160.h>
 #include <botan/emsa3.h>
 #include <botan/look_pk.h>
 
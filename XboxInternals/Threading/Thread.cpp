@@ -0,0 +1,404 @@
+#include "Thread.h"
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <process.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+class Mutex::Impl
+{
+public:
+#ifdef _WIN32
+    CRITICAL_SECTION section;
+#else
+    pthread_mutex_t mutex;
+#endif
+};
+
+class Condition::Impl
+{
+public:
+#ifdef _WIN32
+    CONDITION_VARIABLE condition;
+#else
+    pthread_cond_t condition;
+#endif
+};
+
+#ifdef _WIN32
+typedef DWORD ThreadId;
+
+static ThreadId currentThreadId()
+{
+    return GetCurrentThreadId();
+}
+
+static bool threadIdsEqual(ThreadId a, ThreadId b)
+{
+    return a == b;
+}
+#else
+typedef pthread_t ThreadId;
+
+static ThreadId currentThreadId()
+{
+    return pthread_self();
+}
+
+static bool threadIdsEqual(ThreadId a, ThreadId b)
+{
+    return pthread_equal(a, b) != 0;
+}
+#endif
+
+struct LockHolder
+{
+    ThreadId thread;
+    DWORD depth;
+};
+
+class ReadWriteLock::Impl
+{
+public:
+    ThreadId writer;
+    std::vector<LockHolder> readers;
+
+    // get the index of the current thread in the readers, -1 if it isn't reading
+    int findReader()
+    {
+        ThreadId current = currentThreadId();
+        for (DWORD i = 0; i < readers.size(); i++)
+            if (threadIdsEqual(readers.at(i).thread, current))
+                return i;
+        return -1;
+    }
+};
+
+class Thread::Impl
+{
+public:
+#ifdef _WIN32
+    HANDLE thread;
+#else
+    pthread_t thread;
+#endif
+    bool started;
+};
+
+// gives the platform's entry point access to the thread
+class ThreadEntry
+{
+public:
+    static void Run(Thread *thread)
+    {
+        try
+        {
+            thread->Run();
+        }
+        catch (std::string error)
+        {
+            thread->failed = true;
+            thread->error = error;
+        }
+        catch (...)
+        {
+            thread->failed = true;
+            thread->error = "Thread: Unknown error.\n";
+        }
+    }
+};
+
+#ifdef _WIN32
+static unsigned __stdcall threadEntry(void *arg)
+{
+    ThreadEntry::Run(reinterpret_cast<Thread*>(arg));
+    return 0;
+}
+#else
+extern "C" void *threadEntry(void *arg)
+{
+    ThreadEntry::Run(reinterpret_cast<Thread*>(arg));
+    return NULL;
+}
+#endif
+
+Mutex::Mutex() :
+    impl(new Impl)
+{
+#ifdef _WIN32
+    InitializeCriticalSection(&impl->section);
+#else
+    pthread_mutex_init(&impl->mutex, NULL);
+#endif
+}
+
+Mutex::~Mutex()
+{
+#ifdef _WIN32
+    DeleteCriticalSection(&impl->section);
+#else
+    pthread_mutex_destroy(&impl->mutex);
+#endif
+    delete impl;
+}
+
+void Mutex::Lock()
+{
+#ifdef _WIN32
+    EnterCriticalSection(&impl->section);
+#else
+    pthread_mutex_lock(&impl->mutex);
+#endif
+}
+
+void Mutex::Unlock()
+{
+#ifdef _WIN32
+    LeaveCriticalSection(&impl->section);
+#else
+    pthread_mutex_unlock(&impl->mutex);
+#endif
+}
+
+MutexLocker::MutexLocker(Mutex &mutex) :
+    mutex(mutex)
+{
+    mutex.Lock();
+}
+
+MutexLocker::~MutexLocker()
+{
+    mutex.Unlock();
+}
+
+Condition::Condition() :
+    impl(new Impl)
+{
+#ifdef _WIN32
+    InitializeConditionVariable(&impl->condition);
+#else
+    pthread_cond_init(&impl->condition, NULL);
+#endif
+}
+
+Condition::~Condition()
+{
+#ifndef _WIN32
+    pthread_cond_destroy(&impl->condition);
+#endif
+    delete impl;
+}
+
+void Condition::Wait(Mutex &mutex)
+{
+#ifdef _WIN32
+    SleepConditionVariableCS(&impl->condition, &mutex.impl->section, INFINITE);
+#else
+    pthread_cond_wait(&impl->condition, &mutex.impl->mutex);
+#endif
+}
+
+void Condition::Signal()
+{
+#ifdef _WIN32
+    WakeConditionVariable(&impl->condition);
+#else
+    pthread_cond_signal(&impl->condition);
+#endif
+}
+
+void Condition::Broadcast()
+{
+#ifdef _WIN32
+    WakeAllConditionVariable(&impl->condition);
+#else
+    pthread_cond_broadcast(&impl->condition);
+#endif
+}
+
+ReadWriteLock::ReadWriteLock() :
+    impl(new Impl), waitingWriters(0), writeDepth(0)
+{
+}
+
+ReadWriteLock::~ReadWriteLock()
+{
+    delete impl;
+}
+
+void ReadWriteLock::LockForRead()
+{
+    MutexLocker locker(mutex);
+
+    // the writer can read what it's writing
+    if (writeDepth != 0 && threadIdsEqual(impl->writer, currentThreadId()))
+    {
+        writeDepth++;
+        return;
+    }
+
+    // a thread that's already reading can't be held up by a waiting writer, or it would never finish
+    int index = impl->findReader();
+    if (index != -1)
+    {
+        impl->readers.at(index).depth++;
+        return;
+    }
+
+    while (writeDepth != 0 || waitingWriters != 0)
+        writerDone.Wait(mutex);
+
+    LockHolder holder = { currentThreadId(), 1 };
+    impl->readers.push_back(holder);
+}
+
+void ReadWriteLock::LockForWrite()
+{
+    MutexLocker locker(mutex);
+
+    if (writeDepth != 0 && threadIdsEqual(impl->writer, currentThreadId()))
+    {
+        writeDepth++;
+        return;
+    }
+
+    // waiting for ourselves to finish reading would never end
+    if (impl->findReader() != -1)
+        throw std::string("Thread: Unable to write while reading on the same thread.\n");
+
+    waitingWriters++;
+    while (writeDepth != 0 || impl->readers.size() != 0)
+        readersDone.Wait(mutex);
+    waitingWriters--;
+
+    impl->writer = currentThreadId();
+    writeDepth = 1;
+}
+
+void ReadWriteLock::Unlock()
+{
+    MutexLocker locker(mutex);
+
+    if (writeDepth != 0 && threadIdsEqual(impl->writer, currentThreadId()))
+    {
+        if (--writeDepth == 0)
+        {
+            // let the next writer in, or all of the readers if there aren't any
+            readersDone.Signal();
+            writerDone.Broadcast();
+        }
+        return;
+    }
+
+    int index = impl->findReader();
+    if (index == -1)
+        throw std::string("Thread: The lock isn't held by this thread.\n");
+
+    if (--impl->readers.at(index).depth == 0)
+    {
+        impl->readers.erase(impl->readers.begin() + index);
+        if (impl->readers.size() == 0)
+            readersDone.Signal();
+    }
+}
+
+ReadLocker::ReadLocker(ReadWriteLock &lock) :
+    lock(lock)
+{
+    lock.LockForRead();
+}
+
+ReadLocker::~ReadLocker()
+{
+    lock.Unlock();
+}
+
+WriteLocker::WriteLocker(ReadWriteLock &lock) :
+    lock(lock)
+{
+    lock.LockForWrite();
+}
+
+WriteLocker::~WriteLocker()
+{
+    lock.Unlock();
+}
+
+Thread::Thread() :
+    impl(new Impl), failed(false)
+{
+    impl->started = false;
+}
+
+Thread::~Thread()
+{
+    // a thread can't be left running with nothing to run on
+    if (impl->started)
+    {
+        try
+        {
+            Join();
+        }
+        catch (...)
+        {
+        }
+    }
+
+    delete impl;
+}
+
+void Thread::Start()
+{
+    if (impl->started)
+        throw std::string("Thread: Thread has already been started.\n");
+
+    failed = false;
+    error = "";
+
+#ifdef _WIN32
+    impl->thread = (HANDLE)_beginthreadex(NULL, 0, threadEntry, this, 0, NULL);
+    if (impl->thread == 0)
+        throw std::string("Thread: Unable to create a thread.\n");
+#else
+    if (pthread_create(&impl->thread, NULL, threadEntry, this) != 0)
+        throw std::string("Thread: Unable to create a thread.\n");
+#endif
+
+    impl->started = true;
+}
+
+void Thread::Join()
+{
+    if (!impl->started)
+        return;
+
+#ifdef _WIN32
+    WaitForSingleObject(impl->thread, INFINITE);
+    CloseHandle(impl->thread);
+#else
+    pthread_join(impl->thread, NULL);
+#endif
+
+    impl->started = false;
+
+    if (failed)
+        throw error;
+}
+
+DWORD Thread::HardwareConcurrency()
+{
+    long count;
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    count = info.dwNumberOfProcessors;
+#else
+    count = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+
+    return (count > 0) ? (DWORD)count : 1;
+}
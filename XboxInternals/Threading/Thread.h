@@ -0,0 +1,148 @@
+#ifndef THREAD_H
+#define THREAD_H
+
+#include "winnames.h"
+#include <iostream>
+
+#include "XboxInternals_global.h"
+
+class XBOXINTERNALSSHARED_EXPORT Mutex
+{
+public:
+    Mutex();
+    ~Mutex();
+
+    void Lock();
+    void Unlock();
+
+private:
+    // not copyable
+    Mutex(const Mutex&);
+    Mutex &operator=(const Mutex&);
+
+    class Impl;
+    Impl *impl;
+
+    friend class Condition;
+};
+
+// locks the mutex for as long as it's in scope
+class XBOXINTERNALSSHARED_EXPORT MutexLocker
+{
+public:
+    MutexLocker(Mutex &mutex);
+    ~MutexLocker();
+
+private:
+    Mutex &mutex;
+};
+
+class XBOXINTERNALSSHARED_EXPORT Condition
+{
+public:
+    Condition();
+    ~Condition();
+
+    // unlock the mutex and wait until the condition is signalled, the mutex is locked again on return
+    void Wait(Mutex &mutex);
+
+    // wake up one waiting thread
+    void Signal();
+
+    // wake up all of the waiting threads
+    void Broadcast();
+
+private:
+    Condition(const Condition&);
+    Condition &operator=(const Condition&);
+
+    class Impl;
+    Impl *impl;
+};
+
+// lets any number of readers in at once, or a single writer. Both can be taken again by the thread
+// holding them, and a writer can also read, but a reader can't start writing
+class XBOXINTERNALSSHARED_EXPORT ReadWriteLock
+{
+public:
+    ReadWriteLock();
+    ~ReadWriteLock();
+
+    // wait until there are no writers, waiting writers go first so that they can't be starved
+    void LockForRead();
+
+    // wait until there are no other readers or writers
+    void LockForWrite();
+
+    // release the lock taken last by this thread
+    void Unlock();
+
+private:
+    ReadWriteLock(const ReadWriteLock&);
+    ReadWriteLock &operator=(const ReadWriteLock&);
+
+    class Impl;
+    Impl *impl;
+
+    Mutex mutex;
+    Condition readersDone;
+    Condition writerDone;
+    DWORD waitingWriters;
+    DWORD writeDepth;
+};
+
+// holds a read lock for as long as it's in scope
+class XBOXINTERNALSSHARED_EXPORT ReadLocker
+{
+public:
+    ReadLocker(ReadWriteLock &lock);
+    ~ReadLocker();
+
+private:
+    ReadWriteLock &lock;
+};
+
+// holds a write lock for as long as it's in scope
+class XBOXINTERNALSSHARED_EXPORT WriteLocker
+{
+public:
+    WriteLocker(ReadWriteLock &lock);
+    ~WriteLocker();
+
+private:
+    ReadWriteLock &lock;
+};
+
+class XBOXINTERNALSSHARED_EXPORT Thread
+{
+public:
+    Thread();
+    virtual ~Thread();
+
+    // start executing Run on a new thread
+    void Start();
+
+    // wait for the thread to finish, rethrows the error if Run threw one
+    void Join();
+
+    // get the amount of threads the machine can run at once
+    static DWORD HardwareConcurrency();
+
+protected:
+    // the work done on the thread, errors are thrown as strings like everywhere else
+    virtual void Run() = 0;
+
+private:
+    Thread(const Thread&);
+    Thread &operator=(const Thread&);
+
+    class Impl;
+    Impl *impl;
+
+    bool failed;
+    std::string error;
+
+    friend class ThreadEntry;
+};
+
+#endif // THREAD_H
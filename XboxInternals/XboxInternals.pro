@@ -29,6 +29,7 @@ macx {
 unix {
     INCLUDEPATH += /usr/include/botan-1.10
     LIBS += /usr/lib/libbotan-1.10.so.0
+    LIBS += -lpthread
 }
 
 SOURCES += \
@@ -59,7 +60,21 @@ SOURCES += \
     IO/FatxIO.cpp \
     Fatx/FatxDriveDetection.cpp \
     IO/SvodMultiFileIO.cpp \
-    IO/MultiFileIO.cpp
+    IO/MultiFileIO.cpp \
+    Threading/Thread.cpp \
+    Compression/Lz4.cpp \
+    Fatx/FatxBackup.cpp \
+    IO/AsyncCopy.cpp \
+    Stfs/StfsPackageBuilder.cpp \
+    Cryptography/Sha1.cpp \
+    Fatx/FatxFreeSpace.cpp \
+    Fatx/FatxAllocationTable.cpp \
+    Fatx/FatxDefragmenter.cpp \
+    Fatx/FatxContentCatalog.cpp \
+    Fatx/FatxCopier.cpp \
+    Fatx/FatxLookup.cpp \
+    Fatx/FatxMounter.cpp \
+    Fatx/FatxRecovery.cpp
 
 HEADERS +=\
         XboxInternals_global.h \
@@ -101,4 +116,18 @@ HEADERS +=\
     Fatx/FatxHelpers.h \
     Fatx/FatxDriveDetection.h \
     Fatx/FatxDrive.h \
-    Fatx/FatxConstants.h
+    Fatx/FatxConstants.h \
+    Threading/Thread.h \
+    Compression/Lz4.h \
+    Fatx/FatxBackup.h \
+    IO/AsyncCopy.h \
+    Stfs/StfsPackageBuilder.h \
+    Cryptography/Sha1.h \
+    Fatx/FatxFreeSpace.h \
+    Fatx/FatxAllocationTable.h \
+    Fatx/FatxDefragmenter.h \
+    Fatx/FatxContentCatalog.h \
+    Fatx/FatxCopier.h \
+    Fatx/FatxLookup.h \
+    Fatx/FatxMounter.h \
+    Fatx/FatxRecovery.h